@@ -61,6 +61,7 @@
 #include "switch.h"
 #include "events.h"
 #include "cfg/cfg_struct.h"
+#include "rprof.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -222,6 +223,15 @@ char *get_cfg_crt_route_name(void)
 	} while(0)
 
 
+/* accounting of module function calls, when the route profiler is on */
+#define MODF_RPROF_ENTER(cmd) \
+	((unlikely(ksr_rprof_on())) ? ksr_rprof_enter(KSR_RPROF_CMD, (cmd)) : 0)
+#define MODF_RPROF_EXIT(rpf)  \
+	do {                      \
+		if(unlikely(rpf))     \
+			ksr_rprof_exit(); \
+	} while(0)
+
 /* call a module function with normal STRING_ST params.
  * (used internally in do_action())
  * @param f_type - cmd_function type
@@ -238,14 +248,18 @@ char *get_cfg_crt_route_name(void)
 #define MODF_CALL(f_type, h, msg, src, ...)                \
 	do {                                                   \
 		cmd = (src)[0].u.data;                             \
+		rpf = MODF_RPROF_ENTER(cmd);                       \
 		ret = ((f_type)cmd->function)((msg), __VA_ARGS__); \
+		MODF_RPROF_EXIT(rpf);                              \
 		MODF_HANDLE_RETCODE(h, ret);                       \
 	} while(0)
 #else /* ! __SUNPRO_C  (gcc, icc a.s.o) */
 #define MODF_CALL(f_type, h, msg, src, params...)       \
 	do {                                                \
 		cmd = (src)[0].u.data;                          \
+		rpf = MODF_RPROF_ENTER(cmd);                    \
 		ret = ((f_type)cmd->function)((msg), ##params); \
+		MODF_RPROF_EXIT(rpf);                           \
 		MODF_HANDLE_RETCODE(h, ret);                    \
 	} while(0)
 #endif /* __SUNPRO_C */
@@ -271,7 +285,9 @@ char *get_cfg_crt_route_name(void)
 	do {                                                   \
 		cmd = (src)[0].u.data;                             \
 		MODF_RVE_PARAM_CONVERT(h, msg, cmd, src, dst);     \
+		rpf = MODF_RPROF_ENTER(cmd);                       \
 		ret = ((f_type)cmd->function)((msg), __VA_ARGS__); \
+		MODF_RPROF_EXIT(rpf);                              \
 		MODF_HANDLE_RETCODE(h, ret);                       \
 		/* free strings allocated by us or fixups */       \
 		MODF_RVE_PARAM_FREE(cmd, src, dst);                \
@@ -281,7 +297,9 @@ char *get_cfg_crt_route_name(void)
 	do {                                                   \
 		cmd = (src)[0].u.data;                             \
 		MODF_RVE_PARAM_CONVERT(h, msg, cmd, src, dst);     \
+		rpf = MODF_RPROF_ENTER(cmd);                       \
 		ret = ((f_type)cmd->function)((msg), ##params);    \
+		MODF_RPROF_EXIT(rpf);                              \
 		MODF_HANDLE_RETCODE(h, ret);                       \
 		/* free strings allocated by us or fixups */       \
 		MODF_RVE_PARAM_FREE(cmd, src, dst);                \
@@ -301,6 +319,7 @@ int do_action(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 	char *tmp;
 	char *new_uri, *end, *crt;
 	ksr_cmd_export_t *cmd;
+	int rpf;
 	int len;
 	int user;
 	struct sip_uri uri, next_hop;
@@ -708,7 +727,12 @@ int do_action(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 				goto error;
 			}
 			/*ret=((ret=run_actions(rlist[a->val[0].u.number],msg))<0)?ret:1;*/
+			rpf = (unlikely(ksr_rprof_on()) && main_rt.rlist[i] != NULL)
+						  ? ksr_rprof_enter(KSR_RPROF_ROUTE, main_rt.rlist[i])
+						  : 0;
 			ret = run_actions(h, main_rt.rlist[i], msg);
+			if(unlikely(rpf))
+				ksr_rprof_exit();
 			h->last_retcode = ret;
 			_last_returned_code = h->last_retcode;
 			h->run_flags &=
@@ -1571,15 +1595,110 @@ error:
 }
 
 
+/* log if the execution of the action took more than latency_limit_action */
+static void run_action_latency_check(struct action *t, struct timeval *tvb)
+{
+	struct timeval tve;
+	struct timezone tz;
+	unsigned int tdiff;
+
+	gettimeofday(&tve, &tz);
+	tdiff = (tve.tv_sec - tvb->tv_sec) * 1000000 + (tve.tv_usec - tvb->tv_usec);
+	if(tdiff >= cfg_get(core, core_cfg, latency_limit_action)) {
+		LOG(cfg_get(core, core_cfg, latency_log),
+				"alert - action [%s (%d)]"
+				" cfg [%s:%d] took too long [%u us]\n",
+				is_mod_func(t) ? ((cmd_export_t *)(t->val[0].u.data))->name
+							   : "corefunc",
+				t->type, (t->cfile) ? t->cfile : "", t->cline, tdiff);
+	}
+}
+
+
+/* compiled route blocks
+ * - the action list of a route block is turned in an array of operations,
+ *   with the bodies of if-else inlined and resolved jump targets, direct
+ *   calls of module functions and of sub-routes (route(N)); other actions
+ *   are executed with do_action() */
+
+/* enable compiling the route blocks (core parameter) */
+int ksr_cfg_compile = 0;
+
+enum cfg_op_code
+{
+	CFG_OP_ACT = 0, /* run do_action() */
+	CFG_OP_IF,		/* eval condition, jump to op->jmp if false */
+	CFG_OP_JMP,		/* jump to op->jmp */
+	CFG_OP_MODF0,	/* module functions by number of parameters */
+	CFG_OP_MODF1,
+	CFG_OP_MODF2,
+	CFG_OP_MODF3,
+	CFG_OP_MODF4,
+	CFG_OP_MODF5,
+	CFG_OP_MODF6,
+	CFG_OP_MODFX,
+	CFG_OP_ROUTE, /* run sub-route op->p */
+	CFG_OP_SIZE
+};
+
+typedef struct cfg_op
+{
+	int code;		  /* operation code (CFG_OP_*) */
+	int jmp;		  /* jump target index */
+	struct action *a; /* source action */
+	void *p;		  /* module function or sub-route actions */
+} cfg_op_t;
+
+typedef struct cfg_prog
+{
+	struct action *a; /* head of the compiled action list */
+	int n;			  /* number of operations */
+	int size;		  /* allocated operations */
+	cfg_op_t *ops;
+	struct cfg_prog *next;
+} cfg_prog_t;
+
+#define CFG_PROG_HASH_SIZE 256
+#define cfg_prog_hash_idx(a) \
+	((((unsigned long)(a)) >> 4) & (CFG_PROG_HASH_SIZE - 1))
+
+static cfg_prog_t *_cfg_prog_hash[CFG_PROG_HASH_SIZE];
+
+/* return the compiled operations for the action list a */
+static inline cfg_prog_t *cfg_prog_get(struct action *a)
+{
+	cfg_prog_t *prog;
+
+	for(prog = _cfg_prog_hash[cfg_prog_hash_idx(a)]; prog != NULL;
+			prog = prog->next) {
+		if(prog->a == a) {
+			return prog;
+		}
+	}
+	return NULL;
+}
+
+static int cfg_prog_exec(
+		struct run_act_ctx *h, cfg_prog_t *prog, struct sip_msg *msg);
+
 /* returns: 0, or 1 on success, <0 on error */
 /* (0 if drop or break encountered, 1 if not ) */
 int run_actions(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 {
 	struct action *t;
 	int ret;
-	struct timeval tvb = {0}, tve = {0};
+	struct timeval tvb = {0};
 	struct timezone tz;
-	unsigned int tdiff;
+	cfg_prog_t *prog;
+	int rpd;
+
+	if(unlikely(ksr_cfg_compile) && a != NULL
+			&& !sr_event_enabled(SREV_CFG_RUN_ACTION) && !ksr_rprof_on()) {
+		prog = cfg_prog_get(a);
+		if(prog != NULL) {
+			return cfg_prog_exec(h, prog, msg);
+		}
+	}
 
 	ret = E_UNSPEC;
 	h->rec_lev++;
@@ -1593,9 +1712,12 @@ int run_actions(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 		h->run_flags = 0;
 		h->last_retcode = 0;
 		_last_returned_code = h->last_retcode;
+		rpd = ksr_rprof_depth();
 #ifdef USE_LONGJMP
 		if(unlikely(setjmp(h->jmp_env))) {
 			h->rec_lev = 0;
+			/* close the profiled frames skipped by exit */
+			ksr_rprof_unwind(rpd);
 			ret = h->last_retcode;
 			goto end;
 		}
@@ -1624,18 +1746,7 @@ int run_actions(struct run_act_ctx *h, struct action *a, struct sip_msg *msg)
 		}
 		if(unlikely(cfg_get(core, core_cfg, latency_limit_action) > 0)
 				&& is_printable(cfg_get(core, core_cfg, latency_log))) {
-			gettimeofday(&tve, &tz);
-			tdiff = (tve.tv_sec - tvb.tv_sec) * 1000000
-					+ (tve.tv_usec - tvb.tv_usec);
-			if(tdiff >= cfg_get(core, core_cfg, latency_limit_action)) {
-				LOG(cfg_get(core, core_cfg, latency_log),
-						"alert - action [%s (%d)]"
-						" cfg [%s:%d] took too long [%u us]\n",
-						is_mod_func(t)
-								? ((cmd_export_t *)(t->val[0].u.data))->name
-								: "corefunc",
-						t->type, (t->cfile) ? t->cfile : "", t->cline, tdiff);
-			}
+			run_action_latency_check(t, &tvb);
 		}
 		/* break, return or drop/exit stop execution of the current
 		   block */
@@ -1688,11 +1799,361 @@ int run_actions_safe(
 #endif /* USE_LONGJMP */
 
 
+/* add an operation, return its index or -1 on error */
+static int cfg_prog_add(cfg_prog_t *prog, int code, struct action *a, void *p)
+{
+	cfg_op_t *ops;
+
+	if(prog->n == prog->size) {
+		ops = (cfg_op_t *)pkg_realloc(
+				prog->ops, (prog->size + 16) * sizeof(cfg_op_t));
+		if(ops == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		prog->ops = ops;
+		prog->size += 16;
+	}
+	prog->ops[prog->n].code = code;
+	prog->ops[prog->n].jmp = 0;
+	prog->ops[prog->n].a = a;
+	prog->ops[prog->n].p = p;
+	return prog->n++;
+}
+
+/* compile the action list a, appending to prog operations */
+static int cfg_prog_compile_list(cfg_prog_t *prog, struct action *a)
+{
+	struct action *t;
+	int iidx;
+	int jidx;
+	long i;
+
+	for(t = a; t != NULL; t = t->next) {
+		switch((unsigned char)t->type) {
+			case IF_T:
+				iidx = cfg_prog_add(prog, CFG_OP_IF, t, NULL);
+				if(iidx < 0) {
+					return -1;
+				}
+				if(t->val[1].type == ACTIONS_ST && t->val[1].u.data) {
+					if(cfg_prog_compile_list(
+							   prog, (struct action *)t->val[1].u.data)
+							< 0) {
+						return -1;
+					}
+				}
+				if(t->val[2].type == ACTIONS_ST && t->val[2].u.data) {
+					jidx = cfg_prog_add(prog, CFG_OP_JMP, t, NULL);
+					if(jidx < 0) {
+						return -1;
+					}
+					prog->ops[iidx].jmp = prog->n;
+					if(cfg_prog_compile_list(
+							   prog, (struct action *)t->val[2].u.data)
+							< 0) {
+						return -1;
+					}
+					prog->ops[jidx].jmp = prog->n;
+				} else {
+					prog->ops[iidx].jmp = prog->n;
+				}
+				break;
+			case MODULE0_T:
+			case MODULE1_T:
+			case MODULE2_T:
+			case MODULE3_T:
+			case MODULE4_T:
+			case MODULE5_T:
+			case MODULE6_T:
+				if(cfg_prog_add(prog,
+						   CFG_OP_MODF0 + ((unsigned char)t->type - MODULE0_T),
+						   t,
+						   (void *)((ksr_cmd_export_t *)t->val[0].u.data)
+								   ->function)
+						< 0) {
+					return -1;
+				}
+				break;
+			case MODULEX_T:
+				if(cfg_prog_add(prog, CFG_OP_MODFX, t,
+						   (void *)((ksr_cmd_export_t *)t->val[0].u.data)
+								   ->function)
+						< 0) {
+					return -1;
+				}
+				break;
+			case ROUTE_T:
+				i = t->val[0].u.number;
+				if(t->val[0].type == NUMBER_ST && i >= 0 && i < main_rt.idx) {
+					if(cfg_prog_add(prog, CFG_OP_ROUTE, t, main_rt.rlist[i])
+							< 0) {
+						return -1;
+					}
+					break;
+				}
+				/* fall through */
+			default:
+				if(cfg_prog_add(prog, CFG_OP_ACT, t, NULL) < 0) {
+					return -1;
+				}
+		}
+	}
+	return 0;
+}
+
+/* compile the action list of a route block */
+static int cfg_prog_compile(struct action *a)
+{
+	cfg_prog_t *prog;
+	unsigned int hidx;
+
+	if(a == NULL || cfg_prog_get(a) != NULL) {
+		return 0;
+	}
+	prog = (cfg_prog_t *)pkg_malloc(sizeof(cfg_prog_t));
+	if(prog == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memset(prog, 0, sizeof(cfg_prog_t));
+	prog->a = a;
+	if(cfg_prog_compile_list(prog, a) < 0) {
+		if(prog->ops) {
+			pkg_free(prog->ops);
+		}
+		pkg_free(prog);
+		return -1;
+	}
+	hidx = cfg_prog_hash_idx(a);
+	prog->next = _cfg_prog_hash[hidx];
+	_cfg_prog_hash[hidx] = prog;
+	return 0;
+}
+
+static int cfg_compile_rl(struct route_list *rt)
+{
+	int i;
+
+	for(i = 0; i < rt->idx; i++) {
+		if(cfg_prog_compile(rt->rlist[i]) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * compile all route blocks - to be done after fixing them (fix_rls())
+ */
+int cfg_compile_rls(void)
+{
+	if(cfg_compile_rl(&main_rt) < 0 || cfg_compile_rl(&onreply_rt) < 0
+			|| cfg_compile_rl(&failure_rt) < 0 || cfg_compile_rl(&branch_rt) < 0
+			|| cfg_compile_rl(&onsend_rt) < 0 || cfg_compile_rl(&event_rt) < 0) {
+		LM_ERR("failed to compile the route blocks\n");
+		return -1;
+	}
+	LM_DBG("route blocks compiled\n");
+	return 0;
+}
+
+/* run the compiled operations of a route block, same result as
+ * run_actions() over the action list */
+static int cfg_prog_exec(
+		struct run_act_ctx *h, cfg_prog_t *prog, struct sip_msg *msg)
+{
+	cfg_op_t *op;
+	struct action *a;
+	int pc;
+	int ret;
+	long v;
+	struct rval_expr *rve;
+	struct timeval tvb = {0};
+	struct timezone tz;
+	int rpd;
+#ifdef __GNUC__
+	static void *op_labels[CFG_OP_SIZE] = {&&op_act, &&op_if, &&op_jmp,
+			&&op_modf0, &&op_modf1, &&op_modf2, &&op_modf3, &&op_modf4,
+			&&op_modf5, &&op_modf6, &&op_modfx, &&op_route};
+#endif
+
+	ret = E_UNSPEC;
+	h->rec_lev++;
+	if(unlikely(h->rec_lev > max_recursive_level)) {
+		LM_ERR("too many recursive routing table lookups (%d) giving up!\n",
+				h->rec_lev);
+		h->rec_lev--;
+		return E_UNSPEC;
+	}
+	if(unlikely(h->rec_lev == 1)) {
+		h->run_flags = 0;
+		h->last_retcode = 0;
+		_last_returned_code = h->last_retcode;
+		rpd = ksr_rprof_depth();
+#ifdef USE_LONGJMP
+		if(unlikely(setjmp(h->jmp_env))) {
+			h->rec_lev = 0;
+			ksr_rprof_unwind(rpd);
+			return h->last_retcode;
+		}
+#endif
+	}
+
+	pc = 0;
+	while(pc < prog->n) {
+		op = &prog->ops[pc];
+		pc++;
+		if(op->code == CFG_OP_JMP) {
+			pc = op->jmp;
+			continue;
+		}
+		a = op->a;
+		if(unlikely(cfg_get(core, core_cfg, latency_limit_action) > 0)
+				&& is_printable(cfg_get(core, core_cfg, latency_log))) {
+			gettimeofday(&tvb, &tz);
+		}
+		_cfg_crt_action = a;
+		if(unlikely(log_prefix_mode & LOG_PREFIX_MODE_REFRESH)) {
+			log_prefix_set(msg);
+		}
+		if(op->code != CFG_OP_ACT) {
+			/* done by do_action() for the other operations */
+			prev_ser_error = ser_error;
+			ser_error = E_UNSPEC;
+		}
+#ifdef __GNUC__
+		goto *op_labels[op->code];
+#else
+		switch(op->code) {
+			case CFG_OP_ACT:
+				goto op_act;
+			case CFG_OP_IF:
+				goto op_if;
+			case CFG_OP_MODF0:
+				goto op_modf0;
+			case CFG_OP_MODF1:
+				goto op_modf1;
+			case CFG_OP_MODF2:
+				goto op_modf2;
+			case CFG_OP_MODF3:
+				goto op_modf3;
+			case CFG_OP_MODF4:
+				goto op_modf4;
+			case CFG_OP_MODF5:
+				goto op_modf5;
+			case CFG_OP_MODF6:
+				goto op_modf6;
+			case CFG_OP_MODFX:
+				goto op_modfx;
+			case CFG_OP_ROUTE:
+				goto op_route;
+			default:
+				goto op_jmp;
+		}
+#endif
+	op_act:
+		ret = do_action(h, a, msg);
+		goto op_done;
+	op_if:
+		rve = (struct rval_expr *)a->val[0].u.data;
+		if(unlikely(rval_expr_eval_long(h, msg, &v, rve) != 0)) {
+			ERR("if expression evaluation failed (%d,%d-%d,%d)\n",
+					rve->fpos.s_line, rve->fpos.s_col, rve->fpos.e_line,
+					rve->fpos.e_col);
+			v = 0; /* false */
+		}
+		if(unlikely(h->run_flags & EXIT_R_F)) {
+			ret = 0;
+			goto op_done;
+		}
+		/* catch return & break in expr */
+		h->run_flags &= ~(RETURN_R_F | BREAK_R_F);
+		ret = 1; /* default is continue */
+		if(!((ksr_return_mode == 0 && v > 0)
+				   || (ksr_return_mode != 0 && v != 0))) {
+			/* go to else operations */
+			pc = op->jmp;
+		}
+		goto op_done;
+	op_modf0:
+		ret = ((cmd_function)op->p)(msg, 0, 0);
+		goto op_modf_done;
+	op_modf1:
+		ret = ((cmd_function)op->p)(msg, (char *)a->val[2].u.data, 0);
+		goto op_modf_done;
+	op_modf2:
+		ret = ((cmd_function)op->p)(
+				msg, (char *)a->val[2].u.data, (char *)a->val[3].u.data);
+		goto op_modf_done;
+	op_modf3:
+		ret = ((cmd_function3)op->p)(msg, (char *)a->val[2].u.data,
+				(char *)a->val[3].u.data, (char *)a->val[4].u.data);
+		goto op_modf_done;
+	op_modf4:
+		ret = ((cmd_function4)op->p)(msg, (char *)a->val[2].u.data,
+				(char *)a->val[3].u.data, (char *)a->val[4].u.data,
+				(char *)a->val[5].u.data);
+		goto op_modf_done;
+	op_modf5:
+		ret = ((cmd_function5)op->p)(msg, (char *)a->val[2].u.data,
+				(char *)a->val[3].u.data, (char *)a->val[4].u.data,
+				(char *)a->val[5].u.data, (char *)a->val[6].u.data);
+		goto op_modf_done;
+	op_modf6:
+		ret = ((cmd_function6)op->p)(msg, (char *)a->val[2].u.data,
+				(char *)a->val[3].u.data, (char *)a->val[4].u.data,
+				(char *)a->val[5].u.data, (char *)a->val[6].u.data,
+				(char *)a->val[7].u.data);
+		goto op_modf_done;
+	op_modfx:
+		ret = ((cmd_function_var)op->p)(
+				msg, a->val[1].u.number, &a->val[2]);
+	op_modf_done:
+		MODF_HANDLE_RETCODE(h, ret);
+		goto op_done;
+	op_route:
+		ret = run_actions(h, (struct action *)op->p, msg);
+		h->last_retcode = ret;
+		_last_returned_code = h->last_retcode;
+		h->run_flags &= ~(RETURN_R_F | BREAK_R_F); /* absorb return & break */
+		goto op_done;
+	op_jmp:
+		/* not reached - handled before dispatching */
+		continue;
+	op_done:
+		_cfg_crt_action = 0;
+		if(unlikely(log_prefix_mode & LOG_PREFIX_MODE_REFRESH)) {
+			log_prefix_set(msg);
+		}
+		if(unlikely(cfg_get(core, core_cfg, latency_limit_action) > 0)
+				&& is_printable(cfg_get(core, core_cfg, latency_log))) {
+			run_action_latency_check(a, &tvb);
+		}
+		/* break, return or drop/exit stop execution of the block */
+		if(unlikely(h->run_flags & (BREAK_R_F | RETURN_R_F | EXIT_R_F))) {
+			if(unlikely(h->run_flags & EXIT_R_F)) {
+				h->last_retcode = ret;
+				_last_returned_code = h->last_retcode;
+#ifdef USE_LONGJMP
+				longjmp(h->jmp_env, ret);
+#endif
+			}
+			break;
+		}
+	}
+
+	h->rec_lev--;
+	return ret;
+}
+
+
 int run_top_route(struct action *a, sip_msg_t *msg, struct run_act_ctx *c)
 {
 	struct run_act_ctx ctx;
 	struct run_act_ctx *p;
 	int ret;
+	int rpf;
 	flag_t sfbk;
 
 	p = (c) ? c : &ctx;
@@ -1700,7 +2161,12 @@ int run_top_route(struct action *a, sip_msg_t *msg, struct run_act_ctx *c)
 	setsflagsval(0);
 	reset_static_buffer();
 	init_run_actions_ctx(p);
+	rpf = (unlikely(ksr_rprof_on()) && a != NULL)
+				  ? ksr_rprof_enter(KSR_RPROF_ROUTE, a)
+				  : 0;
 	ret = run_actions(p, a, msg);
+	if(unlikely(rpf))
+		ksr_rprof_exit();
 	setsflagsval(sfbk);
 	return ret;
 }
@@ -63,6 +63,8 @@ int run_actions(struct run_act_ctx *c, struct action *a, struct sip_msg *msg);
 
 int run_top_route(struct action *a, sip_msg_t *msg, struct run_act_ctx *c);
 
+int cfg_compile_rls(void);
+
 cfg_action_t *get_cfg_crt_action(void);
 int get_cfg_crt_line(void);
 char *get_cfg_crt_file_name(void);
@@ -65,6 +65,7 @@
 #include "rvalue.h"
 #include "sr_compat.h"
 #include "msg_translator.h"
+#include "parser/parse_hname2.h"
 #include "async_task.h"
 
 #include "kemi.h"
@@ -331,6 +332,9 @@ extern char *default_routename;
 %token LOGPREFIXMODE
 %token LOGENGINETYPE
 %token LOGENGINEDATA
+%token LOGASYNCSIZE
+%token LOGASYNCMODE
+%token LOGASYNCFILE
 %token XAVPVIAPARAMS
 %token XAVPVIAFIELDS
 %token XAVPVIAREPLYPARAMS
@@ -434,6 +438,9 @@ extern char *default_routename;
 %token SQL_BUFFER_SIZE
 %token MSG_CLONE_EXTRA_SIZE
 %token MSG_APPLY_CHANGES_MODE
+%token MSG_BUILD_PBUF
+%token XAVP_ARENA_SIZE
+%token CFG_COMPILE
 %token MSG_RECV_MAX_SIZE
 %token TCP_MSG_READ_TIMEOUT
 %token TCP_MSG_DATA_TIMEOUT
@@ -512,6 +519,8 @@ extern char *default_routename;
 %token OPEN_FD_LIMIT
 %token SHM_MEM_SZ
 %token SHM_FORCE_ALLOC
+%token SHM_HUGE_PAGES
+%token SHM_HUGE_PAGE_SIZE
 %token MLOCK_PAGES
 %token REAL_TIME
 %token RT_PRIO
@@ -560,6 +569,7 @@ extern char *default_routename;
 %token ONSEND_RT_REPLY
 %token URI_HOST_EXTRA_CHARS
 %token HDR_NAME_EXTRA_CHARS
+%token HDR_NAME_REGISTER
 
 %token FLAGS_DECL
 %token AVPFLAGS_DECL
@@ -945,6 +955,12 @@ assign_stm:
 	| LOGENGINETYPE EQUAL error { yyerror("string value expected"); }
 	| LOGENGINEDATA EQUAL STRING { _km_log_engine_data=$3; }
 	| LOGENGINEDATA EQUAL error { yyerror("string value expected"); }
+	| LOGASYNCSIZE EQUAL NUMBER { ksr_log_async_size=$3; }
+	| LOGASYNCSIZE EQUAL error { yyerror("number expected"); }
+	| LOGASYNCMODE EQUAL NUMBER { ksr_log_async_mode=$3; }
+	| LOGASYNCMODE EQUAL error { yyerror("number expected"); }
+	| LOGASYNCFILE EQUAL STRING { ksr_log_async_file=$3; }
+	| LOGASYNCFILE EQUAL error { yyerror("string value expected"); }
 	| XAVPVIAPARAMS EQUAL STRING { _ksr_xavp_via_params.s=$3;
 			_ksr_xavp_via_params.len=strlen($3);
 		}
@@ -1077,6 +1093,12 @@ assign_stm:
 	| MSG_CLONE_EXTRA_SIZE EQUAL error { yyerror("number expected"); }
 	| MSG_APPLY_CHANGES_MODE EQUAL NUMBER { ksr_msg_apply_changes_mode=$3; }
 	| MSG_APPLY_CHANGES_MODE EQUAL error { yyerror("boolean expected"); }
+	| MSG_BUILD_PBUF EQUAL NUMBER { ksr_msg_build_pbuf=$3; }
+	| MSG_BUILD_PBUF EQUAL error { yyerror("number expected"); }
+	| XAVP_ARENA_SIZE EQUAL NUMBER { ksr_xavp_arena_size=$3; }
+	| XAVP_ARENA_SIZE EQUAL error { yyerror("number expected"); }
+	| CFG_COMPILE EQUAL NUMBER { ksr_cfg_compile=$3; }
+	| CFG_COMPILE EQUAL error { yyerror("number expected"); }
 	| MSG_RECV_MAX_SIZE EQUAL NUMBER { ksr_msg_recv_max_size=$3; }
 	| MSG_RECV_MAX_SIZE EQUAL error { yyerror("number expected"); }
 	| TCP_MSG_READ_TIMEOUT EQUAL NUMBER { ksr_tcp_msg_read_timeout=$3; }
@@ -1706,6 +1728,14 @@ assign_stm:
 	| URI_HOST_EXTRA_CHARS EQUAL error { yyerror("string value expected"); }
 	| HDR_NAME_EXTRA_CHARS EQUAL STRING { _ksr_hname_extra_chars=(unsigned char*)$3; }
 	| HDR_NAME_EXTRA_CHARS EQUAL error { yyerror("string value expected"); }
+	| HDR_NAME_REGISTER EQUAL STRING {
+			s_tmp.s=$3;
+			s_tmp.len=strlen($3);
+			if(ksr_hname_register(&s_tmp)<0) {
+				yyerror("failed to register header name");
+			}
+		}
+	| HDR_NAME_REGISTER EQUAL error { yyerror("string value expected"); }
 	| REPLY_TO_VIA EQUAL NUMBER { reply_to_via=$3; }
 	| REPLY_TO_VIA EQUAL error { yyerror("boolean value expected"); }
 	| LISTEN EQUAL id_lst {
@@ -1981,6 +2011,22 @@ assign_stm:
 			shm_force_alloc=$3;
 	}
 	| SHM_FORCE_ALLOC EQUAL error { yyerror("boolean value expected"); }
+	| SHM_HUGE_PAGES EQUAL NUMBER {
+		if (shm_initialized())
+			yyerror("shm_huge_pages must be before any modparam or the"
+					" route blocks");
+		else
+			shm_huge_pages=$3;
+	}
+	| SHM_HUGE_PAGES EQUAL error { yyerror("number expected"); }
+	| SHM_HUGE_PAGE_SIZE EQUAL NUMBER {
+		if (shm_initialized())
+			yyerror("shm_huge_page_size must be before any modparam or the"
+					" route blocks");
+		else
+			shm_huge_page_size=$3;
+	}
+	| SHM_HUGE_PAGE_SIZE EQUAL error { yyerror("number expected"); }
 	| MLOCK_PAGES EQUAL NUMBER { mlock_pages=$3; }
 	| MLOCK_PAGES EQUAL error { yyerror("boolean value expected"); }
 	| REAL_TIME EQUAL NUMBER { real_time=$3; }
@@ -47,6 +47,8 @@
 #include "tcp_options.h"
 #include "cfg_core.h"
 #include "ppcfg.h"
+#include "dprint_async.h"
+#include "rprof.h"
 #include "sr_module.h"
 
 #ifdef USE_DNS_CACHE
@@ -549,6 +551,7 @@ static void core_kill(rpc_t *rpc, void *c)
 static void core_shmmem(rpc_t *rpc, void *c)
 {
 	struct mem_info mi;
+	shm_pages_info_t pi;
 	void *handle;
 	char *param;
 	long rs;
@@ -588,6 +591,12 @@ static void core_shmmem(rpc_t *rpc, void *c)
 			(mi.free_size >> rs), "used", (mi.used_size >> rs), "real_used",
 			(mi.real_used >> rs), "max_used", (mi.max_used >> rs), "fragments",
 			mi.total_frags);
+	if(shm_core_pages_info(&pi) == 0) {
+		rpc->struct_add(handle, "djjjj", "huge_pages", pi.huge_mode,
+				"page_size", pi.page_size, "rss", (pi.rss >> rs),
+				"huge_mapped", (pi.huge_mapped >> rs), "tlb_pages",
+				pi.tlb_pages);
+	}
 }
 
 static const char *core_shmmem_doc[] = {
@@ -595,7 +604,10 @@ static const char *core_shmmem_doc[] = {
 		"specifies"
 		" the measuring unit: b - bytes (default), k or kb, m or mb, g or gb. "
 		"Note: when using something different from bytes, the value is "
-		"truncated.",
+		"truncated. The huge pages mode (0 - none, 1 - transparent, "
+		"2 - explicit), the page size, the resident and huge pages mapped "
+		"sizes and the number of pages (tlb entries) covering the pool are "
+		"the ones seen by the process executing the command.",
 		0 /* Method signature(s) */
 };
 
@@ -1048,6 +1060,23 @@ static void core_ppdefines_full(rpc_t *rpc, void *c)
 	}
 }
 
+static const char *core_rprof_enable_doc[] = {
+		"Enable (1) or disable (0) the route execution profiler.", 0};
+
+static const char *core_rprof_reset_doc[] = {
+		"Reset the data of the route execution profiler.", 0};
+
+static const char *core_rprof_dump_doc[] = {
+		"Print the profiled call paths, with number of calls, total and own"
+		" time (microseconds); with parameter 'folded', print the lines"
+		" for flame graph tools.",
+		0};
+
+static const char *core_log_async_stats_doc[] = {
+		"Statistics of asynchronous logging.", /* Documentation string */
+		0									   /* Method signature(s) */
+};
+
 /*
  * RPC Methods exported by core
  */
@@ -1088,6 +1117,12 @@ static rpc_export_t core_rpc_methods[] = {
 	{"core.ppdefines", core_ppdefines, core_ppdefines_doc, RPC_RET_ARRAY},
 	{"core.ppdefines_full", core_ppdefines_full, core_ppdefines_full_doc,
 				RPC_RET_ARRAY},
+	{"core.log_async_stats", ksr_log_async_rpc_stats,
+			core_log_async_stats_doc, 0},
+	{"core.rprof_enable", ksr_rprof_rpc_enable, core_rprof_enable_doc, 0},
+	{"core.rprof_reset", ksr_rprof_rpc_reset, core_rprof_reset_doc, 0},
+	{"core.rprof_dump", ksr_rprof_rpc_dump, core_rprof_dump_doc,
+			RPC_RET_ARRAY},
 #ifdef USE_DNS_CACHE
 	{"dns.mem_info", dns_cache_mem_info, dns_cache_mem_info_doc, 0},
 	{"dns.debug", dns_cache_debug, dns_cache_debug_doc, 0},
@@ -20,6 +20,8 @@
  * @ingroup: core
  */
 
+#include <limits.h>
+
 #include "counters.h"
 #include "str_hash.h"
 #include "str.h"
@@ -86,6 +88,26 @@ counter_array_t *_cnts_vals = 0;
 int _cnts_row_len = 0;			   /* number of elements per row */
 static unsigned short cnts_no = 0; /* number of registered counters */
 static int cnts_max_rows = 0;	   /* set to 0 if not yet fully init */
+static void *cnts_shm_block = 0;   /* shm block holding the aligned rows */
+/** sums of the values of all counters, valid between counter_snapshot_start()
+  and counter_snapshot_end() */
+static counter_val_t *cnts_snapshot = 0;
+static int cnts_snapshot_refs = 0;
+
+struct counter_hist_record
+{
+	str group;
+	str name;
+	str doc;
+};
+
+/** histograms values. a[proc_no][(hist_id-1)*CNT_HIST_SLOTS + slot] */
+counter_val_t *_cnts_hist_vals = 0;
+int _cnts_hist_row_len = 0; /* number of elements per row */
+static void *cnts_hist_shm_block = 0;
+static struct counter_hist_record *cnt_hist_recs = 0;
+static int cnt_hist_recs_size = 0;
+static unsigned short cnt_hists_no = 0; /* number of histograms */
 char *ksr_stats_namesep = KSR_STATS_NAMESEP;
 
 
@@ -143,12 +165,33 @@ void destroy_counters()
 	if(_cnts_vals) {
 		if(cnts_max_rows)
 			/* fully init => it is in shm */
-			shm_free(_cnts_vals);
+			shm_free(cnts_shm_block);
 		else
 			/* partially init (before prefork) => pkg */
 			pkg_free(_cnts_vals);
 		_cnts_vals = 0;
+		cnts_shm_block = 0;
 	}
+	if(cnts_snapshot) {
+		pkg_free(cnts_snapshot);
+		cnts_snapshot = 0;
+	}
+	cnts_snapshot_refs = 0;
+	if(cnts_hist_shm_block) {
+		shm_free(cnts_hist_shm_block);
+		cnts_hist_shm_block = 0;
+	}
+	_cnts_hist_vals = 0;
+	_cnts_hist_row_len = 0;
+	if(cnt_hist_recs) {
+		for(r = 0; r < cnt_hists_no; r++) {
+			pkg_free(cnt_hist_recs[r].group.s);
+		}
+		pkg_free(cnt_hist_recs);
+		cnt_hist_recs = 0;
+	}
+	cnt_hist_recs_size = 0;
+	cnt_hists_no = 0;
 	if(cnts_hash_table.table) {
 		for(r = 0; r < cnts_hash_table.size; r++) {
 			clist_foreach_safe(&cnts_hash_table.table[r], e, bak, next)
@@ -208,11 +251,17 @@ int counters_prefork_init(int max_process_no)
 	/* replace the temporary pre-fork pkg array (with only 1 row) with
 	   the final shm version (with max_process_no rows) */
 	old = _cnts_vals;
-	_cnts_vals = shm_malloc(size);
-	if(_cnts_vals == 0) {
+	/* align the start of the rows to CACHELINE_PAD too, so that the
+	   counters of different processes never share a cache line */
+	cnts_shm_block = shm_malloc(size + CACHELINE_PAD);
+	if(cnts_shm_block == 0) {
 		SHM_MEM_ERROR;
+		_cnts_vals = old;
 		return -1;
 	}
+	_cnts_vals = (counter_array_t *)(((unsigned long)cnts_shm_block
+											 + CACHELINE_PAD - 1)
+									 & ~((unsigned long)CACHELINE_PAD - 1));
 	memset(_cnts_vals, 0, size);
 	cnts_max_rows = max_process_no;
 	/* copy prefork values into the newly shm array */
@@ -221,6 +270,25 @@ int counters_prefork_init(int max_process_no)
 			counter_pprocess_val(process_no, h) = old[h.id].v;
 		pkg_free(old);
 	}
+	if(cnt_hists_no > 0) {
+		/* histograms - same layout, rows aligned to CACHELINE_PAD */
+		row_size = ((sizeof(counter_val_t) * CNT_HIST_SLOTS * cnt_hists_no - 1)
+						   / CACHELINE_PAD
+				   + 1)
+				   * CACHELINE_PAD;
+		_cnts_hist_row_len = row_size / sizeof(counter_val_t);
+		size = max_process_no * row_size;
+		cnts_hist_shm_block = shm_malloc(size + CACHELINE_PAD);
+		if(cnts_hist_shm_block == 0) {
+			SHM_MEM_ERROR;
+			return -1;
+		}
+		_cnts_hist_vals = (counter_val_t *)(((unsigned long)cnts_hist_shm_block
+													+ CACHELINE_PAD - 1)
+											& ~((unsigned long)CACHELINE_PAD
+													- 1));
+		memset(_cnts_hist_vals, 0, size);
+	}
 	return 0;
 }
 
@@ -609,6 +677,8 @@ counter_val_t counter_get_raw_val(counter_handle_t handle)
 		LM_BUG("invalid counter id %d (max %d)\n", handle.id, cnts_no - 1);
 		return 0;
 	}
+	if(cnts_snapshot)
+		return cnts_snapshot[handle.id];
 	ret = 0;
 	for(r = 0; r < cnts_max_rows; r++)
 		ret += counter_pprocess_val(r, handle);
@@ -616,6 +686,57 @@ counter_val_t counter_get_raw_val(counter_handle_t handle)
 }
 
 
+/** sum up the values of all the counters, walking once the rows of all
+ * the processes.
+ * Until counter_snapshot_end() is called, counter_get_val() and
+ * counter_get_raw_val() return the values from this snapshot, instead of
+ * walking all the rows for each counter. Meant to be used around the
+ * listing of many counters (e.g., rpc commands). Calls can be nested.
+ * @return 0 on success, -1 on error (the values are read directly then).
+ */
+int counter_snapshot_start(void)
+{
+	counter_array_t *row;
+	int r, i;
+
+	if(cnts_snapshot_refs > 0) {
+		cnts_snapshot_refs++;
+		return 0;
+	}
+	if(unlikely(_cnts_vals == 0 || cnts_max_rows == 0)) {
+		return -1;
+	}
+	cnts_snapshot = pkg_malloc(sizeof(*cnts_snapshot) * cnts_no);
+	if(cnts_snapshot == 0) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memset(cnts_snapshot, 0, sizeof(*cnts_snapshot) * cnts_no);
+	for(r = 0; r < cnts_max_rows; r++) {
+		row = &_cnts_vals[r * _cnts_row_len];
+		for(i = 0; i < cnts_no; i++)
+			cnts_snapshot[i] += row[i].v;
+	}
+	cnts_snapshot_refs = 1;
+	return 0;
+}
+
+
+/** release the snapshot of counter values.
+ * Safe to be called also when counter_snapshot_start() failed.
+ */
+void counter_snapshot_end(void)
+{
+	if(cnts_snapshot_refs <= 0)
+		return;
+	cnts_snapshot_refs--;
+	if(cnts_snapshot_refs == 0 && cnts_snapshot) {
+		pkg_free(cnts_snapshot);
+		cnts_snapshot = 0;
+	}
+}
+
+
 /** get the value of the counter, using the callbacks (if defined).
  * @param handle - counter handle obtained using counter_lookup() or
  *                 counter_register().
@@ -659,6 +780,8 @@ void counter_reset(counter_handle_t handle)
 		return;
 	for(r = 0; r < cnts_max_rows; r++)
 		counter_pprocess_val(r, handle) = 0;
+	if(cnts_snapshot)
+		cnts_snapshot[handle.id] = 0;
 	return;
 }
 
@@ -773,6 +896,8 @@ void counter_iterate_grp_var_names(
  *              [variable name, variable handle] pair.
  * @param p   - parameter that will be passed to the callback function
  *              (along the group name, variable name and variable handle).
+ * The values read by the callback come from a snapshot of the counters
+ * (see counter_snapshot_start()).
  */
 void counter_iterate_grp_vars(const char *group,
 		void (*cbk)(void *p, str *g, str *n, counter_handle_t h), void *p)
@@ -784,11 +909,253 @@ void counter_iterate_grp_vars(const char *group,
 	grp.s = (char *)group;
 	grp.len = strlen(group);
 	g = grp_hash_lookup(&grp);
-	if(g)
+	if(g) {
+		counter_snapshot_start();
 		for(r = g->first; r; r = r->grp_next)
 			cbk(p, &r->group, &r->name, r->h);
+		counter_snapshot_end();
+	}
+}
+
+/** register a new histogram.
+ * Must be called before forking (e.g. from mod_init()).
+ * @param handle    - result parameter, it will be filled with the histogram
+ *                    handle on success (can be null if not needed).
+ * @param group     - group name.
+ * @param name      - histogram name (group.name must be unique).
+ * @param doc       - description/documentation string.
+ * @param reg_flags - register flags: 1 - don't fail if histogram already
+ *                    registered (act like counter_hist_lookup()).
+ * @return 0 on success, < 0 on error (-1 not init or malloc error, -2 already
+ *         registered (and register_flags & 1 == 0).
+ */
+int counter_hist_register(counter_hist_handle_t *handle, const char *group,
+		const char *name, const char *doc, int reg_flags)
+{
+	struct counter_hist_record *recs;
+	struct counter_hist_record *rec;
+	counter_hist_handle_t h;
+	int glen, nlen, dlen;
+	char *p;
+
+	if(counter_hist_lookup(&h, group, name) == 0) {
+		if(reg_flags & 1) {
+			if(handle)
+				*handle = h;
+			return 0;
+		}
+		return -2;
+	}
+	if(unlikely(cnts_max_rows)) {
+		/* too late */
+		LM_BUG("late attempt to register histogram: %s.%s\n", group, name);
+		return -1;
+	}
+	if(unlikely(group == 0 || *group == 0)) {
+		LM_BUG("attempt to register histogram %s without a group\n", name);
+		return -1;
+	}
+	if(cnt_hists_no >= cnt_hist_recs_size) {
+		recs = pkg_realloc(cnt_hist_recs,
+				sizeof(*recs) * (cnt_hist_recs_size ? cnt_hist_recs_size * 2 : 8));
+		if(recs == 0) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		cnt_hist_recs = recs;
+		cnt_hist_recs_size = cnt_hist_recs_size ? cnt_hist_recs_size * 2 : 8;
+	}
+	glen = strlen(group);
+	nlen = strlen(name);
+	dlen = doc ? strlen(doc) : 0;
+	/* group, name and doc in one block */
+	p = pkg_malloc(glen + 1 + nlen + 1 + dlen + 1);
+	if(p == 0) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	rec = &cnt_hist_recs[cnt_hists_no];
+	rec->group.s = p;
+	rec->group.len = glen;
+	memcpy(p, group, glen + 1);
+	p += glen + 1;
+	rec->name.s = p;
+	rec->name.len = nlen;
+	memcpy(p, name, nlen + 1);
+	p += nlen + 1;
+	rec->doc.s = p;
+	rec->doc.len = dlen;
+	if(dlen)
+		memcpy(p, doc, dlen);
+	p[dlen] = 0;
+	cnt_hists_no++;
+	/* handle id 0 is invalid, id-1 is the index */
+	if(handle)
+		handle->id = cnt_hists_no;
+	return 0;
 }
 
+
+/** lookup a histogram.
+ * @param handle - pointer to a handle (filled on success).
+ * @param group  - histogram group name.
+ * @param name   - histogram name.
+ * @return 0 on success, < 0 on error
+ */
+int counter_hist_lookup(
+		counter_hist_handle_t *handle, const char *group, const char *name)
+{
+	int i, glen, nlen;
+
+	glen = strlen(group);
+	nlen = strlen(name);
+	for(i = 0; i < cnt_hists_no; i++) {
+		if(cnt_hist_recs[i].group.len == glen
+				&& cnt_hist_recs[i].name.len == nlen
+				&& memcmp(cnt_hist_recs[i].group.s, group, glen) == 0
+				&& memcmp(cnt_hist_recs[i].name.s, name, nlen) == 0) {
+			handle->id = i + 1;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+/** get the aggregated values of a histogram (summed over processes).
+ * @param handle  - histogram handle.
+ * @param buckets - array of CNT_HIST_BUCKETS elements, filled with the
+ *                  number of values per bucket (not cumulative).
+ * @param count   - filled with the number of values.
+ * @param sum     - filled with the sum of values.
+ * @return 0 on success, -1 on error.
+ */
+int counter_hist_get(counter_hist_handle_t handle, counter_val_t *buckets,
+		counter_val_t *count, counter_val_t *sum)
+{
+	counter_val_t *h;
+	int r, b;
+
+	if(unlikely(handle.id == 0 || handle.id > cnt_hists_no)) {
+		LM_BUG("invalid histogram id %d (max %d)\n", handle.id, cnt_hists_no);
+		return -1;
+	}
+	memset(buckets, 0, sizeof(counter_val_t) * CNT_HIST_BUCKETS);
+	*count = 0;
+	*sum = 0;
+	if(unlikely(_cnts_hist_vals == 0)) {
+		/* not init yet */
+		return 0;
+	}
+	for(r = 0; r < cnts_max_rows; r++) {
+		h = &_cnts_hist_vals[r * _cnts_hist_row_len
+							 + (handle.id - 1) * CNT_HIST_SLOTS];
+		for(b = 0; b < CNT_HIST_BUCKETS; b++)
+			buckets[b] += h[b];
+		*count += h[CNT_HIST_BUCKETS];
+		*sum += h[CNT_HIST_BUCKETS + 1];
+	}
+	return 0;
+}
+
+
+/** reset a histogram.
+ * Note: it's racy.
+ */
+void counter_hist_reset(counter_hist_handle_t handle)
+{
+	int r;
+
+	if(unlikely(handle.id == 0 || handle.id > cnt_hists_no)) {
+		LM_BUG("invalid histogram id %d (max %d)\n", handle.id, cnt_hists_no);
+		return;
+	}
+	if(unlikely(_cnts_hist_vals == 0))
+		return;
+	for(r = 0; r < cnts_max_rows; r++)
+		memset(&_cnts_hist_vals[r * _cnts_hist_row_len
+								+ (handle.id - 1) * CNT_HIST_SLOTS],
+				0, sizeof(counter_val_t) * CNT_HIST_SLOTS);
+}
+
+
+/** upper bound (inclusive) of the values in a histogram bucket.
+ * @return bound value, ULONG_MAX for the last bucket (no bound).
+ */
+unsigned long counter_hist_bucket_le(int b)
+{
+	int e;
+
+	if(b < CNT_HIST_SUB)
+		return (unsigned long)b;
+	if(b >= CNT_HIST_BUCKETS - 1)
+		return ULONG_MAX;
+	e = b / CNT_HIST_SUB + CNT_HIST_SUB_BITS - 1;
+	return ((unsigned long)(CNT_HIST_SUB + b % CNT_HIST_SUB + 1)
+				   << (e - CNT_HIST_SUB_BITS))
+		   - 1;
+}
+
+
+/** estimate a quantile from the buckets of a histogram.
+ * @param buckets  - values per bucket (see counter_hist_get()).
+ * @param count    - number of values.
+ * @param permille - quantile (e.g., 990 for p99).
+ * @return the upper bound of the bucket holding the quantile (0 if there are
+ *         no values).
+ */
+unsigned long counter_hist_quantile(
+		counter_val_t *buckets, counter_val_t count, int permille)
+{
+	counter_val_t n, c;
+	int b;
+
+	if(count <= 0)
+		return 0;
+	n = (count * permille + 999) / 1000;
+	if(n <= 0)
+		n = 1;
+	c = 0;
+	for(b = 0; b < CNT_HIST_BUCKETS; b++) {
+		c += buckets[b];
+		if(c >= n)
+			return counter_hist_bucket_le(b);
+	}
+	return counter_hist_bucket_le(CNT_HIST_BUCKETS - 1);
+}
+
+
+/** return the description (doc) string for a histogram.
+ * @return asciiz pointer on success, 0 on error.
+ */
+char *counter_hist_get_doc(counter_hist_handle_t handle)
+{
+	if(unlikely(handle.id == 0 || handle.id > cnt_hists_no)) {
+		LM_BUG("invalid histogram id %d (max %d)\n", handle.id, cnt_hists_no);
+		return 0;
+	}
+	return cnt_hist_recs[handle.id - 1].doc.s;
+}
+
+
+/** iterate on all the histograms.
+ * @param cbk - pointer to a callback function that will be called for each
+ *              histogram, with the group name, name and handle.
+ * @param p   - parameter that will be passed to the callback function.
+ */
+void counter_hist_iterate(
+		void (*cbk)(void *p, str *g, str *n, counter_hist_handle_t h), void *p)
+{
+	counter_hist_handle_t h;
+	int i;
+
+	for(i = 0; i < cnt_hists_no; i++) {
+		h.id = i + 1;
+		cbk(p, &cnt_hist_recs[i].group, &cnt_hist_recs[i].name, h);
+	}
+}
+
+
 #ifdef STATISTICS
 
 
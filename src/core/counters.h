@@ -29,12 +29,25 @@
  *    counter_lookup(&h, "my_counters", "foo");
  *  4. get a counter value (the handle can be obtained like above)
  *    val = counter_get(h);
+ *
+ *  Histograms (distribution of values, e.g., latency in microseconds):
+ *  1. register (before forking):
+ *    counter_hist_handle_t hh;
+ *    counter_hist_register(&hh, "my_counters", "foo_time_us", "test", 0);
+ *  2. record a value:
+ *    counter_hist_observe(hh, val);
+ *  3. read the aggregated buckets:
+ *    counter_hist_get(hh, buckets, &count, &sum);
  */
 
 #ifndef __counters_h
 #define __counters_h
 
+#include <sys/time.h>
+
 #include "pt.h"
+#include "bit_scan.h"
+#include "compiler_opt.h"
 
 /* counter flags */
 #define CNT_F_NO_RESET 1 /* don't reset */
@@ -100,6 +113,8 @@ int counter_lookup_str(counter_handle_t *handle, str *group, str *name);
 void counter_reset(counter_handle_t handle);
 counter_val_t counter_get_val(counter_handle_t handle);
 counter_val_t counter_get_raw_val(counter_handle_t handle);
+int counter_snapshot_start(void);
+void counter_snapshot_end(void);
 char *counter_get_name(counter_handle_t handle);
 char *counter_get_group(counter_handle_t handle);
 char *counter_get_doc(counter_handle_t handle);
@@ -131,6 +146,85 @@ inline static void counter_add(counter_handle_t handle, int v)
 }
 
 
+/* histograms - log-linear buckets, CNT_HIST_SUB buckets for each power of 2:
+ *  values 0..3 have their own bucket, then 4, 5, 6, 7, 8-9, 10-11, ...
+ *  and the last bucket collects all the values over 7*2^28 */
+#define CNT_HIST_SUB_BITS 2
+#define CNT_HIST_SUB (1 << CNT_HIST_SUB_BITS)
+#define CNT_HIST_BUCKETS 120
+/* per process slots of a histogram: buckets, number and sum of values */
+#define CNT_HIST_SLOTS (CNT_HIST_BUCKETS + 2)
+
+struct counter_hist_handle_s
+{
+	unsigned short id;
+};
+
+typedef struct counter_hist_handle_s counter_hist_handle_t;
+
+extern counter_val_t *_cnts_hist_vals;
+extern int _cnts_hist_row_len; /* number of elements per row */
+
+int counter_hist_register(counter_hist_handle_t *handle, const char *group,
+		const char *name, const char *doc, int reg_flags);
+int counter_hist_lookup(
+		counter_hist_handle_t *handle, const char *group, const char *name);
+int counter_hist_get(counter_hist_handle_t handle, counter_val_t *buckets,
+		counter_val_t *count, counter_val_t *sum);
+void counter_hist_reset(counter_hist_handle_t handle);
+unsigned long counter_hist_bucket_le(int b);
+unsigned long counter_hist_quantile(
+		counter_val_t *buckets, counter_val_t count, int permille);
+char *counter_hist_get_doc(counter_hist_handle_t handle);
+void counter_hist_iterate(
+		void (*cbk)(void *p, str *g, str *n, counter_hist_handle_t h),
+		void *p);
+
+/** index of the histogram bucket for a value.
+ */
+inline static int counter_hist_bucket(unsigned long v)
+{
+	int e;
+	int b;
+
+	if(v < CNT_HIST_SUB)
+		return (int)v;
+	e = bit_scan_reverse(v);
+	b = (e - CNT_HIST_SUB_BITS + 1) * CNT_HIST_SUB
+		+ (int)((v >> (e - CNT_HIST_SUB_BITS)) & (CNT_HIST_SUB - 1));
+	return (b < CNT_HIST_BUCKETS) ? b : CNT_HIST_BUCKETS - 1;
+}
+
+/** records a value in a histogram.
+ * Lock-less, each process updates only its row.
+ * @param handle - histogram handle.
+ * @param v - value.
+ */
+inline static void counter_hist_observe(
+		counter_hist_handle_t handle, unsigned long v)
+{
+	counter_val_t *h;
+
+	if(unlikely(_cnts_hist_vals == 0 || handle.id == 0))
+		return;
+	h = &_cnts_hist_vals[process_no * _cnts_hist_row_len
+						 + (handle.id - 1) * CNT_HIST_SLOTS];
+	h[counter_hist_bucket(v)]++;
+	h[CNT_HIST_BUCKETS]++;
+	h[CNT_HIST_BUCKETS + 1] += v;
+}
+
+/** current time in microseconds, to compute the duration of operations.
+ */
+inline static unsigned long long counter_hist_time_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (unsigned long long)tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+
 void counter_iterate_grp_names(void (*cbk)(void *p, str *grp_name), void *p);
 void counter_iterate_grp_var_names(
 		const char *group, void (*cbk)(void *p, str *var_name), void *p);
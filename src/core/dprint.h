@@ -177,6 +177,14 @@ extern km_log_f _km_log_func;
 
 void km_log_func_set(km_log_f f);
 
+/** @brief asynchronous logging via per process rings (dprint_async.c) */
+extern int ksr_log_async_size;
+extern int ksr_log_async_mode;
+extern char *ksr_log_async_file;
+extern int _ksr_log_async_active;
+
+void ksr_log_async_printf(int prio, int level, const char *fmt, ...);
+
 /** @brief maps log levels to their string name and corresponding syslog level */
 
 struct log_level_info
@@ -283,7 +291,20 @@ void log_prefix_init(void);
 							   ? L_ALERT                                   \
 							   : (((level) > L_DBG) ? L_DBG : level);      \
 			DPRINT_CRIT_ENTER;                                             \
-			if(unlikely(log_stderr)) {                                     \
+			if(unlikely(_ksr_log_async_active)) {                          \
+				ksr_log_async_printf(                                      \
+						LOG2SYSLOG_LEVEL(__llevel)                         \
+								| (((facility) != DEFAULT_FACILITY)        \
+												? (facility)               \
+												: get_debug_facility(      \
+														  LOG_MNAME,       \
+														  LOG_MNAME_LEN)), \
+						__llevel, "%s: %.*s%s%s%s" fmt,                    \
+						(lname) ? (lname) : LOG_LEVEL2NAME(__llevel),      \
+						LOGV_PREFIX_LEN, LOGV_PREFIX_STR, (prefix),        \
+						LOGV_FUNCNAME_STR(funcname),                       \
+						LOGV_FUNCSUFFIX_STR(funcname), __VA_ARGS__);       \
+			} else if(unlikely(log_stderr)) {                              \
 				if(unlikely(log_color))                                    \
 					dprint_color(__llevel);                                \
 				fprintf(stderr, "%2d(%d) %s: %.*s%s%s%s" fmt, process_no,  \
@@ -355,6 +376,19 @@ void log_prefix_init(void);
 				__kld.v_func = LOGV_FUNCNAME_STR(funcname);                    \
 				__kld.v_locinfo = prefix;                                      \
 				_ksr_slog_func(&__kld, fmt, ##args);                           \
+			} else if(unlikely(_ksr_log_async_active)) { /* async logging */   \
+				ksr_log_async_printf(                                          \
+						LOG2SYSLOG_LEVEL(__llevel)                             \
+								| (((facility) != DEFAULT_FACILITY)            \
+												? (facility)                   \
+												: get_debug_facility(          \
+														  LOG_MNAME,           \
+														  LOG_MNAME_LEN)),     \
+						__llevel, "%s: %.*s%s%s%s" fmt,                        \
+						(lname) ? (lname) : LOG_LEVEL2NAME(__llevel),          \
+						LOGV_PREFIX_LEN, LOGV_PREFIX_STR, (prefix),            \
+						LOGV_FUNCNAME_STR(funcname),                           \
+						LOGV_FUNCSUFFIX_STR(funcname), ##args);                \
 			} else { /* classic logging */                                     \
 				if(unlikely(log_stderr)) {                                     \
 					if(unlikely(log_color))                                    \
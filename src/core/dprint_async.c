@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file
+ * @brief Kamailio core :: asynchronous logging
+ *
+ * Each process writes the formatted log messages in its own ring buffer
+ * in shared memory (single producer, single consumer, no locking) and a
+ * dedicated "log writer" process drains the rings to stderr, syslog (or
+ * the function set by a log engine module) or a file. When the ring is
+ * full the message is dropped (counted per log level) or the process
+ * waits for a limited time, based on log_async_mode.
+ *
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "dprint.h"
+#include "dprint_async.h"
+#include "atomic_ops.h"
+#include "mem/shm.h"
+#include "pt.h"
+#include "ut.h"
+#include "signals.h"
+#include "sr_module.h"
+
+/* core parameters */
+int ksr_log_async_size = 0; /* ring size per process in KB, 0 - disabled */
+int ksr_log_async_mode = KSR_LOG_ASYNC_DROP;
+char *ksr_log_async_file = NULL;
+
+/* set in the processes that write to the rings */
+int _ksr_log_async_active = 0;
+
+/* set for the main thread of the processes, inherited when forking - the
+ * other threads (e.g., started by modules) do not write to the rings */
+static _Thread_local int _ksr_log_async_tmain = 0;
+
+/* max size of a log message, longer ones are truncated */
+#define KSR_LOG_ASYNC_MSG_MAX 8192
+/* sleep time of the log writer when all rings are empty */
+#define KSR_LOG_ASYNC_IDLE_US 1000
+/* waiting step and max number of steps for blocking mode */
+#define KSR_LOG_ASYNC_BLOCK_US 100
+#define KSR_LOG_ASYNC_BLOCK_STEPS 10000
+/* size of the buffer for writing in batches */
+#define KSR_LOG_ASYNC_WBUF_SIZE 65536
+
+#define KSR_LOG_ASYNC_LEVELS (L_MAX - L_MIN + 1)
+#define KSR_LOG_ASYNC_LIDX(l) \
+	(((l) < L_MIN) ? 0 : (((l) > L_MAX) ? (L_MAX - L_MIN) : ((l) - L_MIN)))
+
+/* record marking the skip to the start of the ring */
+#define KSR_LOG_ASYNC_WRAP (-1)
+
+#define KSR_LOG_ASYNC_CACHELINE 64
+
+typedef struct ksr_log_async_rec
+{
+	int len; /* message length or KSR_LOG_ASYNC_WRAP */
+	int level;
+	int prio;
+	int pid;
+} ksr_log_async_rec_t;
+
+#define KSR_LOG_ASYNC_RECSIZE(len) \
+	((sizeof(ksr_log_async_rec_t) + (len) + 15) & ~15u)
+
+typedef struct ksr_log_async_ring
+{
+	/* updated by the producer (owner process) */
+	volatile unsigned int wpos;
+	unsigned long drops[KSR_LOG_ASYNC_LEVELS];
+	unsigned long blocked;
+	unsigned long written;
+	char pad0[KSR_LOG_ASYNC_CACHELINE];
+	/* updated by the consumer (log writer process) */
+	volatile unsigned int rpos;
+	char pad1[KSR_LOG_ASYNC_CACHELINE - sizeof(unsigned int)];
+} ksr_log_async_ring_t;
+
+static ksr_log_async_ring_t *_ksr_log_async_rings = NULL;
+static char *_ksr_log_async_buf = NULL;
+static int _ksr_log_async_rings_no = 0;
+static unsigned int _ksr_log_async_rsize = 0;
+
+static int _ksr_log_async_fd = -1;
+static char _ksr_log_async_wbuf[KSR_LOG_ASYNC_WBUF_SIZE];
+static int _ksr_log_async_wlen = 0;
+static volatile int _ksr_log_async_stop = 0;
+
+#define ksr_log_async_ring_buf(idx) \
+	(_ksr_log_async_buf + (size_t)(idx) * _ksr_log_async_rsize)
+
+/**
+ * write the batch buffer to the file descriptor
+ */
+static void ksr_log_async_flush(void)
+{
+	int n;
+	int w;
+
+	for(w = 0; w < _ksr_log_async_wlen; w += n) {
+		n = write(_ksr_log_async_fd, _ksr_log_async_wbuf + w,
+				_ksr_log_async_wlen - w);
+		if(n < 0) {
+			if(errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			break;
+		}
+	}
+	_ksr_log_async_wlen = 0;
+}
+
+/**
+ * output one log message - to the batch buffer when writing to stderr or
+ * file, otherwise via the syslog function
+ */
+static void ksr_log_async_emit(
+		int pno, int pid, int prio, int level, char *msg, int len)
+{
+	int n;
+
+	if(_ksr_log_async_fd < 0) {
+		_km_log_func(prio, "%.*s", len, msg);
+		return;
+	}
+	if(log_color && _ksr_log_async_fd == STDERR_FILENO) {
+		ksr_log_async_flush();
+		dprint_color(level);
+		fprintf(stderr, "%2d(%d) %.*s", pno, pid, len, msg);
+		dprint_color_reset();
+		return;
+	}
+	if(_ksr_log_async_wlen + len + 32 > KSR_LOG_ASYNC_WBUF_SIZE) {
+		ksr_log_async_flush();
+	}
+	n = snprintf(_ksr_log_async_wbuf + _ksr_log_async_wlen,
+			KSR_LOG_ASYNC_WBUF_SIZE - _ksr_log_async_wlen, "%2d(%d) %.*s",
+			pno, pid, len, msg);
+	if(n > 0) {
+		_ksr_log_async_wlen += n;
+		if(_ksr_log_async_wlen >= KSR_LOG_ASYNC_WBUF_SIZE) {
+			_ksr_log_async_wlen = KSR_LOG_ASYNC_WBUF_SIZE - 1;
+		}
+	}
+}
+
+/**
+ * format the log message and write it in the ring of the process
+ * - prio is the syslog priority (level and facility), level is the
+ *   internal log level
+ * - when async logging is not usable (e.g., in the log writer itself), the
+ *   message is written directly
+ * - the ring has a single producer, the messages of other threads than the
+ *   main one of the process are written directly, without the batch buffer
+ */
+void ksr_log_async_printf(int prio, int level, const char *fmt, ...)
+{
+	static _Thread_local char lbuf[KSR_LOG_ASYNC_MSG_MAX];
+	va_list ap;
+	ksr_log_async_ring_t *ring;
+	ksr_log_async_rec_t *rec;
+	char *rbuf;
+	unsigned int wpos;
+	unsigned int widx;
+	unsigned int rsize;
+	unsigned int skip;
+	int len;
+	int steps;
+
+	va_start(ap, fmt);
+	len = vsnprintf(lbuf, KSR_LOG_ASYNC_MSG_MAX, fmt, ap);
+	va_end(ap);
+	if(len < 0) {
+		return;
+	}
+	if(len >= KSR_LOG_ASYNC_MSG_MAX) {
+		len = KSR_LOG_ASYNC_MSG_MAX - 1;
+		lbuf[len - 1] = '\n';
+	}
+
+	if(unlikely(!_ksr_log_async_tmain)) {
+		if(log_stderr) {
+			fprintf(stderr, "%2d(%d) %.*s", process_no, my_pid(), len, lbuf);
+		} else {
+			_km_log_func(prio, "%.*s", len, lbuf);
+		}
+		return;
+	}
+
+	if(!_ksr_log_async_active || _ksr_log_async_rings == NULL
+			|| process_no < 0 || process_no >= _ksr_log_async_rings_no) {
+		if(_ksr_log_async_fd < 0 && log_stderr) {
+			_ksr_log_async_fd = STDERR_FILENO;
+		}
+		ksr_log_async_emit(process_no, my_pid(), prio, level, lbuf, len);
+		ksr_log_async_flush();
+		return;
+	}
+
+	ring = &_ksr_log_async_rings[process_no];
+	rbuf = ksr_log_async_ring_buf(process_no);
+	rsize = KSR_LOG_ASYNC_RECSIZE(len);
+	wpos = ring->wpos;
+	widx = wpos & (_ksr_log_async_rsize - 1);
+	/* records are not split, skip to the start of the ring if needed */
+	skip = (widx + rsize > _ksr_log_async_rsize) ? (_ksr_log_async_rsize - widx)
+												 : 0;
+	steps = 0;
+	while(wpos + skip + rsize - ring->rpos > _ksr_log_async_rsize) {
+		if(ksr_log_async_mode != KSR_LOG_ASYNC_BLOCK
+				|| steps >= KSR_LOG_ASYNC_BLOCK_STEPS) {
+			ring->drops[KSR_LOG_ASYNC_LIDX(level)]++;
+			return;
+		}
+		if(steps == 0) {
+			ring->blocked++;
+		}
+		steps++;
+		sleep_us(KSR_LOG_ASYNC_BLOCK_US);
+	}
+	membar_read();
+
+	if(skip > 0) {
+		rec = (ksr_log_async_rec_t *)(rbuf + widx);
+		rec->len = KSR_LOG_ASYNC_WRAP;
+		widx = 0;
+	}
+	rec = (ksr_log_async_rec_t *)(rbuf + widx);
+	rec->len = len;
+	rec->level = level;
+	rec->prio = prio;
+	rec->pid = my_pid();
+	memcpy((char *)rec + sizeof(ksr_log_async_rec_t), lbuf, len);
+	ring->written++;
+	membar_write();
+	ring->wpos = wpos + skip + rsize;
+}
+
+/**
+ * drain all rings, return the number of messages written
+ */
+static int ksr_log_async_drain(void)
+{
+	ksr_log_async_ring_t *ring;
+	ksr_log_async_rec_t *rec;
+	char *rbuf;
+	unsigned int rpos;
+	unsigned int wpos;
+	unsigned int ridx;
+	int i;
+	int n;
+
+	n = 0;
+	for(i = 0; i < _ksr_log_async_rings_no; i++) {
+		ring = &_ksr_log_async_rings[i];
+		rbuf = ksr_log_async_ring_buf(i);
+		rpos = ring->rpos;
+		wpos = ring->wpos;
+		if(rpos == wpos) {
+			continue;
+		}
+		membar_read();
+		while(rpos != wpos) {
+			ridx = rpos & (_ksr_log_async_rsize - 1);
+			rec = (ksr_log_async_rec_t *)(rbuf + ridx);
+			if(rec->len == KSR_LOG_ASYNC_WRAP) {
+				rpos += _ksr_log_async_rsize - ridx;
+				continue;
+			}
+			ksr_log_async_emit(i, rec->pid, rec->prio, rec->level,
+					(char *)rec + sizeof(ksr_log_async_rec_t), rec->len);
+			rpos += KSR_LOG_ASYNC_RECSIZE(rec->len);
+			n++;
+		}
+		membar();
+		ring->rpos = rpos;
+	}
+	if(_ksr_log_async_fd >= 0) {
+		ksr_log_async_flush();
+	}
+	return n;
+}
+
+/**
+ *
+ */
+static void ksr_log_async_sig_stop(int signo)
+{
+	_ksr_log_async_stop = 1;
+}
+
+/**
+ * main loop of the log writer process
+ */
+static void ksr_log_async_main(void)
+{
+	_ksr_log_async_active = 0;
+	set_sig_h(SIGTERM, ksr_log_async_sig_stop);
+	set_sig_h(SIGINT, ksr_log_async_sig_stop);
+
+	if(ksr_log_async_file != NULL && ksr_log_async_file[0] != '\0') {
+		_ksr_log_async_fd = open(ksr_log_async_file,
+				O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR | S_IRGRP);
+		if(_ksr_log_async_fd < 0) {
+			LM_ERR("failed to open log file [%s] (%d: %s)\n",
+					ksr_log_async_file, errno, strerror(errno));
+		}
+	}
+	if(_ksr_log_async_fd < 0 && log_stderr) {
+		_ksr_log_async_fd = STDERR_FILENO;
+	}
+
+	while(!_ksr_log_async_stop) {
+		if(ksr_log_async_drain() == 0) {
+			sleep_us(KSR_LOG_ASYNC_IDLE_US);
+		}
+	}
+	/* write what the other processes logged while shutting down */
+	ksr_log_async_drain();
+	_exit(0);
+}
+
+/**
+ * allocate the rings and fork the log writer process
+ * - to be executed by main process before forking the other processes
+ */
+int ksr_log_async_start(void)
+{
+	unsigned int rsize;
+	int pid;
+
+	if(ksr_log_async_size <= 0) {
+		return 0;
+	}
+	rsize = 4 * KSR_LOG_ASYNC_MSG_MAX;
+	while(rsize < (unsigned int)ksr_log_async_size * 1024
+			&& rsize < (1u << 30)) {
+		rsize <<= 1;
+	}
+	_ksr_log_async_rings_no = get_max_procs();
+	_ksr_log_async_rings = (ksr_log_async_ring_t *)shm_malloc(
+			_ksr_log_async_rings_no * sizeof(ksr_log_async_ring_t));
+	if(_ksr_log_async_rings == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_ksr_log_async_rings, 0,
+			_ksr_log_async_rings_no * sizeof(ksr_log_async_ring_t));
+	_ksr_log_async_buf =
+			(char *)shm_malloc((size_t)_ksr_log_async_rings_no * rsize);
+	if(_ksr_log_async_buf == NULL) {
+		SHM_MEM_ERROR;
+		shm_free(_ksr_log_async_rings);
+		_ksr_log_async_rings = NULL;
+		return -1;
+	}
+	_ksr_log_async_rsize = rsize;
+	_ksr_log_async_tmain = 1;
+
+	pid = fork_process(PROC_NOCHLDINIT, "log writer", 0);
+	if(pid < 0) {
+		LM_CRIT("cannot fork log writer process\n");
+		return -1;
+	}
+	if(pid == 0) {
+		/* child */
+		ksr_log_async_main();
+	}
+	LM_INFO("async logging started (%d rings of %u bytes)\n",
+			_ksr_log_async_rings_no, rsize);
+	_ksr_log_async_active = 1;
+	return 0;
+}
+
+/**
+ * stop writing in the rings from the main process on shutdown
+ */
+void ksr_log_async_destroy(void)
+{
+	_ksr_log_async_active = 0;
+}
+
+static const char *ksr_log_async_lnames[KSR_LOG_ASYNC_LEVELS] = {
+		"alert", "bug", "crit2", "crit", "err", "warn", "notice", "info",
+		"dbg"};
+
+/**
+ * rpc command - statistics of async logging
+ */
+void ksr_log_async_rpc_stats(rpc_t *rpc, void *ctx)
+{
+	unsigned long drops[KSR_LOG_ASYNC_LEVELS];
+	unsigned long written;
+	unsigned long blocked;
+	unsigned long dtotal;
+	void *th;
+	void *dh;
+	int i;
+	int j;
+
+	if(_ksr_log_async_rings == NULL) {
+		rpc->fault(ctx, 500, "Async logging not enabled");
+		return;
+	}
+	memset(drops, 0, sizeof(drops));
+	written = 0;
+	blocked = 0;
+	dtotal = 0;
+	for(i = 0; i < _ksr_log_async_rings_no; i++) {
+		written += _ksr_log_async_rings[i].written;
+		blocked += _ksr_log_async_rings[i].blocked;
+		for(j = 0; j < KSR_LOG_ASYNC_LEVELS; j++) {
+			drops[j] += _ksr_log_async_rings[i].drops[j];
+			dtotal += _ksr_log_async_rings[i].drops[j];
+		}
+	}
+	if(rpc->add(ctx, "{", &th) < 0) {
+		rpc->fault(ctx, 500, "Internal error creating rpc");
+		return;
+	}
+	if(rpc->struct_add(th, "sddjjj{", "mode",
+			   (ksr_log_async_mode == KSR_LOG_ASYNC_BLOCK) ? "block" : "drop",
+			   "rings", _ksr_log_async_rings_no, "ring_size",
+			   (int)_ksr_log_async_rsize, "written", written, "blocked",
+			   blocked, "dropped", dtotal, "drops", &dh)
+			< 0) {
+		rpc->fault(ctx, 500, "Internal error adding fields");
+		return;
+	}
+	for(j = 0; j < KSR_LOG_ASYNC_LEVELS; j++) {
+		rpc->struct_add(dh, "j", ksr_log_async_lnames[j], drops[j]);
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file
+ * @brief Kamailio core :: asynchronous logging
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#ifndef _DPRINT_ASYNC_H_
+#define _DPRINT_ASYNC_H_
+
+#include "rpc.h"
+
+/* overflow policy when the ring of the process is full */
+#define KSR_LOG_ASYNC_DROP 0
+#define KSR_LOG_ASYNC_BLOCK 1
+
+int ksr_log_async_start(void);
+void ksr_log_async_destroy(void);
+
+void ksr_log_async_rpc_stats(rpc_t *rpc, void *ctx);
+
+#endif
@@ -630,11 +630,11 @@ int forward_request_mode(struct sip_msg *msg, str *dst, unsigned short port,
 			/* rebuild the message only if the send_sock changed */
 			prev_send_sock = send_info->send_sock;
 #endif
-			if(buf)
-				pkg_free(buf);
+			msg_build_buf_free(buf);
 			send_info->proto = proto;
-			buf = build_req_buf_from_sip_req(
-					msg, &len, send_info, mbmode, NULL);
+			buf = build_req_buf_from_sip_req(msg, &len, send_info,
+					(ksr_msg_build_pbuf) ? (mbmode | BUILD_IN_PBUF) : mbmode,
+					NULL);
 			if(!buf) {
 				LM_ERR("building failed\n");
 				ret = E_OUT_OF_MEM; /* most probable */
@@ -725,9 +725,8 @@ end:
 		dns_srv_handle_put(&dns_srv_h);
 	}
 #endif
-	if(buf)
-		pkg_free(buf);
-		/* received_buf & line_buf will be freed in receive_msg by free_lump_list*/
+	msg_build_buf_free(buf);
+	/* received_buf & line_buf will be freed in receive_msg by free_lump_list*/
 #if defined STATS_REQ_FWD_OK || defined STATS_REQ_FWD_DROP
 	if(ret == 0)
 		STATS_REQ_FWD_OK();
@@ -953,7 +952,8 @@ static int do_forward_reply(struct sip_msg *msg, int mode)
 		goto error;
 	}
 
-	new_buf = build_res_buf_from_sip_res(msg, &new_len);
+	new_buf = generate_res_buf_from_sip_res(
+			msg, &new_len, (ksr_msg_build_pbuf) ? BUILD_IN_PBUF : 0);
 	if(!new_buf) {
 		LM_ERR("building failed\n");
 		goto error;
@@ -1027,12 +1027,11 @@ done:
 			msg->via2->host.len, msg->via2->host.s, (int)msg->via2->port);
 
 	STATS_RPL_FWD_OK();
-	pkg_free(new_buf);
+	msg_build_buf_free(new_buf);
 skip:
 	return 0;
 error:
-	if(new_buf)
-		pkg_free(new_buf);
+	msg_build_buf_free(new_buf);
 	return -1;
 }
 
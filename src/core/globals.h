@@ -206,6 +206,8 @@ extern int open_files_limit;
 
 /* memory lock/pre-fault */
 extern int shm_force_alloc;
+extern int shm_huge_pages;
+extern int shm_huge_page_size;
 extern int mlock_pages;
 
 /* execute onsend_route for replies */
@@ -253,6 +255,9 @@ extern int ksr_rpc_exec_delta;
 extern int ksr_udp_receiver_mode;
 extern int ksr_msg_clone_extra_size;
 extern int ksr_msg_apply_changes_mode;
+extern int ksr_msg_build_pbuf;
+extern int ksr_xavp_arena_size;
+extern int ksr_cfg_compile;
 extern int ksr_msg_recv_max_size;
 extern int ksr_tcp_msg_read_timeout;
 extern int ksr_tcp_msg_data_timeout;
@@ -44,6 +44,7 @@
 #include "parser/parse_methods.h"
 
 #include "kemi.h"
+#include "rprof.h"
 
 
 #define SR_KEMI_HNAME_SIZE 128
@@ -3862,11 +3863,17 @@ int sr_kemi_route(
 {
 	flag_t sfbk;
 	int ret;
+	int rpf;
 
 	sfbk = getsflags();
 	setsflagsval(0);
 	reset_static_buffer();
+	rpf = (unlikely(ksr_rprof_on()))
+				  ? ksr_rprof_enter(KSR_RPROF_KEMI_ROUTE, (void *)(long)rtype)
+				  : 0;
 	ret = keng->froute(msg, rtype, ename, edata);
+	if(unlikely(rpf))
+		ksr_rprof_exit();
 	setsflagsval(sfbk);
 	return ret;
 }
@@ -29,6 +29,7 @@
 #include "dprint.h"
 #include "parser/msg_parser.h"
 #include "kemi.h"
+#include "rprof.h"
 
 
 /**
@@ -65,7 +66,7 @@ static inline sr_kemi_xval_t *sr_kemi_return_false(sr_kemi_t *ket)
 /**
  *
  */
-sr_kemi_xval_t *sr_kemi_exec_func(
+static sr_kemi_xval_t *sr_kemi_exec_func_helper(
 		sr_kemi_t *ket, sip_msg_t *msg, int pno, sr_kemi_xval_t *vps)
 {
 	int ret;
@@ -1903,3 +1904,18 @@ sr_kemi_xval_t *sr_kemi_exec_func(
 			return sr_kemi_return_false(ket);
 	}
 }
+
+/**
+ *
+ */
+sr_kemi_xval_t *sr_kemi_exec_func(
+		sr_kemi_t *ket, sip_msg_t *msg, int pno, sr_kemi_xval_t *vps)
+{
+	sr_kemi_xval_t *xret;
+	int rpf;
+
+	rpf = KSR_RPROF_KEMI_ENTER(ket);
+	xret = sr_kemi_exec_func_helper(ket, msg, pno, vps);
+	KSR_RPROF_KEMI_EXIT(rpf);
+	return xret;
+}
@@ -31,17 +31,25 @@
 
 #ifdef SHM_MMAP
 
+#include <stdio.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/types.h> /*open*/
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
 #endif
 
 #include "memcore.h"
 
 #define SHM_CORE_POOLS_SIZE 4
+/* max number of processes writing the pool pages in parallel */
+#define SHM_PREFAULT_MAX_PROCS 64
 
 #define _ROUND2TYPE(s, type) \
 	(((s) + (sizeof(type) - 1)) & (~(sizeof(type) - 1)))
@@ -57,8 +65,172 @@ static int _shm_core_shmid[SHM_CORE_POOLS_SIZE] = {-1}; /*shared memory id*/
 static void *_shm_core_pools_mem[SHM_CORE_POOLS_SIZE] = {(void *)-1};
 static int _shm_core_pools_num = 1;
 
+static int _shm_core_huge_mode = SHM_HUGE_NONE;
+static unsigned long _shm_core_page_size = 0;
+
 sr_shm_api_t _shm_root = {0};
 
+#ifdef SHM_MMAP
+/**
+ * size of the huge pages - shm_huge_page_size (if thp is 0) or the
+ * system default
+ */
+static unsigned long shm_core_huge_page_size(int thp)
+{
+	FILE *f;
+	char line[128];
+	unsigned long sz;
+
+	if(thp == 0 && shm_huge_page_size > 0)
+		return (unsigned long)shm_huge_page_size * 1024;
+	sz = 0;
+	f = fopen("/proc/meminfo", "r");
+	if(f != NULL) {
+		while(fgets(line, sizeof(line), f) != NULL) {
+			if(sscanf(line, "Hugepagesize: %lu kB", &sz) == 1) {
+				sz *= 1024;
+				break;
+			}
+		}
+		fclose(f);
+	}
+	if(sz == 0)
+		sz = 2 * 1024 * 1024;
+	return sz;
+}
+
+/**
+ * map the shm pool with explicit huge pages, falling back to transparent
+ * huge pages advice and then to normal pages
+ */
+static void *shm_core_mmap_huge(void)
+{
+	char *p;
+	char *a;
+	unsigned long hps;
+	unsigned long size;
+	long psz;
+	int flags;
+	int shift;
+
+#ifdef MAP_HUGETLB
+	if(shm_huge_pages == SHM_HUGE_EXPLICIT) {
+		hps = shm_core_huge_page_size(0);
+		size = ((shm_mem_size + hps - 1) / hps) * hps;
+		flags = MAP_ANON | MAP_SHARED | MAP_HUGETLB;
+		if(shm_huge_page_size > 0) {
+			for(shift = 0; (1UL << shift) < hps; shift++)
+				;
+			flags |= shift << MAP_HUGE_SHIFT;
+		}
+		p = mmap(0, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if(p != MAP_FAILED) {
+			if(size != shm_mem_size) {
+				LM_INFO("shm size rounded up to %lu for huge pages\n", size);
+				shm_mem_size = size;
+			}
+			_shm_core_huge_mode = SHM_HUGE_EXPLICIT;
+			_shm_core_page_size = hps;
+			return p;
+		}
+		LM_WARN("cannot map %lu bytes with huge pages of %lu kB: %s"
+				" (check vm.nr_hugepages) - trying transparent huge pages\n",
+				size, hps / 1024, strerror(errno));
+	}
+#endif
+	hps = shm_core_huge_page_size(1);
+	psz = sysconf(_SC_PAGESIZE);
+	if(psz <= 0)
+		psz = 4096;
+	size = ((shm_mem_size + psz - 1) / psz) * psz;
+	/* map more to align the pool to the huge page size, otherwise its
+	 * ends cannot be backed by huge pages */
+	p = mmap(0, size + hps, PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED, -1,
+			0);
+	if(p == MAP_FAILED)
+		return p;
+	a = (char *)(((unsigned long)p + hps - 1) & ~(hps - 1));
+	if(a > p)
+		munmap(p, a - p);
+	munmap(a + size, (p + size + hps) - (a + size));
+	_shm_core_page_size = psz;
+#ifdef MADV_HUGEPAGE
+	if(madvise(a, size, MADV_HUGEPAGE) == 0) {
+		_shm_core_huge_mode = SHM_HUGE_THP;
+		_shm_core_page_size = hps;
+		LM_DBG("transparent huge pages advised for shm pool (%lu kB pages)"
+			   " - requires shmem_enabled not set to never in"
+			   " /sys/kernel/mm/transparent_hugepage\n",
+				hps / 1024);
+	} else {
+		LM_WARN("transparent huge pages not available for shm pool: %s\n",
+				strerror(errno));
+	}
+#else
+	LM_WARN("transparent huge pages not supported - using normal pages\n");
+#endif
+	return a;
+}
+
+/**
+ * write one word in every page of [start, end)
+ */
+static void shm_core_touch(char *start, char *end, long psz)
+{
+	long *p;
+
+	for(p = (long *)_ROUND_LONG((long)start); (char *)(p + 1) <= end;
+			p = (long *)((char *)p + psz))
+		*p = 0;
+}
+
+/**
+ * allocate the pool pages at startup, with shm_force_alloc processes
+ * writing in parallel their part of the pool if it is greater than 1
+ */
+static void shm_core_prefault(char *mem, unsigned long size, long psz)
+{
+	pid_t pids[SHM_PREFAULT_MAX_PROCS];
+	unsigned long chunk;
+	char *start;
+	char *end;
+	int n;
+	int k;
+
+	n = shm_force_alloc;
+	if(n > SHM_PREFAULT_MAX_PROCS)
+		n = SHM_PREFAULT_MAX_PROCS;
+	if(n <= 1 || size < (unsigned long)n * psz) {
+		shm_core_touch(mem, mem + size, psz);
+		return;
+	}
+	chunk = ((size / n + psz - 1) / psz) * psz;
+	for(k = 0; k < n; k++) {
+		pids[k] = 0;
+		start = mem + k * chunk;
+		if(start >= mem + size)
+			continue;
+		end = (start + chunk < mem + size) ? start + chunk : mem + size;
+		pids[k] = fork();
+		if(pids[k] == 0) {
+			shm_core_touch(start, end, psz);
+			_exit(0);
+		}
+		if(pids[k] < 0) {
+			LM_WARN("cannot fork for writing the shm pages: %s\n",
+					strerror(errno));
+			shm_core_touch(start, end, psz);
+			pids[k] = 0;
+		}
+	}
+	for(k = 0; k < n; k++) {
+		if(pids[k] > 0) {
+			waitpid(pids[k], NULL, 0);
+		}
+	}
+}
+#endif /* SHM_MMAP */
+
 /**
  *
  */
@@ -103,21 +275,25 @@ int shm_core_pools_init(void)
 
 	for(i = 0; i < _shm_core_pools_num; i++) {
 #ifdef SHM_MMAP
+		if(shm_huge_pages != SHM_HUGE_NONE) {
+			_shm_core_pools_mem[i] = shm_core_mmap_huge();
+		} else {
 #ifdef USE_ANON_MMAP
-		_shm_core_pools_mem[i] = mmap(0, shm_mem_size, PROT_READ | PROT_WRITE,
-				MAP_ANON | MAP_SHARED, -1, 0);
+			_shm_core_pools_mem[i] = mmap(0, shm_mem_size,
+					PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED, -1, 0);
 #else
-		fd = open("/dev/zero", O_RDWR);
-		if(fd == -1) {
-			LOG(L_CRIT, "could not open /dev/zero [%d]: %s\n", i,
-					strerror(errno));
-			return -1;
-		}
-		_shm_core_pools_mem[i] = mmap(
-				0, shm_mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-		/* close /dev/zero */
-		close(fd);
+			fd = open("/dev/zero", O_RDWR);
+			if(fd == -1) {
+				LOG(L_CRIT, "could not open /dev/zero [%d]: %s\n", i,
+						strerror(errno));
+				return -1;
+			}
+			_shm_core_pools_mem[i] = mmap(
+					0, shm_mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			/* close /dev/zero */
+			close(fd);
 #endif /* USE_ANON_MMAP */
+		}
 #else
 
 		_shm_core_shmid[i] = shmget(IPC_PRIVATE, shm_mem_size, 0700);
@@ -147,26 +323,38 @@ void *shm_core_get_pool(void)
 	int ret;
 	long sz;
 	long *p;
+#ifndef SHM_MMAP
 	long *end;
+#endif
 	int i;
 
 	ret = shm_core_pools_init();
 	if(ret < 0)
 		return NULL;
 
+	sz = sysconf(_SC_PAGESIZE);
+	DBG("%ld bytes/page\n", sz);
+	if((sz < sizeof(*p)) || (_ROUND_LONG(sz) != sz)) {
+		LOG(L_WARN, "invalid page size %ld, using 4096\n", sz);
+		sz = 4096; /* invalid page size, use 4096 */
+	}
+	if(_shm_core_page_size == 0)
+		_shm_core_page_size = sz;
 	for(i = 0; i < _shm_core_pools_num; i++) {
 		if(shm_force_alloc) {
-			sz = sysconf(_SC_PAGESIZE);
-			DBG("%ld bytes/page\n", sz);
-			if((sz < sizeof(*p)) || (_ROUND_LONG(sz) != sz)) {
-				LOG(L_WARN, "invalid page size %ld, using 4096\n", sz);
-				sz = 4096; /* invalid page size, use 4096 */
-			}
+#ifdef SHM_MMAP
+			/* touch one word in every page */
+			shm_core_prefault(_shm_core_pools_mem[i], shm_mem_size,
+					(_shm_core_huge_mode == SHM_HUGE_EXPLICIT)
+							? (long)_shm_core_page_size
+							: sz);
+#else
 			end = _shm_core_pools_mem[i] + shm_mem_size - sizeof(*p);
 			/* touch one word in every page */
 			for(p = (long *)_ROUND_LONG((long)_shm_core_pools_mem[i]); p <= end;
 					p = (long *)((char *)p + sz))
 				*p = 0;
+#endif
 		}
 	}
 	return _shm_core_pools_mem[0];
@@ -195,6 +383,75 @@ int shm_address_in(void *p)
 	return 0;
 }
 
+/**
+ * page size and huge pages usage for the shm pool, as mapped in the
+ * current process
+ */
+int shm_core_pages_info(shm_pages_info_t *pi)
+{
+	unsigned long psz;
+#ifdef __OS_linux
+	FILE *f;
+	char line[256];
+	unsigned long vs;
+	unsigned long ve;
+	unsigned long v;
+	unsigned long hugetlb;
+	int found;
+#endif
+
+	memset(pi, 0, sizeof(shm_pages_info_t));
+	pi->huge_mode = _shm_core_huge_mode;
+	pi->page_size = _shm_core_page_size;
+	if(_shm_core_pools_mem[0] == (void *)-1) {
+		return -1;
+	}
+	psz = (unsigned long)sysconf(_SC_PAGESIZE);
+	if(psz == 0 || psz == (unsigned long)-1)
+		psz = 4096;
+#ifdef __OS_linux
+	f = fopen("/proc/self/smaps", "r");
+	if(f == NULL) {
+		return -1;
+	}
+	found = 0;
+	hugetlb = 0;
+	while(fgets(line, sizeof(line), f) != NULL) {
+		if(sscanf(line, "%lx-%lx", &vs, &ve) == 2) {
+			/* start of a mapping */
+			if(found)
+				break;
+			found = (vs == (unsigned long)_shm_core_pools_mem[0]);
+			continue;
+		}
+		if(!found)
+			continue;
+		if(sscanf(line, "Rss: %lu kB", &v) == 1) {
+			pi->rss += v * 1024;
+		} else if(sscanf(line, "ShmemPmdMapped: %lu kB", &v) == 1) {
+			pi->huge_mapped += v * 1024;
+		} else if(sscanf(line, "Shared_Hugetlb: %lu kB", &v) == 1) {
+			hugetlb += v * 1024;
+		} else if(sscanf(line, "Private_Hugetlb: %lu kB", &v) == 1) {
+			hugetlb += v * 1024;
+		}
+	}
+	fclose(f);
+	/* hugetlb pages are not counted in rss */
+	pi->rss += hugetlb;
+	pi->huge_mapped += hugetlb;
+	if(pi->huge_mapped > pi->rss)
+		pi->huge_mapped = pi->rss;
+#endif
+	if(pi->huge_mode != SHM_HUGE_NONE && pi->page_size > psz) {
+		pi->tlb_pages = pi->huge_mapped / pi->page_size
+						+ (pi->rss - pi->huge_mapped) / psz;
+	} else {
+		pi->tlb_pages = pi->rss / psz;
+	}
+	return 0;
+}
+
 /**
  *
  */
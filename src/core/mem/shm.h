@@ -122,6 +122,22 @@ void shm_print_manager(void);
 
 int shm_address_in(void *p);
 
+/* huge pages backing of the shm pool (shm_huge_pages) */
+#define SHM_HUGE_NONE 0
+#define SHM_HUGE_THP 1		/* transparent huge pages advice */
+#define SHM_HUGE_EXPLICIT 2 /* MAP_HUGETLB */
+
+typedef struct shm_pages_info
+{
+	int huge_mode;				 /* SHM_HUGE_* in use */
+	unsigned long page_size;	 /* page size used for the pool */
+	unsigned long rss;			 /* resident part of the pool */
+	unsigned long huge_mapped;	 /* part of the pool mapped by huge pages */
+	unsigned long tlb_pages;	 /* pages needed to map the resident part */
+} shm_pages_info_t;
+
+int shm_core_pages_info(shm_pages_info_t *pi);
+
 #define shm_available_safe() shm_available()
 #define shm_malloc_on_fork() \
 	do {                     \
@@ -122,6 +122,67 @@ str _ksr_xavp_via_reply_params = STR_NULL;
 int ksr_local_rport = 0;
 str _ksr_via_body_flags = str_init("kvf");
 int ksr_msg_apply_changes_mode = 0;
+int ksr_msg_build_pbuf = 0;
+
+/* per process buffer used to build outgoing messages (BUILD_IN_PBUF) */
+#define MSG_BUILD_PBUF_MIN 4096
+static char *_ksr_msg_build_pbuf = NULL;
+static unsigned int _ksr_msg_build_pbuf_size = 0;
+/* set while the buffer is not released by msg_build_buf_free() */
+static int _ksr_msg_build_pbuf_busy = 0;
+
+/**
+ * get the per process buffer for building a message of len size
+ * - the buffer is kept for the next messages, grown when needed
+ * - a build done while the buffer is still used by the caller of another
+ *   build (e.g., from onsend_route or tm callbacks) gets a pkg buffer
+ */
+static char *msg_build_pbuf_get(unsigned int len)
+{
+	unsigned int size;
+	char *buf;
+
+	if(_ksr_msg_build_pbuf_busy) {
+		buf = (char *)pkg_malloc(len + 1);
+		if(buf == NULL) {
+			PKG_MEM_ERROR;
+		}
+		return buf;
+	}
+	if(len + 1 > _ksr_msg_build_pbuf_size) {
+		/* grow in 1kB steps, to avoid reallocating for each byte more */
+		size = (len + 1 < MSG_BUILD_PBUF_MIN) ? MSG_BUILD_PBUF_MIN
+											  : ((len + 1 + 1023) & ~1023);
+		if(_ksr_msg_build_pbuf != NULL) {
+			pkg_free(_ksr_msg_build_pbuf);
+			_ksr_msg_build_pbuf_size = 0;
+		}
+		_ksr_msg_build_pbuf = (char *)pkg_malloc(size);
+		if(_ksr_msg_build_pbuf == NULL) {
+			PKG_MEM_ERROR;
+			return NULL;
+		}
+		_ksr_msg_build_pbuf_size = size;
+	}
+	_ksr_msg_build_pbuf_busy = 1;
+	return _ksr_msg_build_pbuf;
+}
+
+/**
+ * release a buffer returned by the message building functions in pkg mode
+ * (either pkg allocated or the per process buffer)
+ */
+void msg_build_buf_free(char *buf)
+{
+	if(buf == NULL) {
+		return;
+	}
+	if(buf == _ksr_msg_build_pbuf) {
+		_ksr_msg_build_pbuf_busy = 0;
+	} else {
+		pkg_free(buf);
+	}
+}
 
 /** per process fixup function for global_req_flags.
   * It should be called from the configuration framework.
@@ -2342,13 +2403,15 @@ after_update_via1:
 	}
 	if(unlikely(mode & BUILD_IN_SHM))
 		new_buf = (char *)shm_malloc(new_len + 1);
+	else if(mode & BUILD_IN_PBUF)
+		new_buf = msg_build_pbuf_get(new_len);
 	else
 		new_buf = (char *)pkg_malloc(new_len + 1);
 	if(new_buf == 0) {
 		ser_error = E_OUT_OF_MEM;
 		if(unlikely(mode & BUILD_IN_SHM)) {
 			SHM_MEM_ERROR;
-		} else {
+		} else if(!(mode & BUILD_IN_PBUF)) {
 			PKG_MEM_ERROR;
 		}
 		goto error00;
@@ -2485,10 +2548,16 @@ char *generate_res_buf_from_sip_res(
 	new_len = len + body_delta + lumps_len(msg, msg->add_rm, 0);
 
 	LM_DBG("old size: %d, new size: %d\n", len, new_len);
-	new_buf = (char *)pkg_malloc(new_len + 1); /* +1 is for debugging
+	if(mode & BUILD_IN_PBUF) {
+		new_buf = msg_build_pbuf_get(new_len);
+	} else {
+		new_buf = (char *)pkg_malloc(new_len + 1); /* +1 is for debugging
 											 (\0 to print it )*/
+		if(new_buf == 0) {
+			PKG_MEM_ERROR;
+		}
+	}
 	if(new_buf == 0) {
-		PKG_MEM_ERROR;
 		goto error;
 	}
 	new_buf[new_len] = 0; /* debug: print the message */
@@ -53,6 +53,9 @@
 #define BUILD_NO_PATH (1 << 2)
 #define BUILD_NEW_LOCAL_VIA (1 << 3)
 #define BUILD_IN_SHM (1 << 7)
+/* build the result in a per process buffer - it must be released with
+ * msg_build_buf_free(), a build done before that gets a pkg buffer */
+#define BUILD_IN_PBUF (1 << 8)
 
 #include "parser/msg_parser.h"
 #include "ip_addr.h"
@@ -98,6 +101,8 @@ typedef struct ksr_msgbuild
 			(hp)->port = &default_global_port;                             \
 	} while(0)
 
+void msg_build_buf_free(char *buf);
+
 char *build_req_buf_from_sip_req(struct sip_msg *msg,
 		unsigned int *returned_len, struct dest_info *send_info,
 		unsigned int mode, ksr_msgbuild_t *mbd);
@@ -194,6 +194,7 @@ typedef enum _hdr_types_t hdr_types_t;
 typedef struct hdr_field
 {
 	hdr_types_t type;		/*!< Header field type */
+	int hid;				/*!< Registered header name id (0 if none) */
 	str name;				/*!< Header field name */
 	str body;				/*!< Header field body (may not include CRLF) */
 	int len;				/*!< length from hdr start until EoHF (incl.CRLF) */
@@ -359,6 +359,9 @@ int parse_headers(
 			case HDR_RETRY_AFTER_T:
 			case HDR_OTHER_T: /* mark the type as found/parsed*/
 				msg->parsed_flag |= HDR_T2F(hf->type);
+				if(hf->hid > 0) {
+					msg->hreg_flag |= KSR_HNAME_REG_F(hf->hid);
+				}
 				break;
 			case HDR_CALLID_T:
 				if(msg->callid == 0) {
@@ -1086,7 +1089,20 @@ hdr_field_t *get_hdr_by_name(
 		const sip_msg_t *const msg, const char *const name, const int name_len)
 {
 	hdr_field_t *hdr;
+	int hid;
 
+	hid = ksr_hname_get_id(name, name_len);
+	if(hid > 0) {
+		/* registered header name - check the index flag, then match by id */
+		if(!(msg->hreg_flag & KSR_HNAME_REG_F(hid))) {
+			return NULL;
+		}
+		for(hdr = msg->headers; hdr; hdr = hdr->next) {
+			if(hdr->hid == hid)
+				return hdr;
+		}
+		return NULL;
+	}
 	for(hdr = msg->headers; hdr; hdr = hdr->next) {
 		if(hdr->name.len == name_len && *hdr->name.s == *name
 				&& strncasecmp(hdr->name.s, name, name_len) == 0)
@@ -1100,6 +1116,13 @@ hdr_field_t *next_sibling_hdr_by_name(const hdr_field_t *const hf)
 {
 	hdr_field_t *hdr;
 
+	if(hf->hid > 0) {
+		for(hdr = hf->next; hdr; hdr = hdr->next) {
+			if(hdr->hid == hf->hid)
+				return hdr;
+		}
+		return NULL;
+	}
 	for(hdr = hf->next; hdr; hdr = hdr->next) {
 		if(hdr->name.len == hf->name.len && *hdr->name.s == *hf->name.s
 				&& strncasecmp(hdr->name.s, hf->name.s, hf->name.len) == 0)
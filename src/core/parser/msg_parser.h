@@ -142,6 +142,9 @@ typedef enum request_method
 #define FL_VIA_NORECEIVED (1ULL << 34) /* no received test for incoming Via */
 /* apply msg changes before transaction is created */
 #define FL_MSG_APPLY_CHANGES (1ULL << 35)
+/* msg cloned in SHM with a compact header list (HDR_OTHER_T and other
+ * headers not used by tm are skipped) */
+#define FL_SHM_CLONE_COMPACT (1ULL << 36)
 
 #define FL_MTU_FB_MASK (FL_MTU_TCP_FB | FL_MTU_TLS_FB | FL_MTU_SCTP_FB)
 
@@ -346,6 +349,7 @@ typedef struct sip_msg
 	struct hdr_field *headers;	   /*!< All the parsed headers*/
 	struct hdr_field *last_header; /*!< Pointer to the last parsed header*/
 	hdr_flags_t parsed_flag;	   /*!< Already parsed header field types */
+	hdr_flags_t hreg_flag;		   /*!< Parsed registered header names */
 
 	/* Via, To, CSeq, Call-Id, From, end of header*/
 	/* pointers to the first occurrences of these headers;
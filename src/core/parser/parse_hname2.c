@@ -29,9 +29,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 #include "../dprint.h"
+#include "../globals.h"
+#include "../mem/pkg.h"
 
 #include "parse_hname2.h"
 
@@ -40,10 +44,11 @@ typedef struct ksr_hdr_map
 	str hname;
 	hdr_types_t htype;
 	hdr_flags_t hflag;
+	int hid;
 } ksr_hdr_map_t;
 
 /* map with SIP header name
- * - must be groupped by first letter - indexed for faster search */
+ * - kept groupped by first letter for readability */
 static ksr_hdr_map_t _ksr_hdr_map[] = {
 		{str_init("a"), HDR_ACCEPTCONTACT_T, HDR_ACCEPTCONTACT_F},
 		{str_init("Accept"), HDR_ACCEPT_T, HDR_ACCEPT_F},
@@ -149,18 +154,13 @@ static ksr_hdr_map_t _ksr_hdr_map[] = {
 
 		{str_init(""), 0, 0}};
 
-typedef struct ksr_hdr_map_idx
-{
-	int idxs;
-	int idxe;
-} ksr_hdr_map_idx_t;
-
-#define KSR_HDR_MAP_IDX_SIZE 256
-
 /**
- * array to keep start and end indexes of header names groupped by first char
+ * header names registered by modules (index is hid - 1)
  */
-static ksr_hdr_map_idx_t _ksr_hdr_map_idx[KSR_HDR_MAP_IDX_SIZE];
+static ksr_hdr_map_t _ksr_hdr_map_reg[KSR_HNAME_REG_MAX];
+static int _ksr_hdr_map_reg_size = 0;
+
+#define KSR_HNAME_CHARS_SIZE 256
 
 /**
  * valid chars in header names
@@ -176,40 +176,133 @@ unsigned char *_ksr_hname_extra_chars = (unsigned char *)"";
 
 /**
  * indexed valid chars in 256-array for 1-byte-index access check
+ * - the value is the lower case of the char, 0 if not allowed
  */
-static unsigned char _ksr_hname_chars_idx[KSR_HDR_MAP_IDX_SIZE];
-
+static unsigned char _ksr_hname_chars_idx[KSR_HNAME_CHARS_SIZE];
 
 /**
- * init header name parsing structures and indexes at very beginning of start up
+ * perfect hash table over the header names (known and registered)
+ * - the slots keep the index + 1 in _ksr_hdr_map_list, 0 for empty
+ * - the seed and the size are searched at startup so that there is no
+ *   collision, then a lookup is one hash and one compare
  */
-int ksr_hname_init_index(void)
+#define KSR_HNAME_HTABLE_MIN 1024
+#define KSR_HNAME_HTABLE_MAX 8192
+#define KSR_HNAME_HSEED_TRIES 4096
+
+static unsigned char _ksr_hname_htable[KSR_HNAME_HTABLE_MAX];
+static unsigned int _ksr_hname_hmask = 0;
+static unsigned int _ksr_hname_hseed = 0;
+static ksr_hdr_map_t *_ksr_hdr_map_list[256];
+static int _ksr_hdr_map_list_size = 0;
+
+/* case insensitive FNV-1a over header name chars */
+#define ksr_hname_hash_init(_h, _c) \
+	(_h) = (_ksr_hname_hseed ^ (_c)) * 16777619U
+#define ksr_hname_hash_add(_h, _c) (_h) = ((_h) ^ (_c)) * 16777619U
+#define ksr_hname_hash_idx(_h) (((_h) ^ ((_h) >> 15)) & _ksr_hname_hmask)
+
+static unsigned int ksr_hname_hash(const char *s, int len)
 {
-	unsigned char c;
+	unsigned int h;
 	int i;
 
-	for(i = 0; i < KSR_HDR_MAP_IDX_SIZE; i++) {
-		_ksr_hdr_map_idx[i].idxs = -1;
-		_ksr_hdr_map_idx[i].idxe = -1;
-		_ksr_hname_chars_idx[i] = 0;
+	ksr_hname_hash_init(h, _ksr_hname_chars_idx[(unsigned char)s[0]]);
+	for(i = 1; i < len; i++) {
+		ksr_hname_hash_add(h, _ksr_hname_chars_idx[(unsigned char)s[i]]);
 	}
+	return ksr_hname_hash_idx(h);
+}
+
+/* set after the header names index is built */
+static int _ksr_hname_index_ready = 0;
 
+/**
+ * search seed and size for a collision free hash table over all header names
+ */
+static int ksr_hname_build_htable(void)
+{
+	unsigned int hsize;
+	unsigned int hidx;
+	int t;
+	int i;
+
+	_ksr_hdr_map_list_size = 0;
 	for(i = 0; _ksr_hdr_map[i].hname.len > 0; i++) {
-		c = _ksr_hdr_map[i].hname.s[0];
-		if(_ksr_hdr_map_idx[c].idxs == -1) {
-			_ksr_hdr_map_idx[tolower(c)].idxs = i;
-			_ksr_hdr_map_idx[toupper(c)].idxs = i;
-		}
-		if(c != _ksr_hdr_map[i + 1].hname.s[0]) {
-			_ksr_hdr_map_idx[tolower(c)].idxe = i;
-			_ksr_hdr_map_idx[toupper(c)].idxe = i;
+		_ksr_hdr_map_list[_ksr_hdr_map_list_size++] = &_ksr_hdr_map[i];
+	}
+	for(i = 0; i < _ksr_hdr_map_reg_size; i++) {
+		_ksr_hdr_map_list[_ksr_hdr_map_list_size++] = &_ksr_hdr_map_reg[i];
+	}
+
+	for(hsize = KSR_HNAME_HTABLE_MIN; hsize <= KSR_HNAME_HTABLE_MAX;
+			hsize <<= 1) {
+		_ksr_hname_hmask = hsize - 1;
+		for(t = 0; t < KSR_HNAME_HSEED_TRIES; t++) {
+			_ksr_hname_hseed = 2166136261U + (unsigned int)t * 0x9e3779b9U;
+			memset(_ksr_hname_htable, 0, hsize);
+			for(i = 0; i < _ksr_hdr_map_list_size; i++) {
+				hidx = ksr_hname_hash(_ksr_hdr_map_list[i]->hname.s,
+						_ksr_hdr_map_list[i]->hname.len);
+				if(_ksr_hname_htable[hidx] != 0) {
+					break;
+				}
+				_ksr_hname_htable[hidx] = (unsigned char)(i + 1);
+			}
+			if(i == _ksr_hdr_map_list_size) {
+				LM_DBG("header names hash table - size: %u seed: %u tries: "
+					   "%d\n",
+						hsize, _ksr_hname_hseed, t + 1);
+				return 0;
+			}
 		}
 	}
+	LM_ERR("failed to build header names hash table\n");
+	return -1;
+}
+
+/**
+ * lookup the header name in the hash table
+ * - the name must have only valid header name chars
+ */
+static inline ksr_hdr_map_t *ksr_hname_lookup_hidx(
+		const char *s, int len, unsigned int hidx)
+{
+	ksr_hdr_map_t *hmap;
+
+	if(_ksr_hname_htable[hidx] == 0) {
+		return NULL;
+	}
+	hmap = _ksr_hdr_map_list[_ksr_hname_htable[hidx] - 1];
+	if(hmap->hname.len == len && strncasecmp(hmap->hname.s, s, len) == 0) {
+		return hmap;
+	}
+	return NULL;
+}
+
+/**
+ * init header name parsing structures and indexes at very beginning of start up
+ */
+int ksr_hname_init_index(void)
+{
+	int i;
+
+	if(_ksr_hname_index_ready) {
+		return 0;
+	}
+	for(i = 0; i < KSR_HNAME_CHARS_SIZE; i++) {
+		_ksr_hname_chars_idx[i] = 0;
+	}
 
 	for(i = 0; _ksr_hname_chars_list[i] != 0; i++) {
-		_ksr_hname_chars_idx[_ksr_hname_chars_list[i]] = 1;
+		_ksr_hname_chars_idx[_ksr_hname_chars_list[i]] =
+				(unsigned char)tolower(_ksr_hname_chars_list[i]);
 	}
 
+	if(ksr_hname_build_htable() < 0) {
+		return -1;
+	}
+	_ksr_hname_index_ready = 1;
 	return 0;
 }
 
@@ -221,12 +314,110 @@ int ksr_hname_init_config(void)
 	int i;
 
 	for(i = 0; _ksr_hname_extra_chars[i] != 0; i++) {
-		_ksr_hname_chars_idx[_ksr_hname_extra_chars[i]] = 1;
+		_ksr_hname_chars_idx[_ksr_hname_extra_chars[i]] =
+				(unsigned char)tolower(_ksr_hname_extra_chars[i]);
 	}
 
 	return 0;
 }
 
+/**
+ * register a header name to be indexed by the parser
+ * - the header gets a dedicated id (hdr->hid), its type stays HDR_OTHER_T
+ * - to be used at startup (e.g., mod_init or mod params), before forking
+ * - returns the id (>0) or -1 on error
+ */
+int ksr_hname_register(str *hname)
+{
+	ksr_hdr_map_t *hmap;
+	int i;
+
+	if(hname == NULL || hname->s == NULL || hname->len <= 0) {
+		LM_ERR("invalid header name\n");
+		return -1;
+	}
+	if(!_ksr_is_main) {
+		LM_ERR("header name [%.*s] can be registered only at startup\n",
+				hname->len, hname->s);
+		return -1;
+	}
+	/* registered before the index is built at startup */
+	if(ksr_hname_init_index() < 0) {
+		LM_ERR("failed to init the header names index\n");
+		return -1;
+	}
+	for(i = 0; i < hname->len; i++) {
+		if(_ksr_hname_chars_idx[(unsigned char)hname->s[i]] == 0) {
+			LM_ERR("invalid char in header name [%.*s]\n", hname->len,
+					hname->s);
+			return -1;
+		}
+	}
+	hmap = ksr_hname_lookup_hidx(
+			hname->s, hname->len, ksr_hname_hash(hname->s, hname->len));
+	if(hmap != NULL) {
+		if(hmap->hid > 0) {
+			/* already registered */
+			return hmap->hid;
+		}
+		LM_ERR("header name [%.*s] is known by the core parser\n",
+				hname->len, hname->s);
+		return -1;
+	}
+	if(_ksr_hdr_map_reg_size >= KSR_HNAME_REG_MAX) {
+		LM_ERR("too many registered header names (max %d)\n",
+				KSR_HNAME_REG_MAX);
+		return -1;
+	}
+	hmap = &_ksr_hdr_map_reg[_ksr_hdr_map_reg_size];
+	hmap->hname.s = (char *)malloc(hname->len + 1);
+	if(hmap->hname.s == NULL) {
+		SYS_MEM_ERROR;
+		return -1;
+	}
+	memcpy(hmap->hname.s, hname->s, hname->len);
+	hmap->hname.s[hname->len] = '\0';
+	hmap->hname.len = hname->len;
+	hmap->htype = HDR_OTHER_T;
+	hmap->hflag = HDR_OTHER_F;
+	hmap->hid = _ksr_hdr_map_reg_size + 1;
+	_ksr_hdr_map_reg_size++;
+
+	if(ksr_hname_build_htable() < 0) {
+		_ksr_hdr_map_reg_size--;
+		free(hmap->hname.s);
+		memset(hmap, 0, sizeof(ksr_hdr_map_t));
+		ksr_hname_build_htable();
+		return -1;
+	}
+	LM_DBG("registered header name [%.*s] with id %d\n", hname->len,
+			hname->s, hmap->hid);
+	return hmap->hid;
+}
+
+/**
+ * return the id of a registered header name, 0 if not registered
+ */
+int ksr_hname_get_id(const char *name, int len)
+{
+	ksr_hdr_map_t *hmap;
+	int i;
+
+	if(_ksr_hdr_map_reg_size == 0 || name == NULL || len <= 0) {
+		return 0;
+	}
+	for(i = 0; i < len; i++) {
+		if(_ksr_hname_chars_idx[(unsigned char)name[i]] == 0) {
+			return 0;
+		}
+	}
+	hmap = ksr_hname_lookup_hidx(name, len, ksr_hname_hash(name, len));
+	if(hmap == NULL) {
+		return 0;
+	}
+	return hmap->hid;
+}
+
 /**
  * parse the sip header name in the buffer starting at 'begin' till before 'end'
  * - fills hdr structure (must not be null)
@@ -240,7 +431,8 @@ char *parse_sip_header_name(char *const begin, const char *const end,
 		hdr_field_t *const hdr, int emode, int logmode)
 {
 	char *p;
-	int i;
+	unsigned int h;
+	ksr_hdr_map_t *hmap;
 
 	if(begin == NULL || end == NULL || end <= begin) {
 		hdr->type = HDR_ERROR_T;
@@ -255,13 +447,17 @@ char *parse_sip_header_name(char *const begin, const char *const end,
 		return begin;
 	}
 	hdr->type = HDR_OTHER_T;
+	hdr->hid = 0;
 	hdr->name.s = begin;
 
+	/* hash the name while checking the chars */
+	ksr_hname_hash_init(h, _ksr_hname_chars_idx[(unsigned char)(*begin)]);
 	for(p = begin + 1; p < end; p++) {
 		if(_ksr_hname_chars_idx[(unsigned char)(*p)] == 0) {
 			/* char not allowed in header name */
 			break;
 		}
+		ksr_hname_hash_add(h, _ksr_hname_chars_idx[(unsigned char)(*p)]);
 	}
 	hdr->name.len = p - hdr->name.s;
 
@@ -301,17 +497,11 @@ char *parse_sip_header_name(char *const begin, const char *const end,
 
 done:
 	/* lookup header type */
-	if(_ksr_hdr_map_idx[(unsigned char)(hdr->name.s[0])].idxs >= 0) {
-		for(i = _ksr_hdr_map_idx[(unsigned char)(hdr->name.s[0])].idxs;
-				i <= _ksr_hdr_map_idx[(unsigned char)(hdr->name.s[0])].idxe;
-				i++) {
-			if(hdr->name.len == _ksr_hdr_map[i].hname.len
-					&& strncasecmp(hdr->name.s, _ksr_hdr_map[i].hname.s,
-							   hdr->name.len)
-							   == 0) {
-				hdr->type = _ksr_hdr_map[i].htype;
-			}
-		}
+	hmap = ksr_hname_lookup_hidx(
+			hdr->name.s, hdr->name.len, ksr_hname_hash_idx(h));
+	if(hmap != NULL) {
+		hdr->type = hmap->htype;
+		hdr->hid = hmap->hid;
 	}
 
 	LM_DBG("parsed header name [%.*s] type %d\n", hdr->name.len, hdr->name.s,
@@ -52,7 +52,16 @@ char *parse_hname2_short(
 		char *const begin, const char *const end, struct hdr_field *const hdr);
 char *parse_hname2_str(str *const hbuf, hdr_field_t *const hdr);
 
+/* max number of header names that can be registered by modules */
+#define KSR_HNAME_REG_MAX 64
+
+/* flag in sip_msg_t.hreg_flag for registered header name id */
+#define KSR_HNAME_REG_F(hid) ((hdr_flags_t)1 << ((hid) - 1))
+
 int ksr_hname_init_index(void);
 int ksr_hname_init_config(void);
 
+int ksr_hname_register(str *hname);
+int ksr_hname_get_id(const char *name, int len);
+
 #endif /* PARSE_HNAME2_H */
@@ -366,6 +366,8 @@ int receive_msg(char *buf, unsigned int len, receive_info_t *rcv_info)
 	via_cnt = 0;
 
 	memset(msg, 0, sizeof(struct sip_msg)); /* init everything to 0 */
+	/* xavps created while processing the message can use arena chunks */
+	xavp_arena_start();
 	/* fill in msg */
 	msg->buf = buf;
 	msg->len = len;
@@ -689,4 +691,5 @@ void ksr_msg_env_reset(void)
 	xavp_reset_list();
 	xavu_reset_list();
 	xavi_reset_list();
+	xavp_arena_release();
 }
@@ -47,7 +47,8 @@ enum rpc_flags
 
 typedef enum rpc_capabilities
 {
-	RPC_DELAYED_REPLY = (1 << 0) /* delayed reply support */
+	RPC_DELAYED_REPLY = (1 << 0), /* delayed reply support */
+	RPC_STREAM_REPLY = (1 << 1)	  /* partial replies with rpc->flush() */
 } rpc_capabilities_t;
 
 struct rpc_delayed_ctx;
@@ -78,6 +79,11 @@ typedef rpc_capabilities_t (*rpc_capabilities_f)(void *ctx);
 typedef struct rpc_delayed_ctx *(*rpc_delayed_ctx_new_f)(void *ctx);
 /* close the special "context" for delayed replies */
 typedef void (*rpc_delayed_ctx_close_f)(struct rpc_delayed_ctx *dctx);
+/* send to the client what was added so far, if it is more than the
+ * transport chunk size; all the handles returned by add/struct_add/array_add
+ * before become invalid, so it must be called only between top level items
+ * returns 1 if data was sent, 0 if not yet, <0 on error (client gone) */
+typedef int (*rpc_flush_f)(void *ctx);
 
 /*
  * RPC context, this is what RPC functions get as a parameter and use
@@ -98,8 +104,14 @@ typedef struct rpc
 	rpc_capabilities_f capabilities;
 	rpc_delayed_ctx_new_f delayed_ctx_new;
 	rpc_delayed_ctx_close_f delayed_ctx_close;
+	rpc_flush_f flush; /* set only if RPC_STREAM_REPLY is supported */
 } rpc_t;
 
+/* true if the reply can be sent in parts with rpc->flush() */
+#define rpc_stream_enabled(rpc, ctx)                      \
+	((rpc)->capabilities != NULL && (rpc)->flush != NULL \
+			&& ((rpc)->capabilities(ctx) & RPC_STREAM_REPLY))
+
 
 typedef struct rpc_delayed_ctx
 {
@@ -0,0 +1,662 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file
+ * @brief Kamailio core :: route execution profiler
+ *
+ * When enabled (core.rprof_enable RPC command), the execution of route
+ * blocks, module functions and KEMI functions is accounted per call path
+ * (e.g., request_route;route[AUTH];auth_check): number of calls and
+ * cumulated time, measured with the cpu time stamp counter where
+ * available (monotonic clock otherwise).
+ *
+ * Each process keeps the call tree in its own table in shared memory,
+ * allocated at the first profiled call, updated without locking. The
+ * core.rprof_dump RPC command merges the tables of all processes and
+ * prints the call paths, also in the folded format of flame graph tools.
+ *
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rprof.h"
+#include "dprint.h"
+#include "atomic_ops.h"
+#include "mem/shm.h"
+#include "mem/pkg.h"
+#include "pt.h"
+#include "route.h"
+#include "sr_module.h"
+#include "kemi.h"
+
+/* max number of call paths per process */
+#define KSR_RPROF_NODES 2048
+#define KSR_RPROF_BUCKETS 512
+/* max depth of the call stack */
+#define KSR_RPROF_DEPTH 32
+#define KSR_RPROF_NAME_SIZE 128
+#define KSR_RPROF_PATH_SIZE 2048
+
+typedef struct ksr_rprof_node
+{
+	const void *id;
+	int type;
+	int parent; /* index of the parent node, -1 for top frames */
+	int next;	/* next node in the hash bucket */
+	unsigned long calls;
+	unsigned long long ticks;
+} ksr_rprof_node_t;
+
+typedef struct ksr_rprof_table
+{
+	unsigned int gen;
+	volatile int nodes_no;
+	unsigned long dropped;
+	int buckets[KSR_RPROF_BUCKETS];
+	ksr_rprof_node_t nodes[KSR_RPROF_NODES];
+} ksr_rprof_table_t;
+
+ksr_rprof_state_t *_ksr_rprof_state = NULL;
+
+static ksr_rprof_table_t **_ksr_rprof_tables = NULL;
+static int _ksr_rprof_tables_no = 0;
+
+/* per process call stack */
+static ksr_rprof_table_t *_ksr_rprof_tbl = NULL;
+static int _ksr_rprof_tbl_failed = 0;
+static int _ksr_rprof_depth = 0;
+static int _ksr_rprof_stack[KSR_RPROF_DEPTH];
+static unsigned long long _ksr_rprof_start[KSR_RPROF_DEPTH];
+
+/**
+ * cpu ticks (time stamp counter) or nanoseconds of the monotonic clock
+ */
+static inline unsigned long long ksr_rprof_ticks(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	unsigned int lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((unsigned long long)hi << 32) | lo;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static unsigned long long ksr_rprof_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * init the profiler state, before forking
+ */
+int ksr_rprof_init(int procs_no)
+{
+	if(_ksr_rprof_state != NULL) {
+		return 0;
+	}
+	_ksr_rprof_state =
+			(ksr_rprof_state_t *)shm_mallocxz(sizeof(ksr_rprof_state_t));
+	if(_ksr_rprof_state == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	_ksr_rprof_tables = (ksr_rprof_table_t **)shm_mallocxz(
+			sizeof(ksr_rprof_table_t *) * procs_no);
+	if(_ksr_rprof_tables == NULL) {
+		SHM_MEM_ERROR;
+		shm_free(_ksr_rprof_state);
+		_ksr_rprof_state = NULL;
+		return -1;
+	}
+	_ksr_rprof_tables_no = procs_no;
+	return 0;
+}
+
+/**
+ *
+ */
+void ksr_rprof_destroy(void)
+{
+	int i;
+
+	if(_ksr_rprof_tables != NULL) {
+		for(i = 0; i < _ksr_rprof_tables_no; i++) {
+			if(_ksr_rprof_tables[i] != NULL) {
+				shm_free(_ksr_rprof_tables[i]);
+			}
+		}
+		shm_free(_ksr_rprof_tables);
+		_ksr_rprof_tables = NULL;
+	}
+	if(_ksr_rprof_state != NULL) {
+		shm_free(_ksr_rprof_state);
+		_ksr_rprof_state = NULL;
+	}
+}
+
+/**
+ *
+ */
+static void ksr_rprof_tbl_reset(ksr_rprof_table_t *tbl)
+{
+	tbl->nodes_no = 0;
+	membar_write();
+	tbl->dropped = 0;
+	memset(tbl->buckets, 0xff, sizeof(tbl->buckets));
+	tbl->gen = _ksr_rprof_state->gen;
+}
+
+/**
+ * get the table of the process, allocate it at first use
+ */
+static ksr_rprof_table_t *ksr_rprof_tbl_get(void)
+{
+	ksr_rprof_table_t *tbl;
+
+	if(likely(_ksr_rprof_tbl != NULL)) {
+		return _ksr_rprof_tbl;
+	}
+	if(_ksr_rprof_tbl_failed || process_no < 0
+			|| process_no >= _ksr_rprof_tables_no) {
+		return NULL;
+	}
+	tbl = (ksr_rprof_table_t *)shm_malloc(sizeof(ksr_rprof_table_t));
+	if(tbl == NULL) {
+		SHM_MEM_ERROR;
+		_ksr_rprof_tbl_failed = 1;
+		return NULL;
+	}
+	tbl->nodes_no = 0;
+	ksr_rprof_tbl_reset(tbl);
+	membar_write();
+	_ksr_rprof_tables[process_no] = tbl;
+	_ksr_rprof_tbl = tbl;
+	return tbl;
+}
+
+static inline int ksr_rprof_hash(int type, const void *id, int parent)
+{
+	unsigned long h;
+
+	h = ((unsigned long)id >> 3) ^ ((unsigned long)id >> 11)
+		^ ((unsigned long)(parent + 1) * 31) ^ (unsigned long)type;
+	return (int)(h & (KSR_RPROF_BUCKETS - 1));
+}
+
+/**
+ * start of a profiled frame
+ * @return 1 if the frame was pushed (ksr_rprof_exit() has to be called at
+ *         the end), 0 if not
+ */
+int ksr_rprof_enter(int type, const void *id)
+{
+	ksr_rprof_table_t *tbl;
+	ksr_rprof_node_t *n;
+	int parent;
+	int h;
+	int i;
+
+	if(_ksr_rprof_depth >= KSR_RPROF_DEPTH) {
+		return 0;
+	}
+	tbl = ksr_rprof_tbl_get();
+	if(tbl == NULL) {
+		return 0;
+	}
+	if(_ksr_rprof_depth == 0 && tbl->gen != _ksr_rprof_state->gen) {
+		ksr_rprof_tbl_reset(tbl);
+	}
+	parent = (_ksr_rprof_depth > 0) ? _ksr_rprof_stack[_ksr_rprof_depth - 1]
+									: -1;
+	h = ksr_rprof_hash(type, id, parent);
+	for(i = tbl->buckets[h]; i >= 0; i = tbl->nodes[i].next) {
+		n = &tbl->nodes[i];
+		if(n->id == id && n->type == type && n->parent == parent) {
+			break;
+		}
+	}
+	if(i < 0) {
+		if(tbl->nodes_no >= KSR_RPROF_NODES) {
+			tbl->dropped++;
+			return 0;
+		}
+		i = tbl->nodes_no;
+		n = &tbl->nodes[i];
+		n->id = id;
+		n->type = type;
+		n->parent = parent;
+		n->calls = 0;
+		n->ticks = 0;
+		n->next = tbl->buckets[h];
+		tbl->buckets[h] = i;
+		membar_write();
+		tbl->nodes_no = i + 1;
+	}
+	_ksr_rprof_stack[_ksr_rprof_depth] = i;
+	_ksr_rprof_start[_ksr_rprof_depth] = ksr_rprof_ticks();
+	_ksr_rprof_depth++;
+	return 1;
+}
+
+/**
+ * end of the last pushed frame
+ */
+void ksr_rprof_exit(void)
+{
+	ksr_rprof_node_t *n;
+
+	if(_ksr_rprof_depth <= 0 || _ksr_rprof_tbl == NULL) {
+		return;
+	}
+	_ksr_rprof_depth--;
+	n = &_ksr_rprof_tbl->nodes[_ksr_rprof_stack[_ksr_rprof_depth]];
+	n->calls++;
+	n->ticks += ksr_rprof_ticks() - _ksr_rprof_start[_ksr_rprof_depth];
+}
+
+/**
+ *
+ */
+int ksr_rprof_depth(void)
+{
+	return _ksr_rprof_depth;
+}
+
+/**
+ * close the frames skipped by a long jump (e.g., exit in a sub-route)
+ */
+void ksr_rprof_unwind(int depth)
+{
+	while(_ksr_rprof_depth > depth) {
+		ksr_rprof_exit();
+	}
+}
+
+/**
+ * name of a route block by its action list
+ */
+static void ksr_rprof_route_name(const void *id, char *buf, int size)
+{
+	struct
+	{
+		struct route_list *rt;
+		char *prefix;
+		char *dname;
+	} rls[] = {{&main_rt, "route", "request_route"},
+			{&onreply_rt, "onreply_route", "reply_route"},
+			{&failure_rt, "failure_route", "failure_route"},
+			{&branch_rt, "branch_route", "branch_route"},
+			{&onsend_rt, "onsend_route", "onsend_route"},
+			{&event_rt, "event_route", "event_route"}};
+	struct str_hash_entry *e;
+	struct route_list *rt;
+	int i, h;
+
+	for(i = 0; i < sizeof(rls) / sizeof(rls[0]); i++) {
+		rt = rls[i].rt;
+		if(rt->rlist == NULL || rt->names.table == NULL) {
+			continue;
+		}
+		for(h = 0; h < rt->names.size; h++) {
+			clist_foreach(&rt->names.table[h], e, next)
+			{
+				if(e->u.n < 0 || e->u.n >= rt->idx
+						|| rt->rlist[e->u.n] != id) {
+					continue;
+				}
+				if(e->u.n == 0) {
+					snprintf(buf, size, "%s", rls[i].dname);
+				} else {
+					snprintf(buf, size, "%s[%.*s]", rls[i].prefix, e->key.len,
+							e->key.s);
+				}
+				return;
+			}
+		}
+	}
+	snprintf(buf, size, "route[%p]", id);
+}
+
+/**
+ *
+ */
+static void ksr_rprof_node_name(ksr_rprof_node_t *n, char *buf, int size)
+{
+	ksr_cmd_export_t *cmd;
+	sr_kemi_t *ket;
+	char *p;
+	int rtype;
+
+	switch(n->type) {
+		case KSR_RPROF_ROUTE:
+			ksr_rprof_route_name(n->id, buf, size);
+			break;
+		case KSR_RPROF_CMD:
+			cmd = (ksr_cmd_export_t *)n->id;
+			snprintf(buf, size, "%s", cmd->name);
+			break;
+		case KSR_RPROF_KEMI:
+			ket = (sr_kemi_t *)n->id;
+			if(ket->mname.len > 0) {
+				snprintf(buf, size, "KSR.%.*s.%.*s", ket->mname.len,
+						ket->mname.s, ket->fname.len, ket->fname.s);
+			} else {
+				snprintf(buf, size, "KSR.%.*s", ket->fname.len, ket->fname.s);
+			}
+			break;
+		case KSR_RPROF_KEMI_ROUTE:
+			rtype = (int)(long)n->id;
+			if(rtype & REQUEST_ROUTE) {
+				snprintf(buf, size, "%s",
+						(rtype & ONEVENT_ROUTE) ? "event_route"
+												: "request_route");
+			} else if(rtype & FAILURE_ROUTE) {
+				snprintf(buf, size, "failure_route");
+			} else if(rtype & BRANCH_FAILURE_ROUTE) {
+				snprintf(buf, size, "branch_failure_route");
+			} else if(rtype & ONREPLY_ROUTE) {
+				snprintf(buf, size, "reply_route");
+			} else if(rtype & BRANCH_ROUTE) {
+				snprintf(buf, size, "branch_route");
+			} else if(rtype & ONSEND_ROUTE) {
+				snprintf(buf, size, "onsend_route");
+			} else if(rtype & ONEVENT_ROUTE) {
+				snprintf(buf, size, "event_route");
+			} else {
+				snprintf(buf, size, "route_%d", rtype);
+			}
+			break;
+		default:
+			snprintf(buf, size, "unknown");
+	}
+	/* folded format - frames separated by ';', value after space */
+	for(p = buf; *p; p++) {
+		if(*p == ';' || *p == ' ') {
+			*p = '_';
+		}
+	}
+}
+
+/**
+ * print the call path of a node, from the top frame
+ */
+static int ksr_rprof_path(
+		ksr_rprof_table_t *tbl, int idx, int nodes_no, char *buf, int size)
+{
+	int frames[KSR_RPROF_DEPTH];
+	char name[KSR_RPROF_NAME_SIZE];
+	int fno;
+	int len;
+	int ret;
+
+	for(fno = 0; idx >= 0 && idx < nodes_no && fno < KSR_RPROF_DEPTH; fno++) {
+		frames[fno] = idx;
+		idx = tbl->nodes[idx].parent;
+	}
+	len = 0;
+	buf[0] = '\0';
+	while(fno > 0) {
+		fno--;
+		ksr_rprof_node_name(&tbl->nodes[frames[fno]], name, sizeof(name));
+		ret = snprintf(buf + len, size - len, "%s%s", (len > 0) ? ";" : "",
+				name);
+		if(ret < 0 || ret >= size - len) {
+			return -1;
+		}
+		len += ret;
+	}
+	return len;
+}
+
+typedef struct ksr_rprof_agg
+{
+	unsigned long long phash; /* hash of the path */
+	ksr_rprof_table_t *tbl;
+	int idx;
+	int nodes_no; /* nodes of the table when the dump started */
+	unsigned long calls;
+	unsigned long long ticks;
+	long long self;
+} ksr_rprof_agg_t;
+
+static int ksr_rprof_agg_cmp(const void *a, const void *b)
+{
+	const ksr_rprof_agg_t *x = (const ksr_rprof_agg_t *)a;
+	const ksr_rprof_agg_t *y = (const ksr_rprof_agg_t *)b;
+
+	if(x->phash < y->phash)
+		return -1;
+	return (x->phash > y->phash) ? 1 : 0;
+}
+
+/**
+ * RPC command - enable or disable the profiler
+ */
+void ksr_rprof_rpc_enable(rpc_t *rpc, void *ctx)
+{
+	int val;
+
+	if(_ksr_rprof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	if(rpc->scan(ctx, "d", &val) < 1) {
+		rpc->fault(ctx, 400, "Missing parameter (0 or 1)");
+		return;
+	}
+	if(val != 0 && _ksr_rprof_state->enabled == 0) {
+		_ksr_rprof_state->ticks0 = ksr_rprof_ticks();
+		_ksr_rprof_state->us0 = ksr_rprof_time_us();
+		membar_write();
+	}
+	_ksr_rprof_state->enabled = (val != 0) ? 1 : 0;
+}
+
+/**
+ * RPC command - reset the profiler data
+ * (done by each process before the next profiled top frame)
+ */
+void ksr_rprof_rpc_reset(rpc_t *rpc, void *ctx)
+{
+	if(_ksr_rprof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	_ksr_rprof_state->gen++;
+}
+
+/**
+ * RPC command - print the profiled call paths of all processes
+ */
+void ksr_rprof_rpc_dump(rpc_t *rpc, void *ctx)
+{
+	ksr_rprof_table_t *tbl;
+	ksr_rprof_node_t *n;
+	ksr_rprof_agg_t *agg = NULL;
+	ksr_rprof_agg_t *a;
+	unsigned long long *phs = NULL;
+	int *cnts = NULL;
+	char path[KSR_RPROF_PATH_SIZE + 32];
+	char *mode = NULL;
+	double tpu;
+	unsigned long long dus;
+	unsigned long dropped;
+	int folded;
+	int total;
+	int i, j, k, len;
+	void *th;
+
+	if(_ksr_rprof_state == NULL) {
+		rpc->fault(ctx, 500, "Profiler not initialized");
+		return;
+	}
+	folded = 0;
+	if(rpc->scan(ctx, "*s", &mode) > 0 && mode != NULL
+			&& strcmp(mode, "folded") == 0) {
+		folded = 1;
+	}
+
+	cnts = (int *)pkg_mallocxz(sizeof(int) * _ksr_rprof_tables_no);
+	phs = (unsigned long long *)pkg_malloc(
+			sizeof(unsigned long long) * KSR_RPROF_NODES);
+	if(cnts == NULL || phs == NULL) {
+		PKG_MEM_ERROR;
+		rpc->fault(ctx, 500, "No more memory");
+		goto done;
+	}
+	total = 0;
+	dropped = 0;
+	for(i = 0; i < _ksr_rprof_tables_no; i++) {
+		tbl = _ksr_rprof_tables[i];
+		if(tbl == NULL || tbl->gen != _ksr_rprof_state->gen) {
+			continue;
+		}
+		cnts[i] = tbl->nodes_no;
+		membar_read();
+		total += cnts[i];
+		dropped += tbl->dropped;
+	}
+	if(dropped > 0) {
+		LM_INFO("%lu profiled call paths not recorded - tables full\n",
+				dropped);
+	}
+	if(total == 0) {
+		goto done;
+	}
+	agg = (ksr_rprof_agg_t *)pkg_malloc(sizeof(ksr_rprof_agg_t) * total);
+	if(agg == NULL) {
+		PKG_MEM_ERROR;
+		rpc->fault(ctx, 500, "No more memory");
+		goto done;
+	}
+
+	/* nodes are added after their parents, the hash of the parent path
+	 * is known when a node is reached */
+	k = 0;
+	for(i = 0; i < _ksr_rprof_tables_no; i++) {
+		tbl = _ksr_rprof_tables[i];
+		for(j = 0; j < cnts[i]; j++) {
+			n = &tbl->nodes[j];
+			phs[j] = (n->parent >= 0 && n->parent < j) ? phs[n->parent]
+													   : 14695981039346656037ULL;
+			phs[j] = (phs[j] ^ (unsigned long long)(unsigned long)n->id)
+					 * 1099511628211ULL;
+			phs[j] = (phs[j] ^ (unsigned long long)n->type) * 1099511628211ULL;
+			a = &agg[k + j];
+			a->phash = phs[j];
+			a->tbl = tbl;
+			a->idx = j;
+			a->nodes_no = cnts[i];
+			a->calls = n->calls;
+			a->ticks = n->ticks;
+			a->self = (long long)n->ticks;
+		}
+		for(j = 0; j < cnts[i]; j++) {
+			n = &tbl->nodes[j];
+			if(n->parent >= 0 && n->parent < j) {
+				agg[k + n->parent].self -= (long long)agg[k + j].ticks;
+			}
+		}
+		k += cnts[i];
+	}
+
+	/* merge the same paths of all processes */
+	qsort(agg, total, sizeof(ksr_rprof_agg_t), ksr_rprof_agg_cmp);
+	for(i = 0, j = 0; i < total; i++) {
+		if(j > 0 && agg[j - 1].phash == agg[i].phash) {
+			agg[j - 1].calls += agg[i].calls;
+			agg[j - 1].ticks += agg[i].ticks;
+			agg[j - 1].self += agg[i].self;
+		} else {
+			agg[j++] = agg[i];
+		}
+	}
+	total = j;
+
+	dus = ksr_rprof_time_us() - _ksr_rprof_state->us0;
+	tpu = (dus > 0) ? (double)(ksr_rprof_ticks() - _ksr_rprof_state->ticks0)
+							  / (double)dus
+					: 1.0;
+	if(tpu <= 0) {
+		tpu = 1.0;
+	}
+
+	for(i = 0; i < total; i++) {
+		a = &agg[i];
+		if(a->self < 0) {
+			/* frames still running */
+			a->self = 0;
+		}
+		len = ksr_rprof_path(
+				a->tbl, a->idx, a->nodes_no, path, KSR_RPROF_PATH_SIZE);
+		if(len < 0) {
+			continue;
+		}
+		if(folded) {
+			if((unsigned long)((double)a->self / tpu) == 0) {
+				continue;
+			}
+			snprintf(path + len, sizeof(path) - len, " %lu",
+					(unsigned long)((double)a->self / tpu));
+			if(rpc->add(ctx, "s", path) < 0) {
+				goto done;
+			}
+		} else {
+			if(rpc->add(ctx, "{", &th) < 0) {
+				rpc->fault(ctx, 500, "Internal error creating rpc");
+				goto done;
+			}
+			if(rpc->struct_add(th, "sjjj", "path", path, "calls", a->calls,
+					   "time_us", (unsigned long)((double)a->ticks / tpu),
+					   "self_us", (unsigned long)((double)a->self / tpu))
+					< 0) {
+				rpc->fault(ctx, 500, "Internal error adding item");
+				goto done;
+			}
+		}
+	}
+
+done:
+	if(agg != NULL) {
+		pkg_free(agg);
+	}
+	if(phs != NULL) {
+		pkg_free(phs);
+	}
+	if(cnts != NULL) {
+		pkg_free(cnts);
+	}
+}
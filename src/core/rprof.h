@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * @file
+ * @brief Kamailio core :: route execution profiler
+ * @ingroup core
+ * Module: @ref core
+ */
+
+#ifndef _KSR_RPROF_H_
+#define _KSR_RPROF_H_
+
+#include "compiler_opt.h"
+#include "rpc.h"
+
+/* types of profiled frames */
+#define KSR_RPROF_ROUTE 1	   /* route block - id is the action list */
+#define KSR_RPROF_CMD 2		   /* module function - id is ksr_cmd_export_t */
+#define KSR_RPROF_KEMI 3	   /* kemi function - id is sr_kemi_t */
+#define KSR_RPROF_KEMI_ROUTE 4 /* kemi route - id is the route type */
+
+typedef struct ksr_rprof_state
+{
+	volatile int enabled;
+	volatile unsigned int gen; /* incremented on reset */
+	unsigned long long ticks0; /* ticks and time when enabled, for */
+	unsigned long long us0;	   /* converting the ticks to microseconds */
+} ksr_rprof_state_t;
+
+extern ksr_rprof_state_t *_ksr_rprof_state;
+
+#define ksr_rprof_on() (_ksr_rprof_state != NULL && _ksr_rprof_state->enabled)
+
+int ksr_rprof_init(int procs_no);
+void ksr_rprof_destroy(void);
+
+int ksr_rprof_enter(int type, const void *id);
+void ksr_rprof_exit(void);
+
+/* accounting of kemi function calls, when the route profiler is on */
+#define KSR_RPROF_KEMI_ENTER(ket) \
+	((unlikely(ksr_rprof_on())) ? ksr_rprof_enter(KSR_RPROF_KEMI, (ket)) : 0)
+#define KSR_RPROF_KEMI_EXIT(rpf) \
+	do {                         \
+		if(unlikely(rpf))        \
+			ksr_rprof_exit();    \
+	} while(0)
+int ksr_rprof_depth(void);
+void ksr_rprof_unwind(int depth);
+
+void ksr_rprof_rpc_enable(rpc_t *rpc, void *ctx);
+void ksr_rprof_rpc_reset(rpc_t *rpc, void *ctx);
+void ksr_rprof_rpc_dump(rpc_t *rpc, void *ctx);
+
+#endif
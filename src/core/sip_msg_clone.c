@@ -310,22 +310,26 @@ static inline struct auth_body *auth_body_cloner(
 static inline int clone_authorized_hooks(
 		struct sip_msg *new, struct sip_msg *old)
 {
-	struct hdr_field *ptr, *new_ptr, *hook1, *hook2;
+	struct hdr_field *new_ptr, *hook1, *hook2;
+	char *name1, *name2;
 	char stop = 0;
 
+	/* the list of headers in the clone can be shorter (compact mode), match
+	 * the headers by their position in the message buffer */
 	get_authorized_cred(old->authorization, &hook1);
 	if(!hook1)
 		stop = 1;
+	name1 = (hook1) ? translate_pointer(new->buf, old->buf, hook1->name.s)
+					: NULL;
 
 	get_authorized_cred(old->proxy_auth, &hook2);
 	if(!hook2)
 		stop |= 2;
+	name2 = (hook2) ? translate_pointer(new->buf, old->buf, hook2->name.s)
+					: NULL;
 
-	ptr = old->headers;
-	new_ptr = new->headers;
-
-	while(ptr) {
-		if(ptr == hook1) {
+	for(new_ptr = new->headers; new_ptr && stop != 3; new_ptr = new_ptr->next) {
+		if(name1 && new_ptr->name.s == name1) {
 			if(!new->authorization || !new->authorization->parsed) {
 				LM_CRIT("Error in message cloner (authorization)\n");
 				return -1;
@@ -335,7 +339,7 @@ static inline int clone_authorized_hooks(
 			stop |= 1;
 		}
 
-		if(ptr == hook2) {
+		if(name2 && new_ptr->name.s == name2) {
 			if(!new->proxy_auth || !new->proxy_auth->parsed) {
 				LM_CRIT("Error in message cloner (proxy_auth)\n");
 				return -1;
@@ -343,14 +347,52 @@ static inline int clone_authorized_hooks(
 			((struct auth_body *)new->proxy_auth->parsed)->authorized = new_ptr;
 			stop |= 2;
 		}
+	}
+	return 0;
+}
+
+
+/* reset the header hooks of a sip_msg_t in the range [_first, _last] */
+#define SIP_MSG_HOOKS_RESET(_msg, _first, _last) \
+	memset(&(_msg)->_first, 0,                   \
+			(char *)(&(_msg)->_last + 1) - (char *)(&(_msg)->_first))
+
+/* number of Via headers with parsed bodies kept in compact mode */
+#define SIP_MSG_CLONE_COMPACT_VIAS 2
 
-		if(stop == 3)
-			break;
+/* parsed flags of the headers kept in compact mode */
+#define SIP_MSG_CLONE_COMPACT_HDRS_F                                       \
+	(HDR_VIA_F | HDR_VIA1_F | HDR_VIA2_F | HDR_TO_F | HDR_FROM_F            \
+			| HDR_CSEQ_F | HDR_CALLID_F | HDR_CONTACT_F | HDR_MAXFORWARDS_F \
+			| HDR_ROUTE_F | HDR_RECORDROUTE_F | HDR_CONTENTTYPE_F           \
+			| HDR_CONTENTLENGTH_F | HDR_AUTHORIZATION_F | HDR_PROXYAUTH_F)
 
-		ptr = ptr->next;
-		new_ptr = new_ptr->next;
+/**
+ * return 1 if the header is not cloned in the given mode
+ * - compact mode keeps only the headers used by tm internally
+ */
+static inline int sip_msg_clone_hdr_skip(hdr_field_t *hdr, unsigned int mode)
+{
+	if(likely(!(mode & KSR_MSG_CLONE_COMPACT)))
+		return 0;
+	switch(hdr->type) {
+		case HDR_VIA_T:
+		case HDR_TO_T:
+		case HDR_FROM_T:
+		case HDR_CSEQ_T:
+		case HDR_CALLID_T:
+		case HDR_CONTACT_T:
+		case HDR_MAXFORWARDS_T:
+		case HDR_ROUTE_T:
+		case HDR_RECORDROUTE_T:
+		case HDR_CONTENTTYPE_T:
+		case HDR_CONTENTLENGTH_T:
+		case HDR_AUTHORIZATION_T:
+		case HDR_PROXYAUTH_T:
+			return 0;
+		default:
+			return 1;
 	}
-	return 0;
 }
 
 
@@ -359,12 +401,19 @@ static inline int clone_authorized_hooks(
 #define HOOK_SET(hook) (new_msg->hook != org_msg->hook)
 
 unsigned int sip_msg_clone_len(sip_msg_t *org_msg, int clone_lumps)
+{
+	return sip_msg_clone_len_mode(org_msg, clone_lumps, KSR_MSG_CLONE_DEFAULT);
+}
+
+unsigned int sip_msg_clone_len_mode(
+		sip_msg_t *org_msg, int clone_lumps, unsigned int mode)
 {
 	struct hdr_field *hdr;
 	struct via_body *via;
 	struct via_param *prm;
 	struct to_param *to_prm;
 	unsigned int len;
+	int nvia = 0;
 
 	/*computing the length of entire sip_msg structure*/
 	len = ROUND4(sizeof(struct sip_msg));
@@ -380,6 +429,8 @@ unsigned int sip_msg_clone_len(sip_msg_t *org_msg, int clone_lumps)
 		len += ROUND4(org_msg->path_vec.len);
 	/*all the headers*/
 	for(hdr = org_msg->headers; hdr; hdr = hdr->next) {
+		if(sip_msg_clone_hdr_skip(hdr, mode))
+			continue;
 		/*size of header struct*/
 		len += ROUND4(sizeof(struct hdr_field));
 		switch(hdr->type) {
@@ -391,6 +442,12 @@ unsigned int sip_msg_clone_len(sip_msg_t *org_msg, int clone_lumps)
 				break;
 
 			case HDR_VIA_T:
+				if((mode & KSR_MSG_CLONE_COMPACT)
+						&& nvia++ >= SIP_MSG_CLONE_COMPACT_VIAS)
+					break;
+				/* Via left unparsed by a compact clone */
+				if(hdr->parsed == NULL)
+					break;
 				for(via = (struct via_body *)hdr->parsed; via;
 						via = via->next) {
 					len += ROUND4(sizeof(struct via_body));
@@ -495,14 +552,29 @@ unsigned int sip_msg_clone_len(sip_msg_t *org_msg, int clone_lumps)
  */
 struct sip_msg *sip_msg_shm_clone(
 		struct sip_msg *org_msg, int *sip_msg_len, int clone_lumps)
+{
+	return sip_msg_shm_clone_mode(
+			org_msg, sip_msg_len, clone_lumps, KSR_MSG_CLONE_DEFAULT);
+}
+
+/** Creates a shm clone for a sip_msg, with the given clone mode.
+ * With KSR_MSG_CLONE_COMPACT, only the headers used by tm are indexed and
+ * only the first Via headers keep their parsed bodies. The raw buffer is
+ * cloned entirely, sip_msg_shm_clone_expand() can be used on a private
+ * copy to get back all the headers.
+ * @return shm malloced sip_msg on success, 0 on error
+ */
+struct sip_msg *sip_msg_shm_clone_mode(struct sip_msg *org_msg,
+		int *sip_msg_len, int clone_lumps, unsigned int mode)
 {
 	unsigned int len;
 	struct hdr_field *hdr, *new_hdr, *last_hdr;
 	struct to_param *to_prm, *new_to_prm;
 	struct sip_msg *new_msg;
 	char *p;
+	int nvia = 0;
 
-	len = sip_msg_clone_len(org_msg, clone_lumps);
+	len = sip_msg_clone_len_mode(org_msg, clone_lumps, mode);
 	p = (char *)shm_malloc(len);
 	if(!p) {
 		SHM_MEM_ERROR;
@@ -596,8 +668,21 @@ struct sip_msg *sip_msg_shm_clone(
 	/*headers list*/
 	new_msg->via1 = 0;
 	new_msg->via2 = 0;
+	new_msg->headers = 0;
+	new_msg->last_header = 0;
+
+	if(mode & KSR_MSG_CLONE_COMPACT) {
+		/* hooks of the headers that are not cloned */
+		new_msg->expires = 0;
+		SIP_MSG_HOOKS_RESET(new_msg, supported, min_expires);
+		new_msg->msg_flags |= FL_SHM_CLONE_COMPACT;
+		/* the headers not cloned have to be looked up as not parsed */
+		new_msg->parsed_flag &= SIP_MSG_CLONE_COMPACT_HDRS_F;
+	}
 
 	for(hdr = org_msg->headers, last_hdr = 0; hdr; hdr = hdr->next) {
+		if(sip_msg_clone_hdr_skip(hdr, mode))
+			continue;
 		new_hdr = (struct hdr_field *)p;
 		memcpy(new_hdr, hdr, sizeof(struct hdr_field));
 		p += ROUND4(sizeof(struct hdr_field));
@@ -634,6 +719,12 @@ struct sip_msg *sip_msg_shm_clone(
 				break;
 
 			case HDR_VIA_T:
+				if((mode & KSR_MSG_CLONE_COMPACT)
+						&& nvia++ >= SIP_MSG_CLONE_COMPACT_VIAS)
+					break;
+				/* Via left unparsed by a compact clone, kept unparsed */
+				if(hdr->parsed == NULL)
+					break;
 				if(!new_msg->via1) {
 					new_msg->h_via1 = new_hdr;
 					new_msg->via1 = via_body_cloner(new_msg->buf, org_msg->buf,
@@ -996,6 +1087,76 @@ int msg_lump_cloner(struct sip_msg *pkg_msg, struct lump **add_rm,
 	return 0;
 }
 
+/**
+ * rebuild the full list of headers for a private copy of a compact clone
+ * - the new header structures are allocated in pkg by the parser, the
+ *   parsed bodies available in the clone are linked to them
+ * - the old header structures are left inside the clone memory block
+ * @return 0 on success, -1 on error
+ */
+int sip_msg_shm_clone_expand(sip_msg_t *msg)
+{
+	hdr_field_t *ohdrs;
+	hdr_field_t *hdr;
+	hdr_field_t *ohdr;
+	auth_body_t *auth;
+
+	if(!(msg->msg_flags & FL_SHM_CLONE_COMPACT)) {
+		return 0;
+	}
+
+	ohdrs = msg->headers;
+	msg->headers = 0;
+	msg->last_header = 0;
+	msg->via1 = 0;
+	msg->via2 = 0;
+	SIP_MSG_HOOKS_RESET(msg, h_via1, min_expires);
+	msg->parsed_flag = 0;
+	msg->eoh = 0;
+	msg->unparsed = msg->buf + msg->first_line.len;
+	msg->msg_flags &= ~FL_SHM_CLONE_COMPACT;
+
+	if(parse_headers(msg, HDR_EOH_F, 0) < 0) {
+		LM_ERR("failed to parse the headers of the cloned message\n");
+		free_hdr_field_lst(msg->headers);
+		msg->headers = 0;
+		msg->last_header = 0;
+		return -1;
+	}
+
+	for(hdr = msg->headers; hdr; hdr = hdr->next) {
+		for(ohdr = ohdrs; ohdr; ohdr = ohdr->next) {
+			if(ohdr->name.s == hdr->name.s) {
+				break;
+			}
+		}
+		if(ohdr == NULL) {
+			continue;
+		}
+		if(hdr->parsed == NULL) {
+			hdr->parsed = ohdr->parsed;
+		}
+		if(hdr->type != HDR_AUTHORIZATION_T && hdr->type != HDR_PROXYAUTH_T) {
+			continue;
+		}
+		/* authorized credentials must refer to the new header structures */
+		for(auth = (auth_body_t *)hdr->parsed, ohdr = ohdrs; auth && ohdr;
+				ohdr = ohdr->next) {
+			if(auth->authorized == ohdr) {
+				for(auth->authorized = msg->headers; auth->authorized;
+						auth->authorized = auth->authorized->next) {
+					if(auth->authorized->name.s == ohdr->name.s) {
+						break;
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
 /**
  *
  */
@@ -19,11 +19,24 @@
 
 #include "parser/msg_parser.h"
 
+/* clone modes */
+#define KSR_MSG_CLONE_DEFAULT 0
+/* clone only the header index and parsed bodies needed by tm */
+#define KSR_MSG_CLONE_COMPACT (1 << 0)
+
 unsigned int sip_msg_clone_len(sip_msg_t *org_msg, int clone_lumps);
 
+unsigned int sip_msg_clone_len_mode(
+		sip_msg_t *org_msg, int clone_lumps, unsigned int mode);
+
 struct sip_msg *sip_msg_shm_clone(
 		struct sip_msg *org_msg, int *sip_msg_len, int clone_lumps);
 
+struct sip_msg *sip_msg_shm_clone_mode(struct sip_msg *org_msg,
+		int *sip_msg_len, int clone_lumps, unsigned int mode);
+
+int sip_msg_shm_clone_expand(sip_msg_t *msg);
+
 int msg_lump_cloner(struct sip_msg *pkg_msg, struct lump **add_rm,
 		struct lump **body_lumps, struct lump_rpl **reply_lump);
 
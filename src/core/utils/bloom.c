@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief core/utils :: Bloom filter in shared memory
+ * \ingroup core/utils
+ * Module: \ref core/utils
+ *
+ * The probes of a key are derived from one 64 bit FNV-1a hash, split in
+ * two halves for double hashing. The hash is computed one char at a time,
+ * so all the prefixes of a value are hashed in a single pass.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/dprint.h"
+
+#include "bloom.h"
+
+#define KSR_BLOOM_FNV_BASIS 0xcbf29ce484222325ULL
+#define KSR_BLOOM_FNV_PRIME 0x100000001b3ULL
+#define KSR_BLOOM_BITS_MIN 64
+#define KSR_BLOOM_BITS_MAX (1UL << 31)
+#define KSR_BLOOM_NHASH_MAX 16
+
+
+ksr_bloom_t *ksr_bloom_new(
+		unsigned int items, unsigned int bits_per_item, unsigned int flags)
+{
+	ksr_bloom_t *b;
+	unsigned long want;
+	unsigned long nbits;
+	unsigned long msize;
+	unsigned int nhash;
+
+	if(bits_per_item == 0)
+		bits_per_item = 10;
+	want = (unsigned long)items * bits_per_item;
+	for(nbits = KSR_BLOOM_BITS_MIN; nbits < want && nbits < KSR_BLOOM_BITS_MAX;
+			nbits <<= 1)
+		;
+	/* ln(2) * bits per key probes give the fewest false positives */
+	nhash = (bits_per_item * 69 + 50) / 100;
+	if(nhash == 0)
+		nhash = 1;
+	if(nhash > KSR_BLOOM_NHASH_MAX)
+		nhash = KSR_BLOOM_NHASH_MAX;
+
+	msize = sizeof(ksr_bloom_t) + nbits / 8;
+	b = (ksr_bloom_t *)shm_malloc(msize);
+	if(b == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(b, 0, msize);
+	b->mask = (unsigned int)(nbits - 1);
+	b->nhash = nhash;
+	b->flags = flags;
+	b->bits = (unsigned int *)(b + 1);
+
+	return b;
+}
+
+
+void ksr_bloom_free(ksr_bloom_t *b)
+{
+	if(b != NULL)
+		shm_free(b);
+}
+
+
+static inline uint64_t ksr_bloom_step(ksr_bloom_t *b, uint64_t h, char c)
+{
+	unsigned char u;
+
+	u = (unsigned char)c;
+	if((b->flags & KSR_BLOOM_ICASE) && u >= 'A' && u <= 'Z')
+		u += 'a' - 'A';
+	return (h ^ u) * KSR_BLOOM_FNV_PRIME;
+}
+
+
+/**
+ * spread the bits of the FNV hash, its low bits are weak
+ */
+static inline uint64_t ksr_bloom_final(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+static inline int ksr_bloom_lenmap_isset(ksr_bloom_t *b, int len)
+{
+	return (b->lenmap[len >> 5] >> (len & 31)) & 1;
+}
+
+
+static void ksr_bloom_set(ksr_bloom_t *b, uint64_t h)
+{
+	unsigned int h1;
+	unsigned int h2;
+	unsigned int bit;
+	unsigned int i;
+
+	h = ksr_bloom_final(h);
+	h1 = (unsigned int)h;
+	h2 = (unsigned int)(h >> 32) | 1;
+	for(i = 0; i < b->nhash; i++) {
+		bit = (h1 + i * h2) & b->mask;
+		b->bits[bit >> 5] |= 1U << (bit & 31);
+	}
+}
+
+
+static int ksr_bloom_probe(ksr_bloom_t *b, uint64_t h)
+{
+	unsigned int h1;
+	unsigned int h2;
+	unsigned int bit;
+	unsigned int i;
+
+	h = ksr_bloom_final(h);
+	h1 = (unsigned int)h;
+	h2 = (unsigned int)(h >> 32) | 1;
+	for(i = 0; i < b->nhash; i++) {
+		bit = (h1 + i * h2) & b->mask;
+		if((b->bits[bit >> 5] & (1U << (bit & 31))) == 0)
+			return 0;
+	}
+	return 1;
+}
+
+
+static int ksr_bloom_key_len(str *key)
+{
+	if(key->len <= 0)
+		return 0;
+	return (key->len < KSR_BLOOM_KEY_MAX) ? key->len : KSR_BLOOM_KEY_MAX;
+}
+
+
+void ksr_bloom_add(ksr_bloom_t *b, str *key)
+{
+	uint64_t h;
+	int n;
+	int i;
+
+	n = ksr_bloom_key_len(key);
+	h = KSR_BLOOM_FNV_BASIS;
+	for(i = 0; i < n; i++)
+		h = ksr_bloom_step(b, h, key->s[i]);
+	ksr_bloom_set(b, h);
+	/* the bits of the key before its length, for the prefix checks */
+	membar_write();
+	b->lenmap[n >> 5] |= 1U << (n & 31);
+	b->items++;
+}
+
+
+static inline void ksr_bloom_count(ksr_bloom_t *b, int ret)
+{
+	atomic_inc_long(&b->checks);
+	if(ret)
+		atomic_inc_long(&b->positives);
+}
+
+
+int ksr_bloom_check(ksr_bloom_t *b, str *key)
+{
+	uint64_t h;
+	int ret;
+	int n;
+	int i;
+
+	n = ksr_bloom_key_len(key);
+	ret = 0;
+	if(ksr_bloom_lenmap_isset(b, n)) {
+		h = KSR_BLOOM_FNV_BASIS;
+		for(i = 0; i < n; i++)
+			h = ksr_bloom_step(b, h, key->s[i]);
+		ret = ksr_bloom_probe(b, h);
+	}
+	ksr_bloom_count(b, ret);
+
+	return ret;
+}
+
+
+int ksr_bloom_check_prefix(ksr_bloom_t *b, str *val)
+{
+	uint64_t h;
+	int ret;
+	int n;
+	int i;
+
+	n = ksr_bloom_key_len(val);
+	ret = 0;
+	h = KSR_BLOOM_FNV_BASIS;
+	for(i = 0;; i++) {
+		if(ksr_bloom_lenmap_isset(b, i) && ksr_bloom_probe(b, h)) {
+			ret = 1;
+			break;
+		}
+		if(i == n)
+			break;
+		h = ksr_bloom_step(b, h, val->s[i]);
+	}
+	ksr_bloom_count(b, ret);
+
+	return ret;
+}
+
+
+void ksr_bloom_false_positive(ksr_bloom_t *b)
+{
+	atomic_inc_long(&b->false_positives);
+}
+
+
+void ksr_bloom_get_stats(ksr_bloom_t *b, ksr_bloom_stats_t *st)
+{
+	unsigned int i;
+
+	memset(st, 0, sizeof(ksr_bloom_stats_t));
+	if(b == NULL)
+		return;
+	st->bits = b->mask + 1;
+	for(i = 0; i <= b->mask >> 5; i++)
+		st->bits_set += __builtin_popcount(b->bits[i]);
+	st->nhash = b->nhash;
+	st->items = b->items;
+	st->checks = (unsigned long)b->checks;
+	st->positives = (unsigned long)b->positives;
+	st->false_positives = (unsigned long)b->false_positives;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief core/utils :: Bloom filter in shared memory
+ * \ingroup core/utils
+ * Module: \ref core/utils
+ *
+ * A Bloom filter tells quickly that a key is not in a set, so that the
+ * lookup of the exact data structure can be skipped. A positive answer
+ * can be wrong and has to be confirmed by the exact lookup, reporting
+ * the false positives back for the statistics. There are no false
+ * negatives, as long as all the keys of the set were added.
+ *
+ * The keys can also be checked as prefixes: the filter keeps the lengths
+ * of the keys added to it and ksr_bloom_check_prefix() probes only the
+ * prefixes of a value with one of these lengths. The keys longer than
+ * KSR_BLOOM_KEY_MAX chars are added truncated.
+ *
+ * The keys can not be removed, a removed key is only a false positive
+ * until the filter is built again. The adds have to be serialized by the
+ * caller, the checks can run in parallel with them.
+ */
+
+#ifndef _KSR_BLOOM_H_
+#define _KSR_BLOOM_H_
+
+#include "../../core/str.h"
+
+/*! longer keys are truncated */
+#define KSR_BLOOM_KEY_MAX 255
+
+/*! flags */
+#define KSR_BLOOM_ICASE (1 << 0) /*!< case insensitive keys */
+
+typedef struct ksr_bloom
+{
+	unsigned int mask;	/*!< number of bits - 1, power of 2 */
+	unsigned int nhash; /*!< number of probes per key */
+	unsigned int flags;
+	unsigned int items; /*!< number of keys added */
+	volatile long checks;
+	volatile long positives;
+	volatile long false_positives;
+	unsigned int lenmap[(KSR_BLOOM_KEY_MAX + 1) / 32]; /*!< key lengths */
+	unsigned int *bits;
+} ksr_bloom_t;
+
+typedef struct ksr_bloom_stats
+{
+	unsigned int bits;
+	unsigned int bits_set;
+	unsigned int nhash;
+	unsigned int items;
+	unsigned long checks;
+	unsigned long positives;
+	unsigned long false_positives;
+} ksr_bloom_stats_t;
+
+/*!
+ * \brief Allocates an empty filter in shared memory
+ * \param items expected number of keys
+ * \param bits_per_item bits per key, 10 gives about 1% false positives
+ * \param flags KSR_BLOOM_* flags
+ * \return the filter on success, NULL otherwise
+ */
+ksr_bloom_t *ksr_bloom_new(
+		unsigned int items, unsigned int bits_per_item, unsigned int flags);
+
+void ksr_bloom_free(ksr_bloom_t *b);
+
+/*!
+ * \brief Adds a key to the filter
+ */
+void ksr_bloom_add(ksr_bloom_t *b, str *key);
+
+/*!
+ * \brief Checks if a key may be in the filter
+ * \return 1 if the key may have been added, 0 if it was not
+ */
+int ksr_bloom_check(ksr_bloom_t *b, str *key);
+
+/*!
+ * \brief Checks if a prefix of a value may be in the filter
+ * \return 1 if a key added may be a prefix of the value, 0 if none is
+ */
+int ksr_bloom_check_prefix(ksr_bloom_t *b, str *val);
+
+/*!
+ * \brief Counts a positive check not confirmed by the exact lookup
+ */
+void ksr_bloom_false_positive(ksr_bloom_t *b);
+
+void ksr_bloom_get_stats(ksr_bloom_t *b, ksr_bloom_stats_t *st);
+
+#endif
@@ -989,6 +989,97 @@ int tr_check_recurrence(tmrec_t *_trp, ac_tm_t *_atp, tr_res_t *_tsw)
 }
 
 
+/**
+ * return the first time after _atp->time when the result of
+ * tr_check_recurrence() can change, 0 if it can not change anymore
+ *
+ * After the first interval, a day either matches or not as a whole and
+ * the time of the day has to be in the interval starting at the time of
+ * dtstart, so the result can change only at the start or at the end of
+ * that interval or at midnight.
+ */
+time_t tr_next_change(tmrec_t *_trp, ac_tm_t *_atp)
+{
+	struct tm _tm;
+	time_t _d, _t;
+	int _v0, _v1, _c;
+
+	if(!_trp || !_atp)
+		return 0;
+
+	if(_atp->time < _trp->dtstart)
+		return _trp->dtstart;
+
+	_d = _IS_SET(_trp->duration) ? _trp->duration
+								  : _trp->dtend - _trp->dtstart;
+	if(_d <= 0)
+		return 0;
+
+	if(_atp->time <= _trp->dtstart + _d)
+		return _trp->dtstart + _d + 1;
+
+	if(_IS_SET(_trp->until) && _atp->time >= _trp->until + _d)
+		return 0;
+
+	_v0 = _trp->ts.tm_hour * 3600 + _trp->ts.tm_min * 60 + _trp->ts.tm_sec;
+	_v1 = _atp->t.tm_hour * 3600 + _atp->t.tm_min * 60 + _atp->t.tm_sec;
+	if(_v1 < _v0)
+		_c = _v0;
+	else if(_v0 + _d < 86400 && _v1 < _v0 + _d)
+		_c = _v0 + _d;
+	else
+		_c = 86400;
+
+	/* the next midnight is normalized by mktime() */
+	_tm = _atp->t;
+	_tm.tm_hour = _c / 3600;
+	_tm.tm_min = (_c % 3600) / 60;
+	_tm.tm_sec = _c % 60;
+	_tm.tm_isdst = -1;
+	_t = mktime(&_tm);
+	/* the local time jumps on a daylight saving change, check again at
+	 * the next quarter of an hour */
+	if(_t == (time_t)-1 || _tm.tm_isdst != _atp->t.tm_isdst) {
+		if(_t == (time_t)-1 || _t > _atp->time - _atp->time % 900 + 900)
+			_t = _atp->time - _atp->time % 900 + 900;
+	}
+	if(_t <= _atp->time)
+		_t = _atp->time + 1;
+
+	if(_IS_SET(_trp->until) && _t > _trp->until + _d)
+		_t = _trp->until + _d;
+	return _t;
+}
+
+
+/**
+ * return the result of tr_check_recurrence() for the time _t, kept in _st
+ * until the next time it can change
+ */
+int tr_check_recurrence_state(tmrec_t *_trp, time_t _t, tr_state_t *_st)
+{
+	ac_tm_t _at;
+	int _ret;
+
+	if(_st->from > 0 && _t >= _st->from
+			&& (_st->until == 0 || _t < _st->until))
+		return _st->match;
+
+	memset(&_at, 0, sizeof(ac_tm_t));
+	if(ac_tm_set_time(&_at, _t) < 0)
+		return REC_ERR;
+	_ret = tr_check_recurrence(_trp, &_at, 0);
+	if(_ret != REC_ERR) {
+		_st->match = _ret;
+		_st->from = _t;
+		_st->until = tr_next_change(_trp, &_at);
+	}
+	ac_tm_destroy(&_at);
+
+	return _ret;
+}
+
+
 int check_freq_interval(tmrec_t *_trp, ac_tm_t *_atp)
 {
 	uint64_t _t0, _t1;
@@ -137,6 +137,14 @@ typedef struct _tr_res
 	time_t rest;
 } tr_res_t;
 
+/* result of a recurrence check and the time range it holds for */
+typedef struct _tr_state
+{
+	int match;	  /* result of tr_check_recurrence() */
+	time_t from;  /* unset if 0 */
+	time_t until; /* excluded, 0 for ever */
+} tr_state_t;
+
 tr_byxxx_t *tr_byxxx_new(void);
 int tr_byxxx_init(tr_byxxx_t *, int);
 int tr_byxxx_free(tr_byxxx_t *);
@@ -167,6 +175,8 @@ tr_byxxx_t *ic_parse_byxxx(char *);
 int ic_parse_wkst(char *);
 
 int tr_check_recurrence(tmrec_t *, ac_tm_t *, tr_res_t *);
+time_t tr_next_change(tmrec_t *, ac_tm_t *);
+int tr_check_recurrence_state(tmrec_t *, time_t, tr_state_t *);
 int tr_parse_recurrence_string(tmrec_t *trp, char *rdef, char sep);
 
 
@@ -27,6 +27,7 @@
 #include "mem/shm_mem.h"
 #include "dprint.h"
 #include "hashes.h"
+#include "atomic_ops.h"
 #include "xavp.h"
 
 /*! XAVP list head */
@@ -44,12 +45,157 @@ static sr_xavp_t *_xavi_list_head = 0;
 /*! Pointer to XAVI current list */
 static sr_xavp_t **_xavi_list_crt = &_xavi_list_head;
 
+/*! size of shm chunks used to allocate xavp nodes (0 - disabled) */
+int ksr_xavp_arena_size = 0;
+
+/*! chunk of shm for allocation of xavp nodes
+ * - the nodes are taken in sequence (bump pointer), the chunk is released
+ *   when all its nodes are freed and the owner process does not use it
+ *   anymore (one reference is kept by the owner while allocating)
+ * - a single live node keeps the whole chunk allocated, therefore the
+ *   chunks are used only for the nodes created while processing a received
+ *   message, which are destroyed with the message or its transaction; the
+ *   other nodes (timer or rpc processes, clones kept by modules like usrloc)
+ *   are allocated one by one */
+typedef struct xavp_arena_chunk
+{
+	atomic_t refcnt;
+	int size;
+	int used;
+} xavp_arena_chunk_t;
+
+/*! prefix of xavp nodes allocated in arena chunks */
+typedef struct xavp_arena_hdr
+{
+	xavp_arena_chunk_t *chunk;
+} xavp_arena_hdr_t;
+
+#define XAVP_ARENA_ALIGN(s) (((s) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+#define XAVP_ARENA_CHUNK_HDR XAVP_ARENA_ALIGN(sizeof(xavp_arena_chunk_t))
+
+/*! arena chunk used by current process for allocations */
+static xavp_arena_chunk_t *_xavp_arena_crt = NULL;
+/*! set while processing a received message, when arena chunks can be used */
+static int _xavp_arena_on = 0;
+
 /*! Helper functions */
 static sr_xavp_t *xavp_get_internal(
 		str *name, sr_xavp_t **list, int idx, sr_xavp_t **prv);
 static int xavp_rm_internal(str *name, sr_xavp_t **head, int idx);
 
 
+/**
+ * enable the allocation of nodes in arena chunks, until the next release
+ * - done at the start of processing a received message
+ */
+void xavp_arena_start(void)
+{
+	_xavp_arena_on = 1;
+}
+
+/**
+ * release the arena chunk used by current process for allocations
+ * - new nodes will be allocated in a new chunk, the old one is freed when
+ *   its last node is freed
+ * - done at the end of processing a message, so the nodes of a message or
+ *   transaction are grouped in the same chunks
+ */
+void xavp_arena_release(void)
+{
+	_xavp_arena_on = 0;
+	if(_xavp_arena_crt == NULL) {
+		return;
+	}
+	if(atomic_dec_and_test(&_xavp_arena_crt->refcnt)) {
+		shm_free(_xavp_arena_crt);
+	}
+	_xavp_arena_crt = NULL;
+}
+
+/**
+ * allocate a xavp node of size in the arena chunk
+ * - returns NULL if arena is disabled, the node is too large or there is no
+ *   more shm, the caller should fallback to shm_malloc()
+ */
+static void *xavp_arena_alloc(int size)
+{
+	xavp_arena_hdr_t *ah;
+	int asize;
+
+	if(ksr_xavp_arena_size <= 0 || _xavp_arena_on == 0) {
+		return NULL;
+	}
+	asize = XAVP_ARENA_ALIGN(sizeof(xavp_arena_hdr_t) + size);
+	if(asize > ksr_xavp_arena_size / 4) {
+		return NULL;
+	}
+	if(_xavp_arena_crt == NULL
+			|| _xavp_arena_crt->used + asize > _xavp_arena_crt->size) {
+		xavp_arena_release();
+		_xavp_arena_crt = (xavp_arena_chunk_t *)shm_malloc(
+				XAVP_ARENA_CHUNK_HDR + ksr_xavp_arena_size);
+		if(_xavp_arena_crt == NULL) {
+			return NULL;
+		}
+		atomic_set(&_xavp_arena_crt->refcnt, 1);
+		_xavp_arena_crt->size = ksr_xavp_arena_size;
+		_xavp_arena_crt->used = 0;
+	}
+	ah = (xavp_arena_hdr_t *)((char *)_xavp_arena_crt + XAVP_ARENA_CHUNK_HDR
+							  + _xavp_arena_crt->used);
+	_xavp_arena_crt->used += asize;
+	atomic_inc(&_xavp_arena_crt->refcnt);
+	ah->chunk = _xavp_arena_crt;
+
+	return (void *)(ah + 1);
+}
+
+/**
+ * allocate a new xavp node (zeroed) - in arena chunk if enabled
+ */
+static sr_xavp_t *xavp_node_alloc(int size)
+{
+	sr_xavp_t *xa;
+
+	xa = (sr_xavp_t *)xavp_arena_alloc(size);
+	if(xa != NULL) {
+		memset(xa, 0, size);
+		xa->flags = XAVP_FLAG_ARENA;
+		return xa;
+	}
+	xa = (sr_xavp_t *)shm_malloc(size);
+	if(xa == NULL) {
+		return NULL;
+	}
+	memset(xa, 0, size);
+	return xa;
+}
+
+/**
+ * free the memory of a xavp node
+ */
+static void xavp_node_free(sr_xavp_t *xa, int unsafe)
+{
+	xavp_arena_chunk_t *chunk;
+
+	if(xa->flags & XAVP_FLAG_ARENA) {
+		chunk = ((xavp_arena_hdr_t *)xa - 1)->chunk;
+		if(atomic_dec_and_test(&chunk->refcnt)) {
+			if(unsafe) {
+				shm_free_unsafe(chunk);
+			} else {
+				shm_free(chunk);
+			}
+		}
+		return;
+	}
+	if(unsafe) {
+		shm_free_unsafe(xa);
+	} else {
+		shm_free(xa);
+	}
+}
+
 void xavp_shm_free(void *p)
 {
 	shm_free(p);
@@ -78,7 +224,7 @@ void xavp_free(sr_xavp_t *xa)
 	} else if(xa->val.type == SR_XTYPE_XAVP) {
 		xavp_destroy_list(&xa->val.v.xavp);
 	}
-	shm_free(xa);
+	xavp_node_free(xa, 0);
 }
 
 void xavp_free_unsafe(sr_xavp_t *xa)
@@ -98,7 +244,7 @@ void xavp_free_unsafe(sr_xavp_t *xa)
 	} else if(xa->val.type == SR_XTYPE_XAVP) {
 		xavp_destroy_list_unsafe(&xa->val.v.xavp);
 	}
-	shm_free_unsafe(xa);
+	xavp_node_free(xa, 1);
 }
 
 /**
@@ -120,12 +266,11 @@ static sr_xavp_t *xavp_new_value_mode(str *name, sr_xval_t *val, int mode)
 	size = sizeof(sr_xavp_t) + name->len + 1;
 	if(val->type == SR_XTYPE_STR)
 		size += val->v.s.len + 1;
-	avp = (sr_xavp_t *)shm_malloc(size);
+	avp = xavp_node_alloc(size);
 	if(avp == NULL) {
 		SHM_MEM_ERROR;
 		return NULL;
 	}
-	memset(avp, 0, size);
 	avp->id = id;
 	avp->name.s = (char *)avp + sizeof(sr_xavp_t);
 	memcpy(avp->name.s, name->s, name->len);
@@ -836,7 +981,7 @@ sr_xavp_t *xavp_clone_level_nodata(sr_xavp_t *xold)
  * clone the xavp without values that are custom data
  * - only one list level is cloned, other sublists are ignored
  */
-sr_xavp_t *xavp_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
+static sr_xavp_t *xavp_clone_level_nodata_name(sr_xavp_t *xold, str *dst_name)
 {
 	sr_xavp_t *xnew = NULL;
 	sr_xavp_t *navp = NULL;
@@ -874,7 +1019,7 @@ sr_xavp_t *xavp_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
 				if(xnew->val.v.xavp != NULL) {
 					xavp_destroy_list(&xnew->val.v.xavp);
 				}
-				shm_free(xnew);
+				xavp_node_free(xnew, 0);
 				return NULL;
 			}
 			LM_DBG("cloned inner xavp [%.*s]\n", oavp->name.len, oavp->name.s);
@@ -891,13 +1036,31 @@ sr_xavp_t *xavp_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
 	}
 
 	if(xnew->val.v.xavp == NULL) {
-		shm_free(xnew);
+		xavp_node_free(xnew, 0);
 		return NULL;
 	}
 
 	return xnew;
 }
 
+/**
+ * clone the xavp without values that are custom data, with a new name
+ * - the clones are kept beyond the message, so they are not allocated in
+ *   arena chunks
+ */
+sr_xavp_t *xavp_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
+{
+	sr_xavp_t *xnew;
+	int arena_on;
+
+	arena_on = _xavp_arena_on;
+	_xavp_arena_on = 0;
+	xnew = xavp_clone_level_nodata_name(xold, dst_name);
+	_xavp_arena_on = arena_on;
+
+	return xnew;
+}
+
 int xavp_insert(sr_xavp_t *xavp, int idx, sr_xavp_t **list)
 {
 	sr_xavp_t *crt = 0;
@@ -1738,12 +1901,11 @@ static sr_xavp_t *xavi_new_value(str *name, sr_xval_t *val)
 	size = sizeof(sr_xavp_t) + name->len + 1;
 	if(val->type == SR_XTYPE_STR)
 		size += val->v.s.len + 1;
-	avi = (sr_xavp_t *)shm_malloc(size);
+	avi = xavp_node_alloc(size);
 	if(avi == NULL) {
 		SHM_MEM_ERROR;
 		return NULL;
 	}
-	memset(avi, 0, size);
 	avi->id = id;
 	avi->name.s = (char *)avi + sizeof(sr_xavp_t);
 	memcpy(avi->name.s, name->s, name->len);
@@ -2322,7 +2484,7 @@ sr_xavp_t *xavi_clone_level_nodata(sr_xavp_t *xold)
  * clone the xavi without values that are custom data
  * - only one list level is cloned, other sublists are ignored
  */
-sr_xavp_t *xavi_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
+static sr_xavp_t *xavi_clone_level_nodata_name(sr_xavp_t *xold, str *dst_name)
 {
 	sr_xavp_t *xnew = NULL;
 	sr_xavp_t *navi = NULL;
@@ -2360,7 +2522,7 @@ sr_xavp_t *xavi_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
 				if(xnew->val.v.xavp != NULL) {
 					xavi_destroy_list(&xnew->val.v.xavp);
 				}
-				shm_free(xnew);
+				xavp_node_free(xnew, 0);
 				return NULL;
 			}
 			LM_DBG("cloned inner xavi [%.*s]\n", oavi->name.len, oavi->name.s);
@@ -2377,13 +2539,31 @@ sr_xavp_t *xavi_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
 	}
 
 	if(xnew->val.v.xavp == NULL) {
-		shm_free(xnew);
+		xavp_node_free(xnew, 0);
 		return NULL;
 	}
 
 	return xnew;
 }
 
+/**
+ * clone the xavi without values that are custom data, with a new name
+ * - the clones are kept beyond the message, so they are not allocated in
+ *   arena chunks
+ */
+sr_xavp_t *xavi_clone_level_nodata_with_new_name(sr_xavp_t *xold, str *dst_name)
+{
+	sr_xavp_t *xnew;
+	int arena_on;
+
+	arena_on = _xavp_arena_on;
+	_xavp_arena_on = 0;
+	xnew = xavi_clone_level_nodata_name(xold, dst_name);
+	_xavp_arena_on = arena_on;
+
+	return xnew;
+}
+
 int xavi_insert(sr_xavp_t *xavi, int idx, sr_xavp_t **list)
 {
 	sr_xavp_t *crt = 0;
@@ -64,10 +64,14 @@ typedef struct _sr_xval
 	} v;
 } sr_xval_t;
 
+/* xavp node flags */
+#define XAVP_FLAG_ARENA (1 << 0) /* allocated in arena chunk */
+
 /* structure for extended avp */
 typedef struct _sr_xavp
 {
 	unsigned int id;	   /* internal hash id */
+	unsigned int flags;	   /* internal flags */
 	str name;			   /* name of the xavp */
 	sr_xval_t val;		   /* value of the xavp */
 	struct _sr_xavp *next; /* pointer to next xavp in list */
@@ -75,6 +79,8 @@ typedef struct _sr_xavp
 
 int xavp_init_head(void);
 void xavp_free(sr_xavp_t *xa);
+void xavp_arena_start(void);
+void xavp_arena_release(void);
 
 int xavp_add(sr_xavp_t *xavp, sr_xavp_t **list);
 int xavp_add_last(sr_xavp_t *xavp, sr_xavp_t **list);
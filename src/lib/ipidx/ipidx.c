@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \ingroup ipidx
+ * \brief Longest prefix matching of IPv4 and IPv6 addresses
+ *
+ * The key of a network is '4' or '6' followed by '0' and '1' chars for
+ * the bits of the prefix. The path compression of the prefix index
+ * skips the runs of bits without branches, so a lookup visits only the
+ * nodes where the networks of the index differ.
+ * @{
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include "ipidx.h"
+
+#include "../../core/dprint.h"
+#include "../../core/resolve.h"
+#include "../../core/ut.h"
+#include "../../core/trim.h"
+#include "../../core/pt.h"
+#include "../../core/mem/shm_mem.h"
+
+/* family char and one char per bit */
+#define IPIDX_KEY_SIZE (1 + 128)
+
+
+/**
+ * build the key of the first bitlen bits of an address
+ */
+static int ipidx_key(const ip_addr_t *ip, int bitlen, char *key)
+{
+	int i;
+
+	key[0] = (ip->af == AF_INET) ? '4' : '6';
+	for(i = 0; i < bitlen; i++)
+		key[1 + i] = '0' + ((ip->u.addr[i >> 3] >> (7 - (i & 7))) & 1);
+	return 1 + bitlen;
+}
+
+
+int ipidx_parse_net(str *s, ip_addr_t *net, int *bitlen)
+{
+	str addr;
+	str bits;
+	char *p;
+	unsigned int n;
+
+	addr = *s;
+	trim(&addr);
+	if(addr.len <= 0)
+		return -1;
+	bits.len = 0;
+	p = memchr(addr.s, '/', addr.len);
+	if(p != NULL) {
+		bits.s = p + 1;
+		bits.len = addr.s + addr.len - bits.s;
+		addr.len = p - addr.s;
+		trim(&addr);
+		trim(&bits);
+		if(bits.len <= 0)
+			return -1;
+	}
+	if(addr.len <= 0 || str2ipxbuf(&addr, net) < 0)
+		return -1;
+	if(bits.len == 0) {
+		*bitlen = net->len * 8;
+		return 0;
+	}
+	if(str2int(&bits, &n) < 0 || n > net->len * 8)
+		return -1;
+	*bitlen = (int)n;
+	return 0;
+}
+
+
+ipidx_builder_t *ipidx_builder_new(void)
+{
+	return pfx_builder_new();
+}
+
+
+void **ipidx_builder_slot(ipidx_builder_t *b, ip_addr_t *net, int bitlen)
+{
+	char key[IPIDX_KEY_SIZE];
+
+	if(bitlen < 0 || bitlen > (int)net->len * 8)
+		return NULL;
+	return pfx_builder_slot(b, key, ipidx_key(net, bitlen, key));
+}
+
+
+int ipidx_builder_add(ipidx_builder_t *b, str *s, void *value)
+{
+	ip_addr_t net;
+	void **slot;
+	int bitlen;
+
+	if(ipidx_parse_net(s, &net, &bitlen) < 0) {
+		LM_ERR("invalid network '%.*s'\n", s->len, s->s);
+		return -1;
+	}
+	slot = ipidx_builder_slot(b, &net, bitlen);
+	if(slot == NULL)
+		return -1;
+	*slot = value;
+	return 0;
+}
+
+
+unsigned int ipidx_builder_count(const ipidx_builder_t *b)
+{
+	return pfx_builder_count(b);
+}
+
+
+void ipidx_builder_free(ipidx_builder_t *b, pfx_free_f free_value)
+{
+	pfx_builder_free(b, free_value);
+}
+
+
+ipidx_t *ipidx_build(ipidx_builder_t *b)
+{
+	return pfx_index_build(b);
+}
+
+
+void ipidx_free(ipidx_t *idx, pfx_free_f free_value)
+{
+	pfx_index_free(idx, free_value);
+}
+
+
+void *ipidx_match(const ipidx_t *idx, const ip_addr_t *ip, int *bitlen)
+{
+	char key[IPIDX_KEY_SIZE];
+	void *value;
+	int mlen;
+
+	if(bitlen)
+		*bitlen = -1;
+	if(idx == NULL || (ip->af != AF_INET && ip->af != AF_INET6))
+		return NULL;
+	value = pfx_index_longest(
+			idx, key, ipidx_key(ip, ip->len * 8, key), &mlen);
+	if(value != NULL && bitlen)
+		*bitlen = mlen - 1;
+	return value;
+}
+
+
+void *ipidx_exact(const ipidx_t *idx, ip_addr_t *net, int bitlen)
+{
+	char key[IPIDX_KEY_SIZE];
+
+	if(idx == NULL || bitlen < 0 || bitlen > (int)net->len * 8)
+		return NULL;
+	return pfx_index_exact(idx, key, ipidx_key(net, bitlen, key));
+}
+
+
+typedef struct ipidx_walk_param
+{
+	ipidx_walk_f f;
+	void *param;
+} ipidx_walk_param_t;
+
+
+static int ipidx_walk_prefix(const char *prefix, int len, void *value, void *p)
+{
+	ipidx_walk_param_t *wp;
+	ip_addr_t net;
+	int i;
+
+	wp = (ipidx_walk_param_t *)p;
+	memset(&net, 0, sizeof(ip_addr_t));
+	if(prefix[0] == '4') {
+		net.af = AF_INET;
+		net.len = 4;
+	} else {
+		net.af = AF_INET6;
+		net.len = 16;
+	}
+	for(i = 1; i < len; i++) {
+		if(prefix[i] == '1')
+			net.u.addr[(i - 1) >> 3] |= 0x80 >> ((i - 1) & 7);
+	}
+	return wp->f(&net, len - 1, value, wp->param);
+}
+
+
+int ipidx_walk(const ipidx_t *idx, ipidx_walk_f f, void *param)
+{
+	ipidx_walk_param_t wp;
+
+	wp.f = f;
+	wp.param = param;
+	return pfx_index_walk(idx, ipidx_walk_prefix, &wp);
+}
+
+
+unsigned int ipidx_count(const ipidx_t *idx)
+{
+	pfx_stats_t st;
+
+	pfx_index_stats(idx, &st);
+	return st.prefixes;
+}
+
+
+ipidx_guard_t *ipidx_guard_new(void)
+{
+	ipidx_guard_t *g;
+	int n;
+
+	n = get_max_procs();
+	g = (ipidx_guard_t *)shm_malloc(
+			sizeof(ipidx_guard_t) + n * sizeof(unsigned int));
+	if(g == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(g, 0, sizeof(ipidx_guard_t) + n * sizeof(unsigned int));
+	g->gen = 1;
+	atomic_set(&g->others, 0);
+	g->pins_no = n;
+	g->pins = (volatile unsigned int *)(g + 1);
+	return g;
+}
+
+
+void ipidx_guard_free(ipidx_guard_t *g)
+{
+	if(g != NULL)
+		shm_free(g);
+}
+
+
+void ipidx_guard_pin(ipidx_guard_t *g)
+{
+	if(process_no >= 0 && process_no < g->pins_no)
+		g->pins[process_no] = g->gen;
+	else
+		atomic_inc(&g->others);
+	/* the index pointer is read only after the pin is visible */
+	membar();
+}
+
+
+void ipidx_guard_unpin(ipidx_guard_t *g)
+{
+	membar();
+	if(process_no >= 0 && process_no < g->pins_no)
+		g->pins[process_no] = 0;
+	else
+		atomic_dec(&g->others);
+}
+
+
+void ipidx_guard_sync(ipidx_guard_t *g)
+{
+	unsigned int gen;
+	int i;
+	int n;
+
+	gen = g->gen + 1;
+	if(gen == 0)
+		gen = 1;
+	membar();
+	g->gen = gen;
+	membar();
+
+	for(i = 0; i < g->pins_no; i++) {
+		if(i == process_no)
+			continue;
+		n = 0;
+		while(g->pins[i] != 0 && g->pins[i] != gen) {
+			if(++n % 10000 == 0)
+				LM_WARN("waiting for process %d to release an index\n", i);
+			sleep_us(100);
+		}
+	}
+	while(atomic_get(&g->others) > 0)
+		sleep_us(100);
+}
+
+/** @} */
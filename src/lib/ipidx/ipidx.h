@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \defgroup ipidx Kamailio read-only IP network index
+ * \brief Longest prefix matching of IPv4 and IPv6 addresses
+ *
+ * The networks are kept in a prefix index (\ref pfxidx) with one char per
+ * bit of the network prefix, after a char for the address family, so the
+ * networks of both families are in the same index and a lookup follows
+ * at most one trie node per bit of the address. Like the prefix index,
+ * the networks are first collected in a builder and the index is never
+ * changed after the build.
+ * - Module: \ref ipops
+ * - Module: \ref secfilter
+ * @{
+ */
+
+#ifndef _IPIDX_H_
+#define _IPIDX_H_
+
+#include "../../core/str.h"
+#include "../../core/ip_addr.h"
+#include "../../core/atomic_ops.h"
+#include "../pfxidx/pfxidx.h"
+
+typedef pfx_builder_t ipidx_builder_t;
+typedef pfx_index_t ipidx_t;
+
+/*! Function signature for walking the networks, non zero stops the walk */
+typedef int (*ipidx_walk_f)(
+		ip_addr_t *net, int bitlen, void *value, void *param);
+
+
+/*!
+ * \brief Parses a network, an address with an optional /bitlen
+ *
+ * IPv6 addresses can be enclosed in brackets. Without a bitlen the whole
+ * address is the network.
+ * \return 0 on success, -1 otherwise
+ */
+int ipidx_parse_net(str *s, ip_addr_t *net, int *bitlen);
+
+
+/*!
+ * \brief Allocates an empty builder in shared memory
+ */
+ipidx_builder_t *ipidx_builder_new(void);
+
+
+/*!
+ * \brief Gets the value slot of a network, adding the network if needed
+ *
+ * The bits of the address after bitlen are ignored. The returned address
+ * is valid only until the next network is added.
+ * \return address of the value on success, NULL otherwise
+ */
+void **ipidx_builder_slot(ipidx_builder_t *b, ip_addr_t *net, int bitlen);
+
+
+/*!
+ * \brief Parses a network and sets its value in the builder
+ * \return 0 on success, -1 on parse or memory errors
+ */
+int ipidx_builder_add(ipidx_builder_t *b, str *s, void *value);
+
+
+/*!
+ * \brief Returns the number of networks in the builder
+ */
+unsigned int ipidx_builder_count(const ipidx_builder_t *b);
+
+
+void ipidx_builder_free(ipidx_builder_t *b, pfx_free_f free_value);
+
+
+/*!
+ * \brief Compiles the networks of the builder into an index
+ *
+ * The networks with a NULL value are skipped. The values are moved to
+ * the index, the builder is left empty but still has to be freed.
+ * \return the index on success, NULL otherwise
+ */
+ipidx_t *ipidx_build(ipidx_builder_t *b);
+
+
+void ipidx_free(ipidx_t *idx, pfx_free_f free_value);
+
+
+/*!
+ * \brief Finds the longest network matching an address
+ * \param idx index
+ * \param ip the address
+ * \param bitlen if not NULL, set to the bitlen of the network or -1
+ * \return the value of the network, NULL if no network matches
+ */
+void *ipidx_match(const ipidx_t *idx, const ip_addr_t *ip, int *bitlen);
+
+
+/*!
+ * \brief Finds the value of an exact network
+ * \return the value, NULL if the network is not in the index
+ */
+void *ipidx_exact(const ipidx_t *idx, ip_addr_t *net, int bitlen);
+
+
+/*!
+ * \brief Walks the networks of the index, IPv4 first, in sorted order
+ * \return 0 if all the networks were walked, the non zero value returned
+ * by f otherwise
+ */
+int ipidx_walk(const ipidx_t *idx, ipidx_walk_f f, void *param);
+
+
+/*!
+ * \brief Returns the number of networks in the index
+ */
+unsigned int ipidx_count(const ipidx_t *idx);
+
+
+/*!
+ * \brief Guard of the indexes replaced while the processes read them
+ *
+ * The readers do not lock, each process pins the current generation in its
+ * slot while it uses an index. A writer replacing an index starts a new
+ * generation and waits only for the processes still pinning an older one,
+ * then the replaced index can be freed.
+ */
+typedef struct ipidx_guard
+{
+	volatile unsigned int gen; /*!< current generation, never 0 */
+	atomic_t others;		   /*!< readers without slot of their process */
+	int pins_no;
+	volatile unsigned int *pins; /*!< generation pinned by each process */
+} ipidx_guard_t;
+
+
+/*!
+ * \brief Allocates a guard in shared memory, with a slot per process
+ * \return the guard on success, NULL otherwise
+ */
+ipidx_guard_t *ipidx_guard_new(void);
+
+
+void ipidx_guard_free(ipidx_guard_t *g);
+
+
+/*!
+ * \brief Pins the current generation, the indexes read after are not freed
+ * until ipidx_guard_unpin()
+ */
+void ipidx_guard_pin(ipidx_guard_t *g);
+
+
+void ipidx_guard_unpin(ipidx_guard_t *g);
+
+
+/*!
+ * \brief Starts a new generation and waits for the readers of the older ones
+ *
+ * To be called after the new index replaced the old one for the readers
+ * and before the old one is freed. The writers have to be serialized.
+ */
+void ipidx_guard_sync(ipidx_guard_t *g);
+
+/** @} */
+#endif
@@ -0,0 +1,748 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \ingroup pfxidx
+ * \brief Compact prefix index for longest prefix matching
+ *
+ * The builder keeps the prefixes in an array, with an open addressing
+ * hash table over it for finding the slot of a prefix. The build sorts
+ * the prefixes and creates the trie from the sorted array: the prefixes
+ * below a node are a contiguous range of it, the children of the node
+ * are the sub-ranges with the same next char and the label of a child is
+ * the common prefix of the first and the last key of its sub-range. A
+ * first pass only counts the nodes and the label chars, so that the index
+ * is allocated in one block.
+ *
+ * The nodes are laid out breadth first, so the top levels of the trie,
+ * visited by every lookup, share a few cache lines. A node is half a
+ * cache line and holds the first chars of the labels of its children and
+ * its own label when it is short, so a lookup step usually touches only
+ * the node of the next level.
+ * @{
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "pfxidx.h"
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+
+#define PFX_BUILDER_INIT 256
+
+typedef struct pfx_entry
+{
+	uint32_t koff;		/* offset of the prefix in the keys pool */
+	uint16_t len;		/* length of the prefix */
+	void *value;
+} pfx_entry_t;
+
+struct pfx_builder
+{
+	pfx_entry_t *entries;
+	unsigned int nentries;
+	unsigned int size;	 /* allocated entries */
+	char *keys;			 /* pool of the prefixes */
+	unsigned long klen;	 /* used bytes of the pool */
+	unsigned long ksize; /* allocated bytes of the pool */
+	uint32_t *hash;		 /* entry index plus 1, 0 if free */
+	unsigned int hsize;	 /* power of 2 */
+};
+
+/* labels up to this length are stored in the node */
+#define PFX_LABEL_INLINE 4
+/* first chars of up to this many children are stored in the node */
+#define PFX_FIRST_INLINE 16
+
+typedef struct pfx_node
+{
+	uint32_t child; /* index of the first child */
+	uint32_t value; /* index of the value plus 1, 0 if none */
+	uint16_t nchild;
+	uint8_t llen; /* length of the label */
+	uint8_t pad;
+	union
+	{
+		char s[PFX_LABEL_INLINE];
+		uint32_t off; /* offset in the labels pool if llen is longer */
+	} label;
+	union
+	{
+		unsigned char c[PFX_FIRST_INLINE];
+		uint32_t off; /* offset in the labels pool if nchild is bigger */
+	} first; /* first chars of the labels of the children */
+} pfx_node_t;
+
+/* range of the sorted prefixes below a node, while building */
+typedef struct pfx_range
+{
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t depth;
+} pfx_range_t;
+
+struct pfx_index
+{
+	pfx_node_t *nodes;
+	char *labels; /* long labels and first chars of the big nodes */
+	void **values;
+	unsigned int nnodes;
+	unsigned int nvalues;
+	unsigned int maxlen;
+	unsigned long size;
+};
+
+/* state of the build passes */
+typedef struct pfx_build
+{
+	pfx_builder_t *b;
+	uint32_t *order; /* entries sorted by prefix */
+	pfx_range_t *ranges; /* ranges of the nodes, NULL in the first pass */
+	pfx_index_t *idx;
+	unsigned int nnodes;
+	unsigned long nlabels;
+	unsigned int nvalues;
+	unsigned int maxlen;
+} pfx_build_t;
+
+/* extra bytes after the labels pool, for the 16 chars compares */
+#define PFX_LABELS_PAD 16
+
+#define PFX_ALIGN(x) (((x) + 15UL) & ~15UL)
+
+#define pfx_key(b, e) ((b)->keys + (e)->koff)
+
+#define pfx_label(idx, node)                  \
+	(((node)->llen <= PFX_LABEL_INLINE)       \
+					? (node)->label.s         \
+					: (idx)->labels + (node)->label.off)
+
+#define pfx_first(idx, node)                                    \
+	(((node)->nchild <= PFX_FIRST_INLINE)                       \
+					? (node)->first.c                           \
+					: (const unsigned char *)(idx)->labels      \
+							  + (node)->first.off)
+
+
+static unsigned int pfx_hash(const char *s, int len)
+{
+	unsigned int h;
+	int i;
+
+	/* FNV-1a */
+	h = 2166136261U;
+	for(i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+
+pfx_builder_t *pfx_builder_new(void)
+{
+	pfx_builder_t *b;
+
+	b = (pfx_builder_t *)shm_malloc(sizeof(pfx_builder_t));
+	if(b == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(b, 0, sizeof(pfx_builder_t));
+	b->size = PFX_BUILDER_INIT;
+	b->hsize = 2 * PFX_BUILDER_INIT;
+	b->ksize = 8 * PFX_BUILDER_INIT;
+	b->entries = (pfx_entry_t *)shm_malloc(b->size * sizeof(pfx_entry_t));
+	b->hash = (uint32_t *)shm_malloc(b->hsize * sizeof(uint32_t));
+	b->keys = (char *)shm_malloc(b->ksize);
+	if(b->entries == NULL || b->hash == NULL || b->keys == NULL) {
+		SHM_MEM_ERROR;
+		pfx_builder_free(b, NULL);
+		return NULL;
+	}
+	memset(b->hash, 0, b->hsize * sizeof(uint32_t));
+	return b;
+}
+
+
+static int pfx_builder_rehash(pfx_builder_t *b)
+{
+	uint32_t *hash;
+	unsigned int hsize;
+	unsigned int i;
+	unsigned int h;
+	pfx_entry_t *e;
+
+	hsize = 2 * b->hsize;
+	hash = (uint32_t *)shm_malloc(hsize * sizeof(uint32_t));
+	if(hash == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(hash, 0, hsize * sizeof(uint32_t));
+	for(i = 0; i < b->nentries; i++) {
+		e = &b->entries[i];
+		h = pfx_hash(pfx_key(b, e), e->len) & (hsize - 1);
+		while(hash[h] != 0)
+			h = (h + 1) & (hsize - 1);
+		hash[h] = i + 1;
+	}
+	shm_free(b->hash);
+	b->hash = hash;
+	b->hsize = hsize;
+	return 0;
+}
+
+
+void **pfx_builder_slot(pfx_builder_t *b, const char *prefix, int len)
+{
+	pfx_entry_t *e;
+	unsigned int h;
+	void *p;
+
+	if(b == NULL || len < 0 || len > PFX_KEY_MAX) {
+		LM_ERR("invalid prefix (length %d)\n", len);
+		return NULL;
+	}
+
+	h = pfx_hash(prefix, len) & (b->hsize - 1);
+	while(b->hash[h] != 0) {
+		e = &b->entries[b->hash[h] - 1];
+		if(e->len == len && memcmp(pfx_key(b, e), prefix, len) == 0)
+			return &e->value;
+		h = (h + 1) & (b->hsize - 1);
+	}
+
+	if(b->klen + len > UINT32_MAX) {
+		LM_ERR("too many prefixes\n");
+		return NULL;
+	}
+	if(2 * (b->nentries + 1) > b->hsize) {
+		if(pfx_builder_rehash(b) < 0)
+			return NULL;
+		h = pfx_hash(prefix, len) & (b->hsize - 1);
+		while(b->hash[h] != 0)
+			h = (h + 1) & (b->hsize - 1);
+	}
+	if(b->nentries == b->size) {
+		p = shm_realloc(b->entries, 2 * b->size * sizeof(pfx_entry_t));
+		if(p == NULL) {
+			SHM_MEM_ERROR;
+			return NULL;
+		}
+		b->entries = (pfx_entry_t *)p;
+		b->size *= 2;
+	}
+	if(b->klen + len > b->ksize) {
+		p = shm_realloc(b->keys, 2 * b->ksize + len);
+		if(p == NULL) {
+			SHM_MEM_ERROR;
+			return NULL;
+		}
+		b->keys = (char *)p;
+		b->ksize = 2 * b->ksize + len;
+	}
+
+	e = &b->entries[b->nentries];
+	e->koff = (uint32_t)b->klen;
+	e->len = (uint16_t)len;
+	e->value = NULL;
+	memcpy(b->keys + b->klen, prefix, len);
+	b->klen += len;
+	b->hash[h] = ++b->nentries;
+
+	return &e->value;
+}
+
+
+unsigned int pfx_builder_count(const pfx_builder_t *b)
+{
+	return (b != NULL) ? b->nentries : 0;
+}
+
+
+int pfx_builder_walk(pfx_builder_t *b, pfx_walk_f f, void *param)
+{
+	unsigned int i;
+	int ret;
+
+	if(b == NULL)
+		return 0;
+	for(i = 0; i < b->nentries; i++) {
+		ret = f(pfx_key(b, &b->entries[i]), b->entries[i].len,
+				b->entries[i].value, param);
+		if(ret != 0)
+			return ret;
+	}
+	return 0;
+}
+
+
+void pfx_builder_free(pfx_builder_t *b, pfx_free_f free_value)
+{
+	unsigned int i;
+
+	if(b == NULL)
+		return;
+	if(free_value != NULL) {
+		for(i = 0; i < b->nentries; i++) {
+			if(b->entries[i].value != NULL)
+				free_value(b->entries[i].value);
+		}
+	}
+	if(b->entries)
+		shm_free(b->entries);
+	if(b->hash)
+		shm_free(b->hash);
+	if(b->keys)
+		shm_free(b->keys);
+	shm_free(b);
+}
+
+
+/* qsort() has no context argument */
+static pfx_builder_t *pfx_sort_builder = NULL;
+
+static int pfx_entry_cmp(const void *a, const void *b)
+{
+	const pfx_entry_t *ea = &pfx_sort_builder->entries[*(const uint32_t *)a];
+	const pfx_entry_t *eb = &pfx_sort_builder->entries[*(const uint32_t *)b];
+	int ret;
+
+	ret = memcmp(pfx_key(pfx_sort_builder, ea), pfx_key(pfx_sort_builder, eb),
+			(ea->len < eb->len) ? ea->len : eb->len);
+	if(ret != 0)
+		return ret;
+	return (int)ea->len - (int)eb->len;
+}
+
+
+/**
+ * create the node n for the sorted prefixes [lo, hi) sharing the first
+ * depth chars and allocate its children. The first pass only counts the
+ * nodes and the pool chars, going depth first, the second one records the
+ * ranges of the children, created later in breadth first order.
+ */
+static void pfx_build_node(
+		pfx_build_t *pb, unsigned int lo, unsigned int hi, int depth, int n)
+{
+	pfx_builder_t *b = pb->b;
+	pfx_entry_t *e;
+	pfx_entry_t *el;
+	pfx_node_t *node;
+	pfx_node_t *cn;
+	unsigned char *first;
+	unsigned int glo;
+	unsigned int ghi;
+	unsigned int child;
+	unsigned int nchild;
+	unsigned char c;
+	int lcp;
+	int maxlcp;
+
+	node = (pb->idx != NULL) ? &pb->idx->nodes[n] : NULL;
+
+	e = &b->entries[pb->order[lo]];
+	if(lo < hi && e->len == depth) {
+		if(node != NULL) {
+			pb->idx->values[pb->nvalues] = e->value;
+			node->value = pb->nvalues + 1;
+		}
+		pb->nvalues++;
+		if(depth > pb->maxlen)
+			pb->maxlen = depth;
+		lo++;
+	}
+
+	/* count the children - the prefixes are longer than depth now */
+	nchild = 0;
+	for(glo = lo; glo < hi; glo = ghi) {
+		c = pfx_key(b, &b->entries[pb->order[glo]])[depth];
+		for(ghi = glo + 1; ghi < hi
+				&& (unsigned char)pfx_key(b, &b->entries[pb->order[ghi]])[depth]
+						   == c;
+				ghi++)
+			;
+		nchild++;
+	}
+	if(nchild == 0)
+		return;
+
+	child = pb->nnodes;
+	pb->nnodes += nchild;
+	first = NULL;
+	if(node != NULL) {
+		node->child = child;
+		node->nchild = (uint16_t)nchild;
+		if(nchild <= PFX_FIRST_INLINE) {
+			first = node->first.c;
+		} else {
+			node->first.off = (uint32_t)pb->nlabels;
+			first = (unsigned char *)pb->idx->labels + pb->nlabels;
+		}
+	}
+	if(nchild > PFX_FIRST_INLINE)
+		pb->nlabels += nchild;
+
+	for(glo = lo; glo < hi; glo = ghi, child++) {
+		e = &b->entries[pb->order[glo]];
+		c = pfx_key(b, e)[depth];
+		for(ghi = glo + 1; ghi < hi
+				&& (unsigned char)pfx_key(b, &b->entries[pb->order[ghi]])[depth]
+						   == c;
+				ghi++)
+			;
+		/* common prefix of the range is the one of its first and last key */
+		el = &b->entries[pb->order[ghi - 1]];
+		maxlcp = (e->len < depth + 255) ? e->len : depth + 255;
+		for(lcp = depth + 1;
+				lcp < maxlcp && pfx_key(b, e)[lcp] == pfx_key(b, el)[lcp];
+				lcp++)
+			;
+		if(node != NULL) {
+			first[child - node->child] = c;
+			cn = &pb->idx->nodes[child];
+			cn->llen = (uint8_t)(lcp - depth);
+			if(cn->llen <= PFX_LABEL_INLINE) {
+				memcpy(cn->label.s, pfx_key(b, e) + depth, cn->llen);
+			} else {
+				cn->label.off = (uint32_t)pb->nlabels;
+				memcpy(pb->idx->labels + pb->nlabels, pfx_key(b, e) + depth,
+						cn->llen);
+			}
+		}
+		if(lcp - depth > PFX_LABEL_INLINE)
+			pb->nlabels += lcp - depth;
+		if(pb->ranges == NULL) {
+			pfx_build_node(pb, glo, ghi, lcp, child);
+		} else {
+			pb->ranges[child].lo = glo;
+			pb->ranges[child].hi = ghi;
+			pb->ranges[child].depth = lcp;
+		}
+	}
+}
+
+
+pfx_index_t *pfx_index_build(pfx_builder_t *b)
+{
+	pfx_build_t pb;
+	pfx_index_t *idx;
+	unsigned int i;
+	unsigned int n;
+	unsigned long size;
+	unsigned long off_nodes;
+	unsigned long off_values;
+	unsigned long off_labels;
+	char *p;
+
+	if(b == NULL)
+		return NULL;
+
+	memset(&pb, 0, sizeof(pfx_build_t));
+	pb.b = b;
+	pb.order = (uint32_t *)shm_malloc((b->nentries + 1) * sizeof(uint32_t));
+	if(pb.order == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	for(i = 0, n = 0; i < b->nentries; i++) {
+		if(b->entries[i].value != NULL)
+			pb.order[n++] = i;
+	}
+	pfx_sort_builder = b;
+	qsort(pb.order, n, sizeof(uint32_t), pfx_entry_cmp);
+	pfx_sort_builder = NULL;
+
+	/* first pass - count the nodes and the label chars */
+	pb.nnodes = 1;
+	if(n > 0)
+		pfx_build_node(&pb, 0, n, 0, 0);
+
+	off_nodes = PFX_ALIGN(sizeof(pfx_index_t));
+	off_values = off_nodes + PFX_ALIGN(pb.nnodes * sizeof(pfx_node_t));
+	off_labels = off_values + PFX_ALIGN(pb.nvalues * sizeof(void *));
+	size = off_labels + pb.nlabels + PFX_LABELS_PAD;
+
+	pb.ranges = (pfx_range_t *)shm_malloc(pb.nnodes * sizeof(pfx_range_t));
+	p = (char *)shm_malloc(size);
+	if(pb.ranges == NULL || p == NULL) {
+		SHM_MEM_ERROR;
+		if(pb.ranges)
+			shm_free(pb.ranges);
+		if(p)
+			shm_free(p);
+		shm_free(pb.order);
+		return NULL;
+	}
+	memset(p, 0, size);
+	idx = (pfx_index_t *)p;
+	idx->nodes = (pfx_node_t *)(p + off_nodes);
+	idx->values = (void **)(p + off_values);
+	idx->labels = p + off_labels;
+	idx->nnodes = pb.nnodes;
+	idx->nvalues = pb.nvalues;
+	idx->maxlen = pb.maxlen;
+	idx->size = size;
+
+	/* second pass - fill in the nodes, breadth first */
+	pb.idx = idx;
+	pb.nnodes = 1;
+	pb.nlabels = 0;
+	pb.nvalues = 0;
+	pb.ranges[0].lo = 0;
+	pb.ranges[0].hi = n;
+	pb.ranges[0].depth = 0;
+	for(i = 0; n > 0 && i < pb.nnodes; i++)
+		pfx_build_node(&pb, pb.ranges[i].lo, pb.ranges[i].hi,
+				pb.ranges[i].depth, i);
+	shm_free(pb.ranges);
+	shm_free(pb.order);
+
+	/* the values belong to the index now */
+	b->nentries = 0;
+	b->klen = 0;
+	memset(b->hash, 0, b->hsize * sizeof(uint32_t));
+
+	LM_DBG("index of %u prefixes built - %u nodes, %lu bytes\n", idx->nvalues,
+			idx->nnodes, idx->size);
+	return idx;
+}
+
+
+void pfx_index_free(pfx_index_t *idx, pfx_free_f free_value)
+{
+	unsigned int i;
+
+	if(idx == NULL)
+		return;
+	if(free_value != NULL) {
+		for(i = 0; i < idx->nvalues; i++)
+			free_value(idx->values[i]);
+	}
+	shm_free(idx);
+}
+
+
+/**
+ * index of the child of node starting with c, 0 if there is none
+ */
+static inline unsigned int pfx_child(
+		const pfx_index_t *idx, const pfx_node_t *node, unsigned char c)
+{
+	const unsigned char *f;
+	unsigned int i;
+#if defined(__SSE2__)
+	__m128i v;
+	unsigned int m;
+#endif
+
+	f = pfx_first(idx, node);
+#if defined(__SSE2__)
+	/* the node and the labels pool are big enough for 16 chars reads */
+	v = _mm_set1_epi8((char)c);
+	for(i = 0; i < node->nchild; i += 16) {
+		m = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128((const __m128i *)(f + i)), v));
+		if(node->nchild - i < 16)
+			m &= (1U << (node->nchild - i)) - 1;
+		if(m != 0)
+			return node->child + i + __builtin_ctz(m);
+	}
+#else
+	for(i = 0; i < node->nchild; i++) {
+		if(f[i] == c)
+			return node->child + i;
+	}
+#endif
+	return 0;
+}
+
+
+/**
+ * follow the key down from the node at depth *d, 0 if it leaves the trie
+ */
+static inline unsigned int pfx_next(const pfx_index_t *idx,
+		const pfx_node_t *node, const char *key, int len, int *d)
+{
+	const pfx_node_t *cn;
+	unsigned int c;
+
+	if(*d >= len || node->nchild == 0)
+		return 0;
+	c = pfx_child(idx, node, (unsigned char)key[*d]);
+	if(c == 0)
+		return 0;
+	cn = &idx->nodes[c];
+	if(cn->llen > 1) {
+		/* the first char is already matched */
+		if(cn->llen > len - *d
+				|| memcmp(pfx_label(idx, cn) + 1, key + *d + 1, cn->llen - 1)
+						   != 0)
+			return 0;
+	}
+	*d += cn->llen;
+	return c;
+}
+
+
+void *pfx_index_longest(
+		const pfx_index_t *idx, const char *key, int len, int *mlen)
+{
+	const pfx_node_t *node;
+	unsigned int value;
+	unsigned int n;
+	int d;
+	int vd;
+
+	if(mlen)
+		*mlen = -1;
+	if(idx == NULL || key == NULL)
+		return NULL;
+
+	/* only the value of the longest match is read */
+	value = 0;
+	vd = -1;
+	n = 0;
+	d = 0;
+	do {
+		node = &idx->nodes[n];
+		if(node->value) {
+			value = node->value;
+			vd = d;
+		}
+	} while((n = pfx_next(idx, node, key, len, &d)) != 0);
+
+	if(value == 0)
+		return NULL;
+	if(mlen)
+		*mlen = vd;
+	return idx->values[value - 1];
+}
+
+
+void *pfx_index_exact(const pfx_index_t *idx, const char *key, int len)
+{
+	const pfx_node_t *node;
+	unsigned int n;
+	int d;
+
+	if(idx == NULL || key == NULL)
+		return NULL;
+
+	n = 0;
+	d = 0;
+	do {
+		node = &idx->nodes[n];
+		if(d == len)
+			return node->value ? idx->values[node->value - 1] : NULL;
+	} while((n = pfx_next(idx, node, key, len, &d)) != 0);
+
+	return NULL;
+}
+
+
+int pfx_index_matches(const pfx_index_t *idx, const char *key, int len,
+		pfx_match_t *m, int n)
+{
+	const pfx_node_t *node;
+	unsigned int k;
+	int cnt;
+	int d;
+
+	if(idx == NULL || key == NULL || n <= 0)
+		return 0;
+
+	cnt = 0;
+	k = 0;
+	d = 0;
+	do {
+		node = &idx->nodes[k];
+		if(node->value) {
+			if(cnt == n) {
+				/* keep the longest ones */
+				memmove(m, m + 1, (n - 1) * sizeof(pfx_match_t));
+				cnt--;
+			}
+			m[cnt].value = idx->values[node->value - 1];
+			m[cnt].len = d;
+			cnt++;
+		}
+	} while((k = pfx_next(idx, node, key, len, &d)) != 0);
+
+	return cnt;
+}
+
+
+static int pfx_walk_node(const pfx_index_t *idx, unsigned int n, char *buf,
+		int depth, pfx_walk_f f, void *param)
+{
+	const pfx_node_t *node;
+	unsigned int i;
+	int ret;
+
+	node = &idx->nodes[n];
+	if(node->value) {
+		ret = f(buf, depth, idx->values[node->value - 1], param);
+		if(ret != 0)
+			return ret;
+	}
+	for(i = node->child; i < node->child + node->nchild; i++) {
+		memcpy(buf + depth, pfx_label(idx, &idx->nodes[i]),
+				idx->nodes[i].llen);
+		ret = pfx_walk_node(
+				idx, i, buf, depth + idx->nodes[i].llen, f, param);
+		if(ret != 0)
+			return ret;
+	}
+	return 0;
+}
+
+
+int pfx_index_walk(const pfx_index_t *idx, pfx_walk_f f, void *param)
+{
+	char buf[PFX_KEY_MAX + 1];
+
+	if(idx == NULL)
+		return 0;
+	return pfx_walk_node(idx, 0, buf, 0, f, param);
+}
+
+
+void pfx_index_stats(const pfx_index_t *idx, pfx_stats_t *st)
+{
+	memset(st, 0, sizeof(pfx_stats_t));
+	if(idx == NULL)
+		return;
+	st->nodes = idx->nnodes;
+	st->prefixes = idx->nvalues;
+	st->maxlen = idx->maxlen;
+	st->size = idx->size;
+}
+
+/** @} */
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * \defgroup pfxidx Kamailio read-only prefix index
+ * \brief Compact prefix index for longest prefix matching
+ *
+ * The prefixes are first collected in a builder, where the value of a
+ * prefix can be looked up and updated while loading the routing data.
+ * The builder is then compiled into a read-only index: a path compressed
+ * trie in a single shared memory block, with the nodes in an array, the
+ * children of a node stored next to each other and the first chars of
+ * their labels in the parent node, so a child is found with one SSE2
+ * compare of up to 16 chars. The index is never changed after the build,
+ * a reload builds a new one.
+ * - Module: \ref carrierroute
+ * - Module: \ref drouting
+ * - Module: \ref prefix_route
+ * @{
+ */
+
+#ifndef _PFXIDX_H_
+#define _PFXIDX_H_
+
+/*! Longest prefix that can be added */
+#define PFX_KEY_MAX 255
+
+typedef struct pfx_builder pfx_builder_t;
+typedef struct pfx_index pfx_index_t;
+
+/*! A prefix of a key found in the index */
+typedef struct pfx_match
+{
+	void *value; /*!< value of the prefix */
+	int len;	 /*!< length of the prefix */
+} pfx_match_t;
+
+/*! Size of an index */
+typedef struct pfx_stats
+{
+	unsigned int nodes;	   /*!< number of trie nodes */
+	unsigned int prefixes; /*!< number of prefixes with a value */
+	unsigned int maxlen;   /*!< length of the longest prefix */
+	unsigned long size;	   /*!< bytes of shared memory used */
+} pfx_stats_t;
+
+/*! Function signature for freeing the values */
+typedef void (*pfx_free_f)(void *value);
+
+/*! Function signature for walking the prefixes, non zero stops the walk */
+typedef int (*pfx_walk_f)(
+		const char *prefix, int len, void *value, void *param);
+
+
+/*!
+ * \brief Allocates an empty builder in shared memory
+ * \return the builder on success, NULL otherwise
+ */
+pfx_builder_t *pfx_builder_new(void);
+
+
+/*!
+ * \brief Gets the value slot of a prefix, adding the prefix if needed
+ *
+ * The value of a new prefix is NULL. The returned address is valid only
+ * until the next prefix is added to the builder.
+ * \param b builder
+ * \param prefix the prefix
+ * \param len length of the prefix, up to PFX_KEY_MAX
+ * \return address of the value on success, NULL otherwise
+ */
+void **pfx_builder_slot(pfx_builder_t *b, const char *prefix, int len);
+
+
+/*!
+ * \brief Returns the number of prefixes in the builder
+ */
+unsigned int pfx_builder_count(const pfx_builder_t *b);
+
+
+/*!
+ * \brief Walks the prefixes of the builder, in no particular order
+ * \return 0 if all the prefixes were walked, the non zero value returned
+ * by f otherwise
+ */
+int pfx_builder_walk(pfx_builder_t *b, pfx_walk_f f, void *param);
+
+
+/*!
+ * \brief Frees the builder
+ * \param b builder
+ * \param free_value function for freeing the values, if not NULL
+ */
+void pfx_builder_free(pfx_builder_t *b, pfx_free_f free_value);
+
+
+/*!
+ * \brief Compiles the prefixes of the builder into an index
+ *
+ * The prefixes with a NULL value are skipped. The values are moved to
+ * the index, the builder is left empty but still has to be freed.
+ * \param b builder
+ * \return the index on success, NULL otherwise
+ */
+pfx_index_t *pfx_index_build(pfx_builder_t *b);
+
+
+/*!
+ * \brief Frees the index
+ * \param idx index
+ * \param free_value function for freeing the values, if not NULL
+ */
+void pfx_index_free(pfx_index_t *idx, pfx_free_f free_value);
+
+
+/*!
+ * \brief Finds the longest prefix of a key
+ * \param idx index
+ * \param key the key
+ * \param len length of the key
+ * \param mlen if not NULL, set to the length of the prefix or -1
+ * \return the value of the longest prefix, NULL if no prefix matches
+ */
+void *pfx_index_longest(
+		const pfx_index_t *idx, const char *key, int len, int *mlen);
+
+
+/*!
+ * \brief Finds the value of an exact prefix
+ * \return the value, NULL if the prefix is not in the index
+ */
+void *pfx_index_exact(const pfx_index_t *idx, const char *key, int len);
+
+
+/*!
+ * \brief Finds all the prefixes of a key
+ *
+ * If the key has more than n prefixes, the n longest are kept.
+ * \param idx index
+ * \param key the key
+ * \param len length of the key
+ * \param m array for the matches, shortest prefix first
+ * \param n size of the array
+ * \return number of matches stored in m
+ */
+int pfx_index_matches(const pfx_index_t *idx, const char *key, int len,
+		pfx_match_t *m, int n);
+
+
+/*!
+ * \brief Walks the prefixes of the index in sorted order
+ * \return 0 if all the prefixes were walked, the non zero value returned
+ * by f otherwise
+ */
+int pfx_index_walk(const pfx_index_t *idx, pfx_walk_f f, void *param);
+
+
+/*!
+ * \brief Gets the size of the index
+ */
+void pfx_index_stats(const pfx_index_t *idx, pfx_stats_t *st);
+
+/** @} */
+#endif
@@ -40,9 +40,12 @@
 #include "db_query.h"
 #include "../../core/globals.h"
 #include "../../core/timer.h"
+#include "../../core/counters.h"
 
 static str sql_str;
 static char *sql_buf = NULL;
+/* time to submit a query (microseconds) */
+static counter_hist_handle_t db_hist_query = {0};
 
 static inline int db_do_submit_query(const db1_con_t *_h, const str *_query,
 		int (*submit_query)(const db1_con_t *, const str *))
@@ -51,20 +54,22 @@ static inline int db_do_submit_query(const db1_con_t *_h, const str *_query,
 	struct timeval tvb = {0}, tve = {0};
 	struct timezone tz;
 	unsigned int tdiff;
+	int tlog;
 
-	if(unlikely(cfg_get(core, core_cfg, latency_limit_db) > 0)
-			&& is_printable(cfg_get(core, core_cfg, latency_log))) {
+	tlog = (unlikely(cfg_get(core, core_cfg, latency_limit_db) > 0)
+			&& is_printable(cfg_get(core, core_cfg, latency_log)));
+	if(tlog || db_hist_query.id != 0) {
 		gettimeofday(&tvb, &tz);
 	}
 
 	ret = submit_query(_h, _query);
 
-	if(unlikely(cfg_get(core, core_cfg, latency_limit_db) > 0)
-			&& is_printable(cfg_get(core, core_cfg, latency_log))) {
+	if(tlog || db_hist_query.id != 0) {
 		gettimeofday(&tve, &tz);
 		tdiff = (tve.tv_sec - tvb.tv_sec) * 1000000
 				+ (tve.tv_usec - tvb.tv_usec);
-		if(tdiff >= cfg_get(core, core_cfg, latency_limit_db)) {
+		counter_hist_observe(db_hist_query, tdiff);
+		if(tlog && tdiff >= cfg_get(core, core_cfg, latency_limit_db)) {
 			LOG(cfg_get(core, core_cfg, latency_log),
 					"alert - query execution too long [%u us] for [%.*s]\n",
 					tdiff, _query->len < 100 ? _query->len : 100, _query->s);
@@ -457,6 +462,14 @@ error:
 
 int db_query_init(void)
 {
+	if(db_hist_query.id == 0
+			&& counter_hist_register(&db_hist_query, "srdb1", "query_time_us",
+					   "time to submit a query to the database server"
+					   " (microseconds)",
+					   1)
+					   < 0) {
+		LM_DBG("query time histogram not registered\n");
+	}
 	if(sql_buf != NULL) {
 		LM_DBG("sql_buf not NULL on init\n");
 		return 0;
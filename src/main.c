@@ -75,6 +75,8 @@
 
 #include "core/config.h"
 #include "core/dprint.h"
+#include "core/dprint_async.h"
+#include "core/rprof.h"
 #include "core/daemonize.h"
 #include "core/route.h"
 #include "core/udp_server.h"
@@ -436,7 +438,12 @@ int open_files_limit = -1; /* don't touch it by default */
 /* memory options */
 int shm_force_alloc = 0; /* force immediate (on startup) page allocation
 						  (by writing 0 in the pages), useful if
-						  mlock_pages is also 1 */
+						  mlock_pages is also 1; if >1, number of
+						  processes writing the pages in parallel */
+int shm_huge_pages = 0;		/* huge pages for shm pool - 0 off, 1 transparent
+							  huge pages advice, 2 explicit huge pages */
+int shm_huge_page_size = 0; /* size of explicit huge pages in KB, 0 - system
+							  default */
 int mlock_pages = 0;	 /* default off, try to disable swapping */
 
 /* real time options */
@@ -594,6 +601,9 @@ void cleanup(int show_status)
 {
 	int memlog;
 
+	/* write the log messages directly from now on */
+	ksr_log_async_destroy();
+	ksr_rprof_destroy();
 	/*clean-up*/
 #ifndef SHM_SAFE_MALLOC
 	if(shm_initialized()) {
@@ -1507,6 +1517,10 @@ int main_loop(void)
 		cfg_main_reset_local();
 		if(counters_prefork_init(get_max_procs()) == -1)
 			goto error;
+		if(ksr_rprof_init(get_max_procs()) < 0)
+			goto error;
+		if(ksr_log_async_start() < 0)
+			goto error;
 
 #ifdef USE_SLOW_TIMER
 		/* we need another process to act as the "slow" timer*/
@@ -1809,6 +1823,10 @@ int main_loop(void)
 
 		if(counters_prefork_init(get_max_procs()) == -1)
 			goto error;
+		if(ksr_rprof_init(get_max_procs()) < 0)
+			goto error;
+		if(ksr_log_async_start() < 0)
+			goto error;
 
 
 		woneinit = 0;
@@ -2186,6 +2204,7 @@ static int calc_proc_no(void)
 #ifdef USE_SLOW_TIMER
 			+ 1 /* slow timer process */
 #endif
+			+ ((ksr_log_async_size > 0) ? 1 : 0) /* async log writer */
 #ifdef USE_TCP
 			+ ((!tcp_disable) ? (1 /* tcp main */ + tcp_listeners) : 0)
 #endif
@@ -2277,7 +2296,11 @@ int main(int argc, char **argv)
 	debug_flag = 0;
 	dont_fork_cnt = 0;
 
-	ksr_hname_init_index();
+	/* before parsing the config, where header names can be registered */
+	if(ksr_hname_init_index() < 0) {
+		fprintf(stderr, "error: failed to init the header names index\n");
+		exit(-1);
+	}
 	sr_cfgenv_init();
 	daemon_status_init();
 
@@ -3434,6 +3457,10 @@ int main(int argc, char **argv)
 		fprintf(stderr, "error %d while trying to fix configuration\n", r);
 		goto error;
 	};
+	if(ksr_cfg_compile && cfg_compile_rls() < 0) {
+		fprintf(stderr, "error while trying to compile configuration\n");
+		goto error;
+	}
 	fixup_complete = 1;
 
 	ret = main_loop();
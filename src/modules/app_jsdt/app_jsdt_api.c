@@ -33,6 +33,7 @@
 #include "../../core/mem/shm.h"
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
+#include "../../core/rprof.h"
 
 #include "duktape.h"
 #include "duk_module_node.h"
@@ -883,6 +884,7 @@ int sr_kemi_jsdt_exec_func_ex(duk_context *J, sr_kemi_t *ket)
 	sr_kemi_xval_t *xret;
 	str *fname;
 	str *mname;
+	int rpf;
 	sr_kemi_xval_t vps[SR_KEMI_PARAMS_MAX];
 	sr_jsdt_env_t *env_J;
 
@@ -898,11 +900,14 @@ int sr_kemi_jsdt_exec_func_ex(duk_context *J, sr_kemi_t *ket)
 
 	argc = duk_get_top(J);
 	if(argc == 0 && ket->ptypes[0] == SR_KEMIP_NONE) {
+		rpf = KSR_RPROF_KEMI_ENTER(ket);
 		if(ket->rtype == SR_KEMIP_XVAL) {
 			xret = ((sr_kemi_xfm_f)(ket->func))(env_J->msg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_jsdt_return_xval(J, ket, xret);
 		} else {
 			ret = ((sr_kemi_fm_f)(ket->func))(env_J->msg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_jsdt_return_int(J, ket, ret);
 		}
 	}
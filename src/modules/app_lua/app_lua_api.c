@@ -36,6 +36,7 @@
 #include "../../core/strutils.h"
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
+#include "../../core/rprof.h"
 
 #include "app_lua_api.h"
 #include "app_lua_kemi_export.h"
@@ -49,6 +50,7 @@
 #endif
 
 extern int _ksr_app_lua_log_mode;
+extern int _ksr_app_lua_kemi_direct;
 
 void lua_sr_kemi_register_libs(lua_State *L);
 
@@ -958,6 +960,7 @@ int sr_kemi_lua_exec_func_ex(lua_State *L, sr_kemi_t *ket, int pdelta)
 	int i;
 	int argc;
 	int ret;
+	int rpf;
 	str *fname;
 	str *mname;
 	sr_kemi_xval_t vps[SR_KEMI_PARAMS_MAX];
@@ -976,11 +979,14 @@ int sr_kemi_lua_exec_func_ex(lua_State *L, sr_kemi_t *ket, int pdelta)
 
 	argc = lua_gettop(L);
 	if(argc == pdelta && ket->ptypes[0] == SR_KEMIP_NONE) {
+		rpf = KSR_RPROF_KEMI_ENTER(ket);
 		if(ket->rtype == SR_KEMIP_XVAL) {
 			xret = ((sr_kemi_xfm_f)(ket->func))(env_L->msg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_lua_return_xval(L, ket, xret);
 		} else {
 			ret = ((sr_kemi_fm_f)(ket->func))(env_L->msg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_lua_return_int(L, ket, ret);
 		}
 	}
@@ -1079,16 +1085,14 @@ int sr_kemi_lua_exec_midx_func(lua_State *L, str *mname, int midx, str *fname)
 /**
  *
  */
-int sr_kemi_lua_exec_func(lua_State *L, int eidx)
+static int sr_kemi_lua_exec_ket(lua_State *L, sr_kemi_t *ket)
 {
-	sr_kemi_t *ket;
 	int ret;
 	struct timeval tvb = {0}, tve = {0};
 	struct timezone tz;
 	unsigned int tdiff;
 	lua_Debug dinfo;
 
-	ket = sr_kemi_lua_export_get(eidx);
 	if(unlikely(cfg_get(core, core_cfg, latency_limit_action) > 0)
 			&& is_printable(cfg_get(core, core_cfg, latency_log))) {
 		gettimeofday(&tvb, &tz);
@@ -1127,6 +1131,292 @@ int sr_kemi_lua_exec_func(lua_State *L, int eidx)
 	return ret;
 }
 
+/**
+ *
+ */
+int sr_kemi_lua_exec_func(lua_State *L, int eidx)
+{
+	return sr_kemi_lua_exec_ket(L, sr_kemi_lua_export_get(eidx));
+}
+
+/**
+ * direct call bindings - C closures specialized per parameters signature,
+ * with the kemi export as upvalue, skipping the lookup and the generic
+ * conversion of the parameters
+ */
+#define SR_KEMI_LUA_DIRECT_KET(L) \
+	((sr_kemi_t *)lua_touserdata((L), lua_upvalueindex(1)))
+
+#define SR_KEMI_LUA_DIRECT_CALL(L, ket, xf, f, ...)                         \
+	do {                                                                    \
+		if((ket)->rtype == SR_KEMIP_XVAL) {                                 \
+			return sr_kemi_lua_return_xval(                                 \
+					(L), (ket), ((xf)((ket)->func))(__VA_ARGS__));          \
+		}                                                                   \
+		return sr_kemi_lua_return_int(                                      \
+				(L), (ket), ((f)((ket)->func))(__VA_ARGS__));               \
+	} while(0)
+
+/**
+ * return the sip message for direct execution or NULL if the call has to
+ * go through the generic path (latency checks, profiling, parameters
+ * mismatch)
+ */
+static inline sip_msg_t *sr_kemi_lua_direct_msg(lua_State *L, int np)
+{
+	sr_lua_env_t *env_L;
+
+	if(unlikely(cfg_get(core, core_cfg, latency_limit_action) > 0)) {
+		return NULL;
+	}
+	if(unlikely(ksr_rprof_on())) {
+		return NULL;
+	}
+	if(unlikely(lua_gettop(L) != np)) {
+		return NULL;
+	}
+	env_L = sr_lua_env_get();
+	if(unlikely(env_L == NULL || env_L->msg == NULL)) {
+		return NULL;
+	}
+	return env_L->msg;
+}
+
+/**
+ * convert the Lua value at index idx to str - same as the generic path
+ */
+static inline void sr_kemi_lua_direct_str(lua_State *L, int idx, str *s)
+{
+	s->s = (char *)lua_tostring(L, idx);
+	if(s->s == NULL) {
+		s->len = 0;
+		return;
+	}
+	if(lua_isstring(L, idx)) {
+#if LUA_VERSION_NUM > 501
+		s->len = lua_rawlen(L, idx);
+#else
+		s->len = lua_strlen(L, idx);
+#endif
+	} else {
+		s->len = strlen(s->s);
+	}
+}
+
+static int sr_kemi_lua_direct_0(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+
+	msg = sr_kemi_lua_direct_msg(L, 0);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	SR_KEMI_LUA_DIRECT_CALL(L, ket, sr_kemi_xfm_f, sr_kemi_fm_f, msg);
+}
+
+static int sr_kemi_lua_direct_s(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	str s1;
+
+	msg = sr_kemi_lua_direct_msg(L, 1);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	sr_kemi_lua_direct_str(L, 1, &s1);
+	SR_KEMI_LUA_DIRECT_CALL(L, ket, sr_kemi_xfms_f, sr_kemi_fms_f, msg, &s1);
+}
+
+static int sr_kemi_lua_direct_n(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	int n1;
+
+	msg = sr_kemi_lua_direct_msg(L, 1);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	n1 = lua_tointeger(L, 1);
+	SR_KEMI_LUA_DIRECT_CALL(L, ket, sr_kemi_xfmn_f, sr_kemi_fmn_f, msg, n1);
+}
+
+static int sr_kemi_lua_direct_ss(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	str s1, s2;
+
+	msg = sr_kemi_lua_direct_msg(L, 2);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	sr_kemi_lua_direct_str(L, 1, &s1);
+	sr_kemi_lua_direct_str(L, 2, &s2);
+	SR_KEMI_LUA_DIRECT_CALL(
+			L, ket, sr_kemi_xfmss_f, sr_kemi_fmss_f, msg, &s1, &s2);
+}
+
+static int sr_kemi_lua_direct_sn(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	str s1;
+	int n2;
+
+	msg = sr_kemi_lua_direct_msg(L, 2);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	sr_kemi_lua_direct_str(L, 1, &s1);
+	n2 = lua_tointeger(L, 2);
+	SR_KEMI_LUA_DIRECT_CALL(
+			L, ket, sr_kemi_xfmsn_f, sr_kemi_fmsn_f, msg, &s1, n2);
+}
+
+static int sr_kemi_lua_direct_ns(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	int n1;
+	str s2;
+
+	msg = sr_kemi_lua_direct_msg(L, 2);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	n1 = lua_tointeger(L, 1);
+	sr_kemi_lua_direct_str(L, 2, &s2);
+	SR_KEMI_LUA_DIRECT_CALL(
+			L, ket, sr_kemi_xfmns_f, sr_kemi_fmns_f, msg, n1, &s2);
+}
+
+static int sr_kemi_lua_direct_nn(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	int n1, n2;
+
+	msg = sr_kemi_lua_direct_msg(L, 2);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	n1 = lua_tointeger(L, 1);
+	n2 = lua_tointeger(L, 2);
+	SR_KEMI_LUA_DIRECT_CALL(
+			L, ket, sr_kemi_xfmnn_f, sr_kemi_fmnn_f, msg, n1, n2);
+}
+
+static int sr_kemi_lua_direct_sss(lua_State *L)
+{
+	sr_kemi_t *ket = SR_KEMI_LUA_DIRECT_KET(L);
+	sip_msg_t *msg;
+	str s1, s2, s3;
+
+	msg = sr_kemi_lua_direct_msg(L, 3);
+	if(msg == NULL) {
+		return sr_kemi_lua_exec_ket(L, ket);
+	}
+	sr_kemi_lua_direct_str(L, 1, &s1);
+	sr_kemi_lua_direct_str(L, 2, &s2);
+	sr_kemi_lua_direct_str(L, 3, &s3);
+	SR_KEMI_LUA_DIRECT_CALL(
+			L, ket, sr_kemi_xfmsss_f, sr_kemi_fmsss_f, msg, &s1, &s2, &s3);
+}
+
+/**
+ * return the direct call function matching the parameters of the kemi
+ * export or NULL if there is none
+ */
+static lua_CFunction sr_kemi_lua_direct_get(sr_kemi_t *ket)
+{
+	char sig[SR_KEMI_PARAMS_MAX + 1];
+	int i;
+
+	for(i = 0; i < SR_KEMI_PARAMS_MAX; i++) {
+		if(ket->ptypes[i] == SR_KEMIP_NONE) {
+			break;
+		}
+		if(i >= 3) {
+			return NULL;
+		}
+		if(ket->ptypes[i] == SR_KEMIP_STR) {
+			sig[i] = 's';
+		} else if(ket->ptypes[i] == SR_KEMIP_INT) {
+			sig[i] = 'n';
+		} else {
+			return NULL;
+		}
+	}
+	sig[i] = '\0';
+
+	if(sig[0] == '\0') {
+		return sr_kemi_lua_direct_0;
+	}
+	if(strcmp(sig, "s") == 0) {
+		return sr_kemi_lua_direct_s;
+	}
+	if(strcmp(sig, "n") == 0) {
+		return sr_kemi_lua_direct_n;
+	}
+	if(strcmp(sig, "ss") == 0) {
+		return sr_kemi_lua_direct_ss;
+	}
+	if(strcmp(sig, "sn") == 0) {
+		return sr_kemi_lua_direct_sn;
+	}
+	if(strcmp(sig, "ns") == 0) {
+		return sr_kemi_lua_direct_ns;
+	}
+	if(strcmp(sig, "nn") == 0) {
+		return sr_kemi_lua_direct_nn;
+	}
+	if(strcmp(sig, "sss") == 0) {
+		return sr_kemi_lua_direct_sss;
+	}
+	return NULL;
+}
+
+/**
+ * replace the functions of KSR (mname is NULL) or KSR.mname with the
+ * direct call closures, for the exports with a supported signature
+ */
+static int sr_kemi_lua_direct_register(
+		lua_State *L, char *mname, sr_kemi_t *kexp)
+{
+	lua_CFunction f;
+	int top;
+	int i;
+	int n;
+
+	top = lua_gettop(L);
+	lua_getglobal(L, "KSR");
+	if(mname != NULL && lua_istable(L, -1)) {
+		lua_getfield(L, -1, mname);
+	}
+	if(!lua_istable(L, -1)) {
+		LM_ERR("KSR%s%s table not found\n", (mname) ? "." : "",
+				(mname) ? mname : "");
+		lua_settop(L, top);
+		return -1;
+	}
+	n = 0;
+	for(i = 0; kexp[i].func != NULL; i++) {
+		f = sr_kemi_lua_direct_get(&kexp[i]);
+		if(f == NULL) {
+			continue;
+		}
+		lua_pushlightuserdata(L, &kexp[i]);
+		lua_pushcclosure(L, f, 1);
+		lua_setfield(L, -2, kexp[i].fname.s);
+		n++;
+	}
+	lua_settop(L, top);
+	return n;
+}
+
 /**
  *
  */
@@ -1401,6 +1691,9 @@ void lua_sr_kemi_register_libs(lua_State *L)
 	}
 
 	luaL_openlib(L, "KSR", _sr_crt_KSRMethods, 0);
+	if(_ksr_app_lua_kemi_direct) {
+		sr_kemi_lua_direct_register(L, NULL, emods[0].kexp);
+	}
 
 	luaL_openlib(L, "KSR.x", _sr_kemi_x_Map, 0);
 
@@ -1432,6 +1725,10 @@ void lua_sr_kemi_register_libs(lua_State *L)
 				exit(-1);
 			}
 			luaL_openlib(L, mname, _sr_crt_KSRMethods, 0);
+			if(_ksr_app_lua_kemi_direct) {
+				sr_kemi_lua_direct_register(
+						L, emods[k].kexp[0].mname.s, emods[k].kexp);
+			}
 			if(_ksr_app_lua_log_mode & KSR_APP_LUA_LOG_EXPORTS) {
 				LM_DBG("initializing kemi sub-module: %s (%s) (%d/%d/%d)\n",
 						mname, emods[k].kexp[0].mname.s, i, k, n);
@@ -63,12 +63,14 @@ int app_lua_load_param(modparam_t type, void *val);
 int app_lua_reload_param(modparam_t type, void *val);
 
 int _ksr_app_lua_log_mode = 0;
+int _ksr_app_lua_kemi_direct = 0;
 
 /* clang-format off */
 static param_export_t params[] = {
 	{"load", PARAM_STRING | PARAM_USE_FUNC, (void *)app_lua_load_param},
 	{"reload", PARAM_INT | PARAM_USE_FUNC, (void *)app_lua_reload_param},
 	{"log_mode", PARAM_INT, &_ksr_app_lua_log_mode},
+	{"kemi_direct", PARAM_INT, &_ksr_app_lua_kemi_direct},
 	{0, 0, 0}
 };
 
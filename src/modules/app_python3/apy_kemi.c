@@ -31,6 +31,7 @@
 #include "../../core/route.h"
 #include "../../core/fmsg.h"
 #include "../../core/kemi.h"
+#include "../../core/rprof.h"
 #include "../../core/locking.h"
 #include "../../core/pvar.h"
 #include "../../core/timer.h"
@@ -223,6 +224,7 @@ PyObject *sr_apy_kemi_exec_func_ex(
 	str fname;
 	int i;
 	int ret;
+	int rpf;
 	sr_kemi_xval_t vps[SR_KEMI_PARAMS_MAX];
 	sr_apy_env_t *env_P;
 	sip_msg_t *lmsg = NULL;
@@ -252,11 +254,14 @@ PyObject *sr_apy_kemi_exec_func_ex(
 	fname = ket->fname;
 
 	if(ket->ptypes[0] == SR_KEMIP_NONE) {
+		rpf = KSR_RPROF_KEMI_ENTER(ket);
 		if(ket->rtype == SR_KEMIP_XVAL) {
 			xret = ((sr_kemi_xfm_f)(ket->func))(lmsg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_apy_return_xval(ket, xret);
 		} else {
 			ret = ((sr_kemi_fm_f)(ket->func))(lmsg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_apy_return_int(ket, ret);
 		}
 	}
@@ -31,6 +31,7 @@
 #include "../../core/sr_module.h"
 #include "../../core/mem/shm.h"
 #include "../../core/kemi.h"
+#include "../../core/rprof.h"
 #include "../../core/rpc.h"
 #include "../../core/rpc_lookup.h"
 
@@ -802,6 +803,7 @@ VALUE sr_kemi_ruby_return_xval(sr_kemi_t *ket, sr_kemi_xval_t *rx)
 VALUE sr_kemi_ruby_exec_func_ex(ksr_ruby_context_t *R, sr_kemi_t *ket, int argc,
 		VALUE *argv, VALUE self)
 {
+	int rpf;
 	sr_kemi_xval_t vps[SR_KEMI_PARAMS_MAX];
 	sr_ruby_env_t *env_R;
 	str *fname;
@@ -818,11 +820,14 @@ VALUE sr_kemi_ruby_exec_func_ex(ksr_ruby_context_t *R, sr_kemi_t *ket, int argc,
 	}
 
 	if(argc == 0 && ket->ptypes[0] == SR_KEMIP_NONE) {
+		rpf = KSR_RPROF_KEMI_ENTER(ket);
 		if(ket->rtype == SR_KEMIP_XVAL) {
 			xret = ((sr_kemi_xfm_f)(ket->func))(env_R->msg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_ruby_return_xval(ket, xret);
 		} else {
 			ret = ((sr_kemi_fm_f)(ket->func))(env_R->msg);
+			KSR_RPROF_KEMI_EXIT(rpf);
 			return sr_kemi_ruby_return_int(ket, ret);
 		}
 	}
@@ -720,6 +720,10 @@ int rule_fixup(struct route_data_t *rd)
 			} else {
 				LM_NOTICE("empty tree at [%i][%i]\n", i, j);
 			}
+			if(rd->carriers[i]->domains[j]
+					&& build_domain_index(rd->carriers[i]->domains[j]) < 0) {
+				return -1;
+			}
 		}
 	}
 	return 0;
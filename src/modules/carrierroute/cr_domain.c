@@ -115,11 +115,93 @@ void destroy_domain_data(struct domain_data_t *domain_data)
 				&domain_data->tree, destroy_route_flags_list, cr_match_mode);
 		dtrie_destroy(&domain_data->failure_tree,
 				destroy_failure_route_rule_list, cr_match_mode);
+		pfx_index_free(domain_data->index, NULL);
+		pfx_index_free(domain_data->failure_index, NULL);
 		shm_free(domain_data);
 	}
 }
 
 
+/**
+ * Adds the prefixes of the routing tree below node to the index builder.
+ *
+ * @param b the index builder
+ * @param node the routing tree node
+ * @param prefix the prefix of node
+ * @param len the length of the prefix
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int domain_index_add(
+		pfx_builder_t *b, struct dtrie_node_t *node, char *prefix, int len)
+{
+	void **slot;
+	int i;
+
+	if(node->data != NULL) {
+		if((slot = pfx_builder_slot(b, prefix, len)) == NULL) {
+			return -1;
+		}
+		*slot = &node->data;
+	}
+	for(i = 0; i < cr_match_mode; i++) {
+		if(node->child[i]) {
+			if(len == PFX_KEY_MAX) {
+				LM_ERR("prefix longer than %d\n", PFX_KEY_MAX);
+				return -1;
+			}
+			/* the same chars as the ones matched by dtrie */
+			prefix[len] = (cr_match_mode == 10) ? '0' + i : i;
+			if(domain_index_add(b, node->child[i], prefix, len + 1) < 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+static pfx_index_t *domain_index_build(struct dtrie_node_t *root)
+{
+	char prefix[PFX_KEY_MAX];
+	pfx_builder_t *b;
+	pfx_index_t *idx = NULL;
+
+	if((b = pfx_builder_new()) == NULL) {
+		return NULL;
+	}
+	if(domain_index_add(b, root, prefix, 0) == 0) {
+		idx = pfx_index_build(b);
+	}
+	pfx_builder_free(b, NULL);
+	return idx;
+}
+
+
+/**
+ * Builds the lookup indexes of the domain from its routing trees. The
+ * values of the indexes point into the trees, so the indexes have to be
+ * rebuilt whenever the trees are changed.
+ *
+ * @param domain_data the domain
+ *
+ * @return 0 on success, -1 on failure
+ */
+int build_domain_index(struct domain_data_t *domain_data)
+{
+	pfx_index_free(domain_data->index, NULL);
+	pfx_index_free(domain_data->failure_index, NULL);
+	domain_data->index = domain_index_build(domain_data->tree);
+	domain_data->failure_index = domain_index_build(domain_data->failure_tree);
+	if(domain_data->index == NULL || domain_data->failure_index == NULL) {
+		LM_ERR("could not build the index of domain %.*s\n",
+				domain_data->name->len, domain_data->name->s);
+		return -1;
+	}
+	return 0;
+}
+
+
 /**
  * Adds the given route information to the prefix tree identified by
  * node. scan_prefix identifies the number for which the information
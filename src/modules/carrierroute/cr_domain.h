@@ -33,6 +33,7 @@
 #include "../../core/str.h"
 #include "../../core/flags.h"
 #include "../../lib/trie/dtrie.h"
+#include "../../lib/pfxidx/pfxidx.h"
 
 
 /**
@@ -48,6 +49,10 @@ struct domain_data_t
 			tree; /*!< the root node of the routing tree. Payload is of type (struct route_flags *) */
 	struct dtrie_node_t *
 			failure_tree; /*!< the root node of the failure routing tree. Payload is of type (struct failure_route_rule *) */
+	pfx_index_t *
+			index; /*!< lookup index of the routing tree. Values point to the payload of the tree nodes */
+	pfx_index_t *
+			failure_index; /*!< lookup index of the failure routing tree. Values point to the payload of the tree nodes */
 };
 
 
@@ -136,6 +141,18 @@ int add_failure_route_to_tree(struct dtrie_node_t *failure_node,
 		const int next_domain, const str *comment);
 
 
+/**
+ * Builds the lookup indexes of the domain from its routing trees. The
+ * values of the indexes point into the trees, so the indexes have to be
+ * rebuilt whenever the trees are changed.
+ *
+ * @param domain_data the domain
+ *
+ * @return 0 on success, -1 on failure
+ */
+int build_domain_index(struct domain_data_t *domain_data);
+
+
 /**
  * Compares the IDs of two domain data structures.
  * A NULL pointer is always greater than any ID.
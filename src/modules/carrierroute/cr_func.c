@@ -201,7 +201,7 @@ static int set_next_domain_on_rule(sip_msg_t *_msg,
  * failure route rules for a single number
  *
  * @param _msg SIP message
- * @param failure_node the current routing tree node
+ * @param failure_index the index of the failure routing tree
  * @param uri the uri to be rewritten at the current position
  * @param host last tried host
  * @param reply_code the last reply code
@@ -211,7 +211,7 @@ static int set_next_domain_on_rule(sip_msg_t *_msg,
  * @return 0 on success, -1 on failure, 1 on no more matching child node and no rule list
  */
 static int set_next_domain_recursor(sip_msg_t *_msg,
-		struct dtrie_node_t *failure_node, const str *uri, const str *host,
+		const pfx_index_t *failure_index, const str *uri, const str *host,
 		const str *reply_code, const flag_t flags, pv_spec_t *dstavp)
 {
 	str re_uri = *uri;
@@ -222,8 +222,7 @@ static int set_next_domain_recursor(sip_msg_t *_msg,
 		++re_uri.s;
 		--re_uri.len;
 	}
-	ret = dtrie_longest_match(
-			failure_node, re_uri.s, re_uri.len, NULL, cr_match_mode);
+	ret = (void **)pfx_index_longest(failure_index, re_uri.s, re_uri.len, NULL);
 
 	if(ret == NULL) {
 		LM_INFO("URI or prefix tree nodes empty, empty rule list\n");
@@ -595,7 +594,7 @@ static int rewrite_on_rule(sip_msg_t *msg, struct route_flags *rf_head,
  * route rules for a single number
  *
  * @param msg the sip message
- * @param node the current routing tree node
+ * @param index the index of the routing tree
  * @param pm the user to be used for prefix matching
  * @param flags user defined flags
  * @param dest the returned new destination URI
@@ -606,7 +605,7 @@ static int rewrite_on_rule(sip_msg_t *msg, struct route_flags *rf_head,
  *
  * @return 0 on success, -1 on failure, 1 on no more matching child node and no rule list
  */
-static int rewrite_uri_recursor(sip_msg_t *msg, struct dtrie_node_t *node,
+static int rewrite_uri_recursor(sip_msg_t *msg, const pfx_index_t *index,
 		const str *pm, flag_t flags, str *dest, const str *user,
 		const enum hash_source hash_source, const enum hash_algorithm alg,
 		pv_spec_t *descavp)
@@ -619,7 +618,7 @@ static int rewrite_uri_recursor(sip_msg_t *msg, struct dtrie_node_t *node,
 		++re_pm.s;
 		--re_pm.len;
 	}
-	ret = dtrie_longest_match(node, re_pm.s, re_pm.len, NULL, cr_match_mode);
+	ret = (void **)pfx_index_longest(index, re_pm.s, re_pm.len, NULL);
 
 	if(ret == NULL) {
 		LM_INFO("URI or prefix tree nodes empty, empty rule list\n");
@@ -677,8 +676,8 @@ int ki_cr_do_route_helper(sip_msg_t *_msg, struct route_data_t *_rd,
 		return -1;
 	}
 
-	ret = rewrite_uri_recursor(_msg, domain_data->tree, _prefix_matching, flags,
-			&dest, _rewrite_user, _hsrc, _halg, _dstavp);
+	ret = rewrite_uri_recursor(_msg, domain_data->index, _prefix_matching,
+			flags, &dest, _rewrite_user, _hsrc, _halg, _dstavp);
 
 	if(ret != 0) {
 		/* this is not necessarily an error, rewrite_recursor does already some error logging */
@@ -1058,7 +1057,7 @@ int ki_cr_load_next_domain_helper(sip_msg_t *_msg, struct route_data_t *_rd,
 		return -1;
 	}
 
-	ret = set_next_domain_recursor(_msg, domain_data->failure_tree,
+	ret = set_next_domain_recursor(_msg, domain_data->failure_index,
 			_prefix_matching, _host, _reply_code, flags, _dstavp);
 
 	if(ret != 0) {
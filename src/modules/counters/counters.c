@@ -27,6 +27,8 @@
  *
  */
 
+#include <limits.h>
+
 #include "../../core/modparam.h"
 #include "../../core/dprint.h"
 #include "../../core/compiler_opt.h"
@@ -90,6 +92,20 @@ static const char *cnt_help_doc[] = {
 		"print the description of a counter (group and counter name required).",
 		0};
 
+static void cnt_hist_get_rpc(rpc_t *rpc, void *ctx);
+static const char *cnt_hist_get_doc[] = {
+		"get the values and the cumulative buckets of a histogram"
+		" (takes group and histogram name as parameters)",
+		0};
+
+static void cnt_hist_list_rpc(rpc_t *rpc, void *ctx);
+static const char *cnt_hist_list_doc[] = {
+		"list all the histograms with count, sum and percentiles", 0};
+
+static void cnt_hist_reset_rpc(rpc_t *rpc, void *ctx);
+static const char *cnt_hist_reset_doc[] = {
+		"reset histogram (takes group and histogram name as parameters)", 0};
+
 
 static rpc_export_t counters_rpc[] = {{"cnt.get", cnt_get_rpc, cnt_get_doc, 0},
 		{"cnt.reset", cnt_reset_rpc, cnt_reset_doc, 0},
@@ -100,7 +116,11 @@ static rpc_export_t counters_rpc[] = {{"cnt.get", cnt_get_rpc, cnt_get_doc, 0},
 		{"cnt.var_list", cnt_var_list_rpc, cnt_var_list_doc, RET_ARRAY},
 		{"cnt.get_vars", cnt_grp_get_all_rpc, cnt_grp_get_all_doc, 0},
 		{"cnt.grp_get_all", cnt_grp_get_all_rpc, cnt_grp_get_all_doc, 0},
-		{"cnt.help", cnt_help_rpc, cnt_help_doc, 0}, {0, 0, 0, 0}};
+		{"cnt.help", cnt_help_rpc, cnt_help_doc, 0},
+		{"cnt.hist_get", cnt_hist_get_rpc, cnt_hist_get_doc, 0},
+		{"cnt.hist_list", cnt_hist_list_rpc, cnt_hist_list_doc, RET_ARRAY},
+		{"cnt.hist_reset", cnt_hist_reset_rpc, cnt_hist_reset_doc, 0},
+		{0, 0, 0, 0}};
 
 
 struct module_exports exports = {
@@ -496,6 +516,118 @@ static void cnt_help_rpc(rpc_t *rpc, void *ctx)
 	return;
 }
 
+/* helper for adding the summary of a histogram to a rpc struct */
+static int rpc_hist_summary_add(rpc_t *rpc, void *s, counter_val_t *buckets,
+		counter_val_t count, counter_val_t sum)
+{
+	return rpc->struct_add(s, "jjjjjj", "count", (unsigned long)count, "sum",
+			(unsigned long)sum, "avg",
+			(unsigned long)((count > 0) ? sum / count : 0), "p50",
+			counter_hist_quantile(buckets, count, 500), "p90",
+			counter_hist_quantile(buckets, count, 900), "p99",
+			counter_hist_quantile(buckets, count, 990));
+}
+
+
+static void cnt_hist_get_rpc(rpc_t *rpc, void *c)
+{
+	char *group;
+	char *name;
+	counter_hist_handle_t h;
+	counter_val_t buckets[CNT_HIST_BUCKETS];
+	counter_val_t count;
+	counter_val_t sum;
+	counter_val_t cbucket;
+	unsigned long le;
+	char lbuf[32];
+	void *s;
+	void *bs;
+	int b;
+
+	if(rpc->scan(c, "ss", &group, &name) < 2) {
+		/* rpc->fault(c, 400, "group and histogram name required"); */
+		return;
+	}
+	if(counter_hist_lookup(&h, group, name) < 0) {
+		rpc->fault(c, 400, "non-existent histogram %s.%s\n", group, name);
+		return;
+	}
+	if(counter_hist_get(h, buckets, &count, &sum) < 0) {
+		rpc->fault(c, 500, "cannot get histogram %s.%s\n", group, name);
+		return;
+	}
+	if(rpc->add(c, "{", &s) < 0)
+		return;
+	if(rpc_hist_summary_add(rpc, s, buckets, count, sum) < 0)
+		return;
+	if(rpc->struct_add(s, "{", "buckets", &bs) < 0)
+		return;
+	/* cumulative values, only for the buckets with new values */
+	cbucket = 0;
+	for(b = 0; b < CNT_HIST_BUCKETS; b++) {
+		if(buckets[b] == 0)
+			continue;
+		cbucket += buckets[b];
+		le = counter_hist_bucket_le(b);
+		if(le == ULONG_MAX)
+			strcpy(lbuf, "le_inf");
+		else
+			snprintf(lbuf, sizeof(lbuf), "le_%lu", le);
+		if(rpc->struct_add(bs, "j", lbuf, (unsigned long)cbucket) < 0)
+			return;
+	}
+}
+
+
+/* helper callback for iterating on histograms */
+static void rpc_print_hist(void *param, str *g, str *n, counter_hist_handle_t h)
+{
+	struct rpc_list_params *p;
+	counter_val_t buckets[CNT_HIST_BUCKETS];
+	counter_val_t count;
+	counter_val_t sum;
+	rpc_t *rpc;
+	void *s;
+
+	p = param;
+	rpc = p->rpc;
+	if(counter_hist_get(h, buckets, &count, &sum) < 0)
+		return;
+	if(rpc->add(p->ctx, "{", &s) < 0)
+		return;
+	if(rpc->struct_add(s, "SS", "group", g, "name", n) < 0)
+		return;
+	rpc_hist_summary_add(rpc, s, buckets, count, sum);
+}
+
+
+static void cnt_hist_list_rpc(rpc_t *rpc, void *c)
+{
+	struct rpc_list_params packed_params;
+
+	packed_params.rpc = rpc;
+	packed_params.ctx = c;
+	counter_hist_iterate(rpc_print_hist, &packed_params);
+}
+
+
+static void cnt_hist_reset_rpc(rpc_t *rpc, void *c)
+{
+	char *group;
+	char *name;
+	counter_hist_handle_t h;
+
+	if(rpc->scan(c, "ss", &group, &name) < 2) {
+		/* rpc->fault(c, 400, "group and histogram name required"); */
+		return;
+	}
+	if(counter_hist_lookup(&h, group, name) < 0) {
+		rpc->fault(c, 400, "non-existent histogram %s.%s\n", group, name);
+		return;
+	}
+	counter_hist_reset(h);
+}
+
 /**
  *
  */
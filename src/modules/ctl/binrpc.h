@@ -114,6 +114,8 @@
 #define BINRPC_REQ 0
 #define BINRPC_REPL 1
 #define BINRPC_FAULT 3
+#define BINRPC_REQ_STREAM 4 /* request, partial replies accepted */
+#define BINRPC_REPL_CHUNK 5 /* partial reply, more will follow */
 
 /* values types */
 #define BINRPC_T_INT 0
@@ -649,6 +651,8 @@ static inline unsigned char *binrpc_parse_init(
 		case BINRPC_REQ:
 		case BINRPC_REPL:
 		case BINRPC_FAULT:
+		case BINRPC_REQ_STREAM:
+		case BINRPC_REPL_CHUNK:
 			break;
 		default:
 			*err = E_BINRPC_BADPKT;
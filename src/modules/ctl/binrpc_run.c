@@ -44,6 +44,7 @@ int autoconvert = 0;
 int binrpc_max_body_size = 32;		 /* multiplied by 1024 in mod init */
 int binrpc_struct_max_body_size = 8; /* multiplied by 1024 in mod init */
 int binrpc_buffer_size = DEFAULT_RPC_PRINTF_BUF_SIZE;
+int binrpc_stream_chunk_size = 16; /* multiplied by 1024 in mod init */
 
 #define BINRPC_MAX_BODY binrpc_max_body_size /* maximum body for send */
 #define STRUCT_MAX_BODY binrpc_struct_max_body_size
@@ -100,6 +101,7 @@ struct binrpc_ctx
 	char *method;
 	struct binrpc_gc_block *gc; /**< garbage collection */
 	int replied;
+	int stream; /**< partial replies allowed (stream request) */
 	int err_code;
 	str err_phrase; /**< Leading zero must be included! */
 };
@@ -116,6 +118,8 @@ struct iovec_array
 /* send */
 static void rpc_fault(struct binrpc_ctx *ctx, int code, char *fmt, ...);
 static int rpc_send(struct binrpc_ctx *ctx);
+static int rpc_flush(struct binrpc_ctx *ctx);
+static rpc_capabilities_t rpc_capabilities(struct binrpc_ctx *ctx);
 static int rpc_send_v(struct iovec_array *a);
 static int rpc_add(struct binrpc_ctx *ctx, char *fmt, ...);
 static int rpc_scan(struct binrpc_ctx *ctx, char *fmt, ...);
@@ -142,6 +146,8 @@ void binrpc_callbacks_init(void)
 	binrpc_callbacks.array_add = (rpc_struct_add_f)rpc_array_add;
 	binrpc_callbacks.struct_scan = (rpc_struct_scan_f)rpc_struct_scan;
 	binrpc_callbacks.struct_printf = (rpc_struct_printf_f)rpc_struct_printf;
+	binrpc_callbacks.capabilities = (rpc_capabilities_f)rpc_capabilities;
+	binrpc_callbacks.flush = (rpc_flush_f)rpc_flush;
 }
 
 /** mark a pointer for freeing when the ctx is destroyed.
@@ -565,10 +571,9 @@ static int rpc_send_v(struct iovec_array *a)
 	return 0;
 }
 
-/* build the reply from the current body */
-static int rpc_send(struct binrpc_ctx *ctx)
+/* send the current body as a reply of the given type */
+static int rpc_send_body(struct binrpc_ctx *ctx, int type, int b_len)
 {
-	int b_len;
 	int hdr_len;
 	struct iovec v[MAX_MSG_CHUNKS];
 	struct iovec_array a;
@@ -581,16 +586,8 @@ static int rpc_send(struct binrpc_ctx *ctx)
 	a.len = MAX_MSG_CHUNKS;
 	a.ctx = ctx->send_h;
 
-	if(ctx->replied) {
-		LOG(L_ERR,
-				"ERROR: binrpc: rpc_send: rpc method %s tried to reply"
-				" more than once\n",
-				ctx->method ? ctx->method : "");
-		goto error;
-	}
-	b_len = body_get_len(&ctx->out.pkt, &ctx->out.structs);
 	err = hdr_len = binrpc_build_hdr(
-			BINRPC_REPL, b_len, ctx->in.ctx.cookie, hdr, BINRPC_MAX_HDR_SIZE);
+			type, b_len, ctx->in.ctx.cookie, hdr, BINRPC_MAX_HDR_SIZE);
 	if(err < 0) {
 		LOG(L_ERR,
 				"ERROR: binrpc: rpc_fault: binrpc_* failed with:"
@@ -615,13 +612,61 @@ static int rpc_send(struct binrpc_ctx *ctx)
 		LOG(L_ERR, "ERROR: binrprc: rpc_send: send failed\n");
 		goto error;
 	}
-	ctx->replied = 1;
 	return 0;
 error:
 	return -1;
 }
 
 
+/* build the reply from the current body */
+static int rpc_send(struct binrpc_ctx *ctx)
+{
+	if(ctx->replied) {
+		LOG(L_ERR,
+				"ERROR: binrpc: rpc_send: rpc method %s tried to reply"
+				" more than once\n",
+				ctx->method ? ctx->method : "");
+		return -1;
+	}
+	if(rpc_send_body(ctx, BINRPC_REPL,
+			   body_get_len(&ctx->out.pkt, &ctx->out.structs))
+			< 0)
+		return -1;
+	ctx->replied = 1;
+	return 0;
+}
+
+
+/* send the current body as a partial reply if it is bigger than the chunk
+ * size and start a new one
+ * returns 1 if sent, 0 if not, -1 on error */
+static int rpc_flush(struct binrpc_ctx *ctx)
+{
+	int b_len;
+
+	if(ctx->stream == 0 || ctx->replied)
+		return 0;
+	b_len = body_get_len(&ctx->out.pkt, &ctx->out.structs);
+	if(b_len < binrpc_stream_chunk_size)
+		return 0;
+	if(rpc_send_body(ctx, BINRPC_REPL_CHUNK, b_len) < 0) {
+		/* the client is gone or too slow, nothing else can be sent */
+		ctx->replied = 1;
+		return -1;
+	}
+	free_structs(&ctx->out.structs);
+	clist_init(&ctx->out.structs, next, prev);
+	ctx->out.pkt.crt = ctx->out.pkt.body;
+	return 1;
+}
+
+
+static rpc_capabilities_t rpc_capabilities(struct binrpc_ctx *ctx)
+{
+	return ctx->stream ? RPC_STREAM_REPLY : 0;
+}
+
+
 /* params: buf, size     - buffer containing the packet
  *         bytes_needed  - int pointer, filled with how many bytes are still
  *                         needed (after bytes_needed new bytes received this
@@ -673,7 +718,11 @@ int process_rpc_req(unsigned char *buf, int size, int *bytes_needed, void *sh,
 		goto error;
 	}
 	err = E_BINRPC_BADPKT;
-	if(ctx->type != BINRPC_REQ) {
+	if(ctx->type == BINRPC_REQ_STREAM) {
+		/* partial replies only on stream connections, on datagram sockets
+		 * the request gets a single reply */
+		f_ctx.stream = (((struct send_handle *)sh)->type == S_CONNECTED);
+	} else if(ctx->type != BINRPC_REQ) {
 		rpc_fault(&f_ctx, 400, "bad request: %s", binrpc_error(err));
 		goto error;
 	}
@@ -61,6 +61,7 @@ extern int autoconvert;
 extern int binrpc_max_body_size;
 extern int binrpc_struct_max_body_size;
 extern int binrpc_buffer_size;
+extern int binrpc_stream_chunk_size;
 
 static int add_binrpc_socket(modparam_t type, void *val);
 #ifdef USE_FIFO
@@ -99,6 +100,7 @@ static param_export_t params[] = {
 		{"binrpc_struct_max_body_size", PARAM_INT,
 				&binrpc_struct_max_body_size},
 		{"binrpc_buffer_size", PARAM_INT, &binrpc_buffer_size},
+		{"binrpc_stream_chunk_size", PARAM_INT, &binrpc_stream_chunk_size},
 		{0, 0, 0}}; /* no params */
 
 struct module_exports exports = {
@@ -224,6 +226,13 @@ static int mod_init(void)
 		binrpc_struct_max_body_size = 1;
 	binrpc_max_body_size *= 1024;
 	binrpc_struct_max_body_size *= 1024;
+	if(binrpc_stream_chunk_size <= 0)
+		binrpc_stream_chunk_size = 1;
+	binrpc_stream_chunk_size *= 1024;
+	/* leave room in the body for the items added after the chunk size
+	 * is reached */
+	if(binrpc_stream_chunk_size > binrpc_max_body_size / 2)
+		binrpc_stream_chunk_size = binrpc_max_body_size / 2;
 
 	if(listen_lst == 0) {
 		if(strcmp(runtime_dir, RUN_DIR) == 0) {
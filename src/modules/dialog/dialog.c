@@ -3297,7 +3297,9 @@ static void internal_rpc_print_dlgs(rpc_t *rpc, void *c, int with_context)
 {
 	dlg_cell_t *dlg;
 	unsigned int i;
+	int stream;
 
+	stream = rpc_stream_enabled(rpc, c);
 	for(i = 0; i < d_table->size; i++) {
 		dlg_lock(d_table, &(d_table->entries[i]));
 
@@ -3305,6 +3307,11 @@ static void internal_rpc_print_dlgs(rpc_t *rpc, void *c, int with_context)
 			internal_rpc_print_dlg(rpc, c, dlg, with_context);
 		}
 		dlg_unlock(d_table, &(d_table->entries[i]));
+		/* send the dialogs printed so far, outside of the lock */
+		if(stream && rpc->flush(c) < 0) {
+			LM_DBG("rpc client gone - stopping the listing\n");
+			return;
+		}
 	}
 }
 
@@ -43,6 +43,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
 #include "../../core/sr_module.h"
 #include "../../lib/srdb1/db.h"
 #include "../../core/dprint.h"
@@ -96,6 +97,7 @@ int dp_fetch_rows = 1000;
 int dp_match_dynamic = 0;
 int dp_append_branch = 1;
 int dp_reload_delta = 5;
+int dp_match_index = 1;
 
 static time_t *dp_rpc_reload_time = NULL;
 /* clang-format off */
@@ -115,6 +117,7 @@ static param_export_t mod_params[]={
 	{ "match_dynamic",	PARAM_INT,	&dp_match_dynamic },
 	{ "append_branch",	PARAM_INT,	&dp_append_branch },
 	{ "reload_delta",	PARAM_INT,	&dp_reload_delta },
+	{ "match_index",	PARAM_INT,	&dp_match_index },
 	{0,0,0}
 };
 
@@ -793,12 +796,93 @@ static void dialplan_rpc_dump(rpc_t *rpc, void *ctx)
 
 static const char *dialplan_rpc_dump_doc[2] = {"Dump dialplan content", 0};
 
+#define DP_BENCH_LOOPS 1000
+#define DP_BENCH_MAX_LOOPS 1000000
+
+static unsigned long long dp_bench_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * RPC command to time the matching of an input, with and without the
+ * prefix index of the rules
+ */
+static void dialplan_rpc_bench(rpc_t *rpc, void *ctx)
+{
+	dpl_id_p idp;
+	dpl_node_p rulep = NULL;
+	str input;
+	str none = str_init("");
+	int dpid;
+	int loops = DP_BENCH_LOOPS;
+	int tested[2] = {0, 0};
+	unsigned long long ns[2];
+	unsigned long long t0;
+	int seq;
+	int i;
+	void *th;
+
+	if(rpc->scan(ctx, "dS", &dpid, &input) < 2) {
+		rpc->fault(ctx, 500, "Invalid parameters");
+		return;
+	}
+	if(rpc->scan(ctx, "*d", &loops) < 1) {
+		loops = DP_BENCH_LOOPS;
+	}
+	if(loops <= 0 || loops > DP_BENCH_MAX_LOOPS) {
+		rpc->fault(ctx, 500, "Invalid number of loops");
+		return;
+	}
+	if(input.s == NULL || input.len == 0) {
+		rpc->fault(ctx, 500, "Empty input parameter");
+		return;
+	}
+	if((idp = select_dpid(dpid)) == 0) {
+		rpc->fault(ctx, 500, "Dialplan ID not matched");
+		return;
+	}
+
+	for(seq = 0; seq < 2; seq++) {
+		t0 = dp_bench_ns();
+		for(i = 0; i < loops; i++) {
+			rulep = dpl_match_rule(NULL, &input, idp, seq, &tested[seq]);
+		}
+		ns[seq] = (dp_bench_ns() - t0) / loops;
+	}
+
+	if(rpc->add(ctx, "{", &th) < 0) {
+		rpc->fault(ctx, 500, "Internal error creating rpc");
+		return;
+	}
+	if(rpc->struct_add(th, "dSdjdjd", "Matched", (rulep != NULL) ? 1 : 0,
+			   "MatchExp", (rulep != NULL) ? &rulep->match_exp : &none,
+			   "Priority", (rulep != NULL) ? rulep->pr : 0, "IndexNs",
+			   (unsigned long)ns[0], "IndexTested", tested[0],
+			   "SequentialNs", (unsigned long)ns[1], "SequentialTested",
+			   tested[1])
+			< 0) {
+		rpc->fault(ctx, 500, "Internal error creating rpc");
+		return;
+	}
+}
+
+static const char *dialplan_rpc_bench_doc[2] = {
+		"Time the matching of an input against the rules of a dialplan id,"
+		" with the prefix index and sequentially. Parameters: dpid, input,"
+		" optional number of loops (default 1000)",
+		0};
+
 
 rpc_export_t dialplan_rpc_list[] = {
 		{"dialplan.reload", dialplan_rpc_reload, dialplan_rpc_reload_doc, 0},
 		{"dialplan.translate", dialplan_rpc_translate,
 				dialplan_rpc_translate_doc, 0},
 		{"dialplan.dump", dialplan_rpc_dump, dialplan_rpc_dump_doc, 0},
+		{"dialplan.bench", dialplan_rpc_bench, dialplan_rpc_bench_doc, 0},
 		{0, 0, 0, 0}};
 
 static int dialplan_init_rpc(void)
@@ -46,6 +46,9 @@
 #define DP_TFLAGS_PV_MATCH (1 << 0)
 #define DP_TFLAGS_PV_SUBST (1 << 1)
 
+/* max length of the literal prefix indexed for a rule */
+#define DP_PFX_MAX_LEN 24
+
 extern pcre2_general_context *dpl_gctx;
 extern pcre2_compile_context *dpl_ctx;
 
@@ -74,9 +77,21 @@ typedef struct dpl_index
 	dpl_node_t *first_rule;
 	dpl_node_t *last_rule;
 
+	int nrules;				  /* number of indexed rules */
+	dpl_node_t **rules;		  /* the rules in priority order */
+	struct dpl_pfx_node *pfx; /* literal prefix index of the rules */
+
 	struct dpl_index *next;
 } dpl_index_t, *dpl_index_p;
 
+/*Candidate rules for an input, from the prefix index*/
+typedef struct dpl_pfx_iter
+{
+	int n;
+	int *rules[DP_PFX_MAX_LEN + 1];
+	int cnt[DP_PFX_MAX_LEN + 1];
+} dpl_pfx_iter_t;
+
 /*For every DPID*/
 typedef struct dpl_id
 {
@@ -109,8 +124,15 @@ struct subst_expr *repl_exp_parse(str subst);
 void repl_expr_free(struct subst_expr *se);
 int dp_translate_helper(
 		sip_msg_t *msg, str *user_name, str *repl_user, dpl_id_p idp, str *);
+dpl_node_p dpl_match_rule(
+		sip_msg_t *msg, str *input, dpl_id_p idp, int seq, int *tested);
 int rule_translate(sip_msg_t *msg, str *instr, dpl_node_t *rule,
 		pcre2_code *subst_comp, str *);
 
 pcre2_code *reg_ex_comp(const char *pattern, int *cap_cnt, int mtype);
+
+int dpl_pfx_index_build(dpl_index_p indexp);
+void dpl_pfx_index_destroy(dpl_index_p indexp);
+void dpl_pfx_iter_init(dpl_pfx_iter_t *it, dpl_index_p indexp, str *input);
+int dpl_pfx_iter_next(dpl_pfx_iter_t *it);
 #endif
@@ -52,6 +52,7 @@ str attrs_column = str_init(ATTRS_COL);
 
 extern int dp_fetch_rows;
 extern int dp_match_dynamic;
+extern int dp_match_index;
 
 static db1_con_t *dp_db_handle = 0; /* database connection handle */
 static db_func_t dp_dbf;
@@ -70,6 +71,7 @@ static db_func_t dp_dbf;
 
 void destroy_rule(dpl_node_t *rule);
 void destroy_hash(int);
+void index_hash(int);
 
 dpl_node_t *build_rule(db_val_t *values);
 int add_rule2hash(dpl_node_t *, int);
@@ -358,6 +360,8 @@ int dp_load_db(void)
 		}
 	} while(RES_ROW_N(res) > 0);
 
+	if(dp_match_index)
+		index_hash(*dp_next_idx);
 
 end:
 	/*update data*/
@@ -698,6 +702,7 @@ void destroy_hash(int index)
 				rulep = 0;
 				rulep = indexp->first_rule;
 			}
+			dpl_pfx_index_destroy(indexp);
 			crt_idp->first_index = indexp->next;
 			shm_free(indexp);
 			indexp = 0;
@@ -714,6 +719,26 @@ void destroy_hash(int index)
 }
 
 
+/*build the prefix index of the rules, per length bucket*/
+void index_hash(int h_index)
+{
+	dpl_id_p crt_idp;
+	dpl_index_p indexp;
+
+	for(crt_idp = dp_rules_hash[h_index]; crt_idp != NULL;
+			crt_idp = crt_idp->next) {
+		for(indexp = crt_idp->first_index; indexp != NULL;
+				indexp = indexp->next) {
+			if(dpl_pfx_index_build(indexp) != 0) {
+				LM_WARN("no prefix index for dpid %d len %d - rules are"
+						" tested sequentially\n",
+						crt_idp->dp_id, indexp->len);
+			}
+		}
+	}
+}
+
+
 void destroy_rule(dpl_node_t *rule)
 {
 
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*!
+ * \file
+ * \brief Kamailio dialplan :: literal prefix index of the rules
+ * \ingroup dialplan
+ * Module: \ref dialplan
+ *
+ * Every static rule of a length bucket is indexed in a tree by the literal
+ * prefix that any matching input must start with (the match value for
+ * equal, the leading literal characters of anchored regex and fnmatch
+ * expressions). Rules without such prefix, including the ones with
+ * variables in the match expression, are kept in the root. A lookup walks
+ * the input once down the tree and yields the candidate rules in priority
+ * order, so only they have to be tested with pcre2/fnmatch.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "dialplan.h"
+
+typedef struct dpl_pfx_node
+{
+	unsigned char c;
+	int nrules; /* number of rules with the prefix ending here */
+	int *rules; /* positions of the rules, in priority order */
+	struct dpl_pfx_node *child;
+	struct dpl_pfx_node *next;
+} dpl_pfx_node_t;
+
+/**
+ * literal prefix of a regex - it has to be anchored and without
+ * alternatives at top level
+ */
+static int dpl_regex_prefix(str *exp, char *buf)
+{
+	char *p;
+	char *end;
+	int depth;
+	int cls;
+	int n;
+
+	if(exp->len < 2 || exp->s[0] != '^')
+		return 0;
+	end = exp->s + exp->len;
+	depth = 0;
+	cls = 0;
+	for(p = exp->s; p < end; p++) {
+		if(*p == '\\') {
+			p++;
+			continue;
+		}
+		if(cls) {
+			if(*p == ']')
+				cls = 0;
+			continue;
+		}
+		switch(*p) {
+			case '[':
+				cls = 1;
+				break;
+			case '(':
+				depth++;
+				break;
+			case ')':
+				depth--;
+				break;
+			case '|':
+				if(depth == 0)
+					return 0;
+				break;
+		}
+	}
+
+	n = 0;
+	for(p = exp->s + 1; p < end && n < DP_PFX_MAX_LEN; p++) {
+		if(*p == '\\') {
+			/* only escaped punctuation is a literal */
+			if(p + 1 >= end || (p[1] >= '0' && p[1] <= '9')
+					|| (p[1] >= 'a' && p[1] <= 'z')
+					|| (p[1] >= 'A' && p[1] <= 'Z'))
+				break;
+			p++;
+		} else if(strchr(".[]()|*+?{}^$", *p) != NULL) {
+			break;
+		}
+		/* a quantifier allowing zero occurrences cancels the literal */
+		if(p + 1 < end && (p[1] == '?' || p[1] == '*' || p[1] == '{'))
+			break;
+		buf[n++] = *p;
+		if(p + 1 < end && p[1] == '+')
+			break;
+	}
+	return n;
+}
+
+/**
+ * literal prefix of a fnmatch pattern
+ */
+static int dpl_fnmatch_prefix(str *exp, char *buf)
+{
+	int n;
+
+	for(n = 0; n < exp->len && n < DP_PFX_MAX_LEN; n++) {
+		if(strchr("*?[\\", exp->s[n]) != NULL)
+			break;
+		buf[n] = exp->s[n];
+	}
+	return n;
+}
+
+/**
+ * literal prefix that any input matching the rule starts with
+ */
+static int dpl_rule_prefix(dpl_node_t *rule, char *buf)
+{
+	int n;
+
+	if(rule->tflags & DP_TFLAGS_PV_MATCH)
+		return 0;
+	switch(rule->matchop) {
+		case DP_EQUAL_OP:
+			if(rule->match_exp.s == NULL)
+				return 0;
+			n = (rule->match_exp.len < DP_PFX_MAX_LEN) ? rule->match_exp.len
+													   : DP_PFX_MAX_LEN;
+			memcpy(buf, rule->match_exp.s, n);
+			return n;
+		case DP_REGEX_OP:
+			return dpl_regex_prefix(&rule->match_exp, buf);
+		case DP_FNMATCH_OP:
+			if(rule->match_exp.s == NULL)
+				return 0;
+			return dpl_fnmatch_prefix(&rule->match_exp, buf);
+	}
+	return 0;
+}
+
+static dpl_pfx_node_t *dpl_pfx_node_get(dpl_pfx_node_t *node, unsigned char c)
+{
+	dpl_pfx_node_t *n;
+
+	for(n = node->child; n != NULL; n = n->next) {
+		if(n->c == c)
+			return n;
+	}
+	n = (dpl_pfx_node_t *)shm_malloc(sizeof(dpl_pfx_node_t));
+	if(n == NULL) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(n, 0, sizeof(dpl_pfx_node_t));
+	n->c = c;
+	n->next = node->child;
+	node->child = n;
+	return n;
+}
+
+static dpl_pfx_node_t *dpl_pfx_node_find(
+		dpl_pfx_node_t *node, char *pfx, int len)
+{
+	dpl_pfx_node_t *n;
+	int i;
+
+	for(i = 0; i < len && node != NULL; i++) {
+		for(n = node->child; n != NULL; n = n->next) {
+			if(n->c == (unsigned char)pfx[i])
+				break;
+		}
+		node = n;
+	}
+	return node;
+}
+
+static void dpl_pfx_node_free(dpl_pfx_node_t *node)
+{
+	dpl_pfx_node_t *n;
+
+	while(node->child != NULL) {
+		n = node->child;
+		node->child = n->next;
+		dpl_pfx_node_free(n);
+	}
+	if(node->rules != NULL)
+		shm_free(node->rules);
+	shm_free(node);
+}
+
+/**
+ * build the prefix index of the rules in the length bucket
+ */
+int dpl_pfx_index_build(dpl_index_p indexp)
+{
+	dpl_pfx_node_t *root;
+	dpl_pfx_node_t *node;
+	dpl_node_p rulep;
+	char buf[DP_PFX_MAX_LEN];
+	int nrules;
+	int len;
+	int i;
+	int k;
+
+	nrules = 0;
+	for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next)
+		nrules++;
+	if(nrules == 0)
+		return 0;
+
+	indexp->rules = (dpl_node_t **)shm_malloc(nrules * sizeof(dpl_node_t *));
+	root = (dpl_pfx_node_t *)shm_malloc(sizeof(dpl_pfx_node_t));
+	if(indexp->rules == NULL || root == NULL) {
+		SHM_MEM_ERROR;
+		goto error;
+	}
+	memset(root, 0, sizeof(dpl_pfx_node_t));
+	indexp->pfx = root;
+
+	/* first pass - create the nodes and count the rules of each */
+	for(i = 0, rulep = indexp->first_rule; rulep != NULL;
+			i++, rulep = rulep->next) {
+		indexp->rules[i] = rulep;
+		len = dpl_rule_prefix(rulep, buf);
+		node = root;
+		for(k = 0; k < len && node != NULL; k++)
+			node = dpl_pfx_node_get(node, (unsigned char)buf[k]);
+		if(node == NULL)
+			goto error;
+		node->nrules++;
+	}
+	/* second pass - fill in the rule positions */
+	for(i = 0; i < nrules; i++) {
+		len = dpl_rule_prefix(indexp->rules[i], buf);
+		node = dpl_pfx_node_find(root, buf, len);
+		if(node->rules == NULL) {
+			node->rules = (int *)shm_malloc(node->nrules * sizeof(int));
+			if(node->rules == NULL) {
+				SHM_MEM_ERROR;
+				goto error;
+			}
+			node->nrules = 0;
+		}
+		node->rules[node->nrules++] = i;
+	}
+	indexp->nrules = nrules;
+	LM_DBG("prefix index built for %d rules (len %d), %d without prefix\n",
+			nrules, indexp->len, root->nrules);
+	return 0;
+
+error:
+	dpl_pfx_index_destroy(indexp);
+	return -1;
+}
+
+void dpl_pfx_index_destroy(dpl_index_p indexp)
+{
+	if(indexp->pfx != NULL) {
+		dpl_pfx_node_free(indexp->pfx);
+		indexp->pfx = NULL;
+	}
+	if(indexp->rules != NULL) {
+		shm_free(indexp->rules);
+		indexp->rules = NULL;
+	}
+	indexp->nrules = 0;
+}
+
+/**
+ * collect the rule lists of the index nodes on the path of the input
+ */
+void dpl_pfx_iter_init(dpl_pfx_iter_t *it, dpl_index_p indexp, str *input)
+{
+	dpl_pfx_node_t *node;
+	dpl_pfx_node_t *n;
+	int i;
+
+	it->n = 0;
+	node = indexp->pfx;
+	for(i = 0; node != NULL; i++) {
+		if(node->nrules > 0) {
+			it->rules[it->n] = node->rules;
+			it->cnt[it->n] = node->nrules;
+			it->n++;
+		}
+		if(i >= input->len)
+			break;
+		for(n = node->child; n != NULL; n = n->next) {
+			if(n->c == (unsigned char)input->s[i])
+				break;
+		}
+		node = n;
+	}
+}
+
+/**
+ * next candidate rule position, merging the collected lists
+ * - returns -1 when there are no more candidates
+ */
+int dpl_pfx_iter_next(dpl_pfx_iter_t *it)
+{
+	int i;
+	int m;
+
+	m = -1;
+	for(i = 0; i < it->n; i++) {
+		if(it->cnt[i] > 0 && (m < 0 || it->rules[i][0] < it->rules[m][0]))
+			m = i;
+	}
+	if(m < 0)
+		return -1;
+	it->cnt[m]--;
+	return *(it->rules[m]++);
+}
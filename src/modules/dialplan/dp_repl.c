@@ -593,22 +593,106 @@ error:
 	return -1;
 }
 
-#define DP_MAX_ATTRS_LEN 255
-static char dp_attrs_buf[DP_MAX_ATTRS_LEN + 1];
-int dp_translate_helper(
-		sip_msg_t *msg, str *input, str *output, dpl_id_p idp, str *attrs)
+extern int dp_match_index;
+
+/**
+ * test if the input matches the rule
+ * - returns >=0 on match, -1 on no match, -2 on error
+ */
+static int dpl_rule_test(sip_msg_t *msg, str *input, dpl_node_p rulep,
+		pcre2_match_data *pcre_md)
+{
+	int rez;
+	char b;
+	dpl_dyn_pcre_p re_list = NULL;
+	dpl_dyn_pcre_p rt = NULL;
+
+	switch(rulep->matchop) {
+
+		case DP_REGEX_OP:
+			LM_DBG("regex operator testing over [%.*s]\n", input->len,
+					input->s);
+			if(rulep->tflags & DP_TFLAGS_PV_MATCH) {
+				re_list = dpl_dynamic_pcre_list(msg, &rulep->match_exp);
+				if(re_list == NULL) {
+					/* failed to compile dynamic pcre -- ignore */
+					LM_DBG("failed to compile dynamic pcre[%.*s]\n",
+							rulep->match_exp.len, rulep->match_exp.s);
+					return -1;
+				}
+				rez = -1;
+				do {
+					if(rez < 0) {
+						rez = pcre2_match(re_list->re, (PCRE2_SPTR)input->s,
+								(PCRE2_SIZE)input->len, 0, 0, pcre_md, NULL);
+						LM_DBG("match check: [%.*s] %d\n", re_list->expr.len,
+								re_list->expr.s, rez);
+					} else
+						LM_DBG("match check skipped: [%.*s] %d\n",
+								re_list->expr.len, re_list->expr.s, rez);
+					rt = re_list->next;
+					pcre2_code_free(re_list->re);
+					pkg_free(re_list);
+					re_list = rt;
+				} while(re_list);
+			} else {
+				rez = pcre2_match(rulep->match_comp, (PCRE2_SPTR)input->s,
+						(PCRE2_SIZE)input->len, 0, 0, pcre_md, 0);
+			}
+			break;
+
+		case DP_EQUAL_OP:
+			LM_DBG("equal operator testing\n");
+			if(rulep->match_exp.s == NULL
+					|| rulep->match_exp.len != input->len) {
+				rez = -1;
+			} else {
+				rez = strncmp(rulep->match_exp.s, input->s, input->len);
+				rez = (rez == 0) ? 0 : -1;
+			}
+			break;
+
+		case DP_FNMATCH_OP:
+			LM_DBG("fnmatch operator testing\n");
+			if(rulep->match_exp.s != NULL) {
+				b = input->s[input->len];
+				input->s[input->len] = '\0';
+				rez = fnmatch(rulep->match_exp.s, input->s, 0);
+				input->s[input->len] = b;
+				rez = (rez == 0) ? 0 : -1;
+			} else {
+				rez = -1;
+			}
+			break;
+
+		default:
+			LM_ERR("bogus match operator code %i\n", rulep->matchop);
+			return -2;
+	}
+	return (rez >= 0) ? rez : -1;
+}
+
+/**
+ * first rule in priority order matching the input
+ * - seq: if 1, test all rules sequentially, not only the candidates given
+ *   by the prefix index
+ * - tested: if not NULL, it is set to the number of tested rules
+ */
+dpl_node_p dpl_match_rule(
+		sip_msg_t *msg, str *input, dpl_id_p idp, int seq, int *tested)
 {
 	static pcre2_match_data *pcre_md = NULL;
 	dpl_node_p rulep;
 	dpl_index_p indexp;
+	dpl_pfx_iter_t it;
 	int user_len, rez;
-	char b;
-	dpl_dyn_pcre_p re_list = NULL;
-	dpl_dyn_pcre_p rt = NULL;
+	int pos;
 
+	if(tested)
+		*tested = 0;
 	if(!input || !input->s || !input->len) {
 		LM_WARN("invalid or empty input string to be matched\n");
-		return -1;
+		return NULL;
 	}
 
 	user_len = input->len;
@@ -618,84 +702,41 @@ int dp_translate_helper(
 
 	if(!indexp || (indexp != NULL && !indexp->first_rule)) {
 		LM_DBG("no rule for len %i\n", input->len);
-		return -1;
+		return NULL;
 	}
 
 	if(pcre_md == NULL) {
 		pcre_md = pcre2_match_data_create(MAX_REPLACE_WITH, NULL);
 		if(pcre_md == NULL) {
 			LM_ERR("failed to allocate pcre2_match_data\n");
-			return -1;
+			return NULL;
 		}
 	}
 
 search_rule:
-	for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next) {
-		switch(rulep->matchop) {
-
-			case DP_REGEX_OP:
-				LM_DBG("regex operator testing over [%.*s]\n", input->len,
-						input->s);
-				if(rulep->tflags & DP_TFLAGS_PV_MATCH) {
-					re_list = dpl_dynamic_pcre_list(msg, &rulep->match_exp);
-					if(re_list == NULL) {
-						/* failed to compile dynamic pcre -- ignore */
-						LM_DBG("failed to compile dynamic pcre[%.*s]\n",
-								rulep->match_exp.len, rulep->match_exp.s);
-						continue;
-					}
-					rez = -1;
-					do {
-						if(rez < 0) {
-							rez = pcre2_match(re_list->re, (PCRE2_SPTR)input->s,
-									(PCRE2_SIZE)input->len, 0, 0, pcre_md,
-									NULL);
-							LM_DBG("match check: [%.*s] %d\n",
-									re_list->expr.len, re_list->expr.s, rez);
-						} else
-							LM_DBG("match check skipped: [%.*s] %d\n",
-									re_list->expr.len, re_list->expr.s, rez);
-						rt = re_list->next;
-						pcre2_code_free(re_list->re);
-						pkg_free(re_list);
-						re_list = rt;
-					} while(re_list);
-				} else {
-					rez = pcre2_match(rulep->match_comp, (PCRE2_SPTR)input->s,
-							(PCRE2_SIZE)input->len, 0, 0, pcre_md, 0);
-				}
-				break;
-
-			case DP_EQUAL_OP:
-				LM_DBG("equal operator testing\n");
-				if(rulep->match_exp.s == NULL
-						|| rulep->match_exp.len != input->len) {
-					rez = -1;
-				} else {
-					rez = strncmp(rulep->match_exp.s, input->s, input->len);
-					rez = (rez == 0) ? 0 : -1;
-				}
-				break;
-
-			case DP_FNMATCH_OP:
-				LM_DBG("fnmatch operator testing\n");
-				if(rulep->match_exp.s != NULL) {
-					b = input->s[input->len];
-					input->s[input->len] = '\0';
-					rez = fnmatch(rulep->match_exp.s, input->s, 0);
-					input->s[input->len] = b;
-					rez = (rez == 0) ? 0 : -1;
-				} else {
-					rez = -1;
-				}
-				break;
-
-			default:
-				LM_ERR("bogus match operator code %i\n", rulep->matchop);
-				return -1;
+	if(!seq && indexp->pfx != NULL) {
+		/* only the rules with a literal prefix of the input */
+		dpl_pfx_iter_init(&it, indexp, input);
+		while((pos = dpl_pfx_iter_next(&it)) >= 0) {
+			rulep = indexp->rules[pos];
+			if(tested)
+				(*tested)++;
+			rez = dpl_rule_test(msg, input, rulep, pcre_md);
+			if(rez == -2)
+				return NULL;
+			if(rez >= 0)
+				return rulep;
+		}
+	} else {
+		for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next) {
+			if(tested)
+				(*tested)++;
+			rez = dpl_rule_test(msg, input, rulep, pcre_md);
+			if(rez == -2)
+				return NULL;
+			if(rez >= 0)
+				return rulep;
 		}
-		if(rez >= 0)
-			goto repl;
 	}
 	/*test the rules with len 0*/
 	if(indexp->len) {
@@ -707,9 +748,24 @@ search_rule:
 	}
 
 	LM_DBG("no matching rule\n");
-	return -1;
+	return NULL;
+}
+
+#define DP_MAX_ATTRS_LEN 255
+static char dp_attrs_buf[DP_MAX_ATTRS_LEN + 1];
+int dp_translate_helper(
+		sip_msg_t *msg, str *input, str *output, dpl_id_p idp, str *attrs)
+{
+	dpl_node_p rulep;
+	int rez;
+	dpl_dyn_pcre_p re_list = NULL;
+	dpl_dyn_pcre_p rt = NULL;
+
+	rulep = dpl_match_rule(msg, input, idp, dp_match_index ? 0 : 1, NULL);
+	if(rulep == NULL) {
+		return -1;
+	}
 
-repl:
 	LM_DBG("found a matching rule %p: pr %i, match_exp %.*s\n", rulep,
 			rulep->pr, rulep->match_exp.len, rulep->match_exp.s);
 
@@ -581,6 +581,9 @@ rt_data_t *dr_load_routing_info(db_func_t *dr_dbf, db1_con_t *db_hdl,
 	if(n == 0) {
 		LM_WARN("no valid routing rules -> discarding all destinations\n");
 		free_rt_data(rdata, 0);
+	} else if(build_ptree(rdata->pt) != 0) {
+		LM_ERR("failed to build the prefix index\n");
+		goto error;
 	}
 
 	return rdata;
@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 #include "../../core/mem/shm_mem.h"
+#include "../../core/atomic_ops.h"
 #include "dr_time.h"
 
 
@@ -1139,3 +1140,103 @@ int dr_check_byxxx(dr_tmrec_p _trp, dr_ac_tm_p _atp)
 
 	return REC_MATCH;
 }
+
+
+/**
+ * return the first time after _atp->time when the result of
+ * dr_check_tmrec() can change, 0 if it can not change anymore
+ *
+ * After the first interval, a day either matches or not as a whole and
+ * the time of the day has to be in the interval starting at the time of
+ * dtstart, so the result can change only at the start or at the end of
+ * that interval or at midnight.
+ */
+time_t dr_next_change(dr_tmrec_p _trp, dr_ac_tm_p _atp)
+{
+	struct tm _tm;
+	time_t _d, _t;
+	int _v0, _v1, _c;
+
+	if(!_trp || !_atp)
+		return 0;
+
+	if(_atp->time < _trp->dtstart)
+		return _trp->dtstart;
+
+	_d = _IS_SET(_trp->duration) ? _trp->duration
+								  : _trp->dtend - _trp->dtstart;
+	/* no duration or end -> for ever */
+	if(_d <= 0)
+		return 0;
+
+	if(_atp->time <= _trp->dtstart + _d)
+		return _trp->dtstart + _d + 1;
+
+	if(_IS_SET(_trp->until) && _atp->time >= _trp->until + _d)
+		return 0;
+
+	_v0 = _trp->ts.tm_hour * 3600 + _trp->ts.tm_min * 60 + _trp->ts.tm_sec;
+	_v1 = _atp->t.tm_hour * 3600 + _atp->t.tm_min * 60 + _atp->t.tm_sec;
+	if(_v1 < _v0)
+		_c = _v0;
+	else if(_v0 + _d < 86400 && _v1 < _v0 + _d)
+		_c = _v0 + _d;
+	else
+		_c = 86400;
+
+	/* the next midnight is normalized by mktime() */
+	_tm = _atp->t;
+	_tm.tm_hour = _c / 3600;
+	_tm.tm_min = (_c % 3600) / 60;
+	_tm.tm_sec = _c % 60;
+	_tm.tm_isdst = -1;
+	_t = mktime(&_tm);
+	/* the local time jumps on a daylight saving change, check again at
+	 * the next quarter of an hour */
+	if(_t == (time_t)-1 || _tm.tm_isdst != _atp->t.tm_isdst) {
+		if(_t == (time_t)-1 || _t > _atp->time - _atp->time % 900 + 900)
+			_t = _atp->time - _atp->time % 900 + 900;
+	}
+	if(_t <= _atp->time)
+		_t = _atp->time + 1;
+
+	if(_IS_SET(_trp->until) && _t > _trp->until + _d)
+		_t = _trp->until + _d;
+	return _t;
+}
+
+
+/**
+ * return the result of dr_check_tmrec() for the time _t, kept in the
+ * record until the next time it can change
+ *
+ * The record is in shared memory and updated without lock: the result is
+ * written before its time range, so a process seeing the new range sees
+ * the new result as well.
+ */
+int dr_check_tmrec_state(dr_tmrec_p _trp, time_t _t)
+{
+	dr_ac_tm_t _at;
+	time_t _from, _until;
+	int _ret;
+
+	_from = _trp->st.from;
+	_until = _trp->st.until;
+	membar_read();
+	if(_from > 0 && _t >= _from && (_until == 0 || _t < _until))
+		return _trp->st.match;
+
+	memset(&_at, 0, sizeof(dr_ac_tm_t));
+	if(dr_ac_tm_set_time(&_at, _t))
+		return REC_ERR;
+	_ret = dr_check_tmrec(_trp, &_at, 0);
+	if(_ret != REC_ERR) {
+		_until = dr_next_change(_trp, &_at);
+		_trp->st.match = _ret;
+		membar_write();
+		_trp->st.from = _t;
+		_trp->st.until = _until;
+	}
+
+	return _ret;
+}
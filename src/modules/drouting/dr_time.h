@@ -112,6 +112,14 @@ typedef struct _dr_tr_byxxx
 	int *req;
 } dr_tr_byxxx_t, *dr_tr_byxxx_p;
 
+/* result of a recurrence check and the time range it holds for */
+typedef struct _dr_tr_state
+{
+	int match;	  /* result of dr_check_tmrec() */
+	time_t from;  /* unset if 0 */
+	time_t until; /* excluded, 0 for ever */
+} dr_tr_state_t;
+
 typedef struct _dr_tmrec
 {
 	time_t dtstart;
@@ -127,6 +135,8 @@ typedef struct _dr_tmrec
 	dr_tr_byxxx_p bymonth;
 	dr_tr_byxxx_p byweekno;
 	int wkst;
+	/* result of the last check, shared by the processes */
+	dr_tr_state_t st;
 } dr_tmrec_t, *dr_tmrec_p;
 
 typedef struct _dr_tr_res
@@ -164,6 +174,8 @@ dr_tr_byxxx_p dr_ic_parse_byxxx(char *);
 int dr_ic_parse_wkst(char *);
 
 int dr_check_tmrec(dr_tmrec_p, dr_ac_tm_p, dr_tr_res_p);
+time_t dr_next_change(dr_tmrec_p, dr_ac_tm_p);
+int dr_check_tmrec_state(dr_tmrec_p, time_t);
 
 
 #endif
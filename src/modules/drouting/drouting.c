@@ -100,11 +100,6 @@ static struct _attrs_avp
 } attrs_avp = {0, {.n = (int)0xad346b30}};
 static str attrs_avp_spec = {0, 0};
 
-/* statistic data */
-int tree_size = 0;
-int inode = 0;
-int unode = 0;
-
 /* lock, ref counter and flag used for reloading the date */
 static gen_lock_t *ref_lock = 0;
 static int *data_refcnt = 0;
@@ -32,26 +32,16 @@
 #include "routing.h"
 #include "dr_time.h"
 
-extern int inode;
-extern int unode;
-
 
 static inline int check_time(dr_tmrec_t *time_rec)
 {
-	dr_ac_tm_t att;
-
 	/* shortcut: if there is no dstart, timerec is valid */
 	if(time_rec->dtstart == 0)
 		return 1;
 
-	memset(&att, 0, sizeof(att));
-
-	/* set current time */
-	if(dr_ac_tm_set_time(&att, time(0)))
-		return 0;
-
-	/* does the recv_time match the specified interval?  */
-	if(dr_check_tmrec(time_rec, &att, 0) != 0)
+	/* does the current time match the specified interval? the result
+	 * is computed again only after its next possible change */
+	if(dr_check_tmrec_state(time_rec, time(0)) != 0)
 		return 0;
 
 	return 1;
@@ -95,48 +85,25 @@ rt_info_t *check_rt(ptree_node_t *ptn, unsigned int rgid)
 rt_info_t *get_prefix(ptree_t *ptree, str *prefix, unsigned int rgid)
 {
 	rt_info_t *rt = NULL;
-	char *tmp = NULL;
-	int idx = 0;
+	ptree_node_t *ptn = NULL;
+	int len = 0;
+	int mlen = 0;
 
-	if(NULL == ptree)
-		goto err_exit;
+	if(NULL == ptree || NULL == ptree->index)
+		return NULL;
 	if(NULL == prefix || NULL == prefix->s)
-		goto err_exit;
-	tmp = prefix->s;
-	/* go the tree down to the last digit in the
-	 * prefix string or down to a leaf */
-	while(tmp < (prefix->s + prefix->len)) {
-		idx = get_node_index(*tmp);
-		if(idx == -1) {
-			/* unknown character in the prefix string */
-			goto err_exit;
-		}
-		if(tmp == (prefix->s + prefix->len - 1)) {
-			/* last digit in the prefix string */
-			break;
-		}
-		if(NULL == ptree->ptnode[idx].next) {
-			/* this is a leaf */
-			break;
-		}
-		ptree = ptree->ptnode[idx].next;
-		tmp++;
-	}
-	/* go in the tree up to the root trying to match the prefix */
-	while(ptree != NULL) {
-		/* is it a real node or an intermediate one */
-		idx = get_node_index(*tmp);
-		if(idx != -1 && NULL != ptree->ptnode[idx].rg) {
-			/* real node; check the constraints on the routing info*/
-			if(NULL != (rt = internal_check_rt(&(ptree->ptnode[idx]), rgid)))
-				break;
-		}
-		tmp--;
-		ptree = ptree->bp;
+		return NULL;
+	/* try the prefixes of the string from the longest one, until the
+	 * constraints on the routing info are matched */
+	len = prefix->len;
+	while(len > 0
+			&& NULL
+					   != (ptn = (ptree_node_t *)pfx_index_longest(
+								   ptree->index, prefix->s, len, &mlen))) {
+		if(NULL != (rt = internal_check_rt(ptn, rgid)))
+			return rt;
+		len = mlen - 1;
 	}
-	return rt;
-
-err_exit:
 	return NULL;
 }
 
@@ -156,77 +123,103 @@ err_exit:
 }
 
 
+ptree_t *new_ptree(void)
+{
+	ptree_t *ptree = NULL;
+
+	ptree = (ptree_t *)shm_malloc(sizeof(ptree_t));
+	if(NULL == ptree) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memset(ptree, 0, sizeof(ptree_t));
+	ptree->builder = pfx_builder_new();
+	if(NULL == ptree->builder) {
+		shm_free(ptree);
+		return NULL;
+	}
+	return ptree;
+}
+
+
 int add_prefix(ptree_t *ptree, str *prefix, rt_info_t *r, unsigned int rg)
 {
-	char *tmp = NULL;
-	int res = 0;
-	if(NULL == ptree)
+	ptree_node_t **ptn = NULL;
+	int i = 0;
+
+	if(NULL == ptree || NULL == ptree->builder)
 		goto err_exit;
-	tmp = prefix->s;
-	while(tmp < (prefix->s + prefix->len)) {
-		if(NULL == tmp)
-			goto err_exit;
-		int insert_index = get_node_index(*tmp);
-		if(insert_index == -1) {
+	if(prefix->len > PFX_KEY_MAX) {
+		LM_ERR("prefix too long (%d)\n", prefix->len);
+		goto err_exit;
+	}
+	for(i = 0; i < prefix->len; i++) {
+		if(get_node_index(prefix->s[i]) == -1) {
 			/* unknown character in the prefix string */
 			goto err_exit;
 		}
-		if(tmp == (prefix->s + prefix->len - 1)) {
-			/* last symbol in the prefix string */
-
-			LM_DBG("adding info %p, %d at: "
-				   "%p (%d)\n",
-					r, rg, &(ptree->ptnode[insert_index]), insert_index);
-			res = add_rt_info(&(ptree->ptnode[insert_index]), r, rg);
-			if(res < 0)
-				goto err_exit;
-			unode++;
-			res = 1;
-			goto ok_exit;
-		}
-		/* process the current symbol in the prefix */
-		if(NULL == ptree->ptnode[insert_index].next) {
-			/* allocate new node */
-			INIT_PTREE_NODE(ptree, ptree->ptnode[insert_index].next);
-			inode += PTREE_CHILDREN;
-#if 0
-			printf("new tree node: %p (bp: %p)\n",
-					ptree->ptnode[insert_index].next,
-					ptree->ptnode[insert_index].next->bp
-					);
-#endif
-		}
-		ptree = ptree->ptnode[insert_index].next;
-		tmp++;
 	}
+	if(prefix->len == 0)
+		return 0;
 
-ok_exit:
+	ptn = (ptree_node_t **)pfx_builder_slot(
+			ptree->builder, prefix->s, prefix->len);
+	if(NULL == ptn)
+		goto err_exit;
+	if(NULL == *ptn) {
+		*ptn = (ptree_node_t *)shm_malloc(sizeof(ptree_node_t));
+		if(NULL == *ptn) {
+			SHM_MEM_ERROR;
+			goto err_exit;
+		}
+		memset(*ptn, 0, sizeof(ptree_node_t));
+	}
+	LM_DBG("adding info %p, %d at: %p\n", r, rg, *ptn);
+	if(add_rt_info(*ptn, r, rg) < 0)
+		goto err_exit;
 	return 0;
 
 err_exit:
 	return -1;
 }
 
+
+int build_ptree(ptree_t *ptree)
+{
+	if(NULL == ptree || NULL == ptree->builder)
+		return 0;
+	ptree->index = pfx_index_build(ptree->builder);
+	if(NULL == ptree->index)
+		return -1;
+	pfx_builder_free(ptree->builder, NULL);
+	ptree->builder = NULL;
+	return 0;
+}
+
+
+static void free_ptree_node(void *p)
+{
+	ptree_node_t *ptn = (ptree_node_t *)p;
+	int j;
+
+	if(NULL != ptn->rg) {
+		for(j = 0; j < ptn->rg_pos; j++) {
+			/* if non intermediate delete the routing info */
+			if(ptn->rg[j].rtlw != NULL)
+				del_rt_list(ptn->rg[j].rtlw);
+		}
+		shm_free(ptn->rg);
+	}
+	shm_free(ptn);
+}
+
+
 int del_tree(ptree_t *t)
 {
-	int i, j;
 	if(NULL == t)
 		goto exit;
-	/* delete all the children */
-	for(i = 0; i < PTREE_CHILDREN; i++) {
-		/* shm_free the rg array of rt_info */
-		if(NULL != t->ptnode[i].rg) {
-			for(j = 0; j < t->ptnode[i].rg_pos; j++) {
-				/* if non intermediate delete the routing info */
-				if(t->ptnode[i].rg[j].rtlw != NULL)
-					del_rt_list(t->ptnode[i].rg[j].rtlw);
-			}
-			shm_free(t->ptnode[i].rg);
-		}
-		/* if non leaf delete all the children */
-		if(t->ptnode[i].next != NULL)
-			del_tree(t->ptnode[i].next);
-	}
+	pfx_builder_free(t->builder, free_ptree_node);
+	pfx_index_free(t->index, free_ptree_node);
 	shm_free(t);
 exit:
 	return 0;
@@ -27,23 +27,10 @@
 
 #include "../../core/str.h"
 #include "../../core/ip_addr.h"
+#include "../../lib/pfxidx/pfxidx.h"
 #include "../keepalive/api.h"
 #include "dr_time.h"
 
-#define PTREE_CHILDREN 13 //decimal digits, '*', '#',  '+'
-
-extern int tree_size;
-
-#define INIT_PTREE_NODE(p, n)                         \
-	do {                                              \
-		(n) = (ptree_t *)shm_malloc(sizeof(ptree_t)); \
-		if(NULL == (n))                               \
-			goto err_exit;                            \
-		tree_size += sizeof(ptree_t);                 \
-		memset((n), 0, sizeof(ptree_t));              \
-		(n)->bp = (p);                                \
-	} while(0);
-
 
 /* list of PSTN gw */
 typedef struct pgw_addr_
@@ -113,15 +100,21 @@ typedef struct ptree_node_
 	struct ptree_ *next;
 } ptree_node_t;
 
+/* the rules are collected per prefix (ptree_node_t) in the builder while
+ * loading, then the builder is compiled into the read-only index used by
+ * the lookups */
 typedef struct ptree_
 {
-	/* backpointer */
-	struct ptree_ *bp;
-	ptree_node_t ptnode[PTREE_CHILDREN];
+	pfx_builder_t *builder;
+	pfx_index_t *index;
 } ptree_t;
 
 void print_interim(int, int, ptree_t *);
 
+ptree_t *new_ptree(void);
+
+int build_ptree(ptree_t *);
+
 int del_tree(ptree_t *);
 
 int add_prefix(ptree_t *,
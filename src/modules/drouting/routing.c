@@ -50,7 +50,10 @@ rt_data_t *build_rt_data(void)
 	}
 	memset(rdata, 0, sizeof(rt_data_t));
 
-	INIT_PTREE_NODE(NULL, rdata->pt);
+	if(NULL == (rdata->pt = new_ptree())) {
+		shm_free(rdata);
+		goto err_exit;
+	}
 
 	return rdata;
 err_exit:
@@ -1954,6 +1954,7 @@ static void htable_rpc_dump(rpc_t *rpc, void *c)
 	ht_t *ht;
 	ht_cell_t *it;
 	int i;
+	int stream;
 	void *th;
 	void *ih;
 	void *vh;
@@ -1967,6 +1968,7 @@ static void htable_rpc_dump(rpc_t *rpc, void *c)
 		rpc->fault(c, 500, "No such htable");
 		return;
 	}
+	stream = rpc_stream_enabled(rpc, c);
 	for(i = 0; i < ht->htsize; i++) {
 		ht_slot_lock(ht, i);
 		it = ht->entries[i].first;
@@ -2006,6 +2008,11 @@ static void htable_rpc_dump(rpc_t *rpc, void *c)
 			}
 		}
 		ht_slot_unlock(ht, i);
+		/* send the slots dumped so far, outside of the lock */
+		if(stream && rpc->flush(c) < 0) {
+			LM_DBG("rpc client gone - stopping the dump\n");
+			return;
+		}
 	}
 
 	return;
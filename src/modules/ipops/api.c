@@ -27,6 +27,7 @@
 
 #include "api.h"
 #include "ip_parser.h"
+#include "ip_set.h"
 
 extern int _compare_ips(
 		char *, size_t, enum enum_ip_type, char *, size_t, enum enum_ip_type);
@@ -145,6 +146,7 @@ int bind_ipops(ipops_api_t *api)
 	api->compare_ips = ipopsapi_compare_ips;
 	api->ip_is_in_subnet = ipopsapi_ip_is_in_subnet;
 	api->is_ip = ipopsapi_is_ip;
+	api->ip_set_match = ip_set_match;
 
 	return 0;
 }
@@ -38,6 +38,8 @@ int ipopsapi_ip_is_in_subnet(const str *const ip1, const str *const ip2);
 
 typedef int (*is_ip_f)(const str *const ip);
 int ipopsapi_is_ip(const str *const ip);
+
+typedef int (*ip_set_match_f)(str *name, str *ip);
 /**
  * @brief IPOPS API structure
  */
@@ -46,6 +48,7 @@ typedef struct ipops_api
 	compare_ips_f compare_ips;
 	ip_is_in_subnet_f ip_is_in_subnet;
 	is_ip_f is_ip;
+	ip_set_match_f ip_set_match;
 } ipops_api_t;
 
 typedef int (*bind_ipops_f)(ipops_api_t *api);
@@ -0,0 +1,546 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief ipops :: Named sets of IP networks
+ * \ingroup ipops
+ * Module: \ref ipops
+ *
+ * The networks of a set are kept in a read-only index. A change builds a
+ * new index from the file or from the networks of the current one and
+ * swaps it in. The lookups do not lock, they pin the index generation in
+ * the slot of their process and the replaced index is freed once no process
+ * pins an older generation. The changes are serialized by a module wide
+ * lock.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/parser/parse_param.h"
+#include "../../core/resolve.h"
+#include "../../core/dprint.h"
+#include "../../core/trim.h"
+#include "../../core/ut.h"
+#include "../../core/shm_init.h"
+
+#include "ip_set.h"
+
+/* value of the networks in the index, only NULL is special */
+#define IP_SET_VALUE ((void *)1)
+#define IP_SET_LINE_SIZE 512
+#define IP_SET_NET_SIZE (IP_ADDR_MAX_STR_SIZE + 4)
+
+static ip_set_t *_ip_sets = NULL;
+static gen_lock_t *_ip_set_wlock = NULL;
+static ipidx_guard_t *_ip_set_guard = NULL;
+
+
+int ip_set_param(modparam_t type, void *val)
+{
+	param_t *params_list = NULL;
+	param_hooks_t phooks;
+	param_t *pit;
+	ip_set_t *set;
+	str name = STR_NULL;
+	str file = STR_NULL;
+	str s;
+
+	if(val == NULL)
+		return -1;
+	if(!shm_initialized()) {
+		LM_ERR("shm not initialized - cannot define ip set now\n");
+		return -1;
+	}
+
+	s.s = (char *)val;
+	s.len = strlen(s.s);
+	if(s.len > 0 && s.s[s.len - 1] == ';')
+		s.len--;
+	if(parse_params(&s, CLASS_ANY, &phooks, &params_list) < 0) {
+		LM_ERR("invalid ip set definition [%.*s]\n", s.len, s.s);
+		return -1;
+	}
+	for(pit = params_list; pit; pit = pit->next) {
+		if(pit->name.len == 4 && strncasecmp(pit->name.s, "name", 4) == 0) {
+			name = pit->body;
+		} else if(pit->name.len == 4
+				  && strncasecmp(pit->name.s, "file", 4) == 0) {
+			file = pit->body;
+		} else {
+			LM_ERR("unknown ip set attribute [%.*s]\n", pit->name.len,
+					pit->name.s);
+			goto error;
+		}
+	}
+	if(name.len <= 0) {
+		LM_ERR("ip set without name [%.*s]\n", s.len, s.s);
+		goto error;
+	}
+	if(ip_set_get(&name) != NULL) {
+		LM_ERR("duplicate ip set [%.*s]\n", name.len, name.s);
+		goto error;
+	}
+
+	set = (ip_set_t *)shm_malloc(sizeof(ip_set_t) + name.len + file.len + 2);
+	if(set == NULL) {
+		SHM_MEM_ERROR;
+		goto error;
+	}
+	memset(set, 0, sizeof(ip_set_t));
+	set->name.s = (char *)(set + 1);
+	memcpy(set->name.s, name.s, name.len);
+	set->name.len = name.len;
+	set->name.s[name.len] = '\0';
+	set->file.s = set->name.s + name.len + 1;
+	if(file.len > 0)
+		memcpy(set->file.s, file.s, file.len);
+	set->file.len = file.len;
+	set->file.s[file.len] = '\0';
+	set->next = _ip_sets;
+	_ip_sets = set;
+
+	free_params(params_list);
+	return 0;
+
+error:
+	free_params(params_list);
+	return -1;
+}
+
+
+ip_set_t *ip_set_get(str *name)
+{
+	ip_set_t *set;
+
+	for(set = _ip_sets; set != NULL; set = set->next) {
+		if(set->name.len == name->len
+				&& strncmp(set->name.s, name->s, name->len) == 0)
+			return set;
+	}
+	return NULL;
+}
+
+
+/**
+ * add the networks of the file of a set to a builder, one per line
+ */
+static int ip_set_load_file(ip_set_t *set, ipidx_builder_t *b)
+{
+	char line[IP_SET_LINE_SIZE];
+	FILE *f;
+	char *p;
+	str s;
+	int n;
+
+	f = fopen(set->file.s, "r");
+	if(f == NULL) {
+		LM_ERR("cannot open file [%s] of ip set [%.*s]\n", set->file.s,
+				set->name.len, set->name.s);
+		return -1;
+	}
+	for(n = 1; fgets(line, IP_SET_LINE_SIZE, f) != NULL; n++) {
+		p = strchr(line, '#');
+		if(p != NULL)
+			*p = '\0';
+		s.s = line;
+		s.len = strlen(line);
+		trim(&s);
+		if(s.len == 0)
+			continue;
+		if(ipidx_builder_add(b, &s, IP_SET_VALUE) < 0) {
+			LM_ERR("invalid network at %s:%d\n", set->file.s, n);
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+
+/**
+ * build the index of a builder and make it the current one of the set
+ */
+static int ip_set_swap(ip_set_t *set, ipidx_builder_t *b)
+{
+	ipidx_t *idx;
+	ipidx_t *old;
+
+	idx = ipidx_build(b);
+	ipidx_builder_free(b, NULL);
+	if(idx == NULL) {
+		LM_ERR("cannot build the index of ip set [%.*s]\n", set->name.len,
+				set->name.s);
+		return -1;
+	}
+	old = set->idx;
+	membar_write();
+	set->idx = idx;
+	/* wait for the lookups that can still walk the old index */
+	ipidx_guard_sync(_ip_set_guard);
+	ipidx_free(old, NULL);
+
+	LM_DBG("ip set [%.*s] has %u networks\n", set->name.len, set->name.s,
+			ipidx_count(idx));
+	return 0;
+}
+
+
+/**
+ * load the file of a set, the caller holds the module lock
+ */
+static int ip_set_reload(ip_set_t *set)
+{
+	ipidx_builder_t *b;
+
+	b = ipidx_builder_new();
+	if(b == NULL)
+		return -1;
+	if(set->file.len > 0 && ip_set_load_file(set, b) < 0) {
+		ipidx_builder_free(b, NULL);
+		return -1;
+	}
+	return ip_set_swap(set, b);
+}
+
+
+static int ip_set_copy_net(ip_addr_t *net, int bitlen, void *value, void *p)
+{
+	void **slot;
+
+	slot = ipidx_builder_slot((ipidx_builder_t *)p, net, bitlen);
+	if(slot == NULL)
+		return -1;
+	*slot = value;
+	return 0;
+}
+
+
+/**
+ * add or remove one network of a set, the caller holds the module lock
+ * \return 0 on success, -1 on errors, -2 if the network to remove is not
+ * in the set
+ */
+static int ip_set_update(ip_set_t *set, str *s, int add)
+{
+	ipidx_builder_t *b;
+	ip_addr_t net;
+	void **slot;
+	int bitlen;
+
+	if(ipidx_parse_net(s, &net, &bitlen) < 0) {
+		LM_ERR("invalid network [%.*s]\n", s->len, s->s);
+		return -1;
+	}
+	/* only the module lock holders replace the index */
+	if(!add && ipidx_exact(set->idx, &net, bitlen) == NULL)
+		return -2;
+	b = ipidx_builder_new();
+	if(b == NULL)
+		return -1;
+	if(ipidx_walk(set->idx, ip_set_copy_net, b) != 0)
+		goto error;
+	slot = ipidx_builder_slot(b, &net, bitlen);
+	if(slot == NULL)
+		goto error;
+	*slot = add ? IP_SET_VALUE : NULL;
+	return ip_set_swap(set, b);
+
+error:
+	ipidx_builder_free(b, NULL);
+	return -1;
+}
+
+
+int ip_set_init(void)
+{
+	ip_set_t *set;
+
+	_ip_set_wlock = lock_alloc();
+	if(_ip_set_wlock == NULL) {
+		LM_ERR("cannot allocate the ip set lock\n");
+		return -1;
+	}
+	lock_init(_ip_set_wlock);
+	_ip_set_guard = ipidx_guard_new();
+	if(_ip_set_guard == NULL) {
+		LM_ERR("cannot allocate the ip set guard\n");
+		return -1;
+	}
+	for(set = _ip_sets; set != NULL; set = set->next) {
+		if(ip_set_reload(set) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+
+void ip_set_destroy(void)
+{
+	ip_set_t *set;
+
+	while(_ip_sets != NULL) {
+		set = _ip_sets;
+		_ip_sets = set->next;
+		ipidx_free(set->idx, NULL);
+		shm_free(set);
+	}
+	ipidx_guard_free(_ip_set_guard);
+	_ip_set_guard = NULL;
+	if(_ip_set_wlock != NULL) {
+		lock_destroy(_ip_set_wlock);
+		lock_dealloc(_ip_set_wlock);
+		_ip_set_wlock = NULL;
+	}
+}
+
+
+static int ip_set_match_addr(ip_set_t *set, ip_addr_t *ip, int *bitlen)
+{
+	void *value;
+
+	ipidx_guard_pin(_ip_set_guard);
+	value = ipidx_match(set->idx, ip, bitlen);
+	ipidx_guard_unpin(_ip_set_guard);
+
+	return (value != NULL) ? 1 : -1;
+}
+
+
+int ip_set_match(str *name, str *ip)
+{
+	ip_set_t *set;
+	ip_addr_t addr;
+	str s;
+
+	set = ip_set_get(name);
+	if(set == NULL) {
+		LM_ERR("ip set [%.*s] not found\n", name->len, name->s);
+		return -2;
+	}
+	s = *ip;
+	trim(&s);
+	if(s.len <= 0 || str2ipxbuf(&s, &addr) < 0) {
+		LM_ERR("invalid ip address [%.*s]\n", ip->len, ip->s);
+		return -2;
+	}
+	return ip_set_match_addr(set, &addr, NULL);
+}
+
+
+/*
+ * RPC commands
+ */
+
+static void ip_set_net2a(ip_addr_t *net, int bitlen, char *buf)
+{
+	snprintf(buf, IP_SET_NET_SIZE, "%s/%d", ip_addr2a(net), bitlen);
+}
+
+
+static ip_set_t *ip_set_rpc_get(rpc_t *rpc, void *ctx, str *name)
+{
+	ip_set_t *set;
+
+	if(rpc->scan(ctx, "S", name) < 1) {
+		rpc->fault(ctx, 400, "Set name expected");
+		return NULL;
+	}
+	set = ip_set_get(name);
+	if(set == NULL)
+		rpc->fault(ctx, 404, "Set not found");
+	return set;
+}
+
+
+static const char *ip_set_rpc_reload_doc[2] = {
+		"Reload the networks of an ip set from its file", 0};
+
+static void ip_set_rpc_reload(rpc_t *rpc, void *ctx)
+{
+	ip_set_t *set;
+	str name;
+	int ret;
+
+	set = ip_set_rpc_get(rpc, ctx, &name);
+	if(set == NULL)
+		return;
+	lock_get(_ip_set_wlock);
+	ret = ip_set_reload(set);
+	lock_release(_ip_set_wlock);
+	if(ret < 0)
+		rpc->fault(ctx, 500, "Reload failed");
+}
+
+
+static void ip_set_rpc_update(rpc_t *rpc, void *ctx, int add)
+{
+	ip_set_t *set;
+	str name;
+	str net;
+	int ret;
+
+	set = ip_set_rpc_get(rpc, ctx, &name);
+	if(set == NULL)
+		return;
+	if(rpc->scan(ctx, "S", &net) < 1) {
+		rpc->fault(ctx, 400, "Network expected");
+		return;
+	}
+	lock_get(_ip_set_wlock);
+	ret = ip_set_update(set, &net, add);
+	lock_release(_ip_set_wlock);
+	if(ret == -2)
+		rpc->fault(ctx, 404, "Network not found");
+	else if(ret < 0)
+		rpc->fault(ctx, 500, "Update failed");
+}
+
+
+static const char *ip_set_rpc_add_doc[2] = {
+		"Add a network to an ip set until its next reload", 0};
+
+static void ip_set_rpc_add(rpc_t *rpc, void *ctx)
+{
+	ip_set_rpc_update(rpc, ctx, 1);
+}
+
+
+static const char *ip_set_rpc_del_doc[2] = {
+		"Remove a network from an ip set until its next reload", 0};
+
+static void ip_set_rpc_del(rpc_t *rpc, void *ctx)
+{
+	ip_set_rpc_update(rpc, ctx, 0);
+}
+
+
+typedef struct ip_set_rpc_list
+{
+	rpc_t *rpc;
+	void *ctx;
+	void *th;
+} ip_set_rpc_list_t;
+
+
+static int ip_set_rpc_list_net(ip_addr_t *net, int bitlen, void *value, void *p)
+{
+	ip_set_rpc_list_t *l;
+	char buf[IP_SET_NET_SIZE];
+
+	l = (ip_set_rpc_list_t *)p;
+	ip_set_net2a(net, bitlen, buf);
+	if(l->rpc->array_add(l->th, "s", buf) < 0) {
+		l->rpc->fault(l->ctx, 500, "Internal error adding network");
+		return -1;
+	}
+	return 0;
+}
+
+
+static const char *ip_set_rpc_list_doc[2] = {
+		"List the networks of an ip set", 0};
+
+static void ip_set_rpc_list(rpc_t *rpc, void *ctx)
+{
+	ip_set_rpc_list_t l;
+	ip_set_t *set;
+	void *th;
+	str name;
+
+	set = ip_set_rpc_get(rpc, ctx, &name);
+	if(set == NULL)
+		return;
+	if(rpc->add(ctx, "{", &th) < 0) {
+		rpc->fault(ctx, 500, "Internal error root reply");
+		return;
+	}
+	/* the index is not replaced while the module lock is held */
+	lock_get(_ip_set_wlock);
+	if(rpc->struct_add(th, "SSu[", "name", &set->name, "file", &set->file,
+			   "count", ipidx_count(set->idx), "networks", &l.th)
+			< 0) {
+		lock_release(_ip_set_wlock);
+		rpc->fault(ctx, 500, "Internal error set structure");
+		return;
+	}
+	l.rpc = rpc;
+	l.ctx = ctx;
+	ipidx_walk(set->idx, ip_set_rpc_list_net, &l);
+	lock_release(_ip_set_wlock);
+}
+
+
+static const char *ip_set_rpc_match_doc[2] = {
+		"Find the longest network of an ip set matching an address", 0};
+
+static void ip_set_rpc_match(rpc_t *rpc, void *ctx)
+{
+	char buf[IP_SET_NET_SIZE];
+	ip_addr_t addr;
+	ip_set_t *set;
+	str name;
+	str ip;
+	int bitlen;
+	int i;
+	void *th;
+
+	set = ip_set_rpc_get(rpc, ctx, &name);
+	if(set == NULL)
+		return;
+	if(rpc->scan(ctx, "S", &ip) < 1) {
+		rpc->fault(ctx, 400, "Address expected");
+		return;
+	}
+	if(str2ipxbuf(&ip, &addr) < 0) {
+		rpc->fault(ctx, 400, "Invalid address");
+		return;
+	}
+	if(ip_set_match_addr(set, &addr, &bitlen) < 0) {
+		rpc->fault(ctx, 404, "No match");
+		return;
+	}
+	/* clear the host bits of the address */
+	for(i = bitlen; i < addr.len * 8; i++)
+		addr.u.addr[i >> 3] &= ~(0x80 >> (i & 7));
+	ip_set_net2a(&addr, bitlen, buf);
+	if(rpc->add(ctx, "{", &th) < 0) {
+		rpc->fault(ctx, 500, "Internal error root reply");
+		return;
+	}
+	rpc->struct_add(th, "Ss", "name", &set->name, "network", buf);
+}
+
+
+/* clang-format off */
+rpc_export_t ip_set_rpc[] = {
+	{"ipops.ip_set_reload", ip_set_rpc_reload, ip_set_rpc_reload_doc, 0},
+	{"ipops.ip_set_add", ip_set_rpc_add, ip_set_rpc_add_doc, 0},
+	{"ipops.ip_set_del", ip_set_rpc_del, ip_set_rpc_del_doc, 0},
+	{"ipops.ip_set_list", ip_set_rpc_list, ip_set_rpc_list_doc, 0},
+	{"ipops.ip_set_match", ip_set_rpc_match, ip_set_rpc_match_doc, 0},
+	{0, 0, 0, 0}
+};
+/* clang-format on */
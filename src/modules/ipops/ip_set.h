@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief ipops :: Named sets of IP networks
+ * \ingroup ipops
+ * Module: \ref ipops
+ */
+
+#ifndef _IPOPS_IP_SET_H_
+#define _IPOPS_IP_SET_H_
+
+#include "../../core/str.h"
+#include "../../core/locking.h"
+#include "../../core/sr_module.h"
+#include "../../core/rpc.h"
+#include "../../lib/ipidx/ipidx.h"
+
+typedef struct ip_set
+{
+	str name;
+	str file;		  /*!< networks loaded on startup and reload */
+	ipidx_t *idx;	  /*!< current networks, replaced by the rebuilds */
+	struct ip_set *next;
+} ip_set_t;
+
+/*!
+ * \brief Adds a set from the ip_set modparam, "name=...;file=..."
+ * \return 0 on success, -1 otherwise
+ */
+int ip_set_param(modparam_t type, void *val);
+
+/*!
+ * \brief Loads the files of the sets
+ * \return 0 on success, -1 otherwise
+ */
+int ip_set_init(void);
+
+void ip_set_destroy(void);
+
+ip_set_t *ip_set_get(str *name);
+
+/*!
+ * \brief Matches an address against a set
+ * \return 1 if a network of the set contains the address, -1 if none does
+ * and -2 on errors
+ */
+int ip_set_match(str *name, str *ip);
+
+extern rpc_export_t ip_set_rpc[];
+
+#endif
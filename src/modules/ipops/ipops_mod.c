@@ -54,6 +54,7 @@
 #include "ip_parser.h"
 #include "rfc1918_parser.h"
 #include "detailed_ip_type.h"
+#include "ip_set.h"
 
 MODULE_VERSION
 
@@ -113,7 +114,9 @@ static int w_ptr_query(sip_msg_t *msg, char *str1, char *str2);
 static int w_srv_query(sip_msg_t *msg, char *str1, char *str2);
 static int w_naptr_query(sip_msg_t *msg, char *str1, char *str2);
 static int w_dns_set_local_ttl(sip_msg_t *, char *, char *);
+static int w_ip_set_match(sip_msg_t *, char *, char *);
 static int mod_init(void);
+static void mod_destroy(void);
 
 /* clang-format off */
 static pv_export_t mod_pvs[] = {
@@ -174,12 +177,23 @@ static cmd_export_t cmds[] = {
 			fixup_free_spve_spve, ANY_ROUTE},
 	{"dns_set_local_ttl", (cmd_function)w_dns_set_local_ttl, 1,
 			fixup_igp_null, fixup_free_igp_null, ANY_ROUTE},
+	{"ip_set_match", (cmd_function)w_ip_set_match, 2, fixup_spve_spve,
+			fixup_free_spve_spve, ANY_ROUTE},
 
 	{"bind_ipops", (cmd_function)bind_ipops, 0, 0, 0, 0},
 
 	{0, 0, 0, 0, 0, 0}
 };
 
+/*
+ * Exported parameters
+ */
+static param_export_t params[] = {
+	{"ip_set", PARAM_STRING | PARAM_USE_FUNC, (void *)ip_set_param},
+
+	{0, 0, 0}
+};
+
 /*
  * Module interface
  */
@@ -187,13 +201,13 @@ struct module_exports exports = {
 	"ipops",		 /* module name */
 	DEFAULT_DLFLAGS, /* dlopen flags */
 	cmds,			 /* cmd (cfg function) exports */
-	0,				 /* param exports*/
-	0,				 /* RPC method exports */
+	params,			 /* param exports*/
+	ip_set_rpc,		 /* RPC method exports */
 	mod_pvs,		 /* exported pseudo-variables */
 	0,				 /* response handling function */
 	mod_init,		 /* module init function */
 	0,				 /* per-child init function */
-	0				 /* module destroy function */
+	mod_destroy		 /* module destroy function */
 };
 /* clang-format on */
 
@@ -203,9 +217,18 @@ static int mod_init(void)
 	 * so no need to transform each ip to host order before comparing */
 	ipv4ranges_hton();
 	ipv6ranges_hton();
+	if(ip_set_init() < 0) {
+		LM_ERR("failed to load the ip sets\n");
+		return -1;
+	}
 	return 0;
 }
 
+static void mod_destroy(void)
+{
+	ip_set_destroy();
+}
+
 
 /* Fixup functions */
 
@@ -1431,6 +1454,34 @@ static int w_dns_set_local_ttl(sip_msg_t *msg, char *pttl, char *p2)
 	return ki_dns_set_local_ttl(msg, vttl);
 }
 
+/**
+ *
+ */
+static int ki_ip_set_match(sip_msg_t *msg, str *name, str *ip)
+{
+	return ip_set_match(name, ip);
+}
+
+/**
+ *
+ */
+static int w_ip_set_match(sip_msg_t *msg, char *pname, char *pip)
+{
+	str name;
+	str ip;
+
+	if(fixup_get_svalue(msg, (gparam_t *)pname, &name) < 0) {
+		LM_ERR("cannot get the ip set name\n");
+		return -1;
+	}
+	if(fixup_get_svalue(msg, (gparam_t *)pip, &ip) < 0) {
+		LM_ERR("cannot get the ip address\n");
+		return -1;
+	}
+
+	return ki_ip_set_match(msg, &name, &ip);
+}
+
 /**
  *
  */
@@ -1541,6 +1592,11 @@ static sr_kemi_t sr_kemi_ipops_exports[] = {
 		{ SR_KEMIP_INT, SR_KEMIP_NONE, SR_KEMIP_NONE,
 			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
 	},
+	{ str_init("ipops"), str_init("ip_set_match"),
+		SR_KEMIP_INT, ki_ip_set_match,
+		{ SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+	},
 
 	{ {0, 0}, {0, 0}, 0, NULL, { 0, 0, 0, 0, 0, 0 } }
 };
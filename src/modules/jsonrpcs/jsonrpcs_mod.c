@@ -118,6 +118,7 @@ extern int jsonrpc_dgram_destroy(void);
 
 /* tcp server parameters */
 extern char *jsonrpc_tcp_socket;
+extern int jsonrpc_tcp_stream;
 
 int jsonrpc_tcp_mod_init(void);
 int jsonrpc_tcp_child_init(int rank);
@@ -140,6 +141,9 @@ static rpc_t func_param;
 
 #define JSONRPC_ERROR_REASON_BUF_LEN 128
 #define JSONRPC_PRINT_VALUE_BUF_LEN 1024
+/* the values added by the rpc command are collected in a result array,
+ * always on stream connections as the command can write them in parts */
+#define JSONRPC_RPL_ARRAY(ctx) (((ctx)->flags & RET_ARRAY) || (ctx)->stream)
 
 char jsonrpc_error_buf[JSONRPC_ERROR_REASON_BUF_LEN];
 
@@ -171,6 +175,7 @@ static param_export_t params[] = {
 	{"dgram_user", PARAM_STRING, &jsonrpc_dgram_unix_socket_uid_s},
 	{"dgram_user", PARAM_INT, &jsonrpc_dgram_unix_socket_uid},
 	{"tcp_socket", PARAM_STRING, &jsonrpc_tcp_socket},
+	{"tcp_stream", PARAM_INT, &jsonrpc_tcp_stream},
 
 	{0, 0, 0}
 };
@@ -333,6 +338,119 @@ static void jsonrpc_fault(jsonrpc_ctx_t *ctx, int code, char *fmt, ...)
 }
 
 
+/** Write the buffer to a stream connection.
+ * The socket is blocking, a slow client slows down the rpc process.
+ * @return 0 on success, -1 on error
+ */
+int jsonrpc_stream_write(int fd, char *buf, int len)
+{
+	int n;
+
+	while(len > 0) {
+		n = write(fd, buf, len);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			LM_ERR("failed to write to stream connection: %s\n",
+					strerror(errno));
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/** Write the items of a result array on the stream connection.
+ * The head of the reply is written before the first items.
+ */
+static int jsonrpc_stream_items(jsonrpc_ctx_t *ctx, srjson_t *jarr)
+{
+	static str rhead = str_init("{\"jsonrpc\":\"2.0\",\"result\":[");
+	char *p;
+	int len;
+	int n;
+	int ret;
+
+	if(ctx->stream == 1) {
+		if(jsonrpc_stream_write(ctx->stream_fd, rhead.s, rhead.len) < 0)
+			return -1;
+		ctx->stream = 2;
+	}
+	n = srjson_GetArraySize(ctx->jrpl, jarr);
+	if(n <= 0)
+		return 0;
+	p = srjson_PrintUnformatted(ctx->jrpl, jarr);
+	if(p == NULL) {
+		LM_ERR("failed to print the result items\n");
+		return -1;
+	}
+	/* skip the array brackets */
+	len = strlen(p);
+	ret = 0;
+	if(ctx->stream_items > 0)
+		ret = jsonrpc_stream_write(ctx->stream_fd, ",", 1);
+	if(ret == 0 && len > 2)
+		ret = jsonrpc_stream_write(ctx->stream_fd, p + 1, len - 2);
+	ctx->jrpl->free_fn(p);
+	ctx->stream_items += n;
+	return ret;
+}
+
+/** Write a member of the reply object on the stream connection.
+ */
+static int jsonrpc_stream_member(jsonrpc_ctx_t *ctx, str *name, srjson_t *nj)
+{
+	char *p;
+	int ret;
+
+	p = srjson_PrintUnformatted(ctx->jrpl, nj);
+	if(p == NULL) {
+		LM_ERR("failed to print the member [%.*s]\n", name->len, name->s);
+		return -1;
+	}
+	ret = jsonrpc_stream_write(ctx->stream_fd, name->s, name->len);
+	if(ret == 0)
+		ret = jsonrpc_stream_write(ctx->stream_fd, p, strlen(p));
+	ctx->jrpl->free_fn(p);
+	return ret;
+}
+
+/** Write the rest of a streamed reply.
+ * A fault after the first part of the result was written is added as
+ * error member after the result array.
+ */
+static int jsonrpc_stream_end(jsonrpc_ctx_t *ctx)
+{
+	static str merror = str_init(",\"error\":");
+	static str mid = str_init(",\"id\":");
+	srjson_t *nj;
+	int ret;
+
+	ret = 0;
+	nj = srjson_GetObjectItem(ctx->jrpl, ctx->jrpl->root, "result");
+	if(nj != NULL)
+		ret = jsonrpc_stream_items(ctx, nj);
+	if(ret == 0)
+		ret = jsonrpc_stream_write(ctx->stream_fd, "]", 1);
+	nj = srjson_GetObjectItem(ctx->jrpl, ctx->jrpl->root, "error");
+	if(ret == 0 && nj != NULL)
+		ret = jsonrpc_stream_member(ctx, &merror, nj);
+	nj = srjson_GetObjectItem(ctx->jrpl, ctx->jrpl->root, "id");
+	if(ret == 0 && nj != NULL)
+		ret = jsonrpc_stream_member(ctx, &mid, nj);
+	if(ret == 0)
+		ret = jsonrpc_stream_write(ctx->stream_fd, "}", 1);
+	if(ret < 0) {
+		LM_ERR("failed to complete the streamed reply for [%s]\n",
+				ctx->method ? ctx->method : "");
+	}
+	/* nothing left to be sent by the transport */
+	jsonrpc_set_plain_reply(
+			ctx->http_code, &ctx->http_text, NULL, ctx->jrpl->free_fn);
+	return 0;
+}
+
 /** Implementation of rpc_send function required by the management API.
  *
  * This is the function that will be called whenever a management function
@@ -385,6 +503,14 @@ static int jsonrpc_send_mode(jsonrpc_ctx_t *ctx, int mode)
 	} else {
 		nj = srjson_GetObjectItem(ctx->jrpl, ctx->jrpl->root, "result");
 		if(nj == NULL) {
+			if(ctx->stream == 1 && !(ctx->flags & RET_ARRAY)
+					&& ctx->rpl_node != NULL) {
+				/* nothing written yet, keep the last value as result */
+				nj = srjson_DetachItemFromArray(ctx->jrpl, ctx->rpl_node,
+						srjson_GetArraySize(ctx->jrpl, ctx->rpl_node) - 1);
+				srjson_Delete(ctx->jrpl, ctx->rpl_node);
+				ctx->rpl_node = nj;
+			}
 			if(!ctx->rpl_node) {
 				if(ctx->flags & RET_ARRAY) {
 					ctx->rpl_node = srjson_CreateArray(ctx->jrpl);
@@ -437,7 +563,13 @@ static int jsonrpc_send_mode(jsonrpc_ctx_t *ctx, int mode)
 		}
 	}
 
-	if(jsonrpc_pretty_format == 0) {
+	if(ctx->stream == 2) {
+		/* first part of the result already written */
+		return jsonrpc_stream_end(ctx);
+	}
+
+	/* replies on stream connections have to be on a single line */
+	if(jsonrpc_pretty_format == 0 || ctx->stream) {
 		rbuf.s = srjson_PrintUnformatted(ctx->jrpl, ctx->jrpl->root);
 	} else {
 		rbuf.s = srjson_Print(ctx->jrpl, ctx->jrpl->root);
@@ -492,6 +624,31 @@ static int jsonrpc_send(jsonrpc_ctx_t *ctx)
 	return jsonrpc_send_mode(ctx, 0);
 }
 
+/** Implementation of rpc->flush function of the management API.
+ *
+ * Writes the items of the result array added so far on the stream
+ * connection.
+ * @return 1 if written, 0 if not, -1 on error
+ */
+static int jsonrpc_flush(jsonrpc_ctx_t *ctx)
+{
+	if(ctx->stream == 0 || ctx->reply_sent || ctx->error_code != 0
+			|| ctx->rpl_node == NULL)
+		return 0;
+	if(srjson_GetArraySize(ctx->jrpl, ctx->rpl_node) <= 0)
+		return 0;
+	/* the result is an array once a part of it was written */
+	ctx->flags |= RET_ARRAY;
+	if(jsonrpc_stream_items(ctx, ctx->rpl_node) < 0) {
+		/* the client is gone, nothing else can be sent */
+		ctx->reply_sent = 1;
+		return -1;
+	}
+	srjson_Delete(ctx->jrpl, ctx->rpl_node);
+	ctx->rpl_node = NULL;
+	return 1;
+}
+
 /** Converts the variables provided in parameter ap according to formatting
  * string provided in parameter fmt into HTML format.
  *
@@ -608,7 +765,7 @@ static int jsonrpc_add(jsonrpc_ctx_t *ctx, char *fmt, ...)
 
 		if(nj == NULL)
 			goto err;
-		if(ctx->flags & RET_ARRAY) {
+		if(JSONRPC_RPL_ARRAY(ctx)) {
 			if(ctx->rpl_node == NULL) {
 				ctx->rpl_node = srjson_CreateArray(ctx->jrpl);
 				if(ctx->rpl_node == 0) {
@@ -821,7 +978,7 @@ static int jsonrpc_rpl_printf(jsonrpc_ctx_t *ctx, char *fmt, ...)
 					jsonrpc_free(buf);
 				return -1;
 			}
-			if(ctx->flags & RET_ARRAY) {
+			if(JSONRPC_RPL_ARRAY(ctx)) {
 				if(ctx->rpl_node == NULL) {
 					ctx->rpl_node = srjson_CreateArray(ctx->jrpl);
 					if(ctx->rpl_node == 0) {
@@ -1079,6 +1236,10 @@ static void jsonrpc_clean_context(jsonrpc_ctx_t *ctx)
 static rpc_capabilities_t jsonrpc_capabilities(jsonrpc_ctx_t *ctx)
 {
 	/* support for async commands - delayed response */
+	if(ctx->stream) {
+		/* result array written in parts on stream connections */
+		return RPC_DELAYED_REPLY | RPC_STREAM_REPLY;
+	}
 	return RPC_DELAYED_REPLY;
 }
 
@@ -1312,6 +1473,7 @@ static int mod_init(void)
 	func_param.delayed_ctx_new = (rpc_delayed_ctx_new_f)jsonrpc_delayed_ctx_new;
 	func_param.delayed_ctx_close =
 			(rpc_delayed_ctx_close_f)jsonrpc_delayed_ctx_close;
+	func_param.flush = (rpc_flush_f)jsonrpc_flush;
 
 	jsonrpc_register_rpc();
 
@@ -1464,7 +1626,10 @@ static int jsonrpc_dispatch(sip_msg_t *msg, char *s1, char *s2)
 	return ki_jsonrpcs_dispatch(msg);
 }
 
-int jsonrpc_exec_ex(str *cmd, str *rpath, str *spath)
+/**
+ * sfd - stream connection for writing the reply in parts (-1 if none)
+ */
+static int jsonrpc_exec_run(str *cmd, str *rpath, str *spath, int sfd)
 {
 	rpc_exportx_t *rpce;
 	jsonrpc_ctx_t *ctx;
@@ -1473,7 +1638,7 @@ int jsonrpc_exec_ex(str *cmd, str *rpath, str *spath)
 	str val;
 	str scmd;
 	unsigned int rdata = 0;
-	int mode;
+	int mode = 0;
 
 	scmd = *cmd;
 
@@ -1482,6 +1647,10 @@ int jsonrpc_exec_ex(str *cmd, str *rpath, str *spath)
 	ctx = _jsonrpc_ctx_active;
 	memset(ctx, 0, sizeof(jsonrpc_ctx_t));
 	ctx->msg = NULL; /* mark it not send a reply out */
+	if(sfd >= 0) {
+		ctx->stream = 1;
+		ctx->stream_fd = sfd;
+	}
 	/* parse the jsonrpc request */
 	ctx->jreq = srjson_NewDoc(NULL);
 	if(ctx->jreq == NULL) {
@@ -1604,6 +1773,20 @@ send_reply:
 	return 1;
 }
 
+int jsonrpc_exec_ex(str *cmd, str *rpath, str *spath)
+{
+	return jsonrpc_exec_run(cmd, rpath, spath, -1);
+}
+
+/**
+ * execute the command received on a stream connection, the result array
+ * can be written directly on the connection, in parts
+ */
+int jsonrpc_exec_stream(str *cmd, int sfd)
+{
+	return jsonrpc_exec_run(cmd, NULL, NULL, sfd);
+}
+
 static int jsonrpc_exec(sip_msg_t *msg, char *cmd, char *s2)
 {
 	str scmd;
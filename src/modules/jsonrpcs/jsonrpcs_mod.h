@@ -60,6 +60,10 @@ typedef struct jsonrpc_ctx
 	int transport;		/**< RPC transport */
 	int jsrid_type;		/**< type for Json RPC id value */
 	char jsrid_val[JSONRPC_ID_SIZE]; /**< value for Json RPC id */
+	int stream;		  /**< 1 - result array can be written in parts to
+						stream_fd, 2 - first part written */
+	int stream_fd;	  /**< connection for the streamed reply */
+	int stream_items; /**< result array items written so far */
 } jsonrpc_ctx_t;
 
 /* extra rpc_ctx_t flags */
@@ -82,6 +86,8 @@ typedef struct jsonrpc_plain_reply
 jsonrpc_plain_reply_t *jsonrpc_plain_reply_get(void);
 
 int jsonrpc_exec_ex(str *cmd, str *rpath, str *spath);
+int jsonrpc_exec_stream(str *cmd, int sfd);
+int jsonrpc_stream_write(int fd, char *buf, int len);
 char *jsonrpcs_stored_id_get(void);
 
 #define JSONRPC_RESPONSE_STORING_DONE \
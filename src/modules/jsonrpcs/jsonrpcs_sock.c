@@ -33,6 +33,8 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/select.h>
+#include <poll.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -102,6 +104,9 @@ static int jsonrpc_dgram_post_process(void);
 
 /* tcp socket specific parameters */
 char *jsonrpc_tcp_socket = NULL;
+/* idle timeout (ms) of persistent tcp connections, 0 - one request per
+ * connection */
+int jsonrpc_tcp_stream = 0;
 
 typedef struct jsonrpc_tcp_address
 {
@@ -770,6 +775,224 @@ int jsonrpc_tcp_mod_init(void)
 
 static char jsonrpc_tcp_buf[JSONRPC_DGRAM_BUF_SIZE];
 
+#define JSONRPC_RESPONSE_PARSE_ERROR                                       \
+	"{\"jsonrpc\":\"2.0\",\"error\":{\"code\":-32700,\"message\":\"Parse " \
+	"Error\"},\"id\":null}"
+
+/* max number of persistent tcp connections served at the same time */
+#define JSONRPC_TCP_STREAM_CONNS 32
+
+typedef struct jsonrpc_tcp_conn
+{
+	int sock;
+	int len;
+	long long last; /* time of the last activity (ms) */
+	char *buf;
+} jsonrpc_tcp_conn_t;
+
+static long long jsonrpc_tcp_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void jsonrpc_tcp_conn_close(jsonrpc_tcp_conn_t *conn)
+{
+	close(conn->sock);
+	pkg_free(conn->buf);
+	conn->sock = -1;
+	conn->buf = NULL;
+	conn->len = 0;
+}
+
+/**
+ * process the complete requests received on a persistent tcp connection -
+ * the requests are json documents on a single line, processed in the order
+ * they are received, and each reply is written on a single line; the
+ * result arrays can be written in parts
+ * - return -1 if the connection has to be closed
+ */
+static int jsonrpc_tcp_stream_requests(jsonrpc_tcp_conn_t *conn)
+{
+	char *eol;
+	str scmd;
+	jsonrpc_plain_reply_t *jr = NULL;
+	int n;
+
+	while((eol = memchr(conn->buf, '\n', conn->len)) != NULL) {
+		*eol = '\0';
+		scmd.s = conn->buf;
+		scmd.len = (int)(eol - conn->buf);
+		trim(&scmd);
+		if(scmd.len > 0) {
+			scmd.s[scmd.len] = '\0';
+			if(jsonrpc_exec_stream(&scmd, conn->sock) < 0) {
+				LM_ERR("failed to execute the json document from tcp\n");
+				/* keep one reply per request */
+				if(jsonrpc_stream_write(conn->sock,
+						   JSONRPC_RESPONSE_PARSE_ERROR,
+						   sizeof(JSONRPC_RESPONSE_PARSE_ERROR) - 1)
+						< 0)
+					return -1;
+			} else {
+				jr = jsonrpc_plain_reply_get();
+				if(jr->rbody.s != NULL
+						&& jsonrpc_stream_write(
+								   conn->sock, jr->rbody.s, jr->rbody.len)
+								   < 0)
+					return -1;
+			}
+			if(jsonrpc_stream_write(conn->sock, "\n", 1) < 0)
+				return -1;
+		}
+		n = conn->len - (int)(eol + 1 - conn->buf);
+		memmove(conn->buf, eol + 1, n);
+		conn->len = n;
+	}
+	if(conn->len >= JSONRPC_DGRAM_BUF_SIZE - 1) {
+		LM_ERR("request too big - closing the connection\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * read from a persistent tcp connection and process the requests
+ * - return -1 if the connection has to be closed
+ */
+static int jsonrpc_tcp_stream_read(jsonrpc_tcp_conn_t *conn)
+{
+	int n;
+
+	do {
+		n = read(conn->sock, conn->buf + conn->len,
+				JSONRPC_DGRAM_BUF_SIZE - 1 - conn->len);
+	} while(n < 0 && errno == EINTR);
+	if(n < 0) {
+		LM_ERR("failed reading from tcp socket\n");
+		return -1;
+	}
+	if(n == 0) {
+		LM_DBG("connection closed by the client\n");
+		return -1;
+	}
+	conn->len += n;
+	return jsonrpc_tcp_stream_requests(conn);
+}
+
+/**
+ * serve the persistent tcp connections - the listen socket and the
+ * connections are polled together, so an idle client does not delay the
+ * others, only the execution of a request and the writing of its reply are
+ * done one connection at a time
+ */
+static int jsonrpc_tcp_stream_serve(void)
+{
+	jsonrpc_tcp_conn_t conns[JSONRPC_TCP_STREAM_CONNS];
+	struct pollfd pfds[JSONRPC_TCP_STREAM_CONNS + 1];
+	int pidx[JSONRPC_TCP_STREAM_CONNS + 1];
+	struct sockaddr caddr;
+	socklen_t clen;
+	struct timeval tv;
+	long long now;
+	long long tmo;
+	int csock;
+	int npfds;
+	int i;
+	int n;
+
+	for(i = 0; i < JSONRPC_TCP_STREAM_CONNS; i++) {
+		conns[i].sock = -1;
+		conns[i].buf = NULL;
+		conns[i].len = 0;
+	}
+
+	while(1) {
+		cfg_update();
+		/* close the idle connections, the poll timeout is the next one */
+		now = jsonrpc_tcp_time_ms();
+		tmo = -1;
+		pfds[0].fd = _jsonrpc_tcp_address.tsock;
+		pfds[0].events = POLLIN;
+		pfds[0].revents = 0;
+		npfds = 1;
+		for(i = 0; i < JSONRPC_TCP_STREAM_CONNS; i++) {
+			if(conns[i].sock < 0)
+				continue;
+			if(now - conns[i].last >= jsonrpc_tcp_stream) {
+				LM_DBG("idle connection - closing it\n");
+				jsonrpc_tcp_conn_close(&conns[i]);
+				continue;
+			}
+			if(tmo < 0 || conns[i].last + jsonrpc_tcp_stream - now < tmo)
+				tmo = conns[i].last + jsonrpc_tcp_stream - now;
+			pfds[npfds].fd = conns[i].sock;
+			pfds[npfds].events = POLLIN;
+			pfds[npfds].revents = 0;
+			pidx[npfds] = i;
+			npfds++;
+		}
+
+		n = poll(pfds, npfds, (int)tmo);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			LM_ERR("failed polling the tcp connections\n");
+			continue;
+		}
+		if(n == 0)
+			continue;
+
+		now = jsonrpc_tcp_time_ms();
+		for(i = 1; i < npfds; i++) {
+			if(pfds[i].revents == 0)
+				continue;
+			conns[pidx[i]].last = now;
+			if(jsonrpc_tcp_stream_read(&conns[pidx[i]]) < 0)
+				jsonrpc_tcp_conn_close(&conns[pidx[i]]);
+		}
+
+		if(!(pfds[0].revents & POLLIN))
+			continue;
+		clen = sizeof(caddr);
+		csock = accept(
+				_jsonrpc_tcp_address.tsock, (struct sockaddr *)&caddr, &clen);
+		if(csock < 0) {
+			LM_ERR("cannot accept the client err='%d'\n", errno);
+			continue;
+		}
+		LM_DBG("new client connected - sock: %d\n", csock);
+		for(i = 0; i < JSONRPC_TCP_STREAM_CONNS; i++) {
+			if(conns[i].sock < 0)
+				break;
+		}
+		if(i == JSONRPC_TCP_STREAM_CONNS) {
+			LM_ERR("too many tcp connections - closing the new one\n");
+			close(csock);
+			continue;
+		}
+		conns[i].buf = (char *)pkg_malloc(JSONRPC_DGRAM_BUF_SIZE);
+		if(conns[i].buf == NULL) {
+			PKG_MEM_ERROR;
+			close(csock);
+			continue;
+		}
+		/* a client not reading the replies is dropped after the timeout */
+		tv.tv_sec = jsonrpc_tcp_stream / 1000;
+		tv.tv_usec = (jsonrpc_tcp_stream % 1000) * 1000;
+		if(setsockopt(csock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0) {
+			LM_WARN("cannot set the send timeout on the tcp connection\n");
+		}
+		conns[i].sock = csock;
+		conns[i].len = 0;
+		conns[i].last = now;
+	}
+
+	return 0;
+}
+
 /**
  *
  */
@@ -828,6 +1051,9 @@ int jsonrpc_tcp_process(void)
 	}
 
 	LM_DBG("waiting for client connections\n");
+	if(jsonrpc_tcp_stream > 0) {
+		return jsonrpc_tcp_stream_serve();
+	}
 	while(1) {
 		cfg_update();
 		if(csock >= 0) {
@@ -586,7 +586,9 @@ static void stats_get_all(rpc_t *rpc, void *ctx, char *stat)
 	if(len == 3 && strcmp("all", stat) == 0) {
 		packed_params.rpc = rpc;
 		packed_params.ctx = ctx;
+		counter_snapshot_start();
 		counter_iterate_grp_names(rpc_get_all_grps_cbk, &packed_params);
+		counter_snapshot_end();
 	} else if(stat[len - 1] == ':') {
 		packed_params.rpc = rpc;
 		packed_params.ctx = ctx;
@@ -684,7 +686,9 @@ static void stats_fetch_all(
 		packed_params.ctx = ctx;
 		packed_params.hst = th;
 		packed_params.numeric = numeric;
+		counter_snapshot_start();
 		counter_iterate_grp_names(rpc_fetch_all_grps_cbk, &packed_params);
+		counter_snapshot_end();
 	} else if(stat[len - 1] == ':') {
 		packed_params.rpc = rpc;
 		packed_params.ctx = ctx;
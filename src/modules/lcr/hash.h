@@ -39,7 +39,8 @@ int rule_hash_table_insert(struct rule_info **hash_table, unsigned int lcr_id,
 		unsigned short from_uri_len, char *from_uri, pcre2_code *from_uri_re,
 		unsigned short mt_tvalue_len, char *mt_tvalue,
 		unsigned short request_uri_len, char *request_uri,
-		pcre2_code *request_uri_re, unsigned short stopper);
+		pcre2_code *request_uri_re, unsigned short re_shared,
+		unsigned short stopper);
 
 int rule_hash_table_insert_target(struct rule_info **hash_table,
 		struct gw_info *gws, unsigned int rule_id, unsigned int gw_id,
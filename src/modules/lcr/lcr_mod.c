@@ -67,6 +67,9 @@
 #include "../../core/socket_info.h"
 #include "../../core/pvar.h"
 #include "../../core/rand/kam_rand.h"
+#include "../../core/hashes.h"
+#include "../../core/pt.h"
+#include "../../core/atomic_ops.h"
 #include "../../core/kemi.h"
 #include "hash.h"
 #include "lcr_rpc.h"
@@ -241,6 +244,49 @@ struct gw_info **gw_pt = (struct gw_info **)NULL;
 /* Pointer to rule_id info hash table */
 struct rule_id_info **rule_id_hash_table = (struct rule_id_info **)NULL;
 
+/*
+ * Readers of the rule and gw tables do not take reload_lock. Each process
+ * instead pins the table generation it reads in its lcr_pins slot, and
+ * reload waits only for the processes pinning an older generation before
+ * it reuses the swapped out tables.
+ */
+typedef struct lcr_sync
+{
+	volatile unsigned int gen; /* generation of the current tables */
+	volatile unsigned int seq; /* odd while a rule/gw table pair is swapped */
+} lcr_sync_t;
+
+static lcr_sync_t *lcr_sync = NULL;
+static volatile unsigned int *lcr_pins = NULL;
+static int lcr_pins_no = 0;
+static int lcr_pin_depth = 0;
+
+/* Regexes compiled during reload, shared by the rules of an lcr_id with
+ * the same pattern */
+struct re_cache_info
+{
+	pcre2_code *re;
+	unsigned short len;
+	struct re_cache_info *next;
+	char pattern[1];
+};
+
+static struct re_cache_info **re_cache = NULL;
+static unsigned int re_cache_count = 0;
+
+/* Results of the regexes already run during one lookup */
+#define LCR_RE_MEMO_SIZE 16
+
+struct re_memo
+{
+	int n;
+	pcre2_code *re[LCR_RE_MEMO_SIZE];
+	int rc[LCR_RE_MEMO_SIZE];
+};
+
+/* Per process match data of the rule regexes */
+static pcre2_match_data *lcr_md = NULL;
+
 /* Pinging related vars */
 struct tm_binds _lcr_tmb;
 void ping_timer(unsigned int ticks, void *param);
@@ -779,6 +825,14 @@ static int mod_init(void)
 		memset(gw_pt[i], 0, sizeof(struct gw_info) * (lcr_gw_count_param + 1));
 	}
 
+	lcr_sync = (lcr_sync_t *)shm_malloc(sizeof(lcr_sync_t));
+	if(lcr_sync == NULL) {
+		SHM_MEM_ERROR_FMT("for lcr table generation\n");
+		goto err;
+	}
+	memset(lcr_sync, 0, sizeof(lcr_sync_t));
+	lcr_sync->gen = 1;
+
 	/* Allocate and initialize locks */
 	reload_lock = lock_alloc();
 	if(reload_lock == NULL) {
@@ -819,6 +873,17 @@ err:
 /* Module initialization function called in each child separately */
 static int child_init(int rank)
 {
+	if(rank == PROC_INIT) {
+		/* number of processes is known only after all mod_init calls */
+		lcr_pins_no = get_max_procs();
+		lcr_pins = (volatile unsigned int *)shm_malloc(
+				sizeof(unsigned int) * lcr_pins_no);
+		if(lcr_pins == NULL) {
+			SHM_MEM_ERROR_FMT("for lcr reader slots\n");
+			return -1;
+		}
+		memset((void *)lcr_pins, 0, sizeof(unsigned int) * lcr_pins_no);
+	}
 	return 0;
 }
 
@@ -867,6 +932,126 @@ static void free_shared_memory(void)
 		lock_dealloc(reload_lock);
 		reload_lock = 0;
 	}
+	if(lcr_pins) {
+		shm_free((void *)lcr_pins);
+		lcr_pins = NULL;
+	}
+	if(lcr_sync) {
+		shm_free(lcr_sync);
+		lcr_sync = NULL;
+	}
+}
+
+
+/*
+ * Pins the current rule and gw tables for this process, so that reload
+ * does not reuse them until lcr_unpin() is called. Calls can be nested.
+ */
+void lcr_pin(void)
+{
+	if(lcr_pins == NULL || process_no < 0 || process_no >= lcr_pins_no)
+		return;
+	if(lcr_pin_depth++ > 0)
+		return;
+	lcr_pins[process_no] = lcr_sync->gen;
+	membar();
+}
+
+
+void lcr_unpin(void)
+{
+	if(lcr_pins == NULL || process_no < 0 || process_no >= lcr_pins_no)
+		return;
+	if(lcr_pin_depth == 0 || --lcr_pin_depth > 0)
+		return;
+	membar();
+	lcr_pins[process_no] = 0;
+}
+
+
+/*
+ * Gets a consistent pair of rule and gw tables of lcr_id.
+ * Caller must have pinned the tables.
+ */
+static void lcr_tables_get(
+		unsigned int lcr_id, struct rule_info ***rules, struct gw_info **gws)
+{
+	unsigned int seq;
+
+	do {
+		seq = lcr_sync->seq;
+		membar_read();
+		*rules = rule_pt[lcr_id];
+		*gws = gw_pt[lcr_id];
+		membar_read();
+	} while((seq & 1) || (seq != lcr_sync->seq));
+}
+
+
+/*
+ * Swaps the spare tables with the ones of lcr_id, starts a new generation
+ * and waits until no process reads the swapped out tables anymore.
+ */
+static void lcr_tables_swap(unsigned int lcr_id)
+{
+	struct rule_info **rules;
+	struct gw_info *gws;
+	unsigned int gen, n;
+	int i;
+
+	rules = rule_pt[lcr_id];
+	gws = gw_pt[lcr_id];
+	lcr_sync->seq++;
+	membar_write();
+	rule_pt[lcr_id] = rule_pt[0];
+	gw_pt[lcr_id] = gw_pt[0];
+	membar_write();
+	lcr_sync->seq++;
+	rule_pt[0] = rules;
+	gw_pt[0] = gws;
+
+	gen = lcr_sync->gen + 1;
+	if(gen == 0)
+		gen = 1;
+	membar();
+	lcr_sync->gen = gen;
+	membar();
+
+	if(lcr_pins == NULL)
+		return;
+	for(i = 0; i < lcr_pins_no; i++) {
+		if(i == process_no)
+			continue;
+		n = 0;
+		while((lcr_pins[i] != 0) && (lcr_pins[i] != gen)) {
+			if(++n % 10000 == 0) {
+				LM_WARN("waiting for process %d to release lcr tables\n", i);
+			}
+			sleep_us(100);
+		}
+	}
+}
+
+
+/* Frees the regex cache entries, the regexes are owned by the rules */
+static void re_cache_contents_free(void)
+{
+	int i;
+	struct re_cache_info *rc, *next_rc;
+
+	if(re_cache == NULL)
+		return;
+
+	for(i = 0; i < lcr_rule_hash_size_param; i++) {
+		rc = re_cache[i];
+		while(rc) {
+			next_rc = rc->next;
+			pkg_free(rc);
+			rc = next_rc;
+		}
+		re_cache[i] = NULL;
+	}
+	re_cache_count = 0;
 }
 
 /*
@@ -942,6 +1127,87 @@ static pcre2_code *reg_ex_comp(const char *pattern)
 }
 
 
+/*
+ * Returns compiled pattern from the regex cache of the reload or
+ * compiles and caches it. Sets shared to 1 if the regex is already
+ * owned by another rule.
+ */
+static pcre2_code *re_cache_get(char *pattern, unsigned short len, int *shared)
+{
+	struct re_cache_info *rc;
+	pcre2_code *re;
+	str pattern_str;
+	unsigned int hash_val;
+
+	pattern_str.s = pattern;
+	pattern_str.len = len;
+	hash_val = core_hash(&pattern_str, 0, lcr_rule_hash_size_param);
+
+	for(rc = re_cache[hash_val]; rc; rc = rc->next) {
+		if((rc->len == len) && (memcmp(rc->pattern, pattern, len) == 0)) {
+			*shared = 1;
+			return rc->re;
+		}
+	}
+
+	*shared = 0;
+	re = reg_ex_comp(pattern);
+	if(re == NULL)
+		return NULL;
+
+	rc = (struct re_cache_info *)pkg_malloc(sizeof(struct re_cache_info) + len);
+	if(rc == NULL) {
+		/* the regex is still usable, just not shared */
+		PKG_MEM_ERROR_FMT("for regex cache entry\n");
+		return re;
+	}
+	rc->re = re;
+	rc->len = len;
+	memcpy(rc->pattern, pattern, len);
+	rc->pattern[len] = '\0';
+	rc->next = re_cache[hash_val];
+	re_cache[hash_val] = rc;
+	re_cache_count++;
+
+	return re;
+}
+
+
+/*
+ * Matches subject against regex of a rule. A regex shared by several
+ * rules is run only once during a lookup.
+ * Returns 1 on match, 0 on no match, and -1 on error.
+ */
+static int rule_re_match(pcre2_code *re, str *subject, struct re_memo *memo)
+{
+	int i, rc;
+
+	for(i = 0; i < memo->n; i++) {
+		if(memo->re[i] == re)
+			return memo->rc[i];
+	}
+
+	if(lcr_md == NULL) {
+		/* only match or no match is needed, so one pair is enough */
+		lcr_md = pcre2_match_data_create(1, NULL);
+		if(lcr_md == NULL) {
+			LM_ERR("failed to allocate pcre2 match data\n");
+			return -1;
+		}
+	}
+	rc = pcre2_match(re, (PCRE2_SPTR)subject->s, (PCRE2_SIZE)subject->len, 0,
+			0, lcr_md, NULL);
+	rc = (rc < 0) ? 0 : 1;
+
+	if(memo->n < LCR_RE_MEMO_SIZE) {
+		memo->re[memo->n] = re;
+		memo->rc[memo->n] = rc;
+		memo->n++;
+	}
+	return rc;
+}
+
+
 /*
  * Compare gateways based on their IP address
  */
@@ -1440,7 +1706,9 @@ int reload_tables()
 {
 	unsigned int i, n, lcr_id, rule_id, gw_id, from_uri_len, mt_tvalue_len,
 			request_uri_len, stopper, prefix_len, enabled, gw_cnt,
-			null_gw_ip_addr, priority, weight, tmp;
+			null_gw_ip_addr, priority, weight, tmp, rule_cnt;
+	unsigned short re_shared;
+	int shared;
 	char *prefix, *from_uri, *mt_tvalue, *request_uri;
 	db1_res_t *res = NULL;
 	db_row_t *row;
@@ -1451,8 +1719,8 @@ int reload_tables()
 	db_key_t rule_cols[7];
 	db_key_t target_cols[4];
 	pcre2_code *from_uri_re, *request_uri_re;
-	struct gw_info *gws, *gw_pt_tmp;
-	struct rule_info **rules, **rule_pt_tmp;
+	struct gw_info *gws;
+	struct rule_info **rules;
 
 	key_cols[0] = &lcr_id_col;
 	op[0] = OP_EQ;
@@ -1502,6 +1770,15 @@ int reload_tables()
 	memset(rule_id_hash_table, 0,
 			sizeof(struct rule_id_info *) * lcr_rule_hash_size_param);
 
+	re_cache = pkg_malloc(
+			sizeof(struct re_cache_info *) * lcr_rule_hash_size_param);
+	if(!re_cache) {
+		PKG_MEM_ERROR_FMT("for regex cache\n");
+		goto err;
+	}
+	memset(re_cache, 0,
+			sizeof(struct re_cache_info *) * lcr_rule_hash_size_param);
+
 	for(lcr_id = 1; lcr_id <= lcr_count_param; lcr_id++) {
 
 		/* Reload rules */
@@ -1509,6 +1786,8 @@ int reload_tables()
 		rules = rule_pt[0];
 		rule_hash_table_contents_free(rules);
 		rule_id_hash_table_contents_free();
+		re_cache_contents_free();
+		rule_cnt = 0;
 
 		if(lcr_dbf.use_table(dbh, &lcr_rule_table) < 0) {
 			LM_ERR("error while trying to use lcr_rule table\n");
@@ -1632,14 +1911,17 @@ int reload_tables()
 					LM_ERR("lcr rule <%u> from_uri is too long\n", rule_id);
 					goto err;
 				}
+				re_shared = 0;
 				if(from_uri_len > 0) {
-					from_uri_re = reg_ex_comp(from_uri);
+					from_uri_re = re_cache_get(from_uri, from_uri_len, &shared);
 					if(from_uri_re == 0) {
 						LM_ERR("failed to compile lcr rule <%u> from_uri "
 							   "<%s>\n",
 								rule_id, from_uri);
 						goto err;
 					}
+					if(shared)
+						re_shared |= LCR_RE_FROM_SHARED;
 				} else {
 					from_uri_re = 0;
 				}
@@ -1694,13 +1976,18 @@ int reload_tables()
 					goto err;
 				}
 				if(request_uri_len > 0) {
-					request_uri_re = reg_ex_comp(request_uri);
+					request_uri_re =
+							re_cache_get(request_uri, request_uri_len, &shared);
 					if(request_uri_re == 0) {
 						LM_ERR("failed to compile lcr rule <%u> request_uri "
 							   "<%s>\n",
 								rule_id, request_uri);
+						if(from_uri_re && !(re_shared & LCR_RE_FROM_SHARED))
+							pcre2_code_free(from_uri_re);
 						goto err;
 					}
+					if(shared)
+						re_shared |= LCR_RE_RURI_SHARED;
 				} else {
 					request_uri_re = 0;
 				}
@@ -1708,10 +1995,11 @@ int reload_tables()
 				if(!rule_hash_table_insert(rules, lcr_id, rule_id, prefix_len,
 						   prefix, from_uri_len, from_uri, from_uri_re,
 						   mt_tvalue_len, mt_tvalue, request_uri_len,
-						   request_uri, request_uri_re, stopper)
+						   request_uri, request_uri_re, re_shared, stopper)
 						|| !prefix_len_insert(rules, prefix_len)) {
 					goto err;
 				}
+				rule_cnt++;
 			}
 
 			if(DB_CAPABILITY(lcr_dbf, DB_CAP_FETCH)) {
@@ -1886,19 +2174,22 @@ int reload_tables()
 		lcr_dbf.free_result(dbh, res);
 		res = NULL;
 
+		LM_DBG("lcr_id <%u> has <%u> rules with <%u> distinct regexes\n",
+				lcr_id, rule_cnt, re_cache_count);
+
 		/* Swap tables */
-		rule_pt_tmp = rule_pt[lcr_id];
-		gw_pt_tmp = gw_pt[lcr_id];
-		rule_pt[lcr_id] = rules;
-		gw_pt[lcr_id] = gws;
-		rule_pt[0] = rule_pt_tmp;
-		gw_pt[0] = gw_pt_tmp;
+		lcr_tables_swap(lcr_id);
 	}
 
 	lcr_db_close();
 	rule_id_hash_table_contents_free();
 	if(rule_id_hash_table)
 		pkg_free(rule_id_hash_table);
+	re_cache_contents_free();
+	if(re_cache) {
+		pkg_free(re_cache);
+		re_cache = NULL;
+	}
 	return 1;
 
 err:
@@ -1907,6 +2198,11 @@ err:
 	rule_id_hash_table_contents_free();
 	if(rule_id_hash_table)
 		pkg_free(rule_id_hash_table);
+	re_cache_contents_free();
+	if(re_cache) {
+		pkg_free(re_cache);
+		re_cache = NULL;
+	}
 	return -1;
 }
 
@@ -2162,15 +2458,15 @@ void add_gws_into_avps(struct gw_info *gws, struct matched_gw_info *matched_gws,
  * Loads ids matching GWs in priority order into gw_indexes array.
  * Returns the number of entries in the array.
  */
-int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
-		unsigned int *gw_indexes)
+static int load_gws_dummy_helper(int lcr_id, str *ruri_user, str *from_uri,
+		str *request_uri, unsigned int *gw_indexes)
 {
 	int i, j, rc;
 	unsigned int gw_index, now, dex;
 	struct rule_info **rules, *rule, *pl;
 	struct gw_info *gws;
 	struct target *t;
-	pcre2_match_data *pcre_md = NULL;
+	struct re_memo from_memo, ruri_memo;
 	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
 	struct sip_uri furi;
 	struct usr_avp *avp;
@@ -2189,10 +2485,10 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 			ruri_user->s, from_uri->len, from_uri->s, request_uri->len,
 			request_uri->s);
 
-	rules = rule_pt[lcr_id];
-	gws = gw_pt[lcr_id];
+	lcr_tables_get(lcr_id, &rules, &gws);
 	pl = rules[lcr_rule_hash_size_param];
 	gw_index = 0;
+	from_memo.n = ruri_memo.n = 0;
 
 	if((from_uri->len > 0) && mt_pv_values_param) {
 		if(parse_uri(from_uri->s, from_uri->len, &furi) < 0) {
@@ -2216,20 +2512,10 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 				goto next;
 
 			if(rule->from_uri_len != 0) {
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->from_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "from_uri\n");
-					return -1;
-				}
-				rc = pcre2_match(rule->from_uri_re, (PCRE2_SPTR)from_uri->s,
-						(PCRE2_SIZE)from_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
-				}
+				rc = rule_re_match(rule->from_uri_re, from_uri, &from_memo);
 				if(rc < 0)
+					return -1;
+				if(rc == 0)
 					goto next;
 			}
 			if((from_uri->len > 0) && (rule->mt_tvalue_len > 0)) {
@@ -2264,21 +2550,11 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 						   "param has not been given.\n");
 					return -1;
 				}
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->request_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "request_uri\n");
-					return -1;
-				}
-				rc = pcre2_match(rule->request_uri_re,
-						(PCRE2_SPTR)request_uri->s,
-						(PCRE2_SIZE)request_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
-				}
+				rc = rule_re_match(
+						rule->request_uri_re, request_uri, &ruri_memo);
 				if(rc < 0)
+					return -1;
+				if(rc == 0)
 					goto next;
 			}
 
@@ -2334,18 +2610,30 @@ done:
 	return j;
 }
 
+int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
+		unsigned int *gw_indexes)
+{
+	int ret;
+
+	lcr_pin();
+	ret = load_gws_dummy_helper(
+			lcr_id, ruri_user, from_uri, request_uri, gw_indexes);
+	lcr_unpin();
+	return ret;
+}
+
 
 /*
  * Load info of matching GWs into gw_uri_avps
  */
-static int ki_load_gws_furi(
+static int load_gws_helper(
 		sip_msg_t *_m, int lcr_id, str *ruri_user, str *from_uri)
 {
 	str *request_uri;
 	int i, j, rc;
 	unsigned int gw_index, now, dex;
 	int_str val;
-	pcre2_match_data *pcre_md = NULL;
+	struct re_memo from_memo, ruri_memo;
 	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
 	struct rule_info **rules, *rule, *pl;
 	struct gw_info *gws;
@@ -2372,8 +2660,8 @@ static int ki_load_gws_furi(
 	}
 
 	/* Use rules and gws with index lcr_id */
-	rules = rule_pt[lcr_id];
-	gws = gw_pt[lcr_id];
+	lcr_tables_get(lcr_id, &rules, &gws);
+	from_memo.n = ruri_memo.n = 0;
 
 	/*
      * Find lcr entries that match based on prefix and from_uri and collect
@@ -2405,20 +2693,10 @@ static int ki_load_gws_furi(
 
 			/* Match from uri */
 			if(rule->from_uri_len != 0) {
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->from_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "from_uri\n");
+				rc = rule_re_match(rule->from_uri_re, from_uri, &from_memo);
+				if(rc < 0)
 					return -1;
-				}
-				rc = pcre2_match(rule->from_uri_re, (PCRE2_SPTR)from_uri->s,
-						(PCRE2_SIZE)from_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
-				}
-				if(rc < 0) {
+				if(rc == 0) {
 					LM_DBG("from uri <%.*s> did not match to from regex "
 						   "<%.*s>\n",
 							from_uri->len, from_uri->s, rule->from_uri_len,
@@ -2454,21 +2732,11 @@ static int ki_load_gws_furi(
 
 			/* Match request uri */
 			if(rule->request_uri_len != 0) {
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->request_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "request_uri\n");
+				rc = rule_re_match(
+						rule->request_uri_re, request_uri, &ruri_memo);
+				if(rc < 0)
 					return -1;
-				}
-				rc = pcre2_match(rule->request_uri_re,
-						(PCRE2_SPTR)request_uri->s,
-						(PCRE2_SIZE)request_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
-				}
-				if(rc < 0) {
+				if(rc == 0) {
 					LM_DBG("request uri <%.*s> did not match to request regex "
 						   "<%.*s>\n",
 							request_uri->len, request_uri->s,
@@ -2541,6 +2809,17 @@ done:
 	}
 }
 
+static int ki_load_gws_furi(
+		sip_msg_t *_m, int lcr_id, str *ruri_user, str *from_uri)
+{
+	int ret;
+
+	lcr_pin();
+	ret = load_gws_helper(_m, lcr_id, ruri_user, from_uri);
+	lcr_unpin();
+	return ret;
+}
+
 /*
  * Load info of matching GWs into gw_uri_avps
  */
@@ -2750,7 +3029,7 @@ static int generate_uris(struct sip_msg *_m, char *r_uri, str *r_uri_user,
 /*
  * Defunct current gw until time given as argument has passed.
  */
-static int ki_defunct_gw(sip_msg_t *_m, int defunct_period)
+static int defunct_gw_helper(sip_msg_t *_m, int defunct_period)
 {
 	int_str lcr_id_val, index_val;
 	struct gw_info *gws;
@@ -2793,6 +3072,16 @@ static int ki_defunct_gw(sip_msg_t *_m, int defunct_period)
 	return 1;
 }
 
+static int ki_defunct_gw(sip_msg_t *_m, int defunct_period)
+{
+	int ret;
+
+	lcr_pin();
+	ret = defunct_gw_helper(_m, defunct_period);
+	lcr_unpin();
+	return ret;
+}
+
 /*
  * Defunct current gw until time given as argument has passed.
  */
@@ -2813,7 +3102,7 @@ static int defunct_gw(struct sip_msg *_m, char *_defunct_period, char *_s2)
 /*
  * Inactivate current gw (provided that inactivate threshold has been reached)
  */
-static int ki_inactivate_gw(sip_msg_t *_m)
+static int inactivate_gw_helper(sip_msg_t *_m)
 {
 	int_str lcr_id_val, index_val;
 	struct gw_info *gws;
@@ -2861,6 +3150,16 @@ static int ki_inactivate_gw(sip_msg_t *_m)
 	return 1;
 }
 
+static int ki_inactivate_gw(sip_msg_t *_m)
+{
+	int ret;
+
+	lcr_pin();
+	ret = inactivate_gw_helper(_m);
+	lcr_unpin();
+	return ret;
+}
+
 /*
  * Inactivate current gw (provided that inactivate threshold has been reached)
  */
@@ -2887,13 +3186,16 @@ int rpc_defunct_gw(unsigned int lcr_id, unsigned int gw_id, unsigned int period)
 	LM_DBG("defuncting gw <lcr_id/gw_id>=<%u/%u> for %u seconds until %d\n",
 			lcr_id, gw_id, period, until);
 
+	lcr_pin();
 	gws = gw_pt[lcr_id];
 	for(i = 1; i <= gws[0].ip_addr.u.addr32[0]; i++) {
 		if(gws[i].gw_id == gw_id) {
 			gws[i].defunct_until = until;
+			lcr_unpin();
 			return 1;
 		}
 	}
+	lcr_unpin();
 
 	LM_ERR("gateway with id <%u> not found\n", gw_id);
 
@@ -2959,6 +3261,7 @@ void ping_timer(unsigned int ticks, void *param)
 
 	for(j = 1; j <= lcr_count_param; j++) {
 
+		lcr_pin();
 		gws = gw_pt[j];
 
 		for(i = 1; i <= gws[0].ip_addr.u.addr32[0]; i++) {
@@ -2981,6 +3284,7 @@ void ping_timer(unsigned int ticks, void *param)
 				}
 			}
 		}
+		lcr_unpin();
 	}
 }
 
@@ -3113,7 +3417,7 @@ static int next_gw(struct sip_msg *_m, char *_s1, char *_s2)
 /*
  * Checks if request comes from ip address of a gateway
  */
-static int do_from_gw(struct sip_msg *_m, unsigned int lcr_id,
+static int do_from_gw_helper(struct sip_msg *_m, unsigned int lcr_id,
 		struct ip_addr *src_addr, uri_transport transport,
 		unsigned int src_port)
 {
@@ -3162,6 +3466,18 @@ static int do_from_gw(struct sip_msg *_m, unsigned int lcr_id,
 	}
 }
 
+static int do_from_gw(struct sip_msg *_m, unsigned int lcr_id,
+		struct ip_addr *src_addr, uri_transport transport,
+		unsigned int src_port)
+{
+	int ret;
+
+	lcr_pin();
+	ret = do_from_gw_helper(_m, lcr_id, src_addr, transport, src_port);
+	lcr_unpin();
+	return ret;
+}
+
 
 /*
  * Checks if request comes from ip address of a gateway taking source
@@ -3438,7 +3754,7 @@ static int from_any_gw_3(
 /*
  * Checks if in-dialog request goes to ip address of a gateway.
  */
-static int do_to_gw(struct sip_msg *_m, unsigned int lcr_id,
+static int do_to_gw_helper(struct sip_msg *_m, unsigned int lcr_id,
 		struct ip_addr *dst_addr, uri_transport transport)
 {
 	struct gw_info *res, gw, *gws;
@@ -3468,6 +3784,17 @@ static int do_to_gw(struct sip_msg *_m, unsigned int lcr_id,
 	}
 }
 
+static int do_to_gw(struct sip_msg *_m, unsigned int lcr_id,
+		struct ip_addr *dst_addr, uri_transport transport)
+{
+	int ret;
+
+	lcr_pin();
+	ret = do_to_gw_helper(_m, lcr_id, dst_addr, transport);
+	lcr_unpin();
+	return ret;
+}
+
 
 /*
  * Checks if request goes to ip address and transport protocol of a gateway
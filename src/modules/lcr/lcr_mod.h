@@ -68,12 +68,17 @@ struct rule_info
 	char request_uri[MAX_URI_LEN + 1];
 	unsigned short request_uri_len;
 	pcre2_code *request_uri_re;
+	unsigned short re_shared; /* regexes owned by another rule */
 	unsigned short stopper;
 	unsigned int enabled;
 	struct target *targets;
 	struct rule_info *next;
 };
 
+/* re_shared flags */
+#define LCR_RE_FROM_SHARED (1 << 0)
+#define LCR_RE_RURI_SHARED (1 << 1)
+
 struct rule_id_info
 {
 	unsigned int rule_id;
@@ -149,6 +154,9 @@ extern struct gw_info **gw_pt;
 extern struct rule_info ***rule_pt;
 extern struct rule_id_info **rule_id_hash_table;
 
+extern void lcr_pin(void);
+extern void lcr_unpin(void);
+
 extern int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri,
 		str *request_uri, unsigned int *gw_indexes);
 extern int reload_tables();
@@ -104,7 +104,7 @@ static void dump_gw(rpc_t *rpc, void *st, struct gw_info *gw,
 			start);
 }
 
-static void dump_gws(rpc_t *rpc, void *c)
+static void dump_gws_helper(rpc_t *rpc, void *c)
 {
 	void *st;
 	void *rec = NULL;
@@ -131,12 +131,19 @@ static void dump_gws(rpc_t *rpc, void *c)
 	}
 }
 
+static void dump_gws(rpc_t *rpc, void *c)
+{
+	lcr_pin();
+	dump_gws_helper(rpc, c);
+	lcr_unpin();
+}
+
 
 static const char *dump_rules_doc[2] = {
 		"Dump the contents of the lcr_rules table.", 0};
 
 
-static void dump_rules(rpc_t *rpc, void *c)
+static void dump_rules_helper(rpc_t *rpc, void *c)
 {
 	int i, j;
 	int _filter_by_prefix = 0;
@@ -227,6 +234,13 @@ static void dump_rules(rpc_t *rpc, void *c)
 		rpc->fault(c, 404, "Empty reply");
 }
 
+static void dump_rules(rpc_t *rpc, void *c)
+{
+	lcr_pin();
+	dump_rules_helper(rpc, c);
+	lcr_unpin();
+}
+
 
 static const char *defunct_gw_doc[2] = {
 		"Defunct gateway until specified time (Unix timestamp).", 0};
@@ -257,7 +271,7 @@ static const char *load_gws_doc[2] = {
 		0};
 
 
-static void load_gws(rpc_t *rpc, void *c)
+static void load_gws_helper(rpc_t *rpc, void *c)
 {
 	unsigned int lcr_id, i, j;
 	int gw_count, ret;
@@ -305,6 +319,13 @@ static void load_gws(rpc_t *rpc, void *c)
 	return;
 }
 
+static void load_gws(rpc_t *rpc, void *c)
+{
+	lcr_pin();
+	load_gws_helper(rpc, c);
+	lcr_unpin();
+}
+
 /* clang-format off */
 rpc_export_t lcr_rpc[] = {
     {"lcr.reload", reload, reload_doc, 0},
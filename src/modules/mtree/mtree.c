@@ -87,6 +87,16 @@ int mt_char_table_init(int nset)
 }
 
 
+/**
+ * index of the char in the prefix char list, -1 if not in the list
+ */
+int mt_char_index(unsigned char c)
+{
+	if(_mt_char_table[c] == MT_CHAR_TABLE_NOTSET)
+		return -1;
+	return (int)_mt_char_table[c];
+}
+
 /**
  *
  */
@@ -369,6 +379,9 @@ is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 		return NULL;
 	}
 
+	if(pt->cfile.s != NULL)
+		return mt_cimg_get_tvalue(pt, tomatch, len);
+
 	l = 0;
 	itn = pt->head;
 	tvalue = NULL;
@@ -410,6 +423,9 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 		return -1;
 	}
 
+	if(pt->cfile.s != NULL)
+		return mt_cimg_add_tvalues(msg, pt, tomatch);
+
 	if(pv_get_avp_name(msg, &pv_values.pvp, &values_avp_name, &values_name_type)
 			< 0) {
 		LM_ERR("cannot get values avp name\n");
@@ -644,6 +660,8 @@ void mt_free_tree(m_tree_t *pt)
 		shm_free(pt->dbtable.s);
 	if(pt->tname.s != NULL)
 		shm_free(pt->tname.s);
+	if(pt->cfile.s != NULL)
+		shm_free(pt->cfile.s);
 
 	shm_free(pt);
 	pt = NULL;
@@ -799,13 +817,21 @@ int mt_table_spec(char *val)
 				  && strncasecmp(pit->name.s, "cols", 4) == 0) {
 			tmp.ncols = 1;
 			tmp.scols[0] = pit->body;
+		} else if(pit->name.len == 4
+				  && strncasecmp(pit->name.s, "file", 4) == 0) {
+			tmp.cfile = pit->body;
 		}
 	}
 	if(tmp.tname.s == NULL) {
 		LM_ERR("invalid mtree name\n");
 		goto error;
 	}
-	if(tmp.mode == 0) {
+	if(tmp.cfile.s != NULL) {
+		if(tmp.mode != 0 || tmp.type == MT_TREE_DW) {
+			LM_ERR("file trees must have mode 0 and type 0 or 2\n");
+			goto error;
+		}
+	} else if(tmp.mode == 0) {
 		if(tmp.dbtable.s == NULL) {
 			LM_ERR("no db table provided\n");
 			goto error;
@@ -853,6 +879,17 @@ int mt_table_spec(char *val)
 			LM_ERR("cannot init the tree [%.*s]\n", tmp.tname.len, tmp.tname.s);
 			goto error;
 		}
+		if(tmp.cfile.s != NULL) {
+			ndl->cfile.s = (char *)shm_malloc(tmp.cfile.len + 1);
+			if(ndl->cfile.s == NULL) {
+				SHM_MEM_ERROR;
+				mt_free_tree(ndl);
+				goto error;
+			}
+			memcpy(ndl->cfile.s, tmp.cfile.s, tmp.cfile.len);
+			ndl->cfile.s[tmp.cfile.len] = '\0';
+			ndl->cfile.len = tmp.cfile.len;
+		}
 
 		ndl->next = it;
 
@@ -1016,6 +1053,9 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 	}
 	prefix = *tomatch;
 
+	if(pt->cfile.s != NULL)
+		return mt_cimg_rpc_add_tvalues(rpc, ctx, pt, tomatch);
+
 	l = 0;
 	itn = pt->head;
 
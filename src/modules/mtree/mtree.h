@@ -81,6 +81,8 @@ typedef struct _m_tree
 	unsigned int memsize;
 	unsigned int reload_count;
 	uint64_t reload_time;
+	str cfile;			/* compact image file */
+	unsigned int cgen; /* generation of the image, incremented on reload */
 	mt_node_t *head;
 	struct _m_tree *next;
 } m_tree_t;
@@ -118,4 +120,12 @@ m_tree_t *mt_add_tree(m_tree_t **dpt, str *tname, str *dbtable, str *cols,
 
 int mt_rpc_match_prefix(
 		rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch, int mode);
+
+int mt_char_index(unsigned char c);
+
+/* trees loaded from compact image files */
+int mt_cimg_load(m_tree_t *pt);
+is_t *mt_cimg_get_tvalue(m_tree_t *pt, str *tomatch, int *len);
+int mt_cimg_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch);
+int mt_cimg_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch);
 #endif
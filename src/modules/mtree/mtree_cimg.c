@@ -0,0 +1,436 @@
+/**
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Trees loaded from compact image files (see mtree_cimg.h). The file is
+ * mapped read-only in each process, so the pages are shared through the
+ * page cache. A reload validates the file and increments the generation
+ * of the tree in shm, then every process maps the new file at its next
+ * lookup and unmaps the old one. The compiler writes a new file and
+ * renames it over the old one, so the existing mappings stay valid.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/ut.h"
+#include "../../core/pvar.h"
+#include "../../core/usr_avp.h"
+
+#include "mtree.h"
+#include "mtree_cimg.h"
+
+extern pv_spec_t pv_values;
+
+typedef struct mt_cimg_map
+{
+	m_tree_t *pt;
+	unsigned int gen;
+	char *addr;
+	size_t size;
+	mt_cimg_hdr_t *hdr;
+	mt_cimg_node_t *nodes;
+	unsigned char *labels;
+	uint32_t *vlists;
+	uint32_t *stroffs;
+	char *strings;
+	struct mt_cimg_map *next;
+} mt_cimg_map_t;
+
+/* values found on the path of the matched string */
+typedef struct mt_cimg_match
+{
+	int n;
+	int plen[MT_MAX_DEPTH];
+	uint32_t *vlist[MT_MAX_DEPTH];
+} mt_cimg_match_t;
+
+/* mappings of the current process */
+static mt_cimg_map_t *_mt_cimg_maps = NULL;
+
+/**
+ * map the image file and check its header
+ */
+static int mt_cimg_map_file(str *fname, mt_cimg_map_t *cm)
+{
+	struct stat st;
+	mt_cimg_hdr_t *h;
+	char *addr;
+	int fd;
+
+	fd = open(fname->s, O_RDONLY);
+	if(fd < 0) {
+		LM_ERR("cannot open mtree file [%.*s]: %s\n", fname->len, fname->s,
+				strerror(errno));
+		return -1;
+	}
+	if(fstat(fd, &st) < 0) {
+		LM_ERR("cannot stat mtree file [%.*s]: %s\n", fname->len, fname->s,
+				strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if(st.st_size < (off_t)sizeof(mt_cimg_hdr_t)) {
+		LM_ERR("mtree file [%.*s] too small\n", fname->len, fname->s);
+		close(fd);
+		return -1;
+	}
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED) {
+		LM_ERR("cannot map mtree file [%.*s]: %s\n", fname->len, fname->s,
+				strerror(errno));
+		return -1;
+	}
+	h = (mt_cimg_hdr_t *)addr;
+	if(h->magic != MT_CIMG_MAGIC || h->version != MT_CIMG_VERSION
+			|| h->size != (uint64_t)st.st_size || MT_CIMG_SIZE(h) != h->size
+			|| h->nnodes == 0 || h->maxlen >= MT_MAX_DEPTH) {
+		LM_ERR("invalid mtree file [%.*s]\n", fname->len, fname->s);
+		munmap(addr, st.st_size);
+		return -1;
+	}
+#ifdef MADV_RANDOM
+	madvise(addr, st.st_size, MADV_RANDOM);
+#endif
+	cm->addr = addr;
+	cm->size = st.st_size;
+	cm->hdr = h;
+	cm->nodes = (mt_cimg_node_t *)(addr + MT_CIMG_NODES_OFF(h));
+	cm->labels = (unsigned char *)(addr + MT_CIMG_LABELS_OFF(h));
+	cm->vlists = (uint32_t *)(addr + MT_CIMG_VLISTS_OFF(h));
+	cm->stroffs = (uint32_t *)(addr + MT_CIMG_STROFFS_OFF(h));
+	cm->strings = addr + MT_CIMG_STRINGS_OFF(h);
+	return 0;
+}
+
+/**
+ * mapping of the tree image in the current process, (re)mapped when the
+ * tree was reloaded
+ */
+static mt_cimg_map_t *mt_cimg_get(m_tree_t *pt)
+{
+	mt_cimg_map_t *cm;
+	mt_cimg_map_t nm;
+
+	for(cm = _mt_cimg_maps; cm != NULL; cm = cm->next) {
+		if(cm->pt == pt)
+			break;
+	}
+	if(cm != NULL && cm->gen == pt->cgen)
+		return cm;
+
+	memset(&nm, 0, sizeof(mt_cimg_map_t));
+	if(mt_cimg_map_file(&pt->cfile, &nm) < 0) {
+		if(cm != NULL) {
+			/* keep serving the old data */
+			LM_ERR("using previous data for mtree [%.*s]\n", pt->tname.len,
+					pt->tname.s);
+			cm->gen = pt->cgen;
+		}
+		return cm;
+	}
+	if(cm == NULL) {
+		cm = (mt_cimg_map_t *)pkg_malloc(sizeof(mt_cimg_map_t));
+		if(cm == NULL) {
+			PKG_MEM_ERROR;
+			munmap(nm.addr, nm.size);
+			return NULL;
+		}
+		memset(cm, 0, sizeof(mt_cimg_map_t));
+		cm->pt = pt;
+		cm->next = _mt_cimg_maps;
+		_mt_cimg_maps = cm;
+	} else {
+		munmap(cm->addr, cm->size);
+	}
+	nm.pt = cm->pt;
+	nm.next = cm->next;
+	nm.gen = pt->cgen;
+	memcpy(cm, &nm, sizeof(mt_cimg_map_t));
+	LM_DBG("mapped mtree [%.*s] generation %u (%lu bytes)\n", pt->tname.len,
+			pt->tname.s, cm->gen, (unsigned long)cm->size);
+	return cm;
+}
+
+/**
+ * validate the image file of the tree and switch to it
+ */
+int mt_cimg_load(m_tree_t *pt)
+{
+	mt_cimg_map_t nm;
+
+	mt_char_table_init(0);
+	memset(&nm, 0, sizeof(mt_cimg_map_t));
+	if(mt_cimg_map_file(&pt->cfile, &nm) < 0) {
+		return -1;
+	}
+	pt->nrnodes = nm.hdr->nnodes;
+	pt->nritems = nm.hdr->nitems;
+	pt->memsize = (nm.size > 0xffffffffUL) ? 0xffffffffU
+										   : (unsigned int)nm.size;
+	munmap(nm.addr, nm.size);
+	pt->reload_count++;
+	pt->reload_time = (uint64_t)time(NULL);
+	pt->cgen++;
+
+	/* map it now, in mod_init it is inherited by the children */
+	if(mt_cimg_get(pt) == NULL) {
+		return -1;
+	}
+	LM_DBG("mtree [%.*s] loaded from [%.*s] - %u nodes, %u items\n",
+			pt->tname.len, pt->tname.s, pt->cfile.len, pt->cfile.s,
+			pt->nrnodes, pt->nritems);
+	return 0;
+}
+
+/**
+ * walk the string down the tree, collecting the values on the path
+ * - returns -1 for a char not in the char list, 0 otherwise
+ */
+static int mt_cimg_match(
+		mt_cimg_map_t *cm, str *tomatch, mt_cimg_match_t *mm)
+{
+	mt_cimg_hdr_t *h;
+	mt_cimg_node_t *nd;
+	mt_cimg_node_t *c;
+	unsigned char *lb;
+	unsigned int lo, hi, mid;
+	int l, k;
+
+	h = cm->hdr;
+	nd = &cm->nodes[0];
+	mm->n = 0;
+	l = 0;
+	while(l < tomatch->len && l < MT_MAX_DEPTH && nd->nchild > 0) {
+		if(mt_char_index((unsigned char)tomatch->s[l]) < 0) {
+			LM_DBG("not matching char at %d in [%.*s]\n", l, tomatch->len,
+					tomatch->s);
+			return -1;
+		}
+		if((uint64_t)nd->child + nd->nchild > h->nnodes)
+			return 0;
+		/* children are sorted by the first char of the label */
+		lo = nd->child;
+		hi = nd->child + nd->nchild;
+		c = NULL;
+		while(lo < hi) {
+			mid = (lo + hi) / 2;
+			if(cm->nodes[mid].label >= h->nlabels)
+				return 0;
+			if(cm->labels[cm->nodes[mid].label]
+					< (unsigned char)tomatch->s[l]) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		if(lo < nd->child + nd->nchild && cm->nodes[lo].label < h->nlabels
+				&& cm->labels[cm->nodes[lo].label]
+						   == (unsigned char)tomatch->s[l]) {
+			c = &cm->nodes[lo];
+		}
+		if(c == NULL || l + c->llen > tomatch->len
+				|| (uint64_t)c->label + c->llen > h->nlabels)
+			break;
+		lb = cm->labels + c->label;
+		for(k = 1; k < c->llen; k++) {
+			if(lb[k] != (unsigned char)tomatch->s[l + k]) {
+				if(mt_char_index((unsigned char)tomatch->s[l + k]) < 0)
+					return -1;
+				return 0;
+			}
+		}
+		l += c->llen;
+		nd = c;
+		if(nd->vlist != 0 && nd->vlist <= h->nvlists) {
+			mm->plen[mm->n] = l;
+			mm->vlist[mm->n] = &cm->vlists[nd->vlist - 1];
+			mm->n++;
+		}
+	}
+	return 0;
+}
+
+/**
+ * the value with id sid
+ */
+static int mt_cimg_str(mt_cimg_map_t *cm, uint32_t sid, str *s)
+{
+	if(sid >= cm->hdr->nstrings || cm->stroffs[sid + 1] < cm->stroffs[sid]
+			|| cm->stroffs[sid + 1] > cm->hdr->strsize)
+		return -1;
+	s->s = cm->strings + cm->stroffs[sid];
+	s->len = cm->stroffs[sid + 1] - cm->stroffs[sid];
+	return 0;
+}
+
+/**
+ * number of values in the list, checking the bounds
+ */
+static int mt_cimg_vcount(mt_cimg_map_t *cm, uint32_t *vl)
+{
+	if((uint64_t)(vl - cm->vlists) + 1 + vl[0] > cm->hdr->nvlists)
+		return 0;
+	return (int)vl[0];
+}
+
+/**
+ * first value of the longest matching prefix
+ */
+is_t *mt_cimg_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
+{
+	static is_t tvalue;
+	static mt_cimg_match_t mm;
+	mt_cimg_map_t *cm;
+	uint32_t *vl;
+
+	cm = mt_cimg_get(pt);
+	if(cm == NULL)
+		return NULL;
+	if(mt_cimg_match(cm, tomatch, &mm) < 0 || mm.n == 0)
+		return NULL;
+	vl = mm.vlist[mm.n - 1];
+	if(mt_cimg_vcount(cm, vl) == 0 || mt_cimg_str(cm, vl[1], &tvalue.s) < 0)
+		return NULL;
+	if(pt->type == MT_TREE_IVAL) {
+		if(str2sint(&tvalue.s, &tvalue.n) < 0)
+			return NULL;
+	}
+	*len = mm.plen[mm.n - 1];
+	return &tvalue;
+}
+
+/**
+ * add all the values of the matching prefixes to the values avp
+ */
+int mt_cimg_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
+{
+	static mt_cimg_match_t mm;
+	mt_cimg_map_t *cm;
+	avp_value_t val;
+	avp_name_t values_avp_name;
+	avp_flags_t values_name_type;
+	str s;
+	int ival;
+	int i, j, c, n;
+
+	if(pv_get_avp_name(msg, &pv_values.pvp, &values_avp_name, &values_name_type)
+			< 0) {
+		LM_ERR("cannot get values avp name\n");
+		return -1;
+	}
+
+	destroy_avps(values_name_type, values_avp_name, 1);
+
+	cm = mt_cimg_get(pt);
+	if(cm == NULL)
+		return -1;
+	if(mt_cimg_match(cm, tomatch, &mm) < 0) {
+		LM_ERR("invalid char in [%.*s]\n", tomatch->len, tomatch->s);
+		return -1;
+	}
+	n = 0;
+	for(i = 0; i < mm.n; i++) {
+		c = mt_cimg_vcount(cm, mm.vlist[i]);
+		for(j = 1; j <= c; j++) {
+			if(mt_cimg_str(cm, mm.vlist[i][j], &s) < 0)
+				continue;
+			if(pt->type == MT_TREE_IVAL) {
+				if(str2sint(&s, &ival) < 0)
+					continue;
+				val.n = ival;
+				add_avp(values_name_type, values_avp_name, val);
+			} else {
+				val.s = s;
+				add_avp(values_name_type | AVP_VAL_STR, values_avp_name, val);
+			}
+			n++;
+		}
+	}
+	return (n > 0) ? 0 : -1;
+}
+
+/**
+ * add all the values of the matching prefixes to the rpc response
+ */
+int mt_cimg_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
+{
+	static mt_cimg_match_t mm;
+	mt_cimg_map_t *cm;
+	void *vstruct = NULL;
+	str prefix;
+	str s;
+	int ival;
+	int i, j, c;
+
+	cm = mt_cimg_get(pt);
+	if(cm == NULL)
+		return -1;
+	if(mt_cimg_match(cm, tomatch, &mm) < 0) {
+		LM_ERR("invalid char in [%.*s]\n", tomatch->len, tomatch->s);
+		return -1;
+	}
+	prefix = *tomatch;
+	for(i = 0; i < mm.n; i++) {
+		c = mt_cimg_vcount(cm, mm.vlist[i]);
+		for(j = 1; j <= c; j++) {
+			if(mt_cimg_str(cm, mm.vlist[i][j], &s) < 0)
+				continue;
+			prefix.len = mm.plen[i];
+			if(rpc->add(ctx, "{", &vstruct) < 0) {
+				rpc->fault(ctx, 500, "Internal error adding struct");
+				return -1;
+			}
+			if(rpc->struct_add(vstruct, "S", "PREFIX", &prefix) < 0) {
+				rpc->fault(ctx, 500, "Internal error adding prefix");
+				return -1;
+			}
+			if(pt->type == MT_TREE_IVAL) {
+				ival = 0;
+				str2sint(&s, &ival);
+				if(rpc->struct_add(vstruct, "d", "TVALUE", ival) < 0) {
+					rpc->fault(ctx, 500, "Internal error adding tvalue");
+					return -1;
+				}
+			} else {
+				if(rpc->struct_add(vstruct, "S", "TVALUE", &s) < 0) {
+					rpc->fault(ctx, 500, "Internal error adding tvalue");
+					return -1;
+				}
+			}
+		}
+	}
+
+	if(vstruct == NULL)
+		return -1;
+
+	return 0;
+}
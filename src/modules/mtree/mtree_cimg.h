@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Layout of the compact mtree image files, built offline by
+ * utils/mtree_compile and mapped read-only by the mtree module.
+ *
+ * The file has a header followed by sections aligned to 8 bytes:
+ *  - nodes: path compressed trie, root first, the children of a node are
+ *    stored contiguously and sorted by the first char of their label
+ *  - labels: the chars on the edges to the nodes
+ *  - vlists: for each prefix with values, the number of values followed
+ *    by the ids of the strings, the last added value first
+ *  - stroffs: offsets of the strings in the strings pool, nstrings + 1
+ *  - strings: the distinct values, not zero terminated
+ *
+ * This header is also used by the standalone compiler, so it must not
+ * depend on other Kamailio headers.
+ */
+
+#ifndef _MTREE_CIMG_H_
+#define _MTREE_CIMG_H_
+
+#include <stdint.h>
+
+#define MT_CIMG_MAGIC 0x43544d4bU /* "KMTC" */
+#define MT_CIMG_VERSION 1
+
+#define MT_CIMG_ALIGN(x) (((x) + 7) & ~((uint64_t)7))
+
+typedef struct mt_cimg_hdr
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nnodes;
+	uint32_t nlabels;
+	uint32_t nvlists; /* number of uint32_t in the vlists section */
+	uint32_t nstrings;
+	uint32_t nitems; /* number of prefix - value pairs */
+	uint32_t maxlen; /* longest prefix */
+	uint64_t strsize;
+	uint64_t size; /* total size of the file */
+	uint64_t ctime;
+} mt_cimg_hdr_t;
+
+typedef struct mt_cimg_node
+{
+	uint32_t child;	 /* index of the first child */
+	uint32_t label;	 /* offset of the label */
+	uint32_t vlist;	 /* offset of the values plus 1, 0 if none */
+	uint16_t nchild; /* number of children */
+	uint8_t llen;	 /* length of the label */
+	uint8_t pad;
+} mt_cimg_node_t;
+
+/* offsets of the sections */
+#define MT_CIMG_NODES_OFF(h) MT_CIMG_ALIGN(sizeof(mt_cimg_hdr_t))
+#define MT_CIMG_LABELS_OFF(h) \
+	(MT_CIMG_NODES_OFF(h) + (uint64_t)(h)->nnodes * sizeof(mt_cimg_node_t))
+#define MT_CIMG_VLISTS_OFF(h) \
+	MT_CIMG_ALIGN(MT_CIMG_LABELS_OFF(h) + (uint64_t)(h)->nlabels)
+#define MT_CIMG_STROFFS_OFF(h) \
+	(MT_CIMG_VLISTS_OFF(h) + (uint64_t)(h)->nvlists * sizeof(uint32_t))
+#define MT_CIMG_STRINGS_OFF(h)   \
+	MT_CIMG_ALIGN(MT_CIMG_STROFFS_OFF(h) \
+				  + ((uint64_t)(h)->nstrings + 1) * sizeof(uint32_t))
+#define MT_CIMG_SIZE(h) (MT_CIMG_STRINGS_OFF(h) + (h)->strsize)
+
+#endif
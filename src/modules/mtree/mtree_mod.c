@@ -53,6 +53,8 @@ MODULE_VERSION
 
 int mt_fetch_rows = 1000;
 static int mt_connect_mode = 0;
+/* set to 0 when all trees are loaded from files or in-memory only */
+static int mt_db_needed = 1;
 
 /** database connection */
 static db1_con_t *db_con = NULL;
@@ -212,6 +214,31 @@ static int mod_init(void)
 	if(mt_fetch_rows <= 0)
 		mt_fetch_rows = 1000;
 
+	if(mt_defined_trees()) {
+		mt_db_needed = 0;
+		for(pt = mt_get_first_tree(); pt != NULL; pt = pt->next) {
+			if(pt->mode == 0 && pt->cfile.s == NULL)
+				mt_db_needed = 1;
+		}
+	}
+	if(mt_db_needed == 0) {
+		LM_DBG("no tree loaded from database\n");
+		if((mt_lock = lock_alloc()) == 0 || lock_init(mt_lock) == 0) {
+			LM_CRIT("failed to init lock\n");
+			return -1;
+		}
+		for(pt = mt_get_first_tree(); pt != NULL; pt = pt->next) {
+			if(mt_load_db(pt) != 0) {
+				LM_ERR("cannot load tree [%.*s]\n", pt->tname.len, pt->tname.s);
+				mt_destroy_trees();
+				return -1;
+			}
+		}
+		db_table.s = "";
+		db_table.len = 0;
+		return 0;
+	}
+
 	/* binding to database module */
 	if(db_bind_mod(&db_url, &mt_dbf)) {
 		LM_ERR("database module not found\n");
@@ -307,6 +334,9 @@ static int child_init(int rank)
 	if(rank == PROC_INIT || rank == PROC_MAIN || rank == PROC_TCP_MAIN)
 		return 0;
 
+	if(mt_db_needed == 0)
+		return 0;
+
 	if(mt_connect_mode == 1) {
 		LM_DBG("mtree: database connection deferred until reload "
 			   "(connect_mode=1) "
@@ -540,6 +570,9 @@ static int mt_load_db(m_tree_t *pt)
 	m_tree_t *old_tree = NULL;
 	mt_node_t *bk_head = NULL;
 
+	if(pt->cfile.s != NULL) {
+		return mt_cimg_load(pt);
+	}
 	if(pt->mode == 1) {
 		LM_DBG("skip loading db records - in-memory only tree: [%.*s]\n",
 				pt->tname.len, pt->tname.s);
@@ -907,6 +940,11 @@ void rpc_mtree_summary(rpc_t *rpc, void *c)
 				rpc->fault(c, 500, "Internal error adding items");
 				return;
 			}
+			if(pt->cfile.s != NULL
+					&& rpc->struct_add(ih, "S", "file", &pt->cfile) < 0) {
+				rpc->fault(c, 500, "Internal error adding file");
+				return;
+			}
 		}
 		pt = pt->next;
 	}
@@ -35,6 +35,13 @@
 #include "../../core/mod_fix.h"
 #include "../../core/lvalue.h"
 #include "../../core/kemi.h"
+#include "../../core/pvar.h"
+#include "../../core/pt.h"
+#include "../../core/fmsg.h"
+#include "../../core/route.h"
+#include "../../core/receive.h"
+#include "../../core/cfg/cfg_struct.h"
+#include "../../modules/tm/tm_load.h"
 #include <sys/time.h>
 #include <poll.h>
 #include <stdlib.h>
@@ -47,18 +54,37 @@
 
 #include "common.h"
 #include "config.h"
+#include "pdb_cache.h"
 
 MODULE_VERSION
 
+/*! entries for the queries in flight, if the answers are not cached */
+#define PDB_ASYNC_INFLIGHT 1024
+/*! buckets of the dispatcher table of the queries in flight */
+#define PDB_ASYNC_HASH 256
+
 static char *modp_server = NULL; /*!< format: \<host\>:\<port\>,... */
 static int timeoutlogs = -10;	 /*!< for aggregating timeout logs */
 static int *active = NULL;
 static uint16_t *global_id = NULL;
 
+static int pdb_cache_size = 0;			/*!< cached answers, 0 disables */
+static int pdb_cache_ttl = 3600;		/*!< lifetime of the answers */
+static int pdb_cache_negative_ttl = 300; /*!< lifetime of "not found" */
+static int pdb_async = 0; /*!< dispatcher process for pdb_query_async() */
+
+/*! pipe for passing the new queries to the dispatcher */
+static int pdb_async_pipe[2] = {-1, -1};
+/*! answer for the route resumed by pdb_query_async() */
+static int pdb_async_carrier = 0;
+
+static struct tm_binds tmb;
+
 ksr_loglevels_t _ksr_loglevels_pdb = KSR_LOGLEVELS_DEFAULTS;
 
 /* ---- exported commands: */
 int pdb_query(sip_msg_t *_msg, str *_number, str *_dstvar);
+static int w_pdb_query_async(sip_msg_t *_msg, char *_number, char *_route);
 
 /* ---- fixup functions: */
 int pdb_query_fixup(void **arg, int arg_no);
@@ -67,6 +93,11 @@ int pdb_query_fixup_free(void **arg, int arg_no);
 /* ---- KEMI related functions: */
 int ki_pdb_query(sip_msg_t *_msg, str *number, str *dstvar);
 int ki_pdb_query_helper(sip_msg_t *_msg, str *number, pv_spec_t *dvar);
+static int ki_pdb_query_async(sip_msg_t *_msg, str *number, str *route);
+
+/* ---- pseudo-variables: */
+static int pv_get_pdb_carrier(
+		sip_msg_t *msg, pv_param_t *param, pv_value_t *res);
 
 /* ---- misc. functions: */
 int do_pdb_query(str *number);
@@ -89,6 +120,9 @@ static int pdb_msg_format_send(struct pdb_msg *msg, uint8_t version,
 static cmd_export_t cmds[] = {
 		{"pdb_query", (cmd_function)pdb_query, 2, pdb_query_fixup,
 				pdb_query_fixup_free, REQUEST_ROUTE | FAILURE_ROUTE},
+		{"pdb_query_async", (cmd_function)w_pdb_query_async, 2,
+				fixup_spve_spve, fixup_free_spve_spve,
+				REQUEST_ROUTE | FAILURE_ROUTE},
 		{0, 0, 0, 0, 0, 0}};
 
 
@@ -97,9 +131,19 @@ static param_export_t params[] = {
 	{"server", PARAM_STRING, &modp_server},
 	{"timeout", PARAM_INT, &default_pdb_cfg.timeout},
 	{"ll_info", PARAM_INT, &_ksr_loglevels_pdb.ll_info},
+	{"cache_size", PARAM_INT, &pdb_cache_size},
+	{"cache_ttl", PARAM_INT, &pdb_cache_ttl},
+	{"cache_negative_ttl", PARAM_INT, &pdb_cache_negative_ttl},
+	{"async", PARAM_INT, &pdb_async},
 
 	{0, 0, 0}
 };
+
+static pv_export_t mod_pvs[] = {
+	{{"pdb_carrier", sizeof("pdb_carrier") - 1}, PVT_OTHER,
+		pv_get_pdb_carrier, 0, 0, 0, 0, 0},
+	{{0, 0}, 0, 0, 0, 0, 0, 0, 0}
+};
 /* clang-format on */
 
 struct module_exports exports = {
@@ -108,7 +152,7 @@ struct module_exports exports = {
 		cmds,			 /* cmd (cfg function) exports */
 		params,			 /* param exports */
 		0,				 /* RPC method exports */
-		0,				 /* pseudo-variables exports */
+		mod_pvs,		 /* pseudo-variables exports */
 		0,				 /* response handling function */
 		mod_init,		 /* Module initialization function */
 		child_init,		 /* Child initialization function */
@@ -285,6 +329,11 @@ int do_pdb_query(str *number)
 	if((active == NULL) || (*active == 0))
 		return 0;
 
+	if((carrierid = pdb_cache_get(number)) != 0) {
+		LM_DBG("cached answer for '%.*s'\n", number->len, number->s);
+		return carrierid;
+	}
+
 	LM_DBG("querying '%.*s'...\n", number->len, number->s);
 	if(server_list == NULL)
 		return 0;
@@ -480,6 +529,7 @@ found:
 						  + (tnow.tv_sec - tstart.tv_sec) * 1000000))
 						/ 1000);
 	}
+	pdb_cache_put(number, carrierid);
 	return carrierid;
 }
 
@@ -536,6 +586,473 @@ int pdb_query_fixup_free(void **arg, int arg_no)
 }
 
 
+/*! a query sent by the dispatcher process */
+typedef struct pdb_async_query
+{
+	struct pdb_async_query *next;  /*!< the next query sent */
+	struct pdb_async_query *hnext; /*!< next in the same id bucket */
+	pdb_cache_entry_t *query;	   /*!< NULL once answered */
+	uint16_t id;
+	long long deadline; /*!< in ms */
+} pdb_async_query_t;
+
+/*! queries of the dispatcher in the order they were sent */
+static pdb_async_query_t *pdb_async_first = NULL;
+static pdb_async_query_t *pdb_async_last = NULL;
+/*! queries of the dispatcher waiting for an answer, by id */
+static pdb_async_query_t *pdb_async_table[PDB_ASYNC_HASH];
+static uint16_t pdb_async_id = 0;
+
+
+static long long pdb_async_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+
+/**
+ * Sets the answer of a query in flight and resumes the transactions
+ * waiting for it.
+ */
+static void pdb_async_resume(pdb_cache_entry_t *query, carrier_t carrierid)
+{
+	pdb_waiter_t *w;
+	pdb_waiter_t *next;
+	sr_kemi_eng_t *keng = NULL;
+	str cbname = STR_NULL;
+	str evname = str_init("pdb:async-query");
+
+	for(w = pdb_cache_answer(query, carrierid); w != NULL; w = next) {
+		next = w->next;
+		pdb_async_carrier = carrierid;
+		if(w->act != NULL) {
+			tmb.t_continue(w->tindex, w->tlabel, w->act);
+			ksr_msg_env_reset();
+		} else {
+			keng = sr_kemi_eng_get();
+			if(keng != NULL && w->cbname_len > 0) {
+				cbname.s = w->cbname;
+				cbname.len = w->cbname_len;
+				tmb.t_continue_cb(w->tindex, w->tlabel, &cbname, &evname);
+				ksr_msg_env_reset();
+			} else {
+				LM_WARN("no callback to be executed\n");
+			}
+		}
+		shm_free(w);
+	}
+	pdb_async_carrier = 0;
+}
+
+
+static void pdb_async_unlink(pdb_async_query_t *q)
+{
+	pdb_async_query_t **pq;
+
+	for(pq = &pdb_async_table[q->id % PDB_ASYNC_HASH]; *pq != NULL;
+			pq = &(*pq)->hnext) {
+		if(*pq == q) {
+			*pq = q->hnext;
+			return;
+		}
+	}
+}
+
+
+/**
+ * Sends the query for a number to all the servers.
+ */
+static void pdb_async_send(pdb_cache_entry_t *query)
+{
+	pdb_async_query_t *q;
+	struct pdb_msg msg;
+	struct server_item_t *server;
+	char buf[PDB_CACHE_NUMBER_SIZE];
+	int ret;
+
+	q = (pdb_async_query_t *)pkg_malloc(sizeof(pdb_async_query_t));
+	if(q == NULL) {
+		PKG_MEM_ERROR;
+		pdb_async_resume(query, 0);
+		return;
+	}
+	memset(q, 0, sizeof(pdb_async_query_t));
+	q->query = query;
+	q->id = pdb_async_id++;
+	q->deadline = pdb_async_now() + cfg_get(pdb, pdb_cfg, timeout);
+
+	memcpy(buf, query->number, query->len);
+	buf[query->len] = '\0';
+	LM_DBG("querying '%s'...\n", buf);
+	pdb_msg_format_send(&msg, PDB_VERSION, PDB_TYPE_REQUEST_ID,
+			PDB_CODE_DEFAULT, htons(q->id), buf, query->len + 1);
+	pdb_msg_dbg(&msg, "Kamailio pdb client sends:");
+
+	for(server = server_list->head; server != NULL; server = server->next) {
+		ret = sendto(server->sock, (struct pdb_msg *)&msg, msg.hdr.length,
+				MSG_DONTWAIT, (struct sockaddr *)&(server->dstaddr),
+				server->dstaddrlen);
+		if(ret < 0) {
+			LM_ERR("sendto() failed with errno=%d (%s)\n", errno,
+					strerror(errno));
+		}
+	}
+
+	q->hnext = pdb_async_table[q->id % PDB_ASYNC_HASH];
+	pdb_async_table[q->id % PDB_ASYNC_HASH] = q;
+	if(pdb_async_last != NULL)
+		pdb_async_last->next = q;
+	else
+		pdb_async_first = q;
+	pdb_async_last = q;
+}
+
+
+/**
+ * Matches an answer with its query, only the first answer of the servers
+ * is used.
+ */
+static void pdb_async_reply(char *buf, int len)
+{
+	struct pdb_msg msg;
+	pdb_async_query_t *q;
+	pdb_cache_entry_t *query;
+	carrier_t carrierid;
+	uint16_t id;
+	short int _id;
+
+	if(len < sizeof(struct pdb_hdr))
+		return;
+	memset(&msg, 0, sizeof(struct pdb_msg));
+	memcpy(&msg, buf, len);
+	pdb_msg_dbg(&msg, "Kamailio pdb client receives:");
+
+	id = ntohs(msg.hdr.id);
+	for(q = pdb_async_table[id % PDB_ASYNC_HASH]; q != NULL; q = q->hnext) {
+		if(q->id == id)
+			break;
+	}
+	if(q == NULL) {
+		LM_DBG("no query waiting for the answer %u\n", id);
+		return;
+	}
+	query = q->query;
+
+	switch(msg.hdr.code) {
+		case PDB_CODE_OK:
+			msg.bdy.payload[sizeof(struct pdb_bdy) - 1] = '\0';
+			if(strlen(msg.bdy.payload) != query->len
+					|| memcmp(msg.bdy.payload, query->number, query->len)
+							   != 0) {
+				LM_DBG("answer %u is not for the number queried\n", id);
+				return;
+			}
+			PDB_BUFTOSHORT(_id, msg.bdy.payload, query->len + 1);
+			carrierid = ntohs(_id); /* convert to host byte order */
+			break;
+		case PDB_CODE_NOT_FOUND:
+			LM_NOTICE("Number %.*s pdb_id not found\n", query->len,
+					query->number);
+			carrierid = -1;
+			break;
+		case PDB_CODE_NOT_NUMBER:
+			LM_NOTICE("Number %.*s has letters in it\n", query->len,
+					query->number);
+			carrierid = -2;
+			break;
+		default:
+			LM_NOTICE("Invalid code %d received\n", msg.hdr.code);
+			carrierid = -3;
+			break;
+	}
+
+	/* the entry stays in the send order list until its deadline */
+	pdb_async_unlink(q);
+	q->query = NULL;
+	pdb_async_resume(query, carrierid);
+}
+
+
+/**
+ * Fails the queries not answered in time.
+ */
+static void pdb_async_expire(long long now)
+{
+	pdb_async_query_t *q;
+
+	while(pdb_async_first != NULL && pdb_async_first->deadline <= now) {
+		q = pdb_async_first;
+		pdb_async_first = q->next;
+		if(pdb_async_first == NULL)
+			pdb_async_last = NULL;
+		if(q->query != NULL) {
+			timeoutlogs++;
+			if(timeoutlogs < 0) {
+				LM_ERR("exceeded %d ms timeout while waiting for response. "
+					   "queried nr '%.*s'.\n",
+						cfg_get(pdb, pdb_cfg, timeout), q->query->len,
+						q->query->number);
+			} else if(timeoutlogs > 1000) {
+				LM_ERR("exceeded %d ms timeout %d times while waiting for "
+					   "response. queried nr '%.*s'.\n",
+						cfg_get(pdb, pdb_cfg, timeout), timeoutlogs,
+						q->query->len, q->query->number);
+				timeoutlogs = 0;
+			}
+			pdb_async_unlink(q);
+			pdb_async_resume(q->query, 0);
+		}
+		pkg_free(q);
+	}
+}
+
+
+/**
+ * Main loop of the dispatcher process, sending the queries passed by the
+ * workers through the pipe and resuming the transactions on the answers.
+ */
+static int pdb_async_dispatcher(void)
+{
+	struct pollfd *fds;
+	pdb_cache_entry_t *queries[64];
+	char buf[sizeof(struct pdb_msg)];
+	long long now;
+	int timeout;
+	int nfds;
+	int i;
+	int n;
+
+	if(server_list == NULL || server_list->fds == NULL)
+		return -1;
+	nfds = server_list->nserver + 1;
+	fds = (struct pollfd *)pkg_malloc(nfds * sizeof(struct pollfd));
+	if(fds == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memset(fds, 0, nfds * sizeof(struct pollfd));
+	fds[0].fd = pdb_async_pipe[0];
+	fds[0].events = POLLIN;
+	for(i = 1; i < nfds; i++) {
+		fds[i].fd = server_list->fds[i - 1].fd;
+		fds[i].events = POLLIN;
+	}
+
+	for(;;) {
+		cfg_update();
+
+		timeout = -1;
+		if(pdb_async_first != NULL) {
+			timeout = (int)(pdb_async_first->deadline - pdb_async_now());
+			if(timeout < 0)
+				timeout = 0;
+		}
+		n = poll(fds, nfds, timeout);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			LM_ERR("poll() failed with errno=%d (%s)\n", errno,
+					strerror(errno));
+			continue;
+		}
+
+		if(fds[0].revents & POLLIN) {
+			n = read(pdb_async_pipe[0], queries, sizeof(queries));
+			for(i = 0; i < n / (int)sizeof(pdb_cache_entry_t *); i++)
+				pdb_async_send(queries[i]);
+		}
+		for(i = 1; i < nfds; i++) {
+			if(fds[i].revents & POLLIN) {
+				while((n = recv(fds[i].fd, buf, sizeof(buf), MSG_DONTWAIT))
+						> 0) {
+					pdb_async_reply(buf, n);
+				}
+			}
+		}
+
+		now = pdb_async_now();
+		pdb_async_expire(now);
+	}
+
+	return 0;
+}
+
+
+/**
+ * Suspends the transaction for pdb_cache_join().
+ */
+static int pdb_async_suspend(void *param, pdb_waiter_t *w)
+{
+	if(tmb.t_suspend((sip_msg_t *)param, &w->tindex, &w->tlabel) != 0) {
+		LM_ERR("failed to suspend the processing\n");
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * Runs the route for a cached answer, without suspending.
+ */
+static int pdb_async_run(
+		sip_msg_t *msg, cfg_action_t *act, str *rn, carrier_t carrierid)
+{
+	sr_kemi_eng_t *keng = NULL;
+	str evname = str_init("pdb:async-query");
+
+	pdb_async_carrier = carrierid;
+	if(act != NULL) {
+		run_top_route(act, msg, 0);
+	} else {
+		keng = sr_kemi_eng_get();
+		if(keng != NULL
+				&& sr_kemi_route(keng, msg, get_route_type(), rn, &evname)
+						   < 0) {
+			LM_ERR("error running kemi callback [%.*s]\n", rn->len, rn->s);
+		}
+	}
+	pdb_async_carrier = 0;
+	return 0;
+}
+
+
+/**
+ * Queries the carrier id of a number without blocking the worker and
+ * runs the route with the answer in $pdb_carrier.
+ *
+ * @return 0 to stop the execution of the current route, -1 on failure
+ */
+static int ki_pdb_query_async(sip_msg_t *msg, str *number, str *rn)
+{
+	cfg_action_t *act = NULL;
+	sr_kemi_eng_t *keng = NULL;
+	pdb_cache_entry_t *query = NULL;
+	pdb_waiter_t *w;
+	pdb_waiter_t *next;
+	tm_cell_t *t;
+	carrier_t carrierid;
+	int ri;
+	int ret;
+
+	if(pdb_async == 0) {
+		LM_ERR("the async mode is not enabled\n");
+		return -1;
+	}
+	if(faked_msg_match(msg)) {
+		LM_ERR("invalid usage for faked message\n");
+		return -1;
+	}
+	if((active == NULL) || (*active == 0))
+		return -1;
+
+	keng = sr_kemi_eng_get();
+	if(keng == NULL) {
+		ri = route_lookup(&main_rt, rn->s);
+		if(ri < 0) {
+			LM_ERR("route block not found: %.*s\n", rn->len, rn->s);
+			return -1;
+		}
+		act = main_rt.rlist[ri];
+		if(act == NULL) {
+			LM_ERR("empty action lists in route block [%.*s]\n", rn->len,
+					rn->s);
+			return -1;
+		}
+	} else if(rn->len >= PDB_CBNAME_SIZE) {
+		LM_ERR("callback name is too long: %.*s\n", rn->len, rn->s);
+		return -1;
+	}
+
+	if((carrierid = pdb_cache_get(number)) != 0)
+		return pdb_async_run(msg, act, rn, carrierid);
+
+	if(number->len >= PDB_CACHE_NUMBER_SIZE) {
+		LM_ERR("number too long '%.*s'.\n", number->len, number->s);
+		return -1;
+	}
+
+	w = (pdb_waiter_t *)shm_malloc(sizeof(pdb_waiter_t));
+	if(w == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(w, 0, sizeof(pdb_waiter_t));
+	w->act = act;
+	if(act == NULL) {
+		memcpy(w->cbname, rn->s, rn->len);
+		w->cbname[rn->len] = '\0';
+		w->cbname_len = rn->len;
+	}
+
+	t = tmb.t_gett();
+	if(t == NULL || t == T_UNDEFINED) {
+		if(tmb.t_newtran(msg) < 0) {
+			LM_ERR("cannot create the transaction\n");
+			shm_free(w);
+			return -1;
+		}
+	}
+
+	ret = pdb_cache_join(number, pdb_async_suspend, msg, w, &carrierid, &query);
+	if(ret < 0 || ret == PDB_CACHE_HIT) {
+		shm_free(w);
+		if(ret < 0)
+			return -1;
+		return pdb_async_run(msg, act, rn, carrierid);
+	}
+	if(ret == PDB_CACHE_QUERY) {
+		do {
+			ret = write(pdb_async_pipe[1], &query, sizeof(query));
+		} while(ret < 0 && errno == EINTR);
+		if(ret != sizeof(query)) {
+			LM_ERR("failed to pass the query to the dispatcher\n");
+			/* the suspended transactions are left to the fr timer */
+			for(w = pdb_cache_answer(query, 0); w != NULL; w = next) {
+				next = w->next;
+				shm_free(w);
+			}
+		}
+	}
+
+	/* force exit in config */
+	return 0;
+}
+
+
+/**
+ *
+ */
+static int w_pdb_query_async(sip_msg_t *_msg, char *_number, char *_route)
+{
+	str number;
+	str rn;
+
+	if(fixup_get_svalue(_msg, (gparam_t *)_number, &number) < 0) {
+		LM_ERR("cannot print the number\n");
+		return -1;
+	}
+	if(fixup_get_svalue(_msg, (gparam_t *)_route, &rn) < 0) {
+		LM_ERR("cannot get the route name\n");
+		return -1;
+	}
+
+	return ki_pdb_query_async(_msg, &number, &rn);
+}
+
+
+/**
+ *
+ */
+static int pv_get_pdb_carrier(
+		sip_msg_t *msg, pv_param_t *param, pv_value_t *res)
+{
+	return pv_get_sintval(msg, param, res, pdb_async_carrier);
+}
+
+
 /*!
  * Adds new server structure to server list.
  * \return 0 on success -1 otherwise
@@ -811,6 +1328,26 @@ static void pdb_rpc_deactivate(rpc_t *rpc, void *ctx)
 	*active = 0;
 }
 
+static void pdb_rpc_cache_stats(rpc_t *rpc, void *ctx)
+{
+	void *vh;
+	pdb_cache_stats_t st;
+
+	pdb_cache_get_stats(&st);
+	if(rpc->add(ctx, "{", &vh) < 0) {
+		rpc->fault(ctx, 500, "Server error");
+		return;
+	}
+	rpc->struct_add(vh, "ddddd", "hits", (int)st.hits, "misses",
+			(int)st.misses, "coalesced", (int)st.coalesced, "entries",
+			(int)st.entries, "pending", (int)st.pending);
+}
+
+static void pdb_rpc_cache_flush(rpc_t *rpc, void *ctx)
+{
+	pdb_cache_flush();
+}
+
 static const char *pdb_rpc_status_doc[2] = {"Get the pdb status.", 0};
 
 static const char *pdb_rpc_timeout_doc[2] = {"Set the pdb_query timeout.", 0};
@@ -819,10 +1356,18 @@ static const char *pdb_rpc_activate_doc[2] = {"Activate pdb.", 0};
 
 static const char *pdb_rpc_deactivate_doc[2] = {"Deactivate pdb.", 0};
 
+static const char *pdb_rpc_cache_stats_doc[2] = {
+		"Get the counters of the answer cache.", 0};
+
+static const char *pdb_rpc_cache_flush_doc[2] = {
+		"Remove the cached answers.", 0};
+
 rpc_export_t pdb_rpc[] = {{"pdb.status", pdb_rpc_status, pdb_rpc_status_doc, 0},
 		{"pdb.timeout", pdb_rpc_timeout, pdb_rpc_timeout_doc, 0},
 		{"pdb.activate", pdb_rpc_activate, pdb_rpc_activate_doc, 0},
 		{"pdb.deactivate", pdb_rpc_deactivate, pdb_rpc_deactivate_doc, 0},
+		{"pdb.cache_stats", pdb_rpc_cache_stats, pdb_rpc_cache_stats_doc, 0},
+		{"pdb.cache_flush", pdb_rpc_cache_flush, pdb_rpc_cache_flush_doc, 0},
 		{0, 0, 0, 0}};
 
 static int pdb_rpc_init(void)
@@ -836,6 +1381,8 @@ static int pdb_rpc_init(void)
 
 static int mod_init(void)
 {
+	int ret;
+
 	if(pdb_rpc_init() < 0) {
 		LM_ERR("failed to register RPC commands\n");
 		return -1;
@@ -865,13 +1412,61 @@ static int mod_init(void)
 		return -1;
 	}
 
+	if(pdb_async != 0) {
+		if(load_tm_api(&tmb) != 0) {
+			LM_ERR("cannot load the tm api\n");
+			return -1;
+		}
+		if(pipe(pdb_async_pipe) < 0) {
+			LM_ERR("pipe() failed with errno=%d (%s)\n", errno,
+					strerror(errno));
+			return -1;
+		}
+		register_procs(1);
+		cfg_register_child(1);
+	}
+
+	/* the queries in flight of the async mode need the entries */
+	if(pdb_cache_size > 0) {
+		ret = pdb_cache_init(
+				pdb_cache_size, pdb_cache_ttl, pdb_cache_negative_ttl);
+	} else {
+		ret = pdb_cache_init(pdb_async ? PDB_ASYNC_INFLIGHT : 0, 0, 0);
+	}
+	if(ret < 0) {
+		LM_ERR("failed to initialize the cache\n");
+		return -1;
+	}
+
 	return 0;
 }
 
 static int child_init(int rank)
 {
+	int pid;
+
 	if(rank == PROC_INIT || rank == PROC_TCP_MAIN)
 		return 0;
+
+	if(rank == PROC_MAIN && pdb_async != 0) {
+		pid = fork_process(PROC_NOCHLDINIT, "PDB Dispatcher", 1);
+		if(pid < 0)
+			return -1; /* error */
+		if(pid == 0) {
+			/* child */
+			if(init_child(PROC_RPC) < 0) {
+				LM_ERR("failed to do RPC child init for dispatcher\n");
+				return -1;
+			}
+			/* initialize the config framework */
+			if(cfg_child_init())
+				return -1;
+			if(pdb_async_dispatcher() < 0) {
+				LM_ERR("failed to run the dispatcher process\n");
+				return -1;
+			}
+		}
+	}
 	return rpc_child_init();
 }
 
@@ -893,6 +1488,7 @@ static void mod_destroy(void)
 {
 	destroy_server_socket();
 	destroy_server_list();
+	pdb_cache_destroy();
 	if(active)
 		shm_free(active);
 }
@@ -908,6 +1504,11 @@ static sr_kemi_t sr_kemi_pdb_exports[] = {
         { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
             SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
     },
+    { str_init("pdb"), str_init("pdb_query_async"),
+        SR_KEMIP_INT, ki_pdb_query_async,
+        { SR_KEMIP_STR, SR_KEMIP_STR, SR_KEMIP_NONE,
+            SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+    },
 
     { {0, 0}, {0, 0}, 0, NULL, { 0, 0, 0, 0, 0, 0 } }
 };
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief PDB :: Cache of the answers and of the queries in flight
+ * \ingroup PDB
+ *
+ * The cache is set associative: a number is hashed to a slot with its
+ * own lock and PDB_CACHE_WAYS entries, kept in a most recently used
+ * first list. A new number replaces a free or expired entry of the slot,
+ * or the least recently used answer. The entries of the queries in
+ * flight are never replaced, they hold the suspended transactions
+ * waiting for the answer.
+ */
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
+#include "../../core/hashes.h"
+#include "../../core/timer.h"
+#include "../../core/dprint.h"
+
+#include "pdb_cache.h"
+
+#define PDB_ENTRY_FREE 0
+#define PDB_ENTRY_ANSWER 1
+#define PDB_ENTRY_PENDING 2
+
+typedef struct pdb_cache_slot
+{
+	pdb_cache_entry_t *first; /* most recently used first */
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long coalesced;
+	gen_lock_t lock;
+} pdb_cache_slot_t;
+
+typedef struct pdb_cache
+{
+	unsigned int size; /* number of slots, power of 2 */
+	pdb_cache_slot_t *slots;
+	pdb_cache_entry_t *entries;
+} pdb_cache_t;
+
+static pdb_cache_t *_pdb_cache = NULL;
+static int _pdb_cache_ttl = 0;
+static int _pdb_cache_negative_ttl = 0;
+
+
+int pdb_cache_init(int size, int ttl, int negative_ttl)
+{
+	unsigned int nslots;
+	unsigned long msize;
+	unsigned int i;
+	unsigned int j;
+	pdb_cache_slot_t *slot;
+	pdb_cache_entry_t *e;
+
+	if(size <= 0)
+		return 0;
+
+	for(nslots = 1; nslots * PDB_CACHE_WAYS < (unsigned int)size; nslots <<= 1)
+		;
+
+	msize = sizeof(pdb_cache_t) + nslots * sizeof(pdb_cache_slot_t)
+			+ nslots * PDB_CACHE_WAYS * sizeof(pdb_cache_entry_t);
+	_pdb_cache = (pdb_cache_t *)shm_malloc(msize);
+	if(_pdb_cache == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_pdb_cache, 0, msize);
+	_pdb_cache->size = nslots;
+	_pdb_cache->slots = (pdb_cache_slot_t *)(_pdb_cache + 1);
+	_pdb_cache->entries = (pdb_cache_entry_t *)(_pdb_cache->slots + nslots);
+
+	for(i = 0; i < nslots; i++) {
+		slot = &_pdb_cache->slots[i];
+		lock_init(&slot->lock);
+		for(j = 0; j < PDB_CACHE_WAYS; j++) {
+			e = &_pdb_cache->entries[i * PDB_CACHE_WAYS + j];
+			e->next = slot->first;
+			slot->first = e;
+		}
+	}
+	_pdb_cache_ttl = ttl;
+	_pdb_cache_negative_ttl = negative_ttl;
+
+	LM_DBG("cache of %u entries in %u slots\n", nslots * PDB_CACHE_WAYS,
+			nslots);
+	return 0;
+}
+
+
+void pdb_cache_destroy(void)
+{
+	unsigned int i;
+
+	if(_pdb_cache == NULL)
+		return;
+	for(i = 0; i < _pdb_cache->size; i++)
+		lock_destroy(&_pdb_cache->slots[i].lock);
+	shm_free(_pdb_cache);
+	_pdb_cache = NULL;
+}
+
+
+/**
+ * lifetime of an answer in seconds, 0 if it is not cached
+ */
+static int pdb_cache_ttl(carrier_t carrierid)
+{
+	if(carrierid > 0)
+		return _pdb_cache_ttl;
+	/* number not found or not a number */
+	if(carrierid == -1 || carrierid == -2)
+		return _pdb_cache_negative_ttl;
+	return 0;
+}
+
+
+static pdb_cache_slot_t *pdb_cache_slot(unsigned int hashid)
+{
+	return &_pdb_cache->slots[hashid & (_pdb_cache->size - 1)];
+}
+
+
+/**
+ * move an entry to the front of the list of its locked slot
+ */
+static void pdb_slot_front(pdb_cache_slot_t *slot, pdb_cache_entry_t *e)
+{
+	pdb_cache_entry_t *prev;
+
+	if(slot->first == e)
+		return;
+	for(prev = slot->first; prev->next != e; prev = prev->next)
+		;
+	prev->next = e->next;
+	e->next = slot->first;
+	slot->first = e;
+}
+
+
+/**
+ * find the entry of a number in a locked slot, moving it to the front
+ * of the list, or else the entry to be replaced by it in victim
+ */
+static pdb_cache_entry_t *pdb_slot_find(pdb_cache_slot_t *slot,
+		unsigned int hashid, str *number, pdb_cache_entry_t **victim)
+{
+	pdb_cache_entry_t *e;
+	unsigned int now;
+
+	now = get_ticks();
+	*victim = NULL;
+	for(e = slot->first; e != NULL; e = e->next) {
+		if(e->state == PDB_ENTRY_ANSWER && e->expires <= now)
+			e->state = PDB_ENTRY_FREE;
+		if(e->state != PDB_ENTRY_FREE && e->hashid == hashid
+				&& e->len == number->len
+				&& memcmp(e->number, number->s, number->len) == 0) {
+			pdb_slot_front(slot, e);
+			return e;
+		}
+		/* a free entry or else the least recently used answer */
+		if(e->state == PDB_ENTRY_FREE
+				|| (e->state == PDB_ENTRY_ANSWER
+						&& (*victim == NULL
+								|| (*victim)->state != PDB_ENTRY_FREE))) {
+			*victim = e;
+		}
+	}
+	return NULL;
+}
+
+
+static void pdb_entry_set(pdb_cache_slot_t *slot, pdb_cache_entry_t *e,
+		unsigned int hashid, str *number, unsigned char state)
+{
+	pdb_slot_front(slot, e);
+	e->hashid = hashid;
+	e->len = (unsigned char)number->len;
+	memcpy(e->number, number->s, number->len);
+	e->state = state;
+	e->waiters = NULL;
+}
+
+
+carrier_t pdb_cache_get(str *number)
+{
+	pdb_cache_slot_t *slot;
+	pdb_cache_entry_t *e;
+	pdb_cache_entry_t *victim;
+	unsigned int hashid;
+	carrier_t carrierid;
+
+	if(_pdb_cache == NULL || number->len >= PDB_CACHE_NUMBER_SIZE)
+		return 0;
+
+	carrierid = 0;
+	hashid = get_hash1_raw(number->s, number->len);
+	slot = pdb_cache_slot(hashid);
+	lock_get(&slot->lock);
+	e = pdb_slot_find(slot, hashid, number, &victim);
+	if(e != NULL && e->state == PDB_ENTRY_ANSWER) {
+		carrierid = e->carrierid;
+		slot->hits++;
+	} else {
+		slot->misses++;
+	}
+	lock_release(&slot->lock);
+
+	return carrierid;
+}
+
+
+void pdb_cache_put(str *number, carrier_t carrierid)
+{
+	pdb_cache_slot_t *slot;
+	pdb_cache_entry_t *e;
+	pdb_cache_entry_t *victim;
+	unsigned int hashid;
+	int ttl;
+
+	ttl = pdb_cache_ttl(carrierid);
+	if(_pdb_cache == NULL || ttl <= 0
+			|| number->len >= PDB_CACHE_NUMBER_SIZE)
+		return;
+
+	hashid = get_hash1_raw(number->s, number->len);
+	slot = pdb_cache_slot(hashid);
+	lock_get(&slot->lock);
+	e = pdb_slot_find(slot, hashid, number, &victim);
+	if(e == NULL && victim != NULL) {
+		e = victim;
+		pdb_entry_set(slot, e, hashid, number, PDB_ENTRY_ANSWER);
+	}
+	/* a query in flight gets its own answer */
+	if(e != NULL && e->state == PDB_ENTRY_ANSWER) {
+		e->carrierid = carrierid;
+		e->expires = get_ticks() + ttl;
+	}
+	lock_release(&slot->lock);
+}
+
+
+int pdb_cache_join(str *number, pdb_suspend_f suspend, void *param,
+		pdb_waiter_t *w, carrier_t *carrierid, pdb_cache_entry_t **query)
+{
+	pdb_cache_slot_t *slot;
+	pdb_cache_entry_t *e;
+	pdb_cache_entry_t *victim;
+	unsigned int hashid;
+	int ret;
+
+	if(_pdb_cache == NULL || number->len >= PDB_CACHE_NUMBER_SIZE)
+		return -1;
+
+	hashid = get_hash1_raw(number->s, number->len);
+	slot = pdb_cache_slot(hashid);
+	lock_get(&slot->lock);
+	e = pdb_slot_find(slot, hashid, number, &victim);
+	if(e != NULL && e->state == PDB_ENTRY_ANSWER) {
+		*carrierid = e->carrierid;
+		lock_release(&slot->lock);
+		return PDB_CACHE_HIT;
+	}
+	if(e == NULL && victim == NULL) {
+		lock_release(&slot->lock);
+		LM_ERR("all the entries of the slot are waiting for an answer\n");
+		return -1;
+	}
+	/* suspend with the slot locked, the answer can not arrive before */
+	if(suspend(param, w) < 0) {
+		lock_release(&slot->lock);
+		return -1;
+	}
+	if(e != NULL) {
+		w->next = e->waiters;
+		e->waiters = w;
+		slot->coalesced++;
+		ret = PDB_CACHE_JOINED;
+	} else {
+		e = victim;
+		pdb_entry_set(slot, e, hashid, number, PDB_ENTRY_PENDING);
+		w->next = NULL;
+		e->waiters = w;
+		*query = e;
+		ret = PDB_CACHE_QUERY;
+	}
+	lock_release(&slot->lock);
+
+	return ret;
+}
+
+
+pdb_waiter_t *pdb_cache_answer(pdb_cache_entry_t *query, carrier_t carrierid)
+{
+	pdb_cache_slot_t *slot;
+	pdb_waiter_t *w;
+	int ttl;
+
+	ttl = pdb_cache_ttl(carrierid);
+	slot = pdb_cache_slot(query->hashid);
+	lock_get(&slot->lock);
+	w = query->waiters;
+	query->waiters = NULL;
+	query->carrierid = carrierid;
+	if(ttl > 0) {
+		query->state = PDB_ENTRY_ANSWER;
+		query->expires = get_ticks() + ttl;
+	} else {
+		query->state = PDB_ENTRY_FREE;
+	}
+	lock_release(&slot->lock);
+
+	return w;
+}
+
+
+void pdb_cache_flush(void)
+{
+	pdb_cache_entry_t *e;
+	unsigned int i;
+
+	if(_pdb_cache == NULL)
+		return;
+	for(i = 0; i < _pdb_cache->size; i++) {
+		lock_get(&_pdb_cache->slots[i].lock);
+		for(e = _pdb_cache->slots[i].first; e != NULL; e = e->next) {
+			if(e->state == PDB_ENTRY_ANSWER)
+				e->state = PDB_ENTRY_FREE;
+		}
+		lock_release(&_pdb_cache->slots[i].lock);
+	}
+}
+
+
+void pdb_cache_get_stats(pdb_cache_stats_t *st)
+{
+	pdb_cache_slot_t *slot;
+	pdb_cache_entry_t *e;
+	unsigned int now;
+	unsigned int i;
+
+	memset(st, 0, sizeof(pdb_cache_stats_t));
+	if(_pdb_cache == NULL)
+		return;
+	now = get_ticks();
+	for(i = 0; i < _pdb_cache->size; i++) {
+		slot = &_pdb_cache->slots[i];
+		lock_get(&slot->lock);
+		st->hits += slot->hits;
+		st->misses += slot->misses;
+		st->coalesced += slot->coalesced;
+		for(e = slot->first; e != NULL; e = e->next) {
+			if(e->state == PDB_ENTRY_ANSWER && e->expires > now)
+				st->entries++;
+			else if(e->state == PDB_ENTRY_PENDING)
+				st->pending++;
+		}
+		lock_release(&slot->lock);
+	}
+}
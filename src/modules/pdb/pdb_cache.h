@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief PDB :: Cache of the answers and of the queries in flight
+ * \ingroup PDB
+ */
+
+#ifndef _PDB_CACHE_H_
+#define _PDB_CACHE_H_
+
+#include "../../core/str.h"
+#include "../../core/action.h"
+
+#include "common.h"
+
+/*! longer numbers are not cached */
+#define PDB_CACHE_NUMBER_SIZE 32
+/*! entries of a cache slot, the least recently used one is replaced */
+#define PDB_CACHE_WAYS 8
+/*! size of the KEMI callback name of a suspended transaction */
+#define PDB_CBNAME_SIZE 64
+
+/*! transaction suspended until the answer for a number arrives */
+typedef struct pdb_waiter
+{
+	struct pdb_waiter *next;
+	unsigned int tindex;
+	unsigned int tlabel;
+	struct action *act; /*!< route block to run, NULL for KEMI */
+	int cbname_len;
+	char cbname[PDB_CBNAME_SIZE]; /*!< KEMI callback to run */
+} pdb_waiter_t;
+
+typedef struct pdb_cache_entry
+{
+	struct pdb_cache_entry *next; /*!< LRU list of the slot */
+	unsigned int hashid;
+	unsigned int expires; /*!< in ticks, for the answers */
+	carrier_t carrierid;
+	unsigned char state;
+	unsigned char len;
+	char number[PDB_CACHE_NUMBER_SIZE];
+	pdb_waiter_t *waiters; /*!< for the queries in flight */
+} pdb_cache_entry_t;
+
+typedef struct pdb_cache_stats
+{
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long coalesced; /*!< queries joining one in flight */
+	unsigned int entries;	 /*!< cached answers */
+	unsigned int pending;	 /*!< queries in flight */
+} pdb_cache_stats_t;
+
+/*! pdb_cache_join() results */
+#define PDB_CACHE_HIT 1	   /*!< the answer is cached */
+#define PDB_CACHE_JOINED 2 /*!< waiting for a query in flight */
+#define PDB_CACHE_QUERY 3  /*!< waiting for a new query, to be sent */
+
+/*! suspends the transaction and fills in the waiter */
+typedef int (*pdb_suspend_f)(void *param, pdb_waiter_t *w);
+
+int pdb_cache_init(int size, int ttl, int negative_ttl);
+void pdb_cache_destroy(void);
+
+/*!
+ * \brief Looks up the cached answer for a number
+ * \return the carrier id, 0 if the number is not cached
+ */
+carrier_t pdb_cache_get(str *number);
+
+/*!
+ * \brief Caches the answer for a number, the errors are not cached
+ */
+void pdb_cache_put(str *number, carrier_t carrierid);
+
+/*!
+ * \brief Gets the answer for a number or waits for it
+ *
+ * If the answer is not cached, the transaction is suspended through
+ * suspend, called with the slot of the number locked, and the waiter is
+ * added to the query in flight for the number, or to a new one that is
+ * returned in query and has to be sent. The hits and the misses are
+ * counted by pdb_cache_get(), to be called first.
+ * \return PDB_CACHE_HIT, PDB_CACHE_JOINED, PDB_CACHE_QUERY or -1 on error
+ */
+int pdb_cache_join(str *number, pdb_suspend_f suspend, void *param,
+		pdb_waiter_t *w, carrier_t *carrierid, pdb_cache_entry_t **query);
+
+/*!
+ * \brief Sets the answer of a query in flight, 0 for a failed query
+ * \return the waiters of the query, to be resumed and freed
+ */
+pdb_waiter_t *pdb_cache_answer(pdb_cache_entry_t *query, carrier_t carrierid);
+
+void pdb_cache_flush(void);
+void pdb_cache_get_stats(pdb_cache_stats_t *st);
+
+#endif
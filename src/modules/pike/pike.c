@@ -44,6 +44,7 @@
 #include "pike_funcs.h"
 #include "../../core/rpc_lookup.h"
 #include "pike_rpc.h"
+#include "pike_sketch.h"
 
 MODULE_VERSION
 
@@ -57,6 +58,9 @@ static int pike_time_unit = 2;
 static int pike_max_reqs = 30;
 int pike_timeout = 120;
 int pike_log_level = L_WARN;
+static int pike_sketch_size = 0;
+static int pike_sketch_top_size = 64;
+static int pike_net_max_reqs = 0;
 
 /* global variables */
 gen_lock_t *pike_timer_lock = 0;
@@ -76,6 +80,9 @@ static param_export_t params[] = {
 	{"reqs_density_per_unit", PARAM_INT, &pike_max_reqs},
 	{"remove_latency", PARAM_INT, &pike_timeout},
 	{"pike_log_level", PARAM_INT, &pike_log_level},
+	{"sketch_size", PARAM_INT, &pike_sketch_size},
+	{"sketch_top_size", PARAM_INT, &pike_sketch_top_size},
+	{"net_reqs_density_per_unit", PARAM_INT, &pike_net_max_reqs},
 	{0, 0, 0}
 };
 
@@ -102,6 +109,20 @@ static int pike_init(void)
 		return -1;
 	}
 
+	/* the sketch replaces the IP tree and its timers */
+	if(pike_sketch_size > 0) {
+		if(pike_net_max_reqs <= 0)
+			pike_net_max_reqs = 8 * pike_max_reqs;
+		if(pike_sketch_init(pike_sketch_size, pike_sketch_top_size,
+				   pike_time_unit, pike_max_reqs, pike_net_max_reqs)
+				!= 0) {
+			LM_ERR("sketch creation failed!\n");
+			return -1;
+		}
+		pike_counter_init();
+		return 0;
+	}
+
 	/* alloc the timer lock */
 	pike_timer_lock = lock_alloc();
 	if(pike_timer_lock == 0) {
@@ -35,6 +35,7 @@
 #include "../../core/counters.h"
 #include "../../core/mod_fix.h"
 #include "ip_tree.h"
+#include "pike_sketch.h"
 #include "pike_funcs.h"
 #include "timer.h"
 
@@ -58,6 +59,18 @@ int pike_check_ipaddr(sip_msg_t *msg, ip_addr_t *ip)
 	pike_ip_node_t *node;
 	pike_ip_node_t *father;
 	unsigned char flags;
+	int bitlen;
+	int ret;
+
+	if(pike_sketch_enabled()) {
+		ret = pike_sketch_check(ip, &bitlen);
+		if(ret == -2) {
+			LM_GEN1(pike_log_level, "PIKE - BLOCKing ip %s, network /%d\n",
+					ip_addr2a(ip), bitlen);
+			counter_inc(blocked);
+		}
+		return ret;
+	}
 
 	/* first lock the proper tree branch and mark the IP with one more hit*/
 	lock_tree_branch(ip->u.addr[0]);
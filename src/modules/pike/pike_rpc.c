@@ -30,6 +30,7 @@
 #include "../../core/dprint.h"
 #include "../../core/ut.h"
 #include "pike_top.h"
+#include "pike_sketch.h"
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -121,12 +122,15 @@ static void pike_top(rpc_t *rpc, void *c)
 	char addr_buff[PIKE_BUFF_SIZE * sizeof(char)];
 	char *stropts;
 	int options = 0;
+	int limit = 0;
 
 	DBG("pike: top");
 
 	/* obtain params */
 	if(rpc->scan(c, "s", &stropts) <= 0)
 		stropts = "HOT";
+	else if(rpc->scan(c, "*d", &limit) < 1)
+		limit = 0;
 
 	DBG("pike:top: string options: '%s'", stropts);
 	if(strz_casesearch_strz(stropts, "ALL")) {
@@ -144,6 +148,10 @@ static void pike_top(rpc_t *rpc, void *c)
 		return;
 	}
 
+	if(pike_sketch_enabled()) {
+		pike_sketch_rpc_top(rpc, c, options, limit);
+		return;
+	}
 
 	print_tree(0);
 
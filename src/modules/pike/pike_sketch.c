@@ -0,0 +1,487 @@
+/*
+ * PIKE module
+ *
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Count-min sketch of the requests per source address and network, in
+ * sliding windows of sampling_time_unit.
+ *
+ * The sketch has PIKE_SKETCH_ROWS rows of counters for each of three
+ * windows: the current one, the previous one and the next one, cleared in
+ * advance. The counters are updated with atomic increments and the window
+ * is moved by the first process that sees it expired, so the requests do
+ * not take locks and the memory does not depend on the number of sources.
+ * The rate of a key is the count of the current window plus the count of
+ * the previous one weighted by the part of it still in the sliding window.
+ *
+ * The sketch can not list its keys, so the addresses and networks with a
+ * rate at least WARM are kept in a small table for pike.top, updated only
+ * with a try lock when a key is added.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/locking.h"
+#include "../../core/timer.h"
+#include "../../core/timer_ticks.h"
+#include "ip_tree.h"
+#include "pike_top.h"
+#include "pike_sketch.h"
+
+#define PIKE_SKETCH_ROWS 4
+#define PIKE_SKETCH_SLOTS 3
+#define PIKE_SKETCH_WAYS 4
+
+typedef struct pike_sketch_entry
+{
+	volatile unsigned long keyh; /* 0 for a free entry */
+	int level;
+	unsigned char ip[16];
+} pike_sketch_entry_t;
+
+typedef struct pike_sketch
+{
+	unsigned int width;	 /* counters per row, a power of two */
+	unsigned int period; /* ticks of a window */
+	int reqs[PIKE_SKETCH_LEVELS];
+	volatile int epoch;						/* current window */
+	volatile int slot_epoch[PIKE_SKETCH_SLOTS]; /* window of the counters */
+	volatile int *counters;
+	unsigned int top_sets;
+	pike_sketch_entry_t *top;
+	gen_lock_t top_lock;
+} pike_sketch_t;
+
+typedef struct pike_sketch_item
+{
+	int level;
+	unsigned char ip[16];
+	unsigned int prev;
+	unsigned int curr;
+	unsigned int rate;
+} pike_sketch_item_t;
+
+static pike_sketch_t *_pike_sketch = NULL;
+
+static int _pike_sketch_bitlen[PIKE_SKETCH_LEVELS] = {32, 24, 64, 48};
+
+extern char *node_status_array[];
+
+
+static unsigned int pike_sketch_pow2(unsigned int n)
+{
+	unsigned int p;
+
+	for(p = 1; p < n; p <<= 1)
+		;
+	return p;
+}
+
+
+int pike_sketch_init(
+		int size, int top_size, int time_unit, int host_reqs, int net_reqs)
+{
+	unsigned long msize;
+	unsigned int width;
+	unsigned int sets;
+	int e;
+
+	width = pike_sketch_pow2((unsigned int)size);
+	sets = pike_sketch_pow2(
+			(unsigned int)(top_size + PIKE_SKETCH_WAYS - 1) / PIKE_SKETCH_WAYS);
+	msize = sizeof(pike_sketch_t)
+			+ (unsigned long)sets * PIKE_SKETCH_WAYS
+					  * sizeof(pike_sketch_entry_t)
+			+ (unsigned long)PIKE_SKETCH_SLOTS * PIKE_SKETCH_ROWS * width
+					  * sizeof(int);
+	_pike_sketch = (pike_sketch_t *)shm_malloc(msize);
+	if(_pike_sketch == NULL) {
+		SHM_MEM_ERROR_FMT("for the sketch (%lu bytes)\n", msize);
+		return -1;
+	}
+	memset(_pike_sketch, 0, msize);
+	if(lock_init(&_pike_sketch->top_lock) == 0) {
+		LM_ERR("cannot init the lock\n");
+		shm_free(_pike_sketch);
+		_pike_sketch = NULL;
+		return -1;
+	}
+	_pike_sketch->width = width;
+	_pike_sketch->period = S_TO_TICKS(time_unit > 0 ? time_unit : 1);
+	_pike_sketch->reqs[PIKE_SKETCH_IP4_HOST] = host_reqs;
+	_pike_sketch->reqs[PIKE_SKETCH_IP4_NET] = net_reqs;
+	_pike_sketch->reqs[PIKE_SKETCH_IP6_HOST] = host_reqs;
+	_pike_sketch->reqs[PIKE_SKETCH_IP6_NET] = net_reqs;
+	_pike_sketch->top_sets = sets;
+	_pike_sketch->top = (pike_sketch_entry_t *)(_pike_sketch + 1);
+	_pike_sketch->counters =
+			(volatile int *)(_pike_sketch->top + sets * PIKE_SKETCH_WAYS);
+
+	e = (int)(get_ticks_raw() / _pike_sketch->period);
+	_pike_sketch->epoch = e;
+	_pike_sketch->slot_epoch[e % PIKE_SKETCH_SLOTS] = e;
+	_pike_sketch->slot_epoch[(e + 1) % PIKE_SKETCH_SLOTS] = e + 1;
+	_pike_sketch->slot_epoch[(e + 2) % PIKE_SKETCH_SLOTS] = -1;
+
+	LM_DBG("sketch of %u counters per row, top list of %u entries\n", width,
+			sets * PIKE_SKETCH_WAYS);
+	return 0;
+}
+
+
+int pike_sketch_enabled(void)
+{
+	return (_pike_sketch != NULL) ? 1 : 0;
+}
+
+
+static volatile int *pike_sketch_slot(int e)
+{
+	return _pike_sketch->counters
+		   + (unsigned long)(e % PIKE_SKETCH_SLOTS) * PIKE_SKETCH_ROWS
+					 * _pike_sketch->width;
+}
+
+
+/* clears the counters of a window, if not done yet */
+static void pike_sketch_clear(int e)
+{
+	if(_pike_sketch->slot_epoch[e % PIKE_SKETCH_SLOTS] == e)
+		return;
+	memset((void *)pike_sketch_slot(e), 0,
+			PIKE_SKETCH_ROWS * _pike_sketch->width * sizeof(int));
+	membar_write();
+	_pike_sketch->slot_epoch[e % PIKE_SKETCH_SLOTS] = e;
+}
+
+
+/* moves to the window e, done by one process only */
+static void pike_sketch_rotate(int e)
+{
+	int old;
+
+	old = _pike_sketch->epoch;
+	/* a process late with the time */
+	if(e - old <= 0)
+		return;
+	if(atomic_cmpxchg_int(&_pike_sketch->epoch, old, e) != old)
+		return;
+	/* cleared in advance, unless no request came in the last window */
+	pike_sketch_clear(e);
+	pike_sketch_clear(e + 1);
+}
+
+
+/* bytes of the key of ip at a level, the rest being 0 */
+static void pike_sketch_key(ip_addr_t *ip, int level, unsigned char *key)
+{
+	memset(key, 0, 16);
+	memcpy(key, ip->u.addr, _pike_sketch_bitlen[level] / 8);
+}
+
+
+/* 64 bit FNV-1a hash of the level and key with a final mix, never 0 */
+static unsigned long pike_sketch_hash(int level, unsigned char *key)
+{
+	uint64_t h;
+	int i;
+
+	h = 0xcbf29ce484222325ULL;
+	h = (h ^ (unsigned char)level) * 0x100000001b3ULL;
+	for(i = 0; i < _pike_sketch_bitlen[level] / 8; i++)
+		h = (h ^ key[i]) * 0x100000001b3ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	if((unsigned long)h == 0)
+		h = 1;
+	return (unsigned long)h;
+}
+
+
+/* column of the key in a row, with double hashing */
+static inline unsigned int pike_sketch_col(unsigned long h, int row)
+{
+	uint64_t v;
+
+	v = (uint64_t)h;
+	return ((unsigned int)v + row * ((unsigned int)(v >> 32) | 1))
+		   & (_pike_sketch->width - 1);
+}
+
+
+/* counts a request of the key in the window e, returns its count */
+static unsigned int pike_sketch_add(int e, unsigned long h)
+{
+	volatile int *slot;
+	unsigned int min;
+	unsigned int v;
+	int r;
+
+	slot = pike_sketch_slot(e);
+	min = (unsigned int)-1;
+	for(r = 0; r < PIKE_SKETCH_ROWS; r++) {
+		v = (unsigned int)atomic_add_int(
+				&slot[r * _pike_sketch->width + pike_sketch_col(h, r)], 1);
+		if(v < min)
+			min = v;
+	}
+	return min;
+}
+
+
+/* count of the key in the window e */
+static unsigned int pike_sketch_count(int e, unsigned long h)
+{
+	volatile int *slot;
+	unsigned int min;
+	unsigned int v;
+	int r;
+
+	if(_pike_sketch->slot_epoch[e % PIKE_SKETCH_SLOTS] != e)
+		return 0;
+	membar_read();
+	slot = pike_sketch_slot(e);
+	min = (unsigned int)-1;
+	for(r = 0; r < PIKE_SKETCH_ROWS; r++) {
+		v = (unsigned int)slot[r * _pike_sketch->width + pike_sketch_col(h, r)];
+		if(v < min)
+			min = v;
+	}
+	return min;
+}
+
+
+/* the rate in the sliding window, pos being the ticks from the start of
+ * the current window */
+static unsigned int pike_sketch_rate(
+		unsigned int curr, unsigned int prev, unsigned int pos)
+{
+	return curr
+		   + (unsigned int)((unsigned long long)prev
+							* (_pike_sketch->period - pos)
+							/ _pike_sketch->period);
+}
+
+
+/* adds the key to the top list, if not there and with a rate higher than
+ * the one of an entry of its set */
+static void pike_sketch_top_mark(int level, unsigned char *key,
+		unsigned long h, int e, unsigned int pos, unsigned int rate)
+{
+	pike_sketch_entry_t *set;
+	pike_sketch_entry_t *ev;
+	unsigned int vrate;
+	unsigned int r;
+	int i;
+
+	set = &_pike_sketch->top[((h >> 20) & (_pike_sketch->top_sets - 1))
+							 * PIKE_SKETCH_WAYS];
+	for(i = 0; i < PIKE_SKETCH_WAYS; i++) {
+		if(set[i].keyh == h)
+			return;
+	}
+	/* busy, the next requests of the source will try again */
+	if(lock_try(&_pike_sketch->top_lock) != 0)
+		return;
+	ev = NULL;
+	vrate = rate;
+	for(i = 0; i < PIKE_SKETCH_WAYS; i++) {
+		if(set[i].keyh == h) {
+			ev = NULL;
+			break;
+		}
+		r = (set[i].keyh == 0) ? 0
+							   : pike_sketch_rate(
+									   pike_sketch_count(e, set[i].keyh),
+									   pike_sketch_count(e - 1, set[i].keyh),
+									   pos);
+		if(r < vrate) {
+			ev = &set[i];
+			vrate = r;
+		}
+	}
+	if(ev != NULL) {
+		ev->keyh = 0;
+		membar_write();
+		ev->level = level;
+		memcpy(ev->ip, key, 16);
+		membar_write();
+		ev->keyh = h;
+	}
+	lock_release(&_pike_sketch->top_lock);
+}
+
+
+int pike_sketch_check(ip_addr_t *ip, int *bitlen)
+{
+	unsigned char key[16];
+	unsigned long h;
+	unsigned int now;
+	unsigned int pos;
+	unsigned int rate;
+	int levels[2];
+	int ret;
+	int rl;
+	int e;
+	int i;
+
+	if(ip->af == AF_INET) {
+		levels[0] = PIKE_SKETCH_IP4_HOST;
+		levels[1] = PIKE_SKETCH_IP4_NET;
+	} else {
+		levels[0] = PIKE_SKETCH_IP6_HOST;
+		levels[1] = PIKE_SKETCH_IP6_NET;
+	}
+
+	now = (unsigned int)get_ticks_raw();
+	e = (int)(now / _pike_sketch->period);
+	pos = now % _pike_sketch->period;
+	if(e != _pike_sketch->epoch)
+		pike_sketch_rotate(e);
+
+	ret = 1;
+	for(i = 0; i < 2; i++) {
+		pike_sketch_key(ip, levels[i], key);
+		h = pike_sketch_hash(levels[i], key);
+		rate = pike_sketch_rate(
+				pike_sketch_add(e, h), pike_sketch_count(e - 1, h), pos);
+		if(rate >= (unsigned int)_pike_sketch->reqs[levels[i]] >> 2)
+			pike_sketch_top_mark(levels[i], key, h, e, pos, rate);
+		if(rate < (unsigned int)_pike_sketch->reqs[levels[i]])
+			continue;
+		/* the request that took the rate to the limit */
+		rl = (rate - 1 < (unsigned int)_pike_sketch->reqs[levels[i]]) ? -2
+																	  : -1;
+		if(rl < ret) {
+			ret = rl;
+			*bitlen = _pike_sketch_bitlen[levels[i]];
+		}
+	}
+	return ret;
+}
+
+
+static int pike_sketch_item_cmp(const void *a, const void *b)
+{
+	const pike_sketch_item_t *ia = (const pike_sketch_item_t *)a;
+	const pike_sketch_item_t *ib = (const pike_sketch_item_t *)b;
+
+	if(ia->rate != ib->rate)
+		return (ia->rate > ib->rate) ? -1 : 1;
+	return 0;
+}
+
+
+static pike_node_status_t pike_sketch_status(pike_sketch_item_t *it)
+{
+	if(it->rate >= (unsigned int)_pike_sketch->reqs[it->level])
+		return NODE_STATUS_HOT;
+	if(it->rate >= (unsigned int)_pike_sketch->reqs[it->level] >> 2)
+		return NODE_STATUS_WARM;
+	return NODE_STATUS_OK;
+}
+
+
+void pike_sketch_rpc_top(rpc_t *rpc, void *c, int opts, int limit)
+{
+	pike_sketch_item_t *items;
+	pike_sketch_entry_t *en;
+	pike_node_status_t ns;
+	char addr_buff[PIKE_BUFF_SIZE];
+	unsigned long h;
+	unsigned int now;
+	unsigned int pos;
+	void *handle;
+	void *list;
+	void *item;
+	int n;
+	int e;
+	int i;
+
+	items = (pike_sketch_item_t *)pkg_malloc(_pike_sketch->top_sets
+											 * PIKE_SKETCH_WAYS
+											 * sizeof(pike_sketch_item_t));
+	if(items == NULL) {
+		PKG_MEM_ERROR;
+		rpc->fault(c, 500, "No more memory");
+		return;
+	}
+
+	now = (unsigned int)get_ticks_raw();
+	e = (int)(now / _pike_sketch->period);
+	pos = now % _pike_sketch->period;
+	n = 0;
+	for(i = 0; i < _pike_sketch->top_sets * PIKE_SKETCH_WAYS; i++) {
+		en = &_pike_sketch->top[i];
+		h = en->keyh;
+		if(h == 0)
+			continue;
+		membar_read();
+		items[n].level = en->level;
+		memcpy(items[n].ip, en->ip, 16);
+		if(en->keyh != h)
+			continue;
+		items[n].curr = pike_sketch_count(e, h);
+		items[n].prev = pike_sketch_count(e - 1, h);
+		items[n].rate = pike_sketch_rate(items[n].curr, items[n].prev, pos);
+		if(items[n].rate == 0)
+			continue;
+		ns = pike_sketch_status(&items[n]);
+		/* WARM lists the HOT ones too */
+		if(opts == NODE_STATUS_ALL || ns >= opts)
+			n++;
+	}
+	qsort(items, n, sizeof(pike_sketch_item_t), pike_sketch_item_cmp);
+	if(limit > 0 && n > limit)
+		n = limit;
+
+	if(rpc->add(c, "{", &handle) < 0) {
+		pkg_free(items);
+		return;
+	}
+	rpc->struct_add(handle, "d[", "max_hits",
+			_pike_sketch->reqs[PIKE_SKETCH_IP4_HOST], "list", &list);
+	for(i = 0; i < n; i++) {
+		pike_top_print_addr(items[i].ip,
+				(items[i].level < PIKE_SKETCH_IP6_HOST) ? 4 : 16, addr_buff,
+				sizeof(addr_buff) - 4);
+		snprintf(addr_buff + strlen(addr_buff), 5, "/%d",
+				_pike_sketch_bitlen[items[i].level]);
+		rpc->array_add(list, "{", &item);
+		/* expires when the requests counted leave the sliding window */
+		rpc->struct_add(item, "sddds", "ip_addr", addr_buff, "leaf_hits_prev",
+				items[i].prev, "leaf_hits_curr", items[i].curr, "expires",
+				TICKS_TO_S(((items[i].curr > 0) ? 2 : 1) * _pike_sketch->period
+						   - pos),
+				"status", node_status_array[pike_sketch_status(&items[i])]);
+	}
+	rpc->struct_add(handle, "d", "number_of_rows", n);
+	pkg_free(items);
+}
@@ -0,0 +1,60 @@
+/*
+ * PIKE module
+ *
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __PIKE_SKETCH_H
+#define __PIKE_SKETCH_H
+
+#include "../../core/ip_addr.h"
+#include "../../core/rpc.h"
+
+/* aggregation levels of the source addresses */
+#define PIKE_SKETCH_IP4_HOST 0 /* IPv4 /32 */
+#define PIKE_SKETCH_IP4_NET 1  /* IPv4 /24 */
+#define PIKE_SKETCH_IP6_HOST 2 /* IPv6 /64 */
+#define PIKE_SKETCH_IP6_NET 3  /* IPv6 /48 */
+#define PIKE_SKETCH_LEVELS 4
+
+/**
+ * allocates the sketch with size counters per row and the list of the
+ * top_size most active addresses and networks
+ * \return 0 on success, -1 otherwise
+ */
+int pike_sketch_init(int size, int top_size, int time_unit, int host_reqs,
+		int net_reqs);
+
+/* returns 1 if the sketch is used instead of the IP tree */
+int pike_sketch_enabled(void);
+
+/**
+ * counts a request from ip in the windows of its address and network
+ * \return 1 if allowed, -1 if blocked, -2 if blocked from this request on,
+ * with the prefix length of the flooding address or network in bitlen
+ */
+int pike_sketch_check(ip_addr_t *ip, int *bitlen);
+
+/* pike.top for the sketch, opts is NODE_STATUS_HOT/WARM/ALL */
+void pike_sketch_rpc_top(rpc_t *rpc, void *c, int opts, int limit);
+
+#endif
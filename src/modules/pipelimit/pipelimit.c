@@ -62,6 +62,7 @@
 #include "pl_statistics.h"
 #include "pl_ht.h"
 #include "pl_db.h"
+#include "pl_bucket.h"
 
 MODULE_VERSION
 
@@ -97,6 +98,7 @@ typedef struct pl_queue {
 static int pl_drop_code = 503;
 static str pl_drop_reason = str_init("Server Unavailable");
 static int pl_hash_size = 6;
+static int pl_bucket_size = 0;
 
 static struct timer_ln *pl_timer = NULL;
 
@@ -137,6 +139,10 @@ static int w_pl_drop(struct sip_msg *, char *, char *);
 static void destroy(void);
 static int fixup_pl_check3(void **param, int param_no);
 static int fixup_free_pl_check3(void **param, int param_no);
+static int w_pl_bucket_check(sip_msg_t *, char *, char *, char *);
+static int w_pl_bucket_check_levels(sip_msg_t *, char *, char *);
+static int fixup_pl_bucket_check(void **param, int param_no);
+static int fixup_free_pl_bucket_check(void **param, int param_no);
 
 /* clang-format off */
 static cmd_export_t cmds[] = {
@@ -152,6 +158,10 @@ static cmd_export_t cmds[] = {
 		fixup_uint_null, 0, REQUEST_ROUTE | BRANCH_ROUTE | FAILURE_ROUTE | ONSEND_ROUTE},
 	{"pl_drop", (cmd_function)w_pl_drop, 2,
 		fixup_uint_uint, 0, REQUEST_ROUTE | BRANCH_ROUTE | FAILURE_ROUTE | ONSEND_ROUTE},
+	{"pl_bucket_check", (cmd_function)w_pl_bucket_check, 3,
+		fixup_pl_bucket_check, fixup_free_pl_bucket_check, ANY_ROUTE},
+	{"pl_bucket_check_levels", (cmd_function)w_pl_bucket_check_levels, 1,
+		fixup_spve_null, fixup_free_spve_null, ANY_ROUTE},
 	{0, 0, 0, 0, 0, 0}
 };
 
@@ -168,6 +178,7 @@ static param_export_t params[] = {
 	{"hash_size", PARAM_INT, &pl_hash_size},
 	{"load_fetch", PARAM_INT, &pl_load_fetch},
 	{"clean_unused", PARAM_INT, &pl_clean_unused},
+	{"bucket_size", PARAM_INT, &pl_bucket_size},
 
 	{0, 0, 0}
 };
@@ -400,6 +411,7 @@ static void pl_cleanup(void)
 		pl_timer = NULL;
 	}
 	pl_destroy_htable();
+	pl_bucket_destroy();
 }
 
 /* initialize ratelimit module */
@@ -430,6 +442,10 @@ static int mod_init(void)
 		LM_ERR("could not load pipes description\n");
 		goto error;
 	}
+	if(pl_bucket_init(pl_bucket_size) < 0) {
+		LM_ERR("could not allocate the token buckets\n");
+		goto error;
+	}
 
 	/* bind the SL API */
 	if(sl_load_api(&_pl_slb) != 0) {
@@ -793,6 +809,88 @@ static int fixup_free_pl_check3(void **param, int param_no)
 	return 0;
 }
 
+/**
+ * limit checking with the token bucket of a key
+ */
+static int pl_bucket_check_key(sip_msg_t *msg, str *key, int rate, int burst)
+{
+	pl_bucket_level_t level;
+
+	level.key = *key;
+	level.rate = rate;
+	level.burst = burst;
+
+	return pl_bucket_check(&level, 1);
+}
+
+static int w_pl_bucket_check(
+		sip_msg_t *msg, char *p1key, char *p2rate, char *p3burst)
+{
+	str key = {0, 0};
+	int rate;
+	int burst;
+
+	if(fixup_get_svalue(msg, (gparam_t *)p1key, &key) != 0) {
+		LM_ERR("invalid key parameter\n");
+		return -2;
+	}
+	if(fixup_get_ivalue(msg, (gparam_t *)p2rate, &rate) != 0) {
+		LM_ERR("invalid rate parameter\n");
+		return -2;
+	}
+	if(fixup_get_ivalue(msg, (gparam_t *)p3burst, &burst) != 0) {
+		LM_ERR("invalid burst parameter\n");
+		return -2;
+	}
+
+	return pl_bucket_check_key(msg, &key, rate, burst);
+}
+
+static int fixup_pl_bucket_check(void **param, int param_no)
+{
+	if(param_no == 1)
+		return fixup_spve_null(param, 1);
+	if(param_no == 2 || param_no == 3)
+		return fixup_igp_null(param, 1);
+	return 0;
+}
+
+static int fixup_free_pl_bucket_check(void **param, int param_no)
+{
+	if(param_no == 1)
+		return fixup_free_spve_null(param, 1);
+	if(param_no == 2 || param_no == 3)
+		return fixup_free_igp_null(param, 1);
+	return 0;
+}
+
+/**
+ * limit checking with the token buckets of nested keys
+ */
+static int pl_bucket_check_levels(sip_msg_t *msg, str *spec)
+{
+	pl_bucket_level_t levels[PL_BUCKET_LEVELS];
+	int n;
+
+	n = pl_bucket_parse_levels(spec, levels, PL_BUCKET_LEVELS);
+	if(n < 0)
+		return -2;
+
+	return pl_bucket_check(levels, n);
+}
+
+static int w_pl_bucket_check_levels(sip_msg_t *msg, char *p1, char *p2)
+{
+	str spec = {0, 0};
+
+	if(fixup_get_svalue(msg, (gparam_t *)p1, &spec) != 0) {
+		LM_ERR("invalid levels parameter\n");
+		return -2;
+	}
+
+	return pl_bucket_check_levels(msg, &spec);
+}
+
 static int pl_active(sip_msg_t *msg, str *pipeid)
 {
 	pl_pipe_t *pipe = NULL;
@@ -884,6 +982,12 @@ const char *rpc_pl_rm_pipe_doc[2] = {"Remove a pipe: <pipe_id>", 0};
 const char *rpc_pl_reset_pipe_doc[2] = {
 		"Reset the value of a pipe: <pipe_id>", 0};
 
+const char *rpc_pl_bucket_stats_doc[2] = {
+		"Print the token buckets statistics", 0};
+
+const char *rpc_pl_bucket_reset_doc[2] = {
+		"Fill again the token bucket of a key: <key>", 0};
+
 /* rpc function implementations */
 void rpc_pl_stats(rpc_t *rpc, void *c);
 void rpc_pl_list(rpc_t *rpc, void *c);
@@ -932,6 +1036,33 @@ void rpc_pl_push_load(rpc_t *rpc, void *c)
 	do_update_load();
 }
 
+void rpc_pl_bucket_stats(rpc_t *rpc, void *c)
+{
+	pl_bucket_stats_t st;
+	void *th;
+
+	pl_bucket_get_stats(&st);
+	if(rpc->add(c, "{", &th) < 0) {
+		rpc->fault(c, 500, "Internal error creating rpc");
+		return;
+	}
+	rpc->struct_add(th, "uuujjj", "size", st.size, "used", st.used, "active",
+			st.active, "allowed", st.allowed, "denied", st.denied, "evicted",
+			st.evicted);
+}
+
+void rpc_pl_bucket_reset(rpc_t *rpc, void *c)
+{
+	str key;
+
+	if(rpc->scan(c, "S", &key) < 1) {
+		rpc->fault(c, 400, "Key expected");
+		return;
+	}
+	if(pl_bucket_reset(&key) < 0)
+		rpc->fault(c, 404, "Key not found");
+}
+
 static rpc_export_t rpc_methods[] = {
 		{"pl.stats", rpc_pl_stats, rpc_pl_stats_doc, RET_ARRAY},
 		{"pl.list", rpc_pl_list, rpc_pl_list_doc, RET_ARRAY},
@@ -942,6 +1073,8 @@ static rpc_export_t rpc_methods[] = {
 		{"pl.get_pid", rpc_pl_get_pid, rpc_pl_get_pid_doc, 0},
 		{"pl.set_pid", rpc_pl_set_pid, rpc_pl_set_pid_doc, 0},
 		{"pl.push_load", rpc_pl_push_load, rpc_pl_push_load_doc, 0},
+		{"pl.bucket_stats", rpc_pl_bucket_stats, rpc_pl_bucket_stats_doc, 0},
+		{"pl.bucket_reset", rpc_pl_bucket_reset, rpc_pl_bucket_reset_doc, 0},
 		{0, 0, 0, 0}};
 
 static int ki_pl_drop(sip_msg_t *msg)
@@ -979,6 +1112,16 @@ static sr_kemi_t sr_kemi_pipelimit_exports[] = {
 		{ SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
 			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
 	},
+	{ str_init("pipelimit"), str_init("pl_bucket_check"),
+		SR_KEMIP_INT, pl_bucket_check_key,
+		{ SR_KEMIP_STR, SR_KEMIP_INT, SR_KEMIP_INT,
+			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+	},
+	{ str_init("pipelimit"), str_init("pl_bucket_check_levels"),
+		SR_KEMIP_INT, pl_bucket_check_levels,
+		{ SR_KEMIP_STR, SR_KEMIP_NONE, SR_KEMIP_NONE,
+			SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE }
+	},
 	{ str_init("pipelimit"), str_init("pl_drop"),
 		SR_KEMIP_INT, ki_pl_drop,
 		{ SR_KEMIP_NONE, SR_KEMIP_NONE, SR_KEMIP_NONE,
@@ -0,0 +1,425 @@
+/*
+ * pipelimit module
+ *
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup pipelimit
+ * \brief pipelimit :: pl_bucket - token buckets of many keys
+ *
+ * The bucket of a key is kept as its theoretical arrival time (GCRA): the
+ * time when the bucket is full again. A token is taken by moving it one
+ * emission interval (1/rate) forward, if it stays within burst intervals
+ * from now, with a compare and swap. The refill is implicit in the clock,
+ * there is nothing to update in a timer.
+ *
+ * The table is set associative, a key is hashed to a set of
+ * PL_BUCKET_WAYS entries keeping only the hash of the key. The lookups do
+ * not lock, a lock of the set is taken only to add a key. A new key
+ * replaces a free entry, else one with a full bucket, which is the same
+ * as a new one, else the entry closest to be full.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/counters.h"
+#include "../../core/dprint.h"
+#include "../../core/trim.h"
+#include "../../core/ut.h"
+
+#include "pl_bucket.h"
+
+#define PL_BUCKET_WAYS 8
+#define PL_BUCKET_LOCKS 256
+#define PL_BUCKET_USEC 1000000L
+
+typedef struct pl_bucket_entry
+{
+	volatile unsigned long keyh; /* hash of the key, 0 if free */
+	volatile long tat;			 /* theoretical arrival time, usec */
+} pl_bucket_entry_t;
+
+typedef struct pl_bucket_table
+{
+	unsigned int nsets; /* power of 2 */
+	gen_lock_set_t *locks;
+	pl_bucket_entry_t *entries;
+} pl_bucket_table_t;
+
+static pl_bucket_table_t *_pl_bucket = NULL;
+
+static counter_handle_t _pl_bucket_allowed;
+static counter_handle_t _pl_bucket_denied;
+static counter_handle_t _pl_bucket_evicted;
+
+/* clang-format off */
+static counter_def_t _pl_bucket_cnt_defs[] = {
+	{&_pl_bucket_allowed, "bucket_allowed", 0, 0, 0,
+		"requests allowed by the token buckets"},
+	{&_pl_bucket_denied, "bucket_denied", 0, 0, 0,
+		"requests denied by the token buckets"},
+	{&_pl_bucket_evicted, "bucket_evicted", 0, 0, 0,
+		"keys dropped from the table before their bucket was full"},
+	{0, 0, 0, 0, 0, 0}
+};
+/* clang-format on */
+
+
+int pl_bucket_init(int size)
+{
+	unsigned int nsets;
+	unsigned long msize;
+
+	if(size <= 0)
+		return 0;
+
+	for(nsets = 1; nsets * PL_BUCKET_WAYS < (unsigned int)size; nsets <<= 1)
+		;
+	msize = sizeof(pl_bucket_table_t)
+			+ (unsigned long)nsets * PL_BUCKET_WAYS * sizeof(pl_bucket_entry_t);
+	_pl_bucket = (pl_bucket_table_t *)shm_malloc(msize);
+	if(_pl_bucket == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_pl_bucket, 0, msize);
+	_pl_bucket->nsets = nsets;
+	_pl_bucket->entries = (pl_bucket_entry_t *)(_pl_bucket + 1);
+
+	_pl_bucket->locks = lock_set_alloc(PL_BUCKET_LOCKS);
+	if(_pl_bucket->locks == NULL) {
+		LM_ERR("cannot allocate the bucket locks\n");
+		goto error;
+	}
+	if(lock_set_init(_pl_bucket->locks) == NULL) {
+		LM_ERR("cannot init the bucket locks\n");
+		lock_set_dealloc(_pl_bucket->locks);
+		goto error;
+	}
+	if(counter_register_array("pipelimit", _pl_bucket_cnt_defs) < 0) {
+		LM_ERR("cannot register the bucket counters\n");
+		lock_set_destroy(_pl_bucket->locks);
+		lock_set_dealloc(_pl_bucket->locks);
+		goto error;
+	}
+
+	LM_DBG("token buckets table of %u entries\n", nsets * PL_BUCKET_WAYS);
+	return 0;
+
+error:
+	shm_free(_pl_bucket);
+	_pl_bucket = NULL;
+	return -1;
+}
+
+
+void pl_bucket_destroy(void)
+{
+	if(_pl_bucket == NULL)
+		return;
+	lock_set_destroy(_pl_bucket->locks);
+	lock_set_dealloc(_pl_bucket->locks);
+	shm_free(_pl_bucket);
+	_pl_bucket = NULL;
+}
+
+
+static long pl_bucket_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	/* wraps on 32 bit, the times are only compared by differences */
+	return (long)((unsigned long)ts.tv_sec * PL_BUCKET_USEC
+				  + ts.tv_nsec / 1000);
+}
+
+
+/**
+ * 64 bit FNV-1a hash of the key with a final mix, never 0
+ */
+static unsigned long pl_bucket_hash(str *key)
+{
+	uint64_t h;
+	int i;
+
+	h = 0xcbf29ce484222325ULL;
+	for(i = 0; i < key->len; i++)
+		h = (h ^ (unsigned char)key->s[i]) * 0x100000001b3ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	if((unsigned long)h == 0)
+		h = 1;
+	return (unsigned long)h;
+}
+
+
+static pl_bucket_entry_t *pl_bucket_set(unsigned long keyh, unsigned int *idx)
+{
+	*idx = (unsigned int)(keyh >> 16) & (_pl_bucket->nsets - 1);
+	return &_pl_bucket->entries[*idx * PL_BUCKET_WAYS];
+}
+
+
+/**
+ * finds the entry of a key, adding the key if needed
+ */
+static pl_bucket_entry_t *pl_bucket_get(unsigned long keyh, long now)
+{
+	pl_bucket_entry_t *set;
+	pl_bucket_entry_t *e;
+	unsigned int idx;
+	long age;
+	long oldest;
+	int i;
+
+	set = pl_bucket_set(keyh, &idx);
+	for(i = 0; i < PL_BUCKET_WAYS; i++) {
+		if(set[i].keyh == keyh) {
+			membar_read();
+			return &set[i];
+		}
+	}
+
+	lock_set_get(_pl_bucket->locks, idx % PL_BUCKET_LOCKS);
+	e = NULL;
+	oldest = 0;
+	for(i = 0; i < PL_BUCKET_WAYS; i++) {
+		if(set[i].keyh == keyh) {
+			/* added by another process meanwhile */
+			lock_set_release(_pl_bucket->locks, idx % PL_BUCKET_LOCKS);
+			return &set[i];
+		}
+		/* free first, then the buckets full since the longest time */
+		age = (set[i].keyh == 0) ? LONG_MIN : set[i].tat - now;
+		if(e == NULL || age < oldest) {
+			e = &set[i];
+			oldest = age;
+		}
+	}
+	if(oldest > 0)
+		counter_inc(_pl_bucket_evicted);
+	e->tat = now;
+	/* the bucket of the key before its hash */
+	membar_write();
+	e->keyh = keyh;
+	lock_set_release(_pl_bucket->locks, idx % PL_BUCKET_LOCKS);
+
+	return e;
+}
+
+
+/**
+ * takes a token, if the bucket has one
+ * \return 1 if taken, -1 otherwise
+ */
+static int pl_bucket_take(pl_bucket_entry_t *e, long now, long ival, long tol)
+{
+	long tat;
+	long ntat;
+
+	do {
+		tat = e->tat;
+		/* full bucket, or a stale time after a wrap of the clock; a time
+		 * a bit after the limit is from a process with a more recent now */
+		if(tat - now < 0 || tat - now > tol + PL_BUCKET_USEC)
+			ntat = now + ival;
+		else
+			ntat = tat + ival;
+		if(ntat - now > tol)
+			return -1;
+	} while(atomic_cmpxchg_long(&e->tat, tat, ntat) != tat);
+
+	return 1;
+}
+
+
+/**
+ * gives back a token taken by pl_bucket_take()
+ */
+static void pl_bucket_give(pl_bucket_entry_t *e, long ival)
+{
+	long tat;
+
+	do {
+		tat = e->tat;
+	} while(atomic_cmpxchg_long(&e->tat, tat, tat - ival) != tat);
+}
+
+
+int pl_bucket_parse_levels(str *s, pl_bucket_level_t *levels, int max)
+{
+	str spec;
+	str lv;
+	str v;
+	char *p;
+	char *q;
+	int n;
+
+	if(s->len <= 0)
+		return -1;
+	spec = *s;
+	n = 0;
+	while(spec.len > 0) {
+		p = memchr(spec.s, ';', spec.len);
+		lv.s = spec.s;
+		lv.len = (p != NULL) ? p - spec.s : spec.len;
+		spec.len -= (p != NULL) ? lv.len + 1 : lv.len;
+		spec.s += (p != NULL) ? lv.len + 1 : lv.len;
+		trim(&lv);
+		if(lv.len == 0)
+			continue;
+		if(n == max) {
+			LM_ERR("too many levels in [%.*s]\n", s->len, s->s);
+			return -1;
+		}
+		/* the key can have '=', the rate and burst can not */
+		for(p = lv.s + lv.len - 1; p > lv.s && *p != '='; p--)
+			;
+		q = (p > lv.s) ? memchr(p, '/', lv.s + lv.len - p) : NULL;
+		if(q == NULL) {
+			LM_ERR("invalid level [%.*s]\n", lv.len, lv.s);
+			return -1;
+		}
+		levels[n].key.s = lv.s;
+		levels[n].key.len = p - lv.s;
+		trim(&levels[n].key);
+		v.s = p + 1;
+		v.len = q - v.s;
+		trim(&v);
+		if(str2sint(&v, &levels[n].rate) < 0) {
+			LM_ERR("invalid rate in [%.*s]\n", lv.len, lv.s);
+			return -1;
+		}
+		v.s = q + 1;
+		v.len = lv.s + lv.len - v.s;
+		trim(&v);
+		if(str2sint(&v, &levels[n].burst) < 0) {
+			LM_ERR("invalid burst in [%.*s]\n", lv.len, lv.s);
+			return -1;
+		}
+		n++;
+	}
+	return (n > 0) ? n : -1;
+}
+
+
+int pl_bucket_check(pl_bucket_level_t *levels, int n)
+{
+	pl_bucket_entry_t *e[PL_BUCKET_LEVELS];
+	long ival[PL_BUCKET_LEVELS];
+	long now;
+	long tol;
+	int i;
+
+	if(_pl_bucket == NULL) {
+		LM_ERR("token buckets not enabled, set the bucket_size parameter\n");
+		return -2;
+	}
+	if(n <= 0 || n > PL_BUCKET_LEVELS)
+		return -2;
+	for(i = 0; i < n; i++) {
+		if(levels[i].rate <= 0 || levels[i].burst <= 0
+				|| levels[i].key.len <= 0) {
+			LM_ERR("invalid level %d [%.*s] rate %d burst %d\n", i,
+					levels[i].key.len, levels[i].key.s, levels[i].rate,
+					levels[i].burst);
+			return -2;
+		}
+	}
+
+	now = pl_bucket_now();
+	for(i = 0; i < n; i++) {
+		ival[i] = PL_BUCKET_USEC / levels[i].rate;
+		if(ival[i] == 0)
+			ival[i] = 1;
+		tol = ival[i] * levels[i].burst;
+		e[i] = pl_bucket_get(pl_bucket_hash(&levels[i].key), now);
+		if(pl_bucket_take(e[i], now, ival[i], tol) < 0) {
+			LM_DBG("no token for [%.*s]\n", levels[i].key.len,
+					levels[i].key.s);
+			/* the lower levels get back their tokens */
+			while(--i >= 0)
+				pl_bucket_give(e[i], ival[i]);
+			counter_inc(_pl_bucket_denied);
+			return -1;
+		}
+	}
+	counter_inc(_pl_bucket_allowed);
+
+	return 1;
+}
+
+
+int pl_bucket_reset(str *key)
+{
+	pl_bucket_entry_t *set;
+	unsigned long keyh;
+	unsigned int idx;
+	int i;
+
+	if(_pl_bucket == NULL)
+		return -1;
+	keyh = pl_bucket_hash(key);
+	set = pl_bucket_set(keyh, &idx);
+	for(i = 0; i < PL_BUCKET_WAYS; i++) {
+		if(set[i].keyh == keyh) {
+			set[i].tat = pl_bucket_now();
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+void pl_bucket_get_stats(pl_bucket_stats_t *st)
+{
+	pl_bucket_entry_t *e;
+	unsigned int i;
+	unsigned int n;
+	long now;
+
+	memset(st, 0, sizeof(pl_bucket_stats_t));
+	if(_pl_bucket == NULL)
+		return;
+	now = pl_bucket_now();
+	n = _pl_bucket->nsets * PL_BUCKET_WAYS;
+	st->size = n;
+	for(i = 0; i < n; i++) {
+		e = &_pl_bucket->entries[i];
+		if(e->keyh == 0)
+			continue;
+		st->used++;
+		if(e->tat - now > 0)
+			st->active++;
+	}
+	st->allowed = counter_get_val(_pl_bucket_allowed);
+	st->denied = counter_get_val(_pl_bucket_denied);
+	st->evicted = counter_get_val(_pl_bucket_evicted);
+}
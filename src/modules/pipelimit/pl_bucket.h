@@ -0,0 +1,82 @@
+/*
+ * pipelimit module
+ *
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup pipelimit
+ * \brief pipelimit :: pl_bucket - token buckets of many keys
+ */
+
+#ifndef _PL_BUCKET_H_
+#define _PL_BUCKET_H_
+
+#include "../../core/str.h"
+
+/* max number of levels of a check */
+#define PL_BUCKET_LEVELS 8
+
+typedef struct pl_bucket_level
+{
+	str key;
+	int rate;  /* tokens per second */
+	int burst; /* size of the bucket */
+} pl_bucket_level_t;
+
+typedef struct pl_bucket_stats
+{
+	unsigned int size;	 /* number of entries */
+	unsigned int used;	 /* entries with a key */
+	unsigned int active; /* entries with a bucket not full */
+	unsigned long allowed;
+	unsigned long denied;
+	unsigned long evicted; /* keys dropped with a bucket not full */
+} pl_bucket_stats_t;
+
+/**
+ * allocates the table for about size keys, 0 disables the buckets
+ * \return 0 on success, -1 otherwise
+ */
+int pl_bucket_init(int size);
+void pl_bucket_destroy(void);
+
+/**
+ * parses the levels of a check, "key=rate/burst" separated by ';'
+ * \return the number of levels, -1 on errors
+ */
+int pl_bucket_parse_levels(str *s, pl_bucket_level_t *levels, int max);
+
+/**
+ * takes a token from the bucket of each level, all or none
+ * \return 1 if allowed, -1 if a level has no token, -2 on errors
+ */
+int pl_bucket_check(pl_bucket_level_t *levels, int n);
+
+/**
+ * fills again the bucket of a key
+ * \return 0 if the key was found, -1 otherwise
+ */
+int pl_bucket_reset(str *key);
+
+void pl_bucket_get_stats(pl_bucket_stats_t *st);
+
+#endif
@@ -36,29 +36,30 @@
 #include "../../core/str.h"
 #include "../../core/lock_alloc.h"
 #include "../../core/lock_ops.h"
+#include "../../lib/pfxidx/pfxidx.h"
 #include "tree.h"
 
 
-enum
+/** Defines the route of a prefix */
+struct tree_route
 {
-	DIGITS = 10
+	char name[64]; /**< Route name (for dump)      */
+	int route;	   /**< Valid route number if >0   */
 };
 
 
-/** Defines a route item in the prefix tree */
+/** Defines the prefix routes being loaded */
 struct tree_item
 {
-	struct tree_item *digits[DIGITS]; /**< Child items for each digit */
-	char name[64];					  /**< Route name (for dump)      */
-	int route;						  /**< Valid route number if >0   */
+	pfx_builder_t *builder; /**< Digit prefix -> struct tree_route */
 };
 
 
 /** Defines a locked prefix tree */
 struct tree
 {
-	struct tree_item *root; /**< Root item of tree    */
-	atomic_t refcnt;		/**< Reference counting   */
+	pfx_index_t *index; /**< Read-only prefix index */
+	atomic_t refcnt;	/**< Reference counting   */
 };
 
 
@@ -73,7 +74,6 @@ static gen_lock_t *shared_tree_lock;
 struct tree_item *tree_item_alloc(void)
 {
 	struct tree_item *root;
-	int i;
 
 	root = (struct tree_item *)shm_malloc(sizeof(*root));
 	if(NULL == root) {
@@ -81,29 +81,31 @@ struct tree_item *tree_item_alloc(void)
 		return NULL;
 	}
 
-	for(i = 0; i < DIGITS; i++)
-		root->digits[i] = NULL;
-
-	root->route = 0;
+	root->builder = pfx_builder_new();
+	if(NULL == root->builder) {
+		shm_free(root);
+		return NULL;
+	}
 
 	return root;
 }
 
 
+static void tree_route_free(void *route)
+{
+	shm_free(route);
+}
+
+
 /**
  * Flush tree item
  */
 void tree_item_free(struct tree_item *item)
 {
-	int i;
-
 	if(NULL == item)
 		return;
 
-	for(i = 0; i < DIGITS; i++) {
-		tree_item_free(item->digits[i]);
-	}
-
+	pfx_builder_free(item->builder, tree_route_free);
 	shm_free(item);
 }
 
@@ -114,127 +116,103 @@ void tree_item_free(struct tree_item *item)
 int tree_item_add(struct tree_item *root, const char *prefix, const char *route,
 		int route_ix)
 {
-	struct tree_item *item;
+	struct tree_route **item;
+	char digits[PFX_KEY_MAX];
 	const char *p;
-	int err;
+	int len;
 
 	if(NULL == root || NULL == prefix || route_ix <= 0)
 		return -1;
 
-	item = root;
+	/* only the digits of the prefix are used */
+	len = 0;
 	for(p = prefix; '\0' != *p; p++) {
-		int digit;
-
 		if(!isdigit(*p))
 			continue;
-
-		digit = *p - '0';
-
-		/* exist? */
-		if(!item->digits[digit]) {
-			item->digits[digit] = tree_item_alloc();
-			if(!item->digits[digit]) {
-				LM_CRIT("alloc failed\n");
-				err = -1;
-				goto out;
-			}
+		if(len == PFX_KEY_MAX) {
+			LM_ERR("prefix %s too long\n", prefix);
+			return -1;
 		}
-
-		item = item->digits[digit];
+		digits[len++] = *p;
 	}
 
+	item = (struct tree_route **)pfx_builder_slot(root->builder, digits, len);
 	if(NULL == item) {
 		LM_CRIT("internal error (no item)\n");
-		err = -1;
-		goto out;
+		return -1;
 	}
 
-	if(item->route > 0) {
-		LM_ERR("prefix %s already set to %s\n", prefix, item->name);
+	if(NULL == *item) {
+		*item = (struct tree_route *)shm_malloc(sizeof(struct tree_route));
+		if(NULL == *item) {
+			SHM_MEM_CRITICAL;
+			return -1;
+		}
+	} else {
+		LM_ERR("prefix %s already set to %s\n", prefix, (*item)->name);
 	}
 
 	/* Set route number for the tree item */
-	item->route = route_ix;
+	(*item)->route = route_ix;
 
 	/* Copy the route name (used in tree dump) */
-	strncpy(item->name, route, sizeof(item->name) - 1);
-	item->name[sizeof(item->name) - 1] = '\0';
-
-	err = 0;
+	strncpy((*item)->name, route, sizeof((*item)->name) - 1);
+	(*item)->name[sizeof((*item)->name) - 1] = '\0';
 
-out:
-	return err;
+	return 0;
 }
 
 
 /**
- * Get route number from username
+ * Get route number from username, the non digits are skipped
+ *
+ * A prefix matches only if the username has more digits after it, a
+ * username equal to a whole prefix does not match that prefix.
  */
-int tree_item_get(const struct tree_item *root, const str *user)
+static int tree_index_get(const pfx_index_t *index, const str *user)
 {
-	const struct tree_item *item;
+	const struct tree_route *item;
+	char digits[PFX_KEY_MAX];
 	const char *p, *pmax;
-	int route = 0;
+	int len;
 
-	if(NULL == root || NULL == user || NULL == user->s || !user->len)
+	if(NULL == user || NULL == user->s || !user->len)
 		return -1;
 
+	/* no prefix is longer than PFX_KEY_MAX digits */
 	pmax = user->s + user->len;
-	item = root;
-	for(p = user->s; p < pmax; p++) {
-		int digit;
-
-		if(!isdigit(*p)) {
-			continue;
-		}
-
-		digit = *p - '0';
-
-		/* Update route with best match so far */
-		if(item->route > 0) {
-			route = item->route;
-		}
-
-		/* exist? */
-		if(NULL == item->digits[digit]) {
+	len = 0;
+	for(p = user->s; p < pmax && len < PFX_KEY_MAX; p++) {
+		if(isdigit(*p))
+			digits[len++] = *p;
+	}
+	for(; p < pmax; p++) {
+		if(isdigit(*p))
 			break;
-		}
-
-		item = item->digits[digit];
+	}
+	if(p == pmax) {
+		/* no more digits - the last one is not part of the prefix */
+		if(0 == len)
+			return 0;
+		len--;
 	}
 
-	return route;
+	item = (const struct tree_route *)pfx_index_longest(
+			index, digits, len, NULL);
+
+	return (NULL != item) ? item->route : 0;
 }
 
 
-/**
- * Print one tree item to a file handle
- */
-void tree_item_print(const struct tree_item *item, FILE *f, int level)
+static int tree_index_print(
+		const char *prefix, int len, void *value, void *param)
 {
-	int i;
+	const struct tree_route *item = (const struct tree_route *)value;
+	FILE *f = (FILE *)param;
 
-	if(NULL == item || NULL == f)
-		return;
-
-	if(item->route > 0) {
-		fprintf(f, " \t--> route[%s] ", item->name);
-	}
+	fprintf(f, " %.*s \t--> route[%s]\n", len, prefix, item->name);
 
-	for(i = 0; i < DIGITS; i++) {
-		int j;
-
-		if(!item->digits[i]) {
-			continue;
-		}
-
-		fputc('\n', f);
-		for(j = 0; j < level; j++)
-			fputc(' ', f);
-
-		fprintf(f, "%d ", i);
-		tree_item_print(item->digits[i], f, level + 1);
-	}
+	return 0;
 }
 
 
@@ -251,7 +229,7 @@ static struct tree *tree_alloc(void)
 		return NULL;
 	}
 
-	tree->root = NULL;
+	tree->index = NULL;
 	atomic_set(&tree->refcnt, 0);
 
 	return tree;
@@ -278,7 +256,7 @@ static void tree_flush(struct tree *tree)
 		usleep(100000);
 	};
 
-	tree_item_free(tree->root);
+	pfx_index_free(tree->index, tree_route_free);
 	shm_free(tree);
 }
 
@@ -358,15 +336,26 @@ void tree_close(void)
 }
 
 
+/**
+ * Build the lookup index from the loaded prefix routes, which are always
+ * released, and make it the current tree
+ */
 int tree_swap(struct tree_item *root)
 {
 	struct tree *new_tree, *old_tree;
 
 	new_tree = tree_alloc();
-	if(NULL == new_tree)
+	if(NULL == new_tree) {
+		tree_item_free(root);
 		return -1;
+	}
 
-	new_tree->root = root;
+	new_tree->index = pfx_index_build(root->builder);
+	tree_item_free(root);
+	if(NULL == new_tree->index) {
+		shm_free(new_tree);
+		return -1;
+	}
 
 	/* Save old tree */
 	old_tree = tree_get();
@@ -394,7 +383,7 @@ int tree_route_get(const str *user)
 		return -1;
 	}
 
-	route = tree_item_get(tree->root, user);
+	route = tree_index_get(tree->index, user);
 	tree_deref(tree);
 
 	return route;
@@ -411,7 +400,7 @@ void tree_print(FILE *f)
 
 	if(tree) {
 		fprintf(f, " reference count: %d\n", atomic_get(&tree->refcnt));
-		tree_item_print(tree->root, f, 0);
+		pfx_index_walk(tree->index, tree_index_print, f);
 	} else {
 		fprintf(f, " (no tree)\n");
 	}
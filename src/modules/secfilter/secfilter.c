@@ -39,6 +39,7 @@ MODULE_VERSION
 
 secf_data_p *secf_data = NULL;
 secf_data_p secf_data_1 = NULL;
+ipidx_guard_t *secf_net_guard = NULL;
 secf_data_p secf_data_2 = NULL;
 static gen_lock_t *secf_lock = NULL;
 int *secf_stats;
@@ -53,6 +54,8 @@ static int child_init(int rank);
 static int rpc_init(void);
 static void free_str_list(struct str_list *l);
 static void free_sec_info(secf_info_p info);
+static void free_sec_filter(secf_filter_p filter);
+static void free_sec_net(secf_net_p net);
 void secf_free_data(secf_data_p secf_fdata);
 static void mod_destroy(void);
 static int sf_check_sqli(str *val, int check_quotes);
@@ -149,6 +152,7 @@ static const char *rpc_reload_doc[2] = {"Reload values from database", NULL};
 static const char *rpc_print_doc[2] = {"Print values from database", NULL};
 static const char *rpc_stats_doc[2] = {"Print statistics of blocked and allowed messages", NULL};
 static const char *rpc_stats_reset_doc[2] = {"Reset statistics", NULL};
+static const char *rpc_filter_stats_doc[2] = {"Print statistics of the Bloom filters of the lists", NULL};
 static const char *rpc_add_dst_doc[2] = {"Add new values to destination blacklist", NULL};
 static const char *rpc_del_dst_doc[2] = {"Delete a value from destination blacklist", NULL};
 static const char *rpc_add_bl_doc[2] = {"Add new values to blacklist", NULL};
@@ -161,6 +165,7 @@ rpc_export_t secfilter_rpc[] = {
 	{"secfilter.print", secf_rpc_print, rpc_print_doc, 0},
 	{"secfilter.stats", secf_rpc_stats, rpc_stats_doc, 0},
 	{"secfilter.stats_reset", secf_rpc_stats_reset, rpc_stats_reset_doc, 0},
+	{"secfilter.filter_stats", secf_rpc_filter_stats, rpc_filter_stats_doc, 0},
 	{"secfilter.add_dst", secf_rpc_add_dst, rpc_add_dst_doc, 0},
 	{"secfilter.del_dst", secf_rpc_del_dst, rpc_del_dst_doc, 0},
 	{"secfilter.add_bl", secf_rpc_add_bl, rpc_add_bl_doc, 0},
@@ -355,16 +360,50 @@ end:
 BLACKLIST AND WHITELIST
 ***/
 
+/**
+ * Get the list to scan for the values, NULL if the filter of the list
+ * tells that none of its entries is a prefix of them
+ */
+static struct str_list *secf_filter_list(
+		struct str_list *list, ksr_bloom_t *filter, str *val1, str *val2)
+{
+	if(!filter || !list)
+		return list;
+	if(val1 && val1->s && ksr_bloom_check_prefix(filter, val1))
+		return list;
+	if(val2 && val2->s && ksr_bloom_check_prefix(filter, val2))
+		return list;
+	return NULL;
+}
+
+/* A list returned by secf_filter_list() was scanned without a match */
+static void secf_filter_miss(struct str_list *list, ksr_bloom_t *filter)
+{
+	if(list && filter)
+		ksr_bloom_false_positive(filter);
+}
+
 /* Check if the current destination is allowed */
 static int ki_check_dst(struct sip_msg *msg, str *val)
 {
 	str dst;
-	struct str_list *list;
+	struct str_list *list, *first;
+	ksr_bloom_t *filter;
 
 	dst.s = val->s;
 	dst.len = val->len;
 
+	filter = (*secf_data)->bl_filter.dst;
 	list = (*secf_data)->bl.dst;
+	if(filter && list) {
+		if(secf_dst_exact_match == 1) {
+			if(!ksr_bloom_check(filter, &dst))
+				list = NULL;
+		} else {
+			list = secf_filter_list(list, filter, &dst, NULL);
+		}
+	}
+	first = list;
 	while(list) {
 		if(secf_dst_exact_match == 1) {
 			/* Exact match */
@@ -390,6 +429,7 @@ static int ki_check_dst(struct sip_msg *msg, str *val)
 		}
 		list = list->next;
 	}
+	secf_filter_miss(first, filter);
 
 	return 1;
 }
@@ -413,7 +453,8 @@ static int ki_check_ua(struct sip_msg *msg)
 {
 	int res, len;
 	str ua;
-	struct str_list *list;
+	struct str_list *list, *first;
+	ksr_bloom_t *filter;
 
 	res = secf_get_ua(msg, &ua);
 	if(res != 0)
@@ -422,7 +463,8 @@ static int ki_check_ua(struct sip_msg *msg)
 	len = ua.len;
 
 	/* User-agent whitelisted */
-	list = (*secf_data)->wl.ua;
+	filter = (*secf_data)->wl_filter.ua;
+	list = first = secf_filter_list((*secf_data)->wl.ua, filter, &ua, NULL);
 	while(list) {
 		if(ua.len > list->s.len)
 			ua.len = list->s.len;
@@ -436,9 +478,11 @@ static int ki_check_ua(struct sip_msg *msg)
 		list = list->next;
 		ua.len = len;
 	}
+	secf_filter_miss(first, filter);
 
 	/* User-agent blacklisted */
-	list = (*secf_data)->bl.ua;
+	filter = (*secf_data)->bl_filter.ua;
+	list = first = secf_filter_list((*secf_data)->bl.ua, filter, &ua, NULL);
 	while(list) {
 		if(ua.len > list->s.len)
 			ua.len = list->s.len;
@@ -452,6 +496,7 @@ static int ki_check_ua(struct sip_msg *msg)
 		list = list->next;
 		ua.len = len;
 	}
+	secf_filter_miss(first, filter);
 
 	return 1;
 }
@@ -587,11 +632,12 @@ static int w_check_contact_hdr(struct sip_msg *msg)
 }
 
 
-static int check_generic(
-		struct sip_msg *msg, struct str_list *list, int type, int field)
+static int check_generic(struct sip_msg *msg, struct str_list *list,
+		ksr_bloom_t *filter, int type, int field)
 {
 	str name = STR_NULL, user = STR_NULL, domain = STR_NULL;
 	str *target = NULL;
+	struct str_list *first;
 	int res, original_len;
 
 	switch(type) {
@@ -629,6 +675,8 @@ static int check_generic(
 		return -1;
 	original_len = target->len;
 
+	list = secf_filter_list(list, filter, target, NULL);
+	first = list;
 	while(list) {
 		if(target->len > list->s.len)
 			target->len = list->s.len;
@@ -643,6 +691,7 @@ static int check_generic(
 		list = list->next;
 		target->len = original_len;
 	}
+	secf_filter_miss(first, filter);
 
 	return 0;
 }
@@ -656,7 +705,8 @@ static int check_username(struct sip_msg *msg, int type)
 	// Check Whitelist
 	list = (*secf_data)->wl.user;
 
-	res = check_generic(msg, list, type, field);
+	res = check_generic(
+			msg, list, (*secf_data)->wl_filter.user, type, field);
 
 	if(res == -1) {
 		return -1;
@@ -682,7 +732,8 @@ static int check_username(struct sip_msg *msg, int type)
 	// Check Blacklist
 	res = -1;
 	list = (*secf_data)->bl.user;
-	res = check_generic(msg, list, type, field);
+	res = check_generic(
+			msg, list, (*secf_data)->bl_filter.user, type, field);
 
 	if(res == -1) {
 		return -1;
@@ -717,7 +768,8 @@ static int check_name(struct sip_msg *msg, int type)
 	int res = -1;
 	// Check Whitelist
 	list = (*secf_data)->wl.user;
-	res = check_generic(msg, list, type, field);
+	res = check_generic(
+			msg, list, (*secf_data)->wl_filter.user, type, field);
 	if(res == -1) {
 		return -1;
 	}
@@ -742,7 +794,8 @@ static int check_name(struct sip_msg *msg, int type)
 	// Check Blacklist
 	res = -1;
 	list = (*secf_data)->bl.user;
-	res = check_generic(msg, list, type, field);
+	res = check_generic(
+			msg, list, (*secf_data)->bl_filter.user, type, field);
 
 	if(res == -1) {
 		return -1;
@@ -777,7 +830,8 @@ static int check_domain(struct sip_msg *msg, int type)
 
 	// Check Whitelist
 	list = (*secf_data)->wl.user;
-	res = check_generic(msg, list, type, field);
+	res = check_generic(
+			msg, list, (*secf_data)->wl_filter.user, type, field);
 
 	if(res == -1) {
 		return -1;
@@ -803,7 +857,8 @@ static int check_domain(struct sip_msg *msg, int type)
 	// Check Blacklist
 	res = -1;
 	list = (*secf_data)->bl.domain;
-	res = check_generic(msg, list, type, field);
+	res = check_generic(
+			msg, list, (*secf_data)->bl_filter.domain, type, field);
 
 	if(res == -1) {
 		return -1;
@@ -850,7 +905,8 @@ static int check_user(struct sip_msg *msg, int type)
 	str domain = STR_NULL;
 	int res = 0;
 	int nlen, ulen, dlen;
-	struct str_list *list = NULL;
+	struct str_list *list = NULL, *first = NULL;
+	ksr_bloom_t *filter = NULL;
 
 	switch(type) {
 		case 1:
@@ -878,7 +934,9 @@ static int check_user(struct sip_msg *msg, int type)
 	dlen = domain.len;
 
 	/* User whitelisted */
-	list = (*secf_data)->wl.user;
+	filter = (*secf_data)->wl_filter.user;
+	list = first = secf_filter_list(
+			(*secf_data)->wl.user, filter, &name, &user);
 	while(list) {
 		if(name.len > list->s.len)
 			name.len = list->s.len;
@@ -924,8 +982,11 @@ static int check_user(struct sip_msg *msg, int type)
 		name.len = nlen;
 		user.len = ulen;
 	}
+	secf_filter_miss(first, filter);
 	/* User blacklisted */
-	list = (*secf_data)->bl.user;
+	filter = (*secf_data)->bl_filter.user;
+	list = first = secf_filter_list(
+			(*secf_data)->bl.user, filter, &name, &user);
 	while(list) {
 		if(name.len > list->s.len)
 			name.len = list->s.len;
@@ -971,9 +1032,12 @@ static int check_user(struct sip_msg *msg, int type)
 		name.len = nlen;
 		user.len = ulen;
 	}
+	secf_filter_miss(first, filter);
 
 	/* Domain whitelisted */
-	list = (*secf_data)->wl.domain;
+	filter = (*secf_data)->wl_filter.domain;
+	list = first = secf_filter_list(
+			(*secf_data)->wl.domain, filter, &domain, NULL);
 	while(list) {
 		if(domain.len > list->s.len)
 			domain.len = list->s.len;
@@ -997,8 +1061,11 @@ static int check_user(struct sip_msg *msg, int type)
 		list = list->next;
 		domain.len = dlen;
 	}
+	secf_filter_miss(first, filter);
 	/* Domain blacklisted */
-	list = (*secf_data)->bl.domain;
+	filter = (*secf_data)->bl_filter.domain;
+	list = first = secf_filter_list(
+			(*secf_data)->bl.domain, filter, &domain, NULL);
 	while(list) {
 		if(domain.len > list->s.len)
 			domain.len = list->s.len;
@@ -1022,6 +1089,7 @@ static int check_user(struct sip_msg *msg, int type)
 		list = list->next;
 		domain.len = dlen;
 	}
+	secf_filter_miss(first, filter);
 
 	return 1;
 }
@@ -1039,7 +1107,8 @@ static int ki_check_ip(struct sip_msg *msg)
 {
 	int res, len;
 	str ip;
-	struct str_list *list;
+	struct str_list *list, *first;
+	ksr_bloom_t *filter;
 
 	if(msg == NULL)
 		return -1;
@@ -1050,7 +1119,8 @@ static int ki_check_ip(struct sip_msg *msg)
 	len = ip.len;
 
 	/* IP address whitelisted */
-	list = (*secf_data)->wl.ip;
+	filter = (*secf_data)->wl_filter.ip;
+	list = first = secf_filter_list((*secf_data)->wl.ip, filter, &ip, NULL);
 	while(list) {
 		if(ip.len > list->s.len)
 			ip.len = list->s.len;
@@ -1064,8 +1134,21 @@ static int ki_check_ip(struct sip_msg *msg)
 		list = list->next;
 		ip.len = len;
 	}
+	secf_filter_miss(first, filter);
+	/* IP address in a whitelisted network */
+	ipidx_guard_pin(secf_net_guard);
+	res = (ipidx_match((*secf_data)->wl_net.idx, &msg->rcv.src_ip, NULL)
+			!= NULL);
+	ipidx_guard_unpin(secf_net_guard);
+	if(res) {
+		lock_get(secf_lock);
+		secf_stats[WL_IP]++;
+		lock_release(secf_lock);
+		return 2;
+	}
 	/* IP address blacklisted */
-	list = (*secf_data)->bl.ip;
+	filter = (*secf_data)->bl_filter.ip;
+	list = first = secf_filter_list((*secf_data)->bl.ip, filter, &ip, NULL);
 	while(list) {
 		if(ip.len > list->s.len)
 			ip.len = list->s.len;
@@ -1079,6 +1162,18 @@ static int ki_check_ip(struct sip_msg *msg)
 		list = list->next;
 		ip.len = len;
 	}
+	secf_filter_miss(first, filter);
+	/* IP address in a blacklisted network */
+	ipidx_guard_pin(secf_net_guard);
+	res = (ipidx_match((*secf_data)->bl_net.idx, &msg->rcv.src_ip, NULL)
+			!= NULL);
+	ipidx_guard_unpin(secf_net_guard);
+	if(res) {
+		lock_get(secf_lock);
+		secf_stats[BL_IP]++;
+		lock_release(secf_lock);
+		return -2;
+	}
 
 	return 1;
 }
@@ -1099,7 +1194,8 @@ static int ki_check_country(struct sip_msg *msg, str *val)
 {
 	int res, len;
 	str country;
-	struct str_list *list;
+	struct str_list *list, *first;
+	ksr_bloom_t *filter;
 
 	country.s = val->s;
 	country.len = val->len;
@@ -1107,7 +1203,9 @@ static int ki_check_country(struct sip_msg *msg, str *val)
 	len = country.len;
 
 	/* Country whitelisted */
-	list = (*secf_data)->wl.country;
+	filter = (*secf_data)->wl_filter.country;
+	list = first = secf_filter_list(
+			(*secf_data)->wl.country, filter, &country, NULL);
 	while(list) {
 		if(country.len > list->s.len)
 			country.len = list->s.len;
@@ -1121,8 +1219,11 @@ static int ki_check_country(struct sip_msg *msg, str *val)
 		list = list->next;
 		country.len = len;
 	}
+	secf_filter_miss(first, filter);
 	/* Country blacklisted */
-	list = (*secf_data)->bl.country;
+	filter = (*secf_data)->bl_filter.country;
+	list = first = secf_filter_list(
+			(*secf_data)->bl.country, filter, &country, NULL);
 	while(list) {
 		if(country.len > list->s.len)
 			country.len = list->s.len;
@@ -1136,6 +1237,7 @@ static int ki_check_country(struct sip_msg *msg, str *val)
 		list = list->next;
 		country.len = len;
 	}
+	secf_filter_miss(first, filter);
 
 	return 1;
 }
@@ -1248,6 +1350,11 @@ static int mod_init(void)
 		LM_CRIT("cannot initialize lock.\n");
 		return -1;
 	}
+	secf_net_guard = ipidx_guard_new();
+	if(!secf_net_guard) {
+		LM_CRIT("cannot allocate memory for network index guard.\n");
+		return -1;
+	}
 	/* Init database connection and check version */
 	if(secf_init_db() == -1)
 		return -1;
@@ -1323,6 +1430,25 @@ static void free_sec_info(secf_info_p info)
 }
 
 
+static void free_sec_filter(secf_filter_p filter)
+{
+	ksr_bloom_free(filter->ua);
+	ksr_bloom_free(filter->country);
+	ksr_bloom_free(filter->domain);
+	ksr_bloom_free(filter->user);
+	ksr_bloom_free(filter->ip);
+	ksr_bloom_free(filter->dst);
+	memset(filter, 0, sizeof(secf_filter_t));
+}
+
+
+static void free_sec_net(secf_net_p net)
+{
+	ipidx_free(net->idx, NULL);
+	memset(net, 0, sizeof(secf_net_t));
+}
+
+
 void secf_ht_timer(unsigned int ticks, void *param)
 {
 	if(secf_rpc_reload_time == NULL)
@@ -1355,6 +1481,12 @@ void secf_free_data(secf_data_p secf_fdata)
 	memset(&secf_fdata->bl_last, 0, sizeof(secf_info_t));
 	LM_DBG("so, ua[%p] should be NULL\n", secf_fdata->bl.ua);
 
+	LM_DBG("freeing filters\n");
+	free_sec_filter(&secf_fdata->wl_filter);
+	free_sec_filter(&secf_fdata->bl_filter);
+	free_sec_net(&secf_fdata->wl_net);
+	free_sec_net(&secf_fdata->bl_net);
+
 	lock_release(&secf_fdata->lock);
 }
 
@@ -3,6 +3,8 @@
 
 #include "../../core/str_list.h"
 #include "../../core/sr_module.h"
+#include "../../core/utils/bloom.h"
+#include "../../lib/ipidx/ipidx.h"
 
 #define BL_UA 0
 #define BL_COUNTRY 1
@@ -47,6 +49,24 @@ typedef struct _secf_info
 	struct str_list *dst;
 } secf_info_t, *secf_info_p;
 
+/* Bloom filters of the lists, to skip the scan of a list that can not
+ * match. A NULL filter means that the list has to be scanned. */
+typedef struct _secf_filter
+{
+	ksr_bloom_t *ua;
+	ksr_bloom_t *country;
+	ksr_bloom_t *domain;
+	ksr_bloom_t *user;
+	ksr_bloom_t *ip;
+	ksr_bloom_t *dst;
+} secf_filter_t, *secf_filter_p;
+
+typedef struct _secf_net
+{
+	int built;	  /* the index follows the changes of the ip list */
+	ipidx_t *idx; /* networks of the ip list entries in CIDR notation */
+} secf_net_t, *secf_net_p;
+
 typedef struct _secf_data
 {
 	gen_lock_t lock;
@@ -54,17 +74,25 @@ typedef struct _secf_data
 	secf_info_t wl_last;
 	secf_info_t bl; /* blacklist info */
 	secf_info_t bl_last;
+	secf_filter_t wl_filter;
+	secf_filter_t bl_filter;
+	secf_net_t wl_net;
+	secf_net_t bl_net;
 } secf_data_t, *secf_data_p;
 
 extern secf_data_p *secf_data;
 extern secf_data_p secf_data_1;
 extern secf_data_p secf_data_2;
 
+/* guard of the network indexes, the readers pin them while matching */
+extern ipidx_guard_t *secf_net_guard;
+
 extern int *secf_stats;
 void secf_reset_stats(void);
 
 int secf_append_rule(int action, int type, str *value);
 int secf_remove_rule(int action, int type, str *value);
+void secf_build_filters(secf_data_p data);
 
 /* Get header values from message */
 int secf_get_ua(struct sip_msg *msg, str *ua);
@@ -96,6 +124,7 @@ void secf_rpc_reload(rpc_t *rpc, void *ctx);
 void secf_rpc_print(rpc_t *rpc, void *ctx);
 void secf_rpc_stats(rpc_t *rpc, void *ctx);
 void secf_rpc_stats_reset(rpc_t *rpc, void *ctx);
+void secf_rpc_filter_stats(rpc_t *rpc, void *ctx);
 void secf_rpc_add_dst(rpc_t *rpc, void *ctx);
 void secf_rpc_del_dst(rpc_t *rpc, void *ctx);
 void secf_rpc_add_bl(rpc_t *rpc, void *ctx);
@@ -23,12 +23,20 @@
 
 
 #include "../../core/mem/shm_mem.h"
+#include "../../core/atomic_ops.h"
 #include "../../lib/srdb1/db.h"
 #include "secfilter.h"
 
 
 int mod_version = 1;
 
+/* Bloom filters of the lists */
+#define SECF_FILTER_BITS 10	  /* bits per value, about 1% false positives */
+#define SECF_FILTER_SPARE 64 /* room for the values added by RPC */
+
+/* value of the networks in the indexes, only NULL is special */
+#define SECF_NET_VALUE ((void *)1)
+
 /* Database variables */
 static db_func_t db_funcs;		 /* Database API functions */
 static db1_con_t *db_handle = 0; /* Database connection handle */
@@ -91,6 +99,62 @@ static struct str_list *shm_append_str_list(
 }
 
 
+/**
+ * Build the index of the entries in CIDR notation of an ip list, the
+ * other entries keep matching as string prefixes. The replaced index is
+ * freed after the readers that can still use it are done.
+**/
+static void secf_build_net(struct str_list *list, secf_net_p net)
+{
+	struct str_list *l;
+	ipidx_builder_t *b;
+	ipidx_t *idx = NULL;
+	ipidx_t *old;
+
+	b = ipidx_builder_new();
+	if(!b)
+		return;
+	for(l = list; l; l = l->next) {
+		if(memchr(l->s.s, '/', l->s.len) == NULL)
+			continue;
+		if(ipidx_builder_add(b, &l->s, SECF_NET_VALUE) < 0)
+			LM_WARN("skipping '%.*s' of the ip list\n", l->s.len, l->s.s);
+	}
+	if(ipidx_builder_count(b) > 0) {
+		idx = ipidx_build(b);
+		if(!idx)
+			LM_ERR("can't build the index of the ip list networks\n");
+	}
+	ipidx_builder_free(b, NULL);
+
+	old = net->idx;
+	/* the readers use the index as soon as they see it */
+	membar_write();
+	net->idx = idx;
+	net->built = 1;
+	if(old) {
+		ipidx_guard_sync(secf_net_guard);
+		ipidx_free(old, NULL);
+	}
+}
+
+
+/**
+ * Rebuild the network index of an ip list after a change of a network
+ * entry, once the indexes were built after loading
+**/
+static void secf_update_net(int action, struct str_list *list, str *value)
+{
+	secf_net_p net;
+
+	if(memchr(value->s, '/', value->len) == NULL)
+		return;
+	net = (action == 1) ? &(*secf_data)->wl_net : &(*secf_data)->bl_net;
+	if(net->built)
+		secf_build_net(list, net);
+}
+
+
 /**
 	Action => 0 = blacklist
 	          1 = whitelist
@@ -108,6 +172,8 @@ int secf_append_rule(int action, int type, str *value)
 	struct str_list **ini_node = NULL;
 	struct str_list **last_node = NULL;
 	struct str_list *new = NULL;
+	secf_filter_p filter = NULL;
+	ksr_bloom_t *filter_node = NULL;
 	int total = 0;
 	char *v = NULL;
 
@@ -119,9 +185,11 @@ int secf_append_rule(int action, int type, str *value)
 	if(action == 1) {
 		ini = &(*secf_data)->wl;
 		last = &(*secf_data)->wl_last;
+		filter = &(*secf_data)->wl_filter;
 	} else {
 		ini = &(*secf_data)->bl;
 		last = &(*secf_data)->bl_last;
+		filter = &(*secf_data)->bl_filter;
 	}
 
 	switch(type) {
@@ -129,26 +197,32 @@ int secf_append_rule(int action, int type, str *value)
 			if(action == 2) {
 				ini_node = &ini->dst;
 				last_node = &last->dst;
+				filter_node = filter->dst;
 			} else {
 				ini_node = &ini->ua;
 				last_node = &last->ua;
+				filter_node = filter->ua;
 			}
 			break;
 		case 1:
 			ini_node = &ini->country;
 			last_node = &last->country;
+			filter_node = filter->country;
 			break;
 		case 2:
 			ini_node = &ini->domain;
 			last_node = &last->domain;
+			filter_node = filter->domain;
 			break;
 		case 3:
 			ini_node = &ini->ip;
 			last_node = &last->ip;
+			filter_node = filter->ip;
 			break;
 		case 4:
 			ini_node = &ini->user;
 			last_node = &last->user;
+			filter_node = filter->user;
 			break;
 		default:
 			LM_ERR("Unknown type value %d", type);
@@ -178,6 +252,11 @@ int secf_append_rule(int action, int type, str *value)
 		*ini_node = new;
 	}
 	LM_DBG("ini_node:%p last_node:%p\n", *ini_node, *last_node);
+	/* the filters are built after loading, then they get the new values */
+	if(filter_node)
+		ksr_bloom_add(filter_node, value);
+	if(type == 3)
+		secf_update_net(action, *ini_node, value);
 
 	return 0;
 }
@@ -192,6 +271,8 @@ int secf_append_rule(int action, int type, str *value)
  * @param action: Specifies the target list (0 = blacklist, 1 = whitelist, 2 = destination blacklist).
  * @param type: Indicates the type of rule to be removed (e.g., domain, IP, user, etc.).
  * @param value: The specific value to be matched and removed from the list.
+ * The removed values stay in the Bloom filter of the list until the next
+ * reload, only as false positives.
  * @returns 0 if one or more entries are successfully removed or -1 if no matches are found or if an invalid action or type is specified.
 **/
 int secf_remove_rule(int action, int type, str *value)
@@ -281,6 +362,8 @@ int secf_remove_rule(int action, int type, str *value)
 		current = current->next;
 	}
 	if(total > 0) {
+		if(type == 3)
+			secf_update_net(action, *ini_node, value);
 		LM_DBG("Total matches removed: %d", total);
 		return 0; // Return the total number of removed items
 	} else {
@@ -289,6 +372,55 @@ int secf_remove_rule(int action, int type, str *value)
 	}
 }
 
+static ksr_bloom_t *secf_build_filter(struct str_list *list)
+{
+	struct str_list *l;
+	ksr_bloom_t *filter;
+	unsigned int n = 0;
+
+	for(l = list; l; l = l->next)
+		n++;
+	filter = ksr_bloom_new(
+			n + n / 2 + SECF_FILTER_SPARE, SECF_FILTER_BITS, KSR_BLOOM_ICASE);
+	if(!filter)
+		return NULL;
+	for(l = list; l; l = l->next)
+		ksr_bloom_add(filter, &l->s);
+
+	return filter;
+}
+
+
+static void secf_build_info_filters(secf_info_p info, secf_filter_p filter)
+{
+	secf_filter_t f;
+
+	f.ua = secf_build_filter(info->ua);
+	f.country = secf_build_filter(info->country);
+	f.domain = secf_build_filter(info->domain);
+	f.user = secf_build_filter(info->user);
+	f.ip = secf_build_filter(info->ip);
+	f.dst = secf_build_filter(info->dst);
+	/* the readers use a filter as soon as they see it */
+	membar_write();
+	*filter = f;
+}
+
+
+/**
+ * Build the Bloom filters of the lists of the data and the indexes of
+ * the networks of the ip lists, the data has to be locked. A filter that
+ * can not be built is left NULL and its list is always scanned.
+**/
+void secf_build_filters(secf_data_p data)
+{
+	secf_build_info_filters(&data->wl, &data->wl_filter);
+	secf_build_info_filters(&data->bl, &data->bl_filter);
+	secf_build_net(data->wl.ip, &data->wl_net);
+	secf_build_net(data->bl.ip, &data->bl_net);
+}
+
+
 /* Load data from database */
 int secf_load_db(void)
 {
@@ -358,6 +490,11 @@ int secf_load_db(void)
 	lock_release(&(*secf_data)->lock);
 
 clean:
+	if(res == 0) {
+		lock_get(&(*secf_data)->lock);
+		secf_build_filters(*secf_data);
+		lock_release(&(*secf_data)->lock);
+	}
 	if(db_funcs.free_result(db_handle, db_res) < 0) {
 		LM_DBG("Failed to free the result\n");
 	}
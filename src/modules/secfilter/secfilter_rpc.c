@@ -569,3 +569,55 @@ void secf_rpc_stats_reset(rpc_t *rpc, void *ctx)
 	secf_reset_stats();
 	rpc->rpl_printf(ctx, "The statistics has been reset");
 }
+
+static int rpc_filter_add(
+		rpc_t *rpc, void *ctx, void *h, char *name, ksr_bloom_t *filter)
+{
+	ksr_bloom_stats_t st;
+	void *fh;
+
+	if(filter == NULL)
+		return 0;
+	ksr_bloom_get_stats(filter, &st);
+	if(rpc->struct_add(h, "{", name, &fh) < 0)
+		return -1;
+	return rpc->struct_add(fh, "uuuujjj", "items", st.items, "bits", st.bits,
+			"bits_set", st.bits_set, "hashes", st.nhash, "checks", st.checks,
+			"positives", st.positives, "false_positives", st.false_positives);
+}
+
+static int rpc_filter_info(
+		rpc_t *rpc, void *ctx, void *h, char *name, secf_filter_p filter)
+{
+	void *ih;
+
+	if(rpc->struct_add(h, "{", name, &ih) < 0)
+		return -1;
+	if(rpc_filter_add(rpc, ctx, ih, "User-Agent", filter->ua) < 0
+			|| rpc_filter_add(rpc, ctx, ih, "Country", filter->country) < 0
+			|| rpc_filter_add(rpc, ctx, ih, "Domain", filter->domain) < 0
+			|| rpc_filter_add(rpc, ctx, ih, "User", filter->user) < 0
+			|| rpc_filter_add(rpc, ctx, ih, "IP-Address", filter->ip) < 0
+			|| rpc_filter_add(rpc, ctx, ih, "Destination", filter->dst) < 0)
+		return -1;
+	return 0;
+}
+
+/* Print statistics of the Bloom filters of the lists */
+void secf_rpc_filter_stats(rpc_t *rpc, void *ctx)
+{
+	secf_data_p data = *secf_data;
+	void *handle;
+	int res;
+
+	if(rpc->add(ctx, "{", &handle) < 0)
+		return;
+
+	lock_get(&data->lock);
+	res = rpc_filter_info(rpc, ctx, handle, "Blacklist", &data->bl_filter);
+	if(res == 0)
+		res = rpc_filter_info(rpc, ctx, handle, "Whitelist", &data->wl_filter);
+	lock_release(&data->lock);
+	if(res < 0)
+		rpc->fault(ctx, 500, "Internal error creating inner struct");
+}
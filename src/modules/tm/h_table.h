@@ -211,6 +211,8 @@ typedef struct ua_client
 	str location_ua;
 	/* if we don't store, we at least want to know the status */
 	int last_received;
+	/* when the request was sent (microseconds), set only for INVITE */
+	unsigned long long req_sent_us;
 
 	/* internal flags per tm uac */
 	unsigned int flags;
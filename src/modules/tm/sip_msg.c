@@ -53,6 +53,7 @@
 #include "../../core/sip_msg_clone.h"
 #include "../../core/fix_lumps.h"
 
+extern int _tm_clone_mode;
 
 /**
  * @brief Clone a SIP message
@@ -70,7 +71,9 @@ struct sip_msg *sip_msg_cloner(struct sip_msg *org_msg, int *sip_msg_len)
 		/*cloning all the lumps*/
 		return sip_msg_shm_clone(org_msg, sip_msg_len, 1);
 	/* don't clone the lumps */
-	return sip_msg_shm_clone(org_msg, sip_msg_len, 0);
+	return sip_msg_shm_clone_mode(org_msg, sip_msg_len, 0,
+			(_tm_clone_mode & 1) ? KSR_MSG_CLONE_COMPACT
+								 : KSR_MSG_CLONE_DEFAULT);
 }
 
 /**
@@ -49,11 +49,11 @@
 #include "h_table.h"
 #include "../../core/fix_lumps.h"
 #include "config.h"
+#include "../../core/msg_translator.h"
+#include "lw_parser.h"
 #ifdef USE_DNS_FAILOVER
 #include "../../core/dns_cache.h"
 #include "../../core/cfg_core.h" /* cfg_get(core, core_cfg, use_dns_failover) */
-#include "../../core/msg_translator.h"
-#include "lw_parser.h"
 #endif
 #ifdef USE_DST_BLOCKLIST
 #include "../../core/dst_blocklist.h"
@@ -85,11 +85,27 @@ typedef struct tm_branch_bak
 	struct socket_info *force_send_socket_bak;
 } tm_branch_bak_t;
 
+/* branch request used as template for building the next branches, only
+ * within the branches loop of a t_forward_nonack() call */
+typedef struct tm_branch_tmpl
+{
+	int on;
+	struct cell *t;
+	unsigned int msg_id;
+	int branch;
+	struct socket_info *send_sock;
+	int proto;
+	unsigned int vbflags;
+} tm_branch_tmpl_t;
+
 extern int tm_failure_exec_mode;
 extern int tm_dns_reuse_rcv_socket;
 extern int tm_headers_mode;
+extern int _tm_branch_template;
 static int goto_on_branch = 0, branch_route = 0;
 
+static tm_branch_tmpl_t _tm_branch_tmpl = {0};
+
 /* E2E_CANCEL_HOP_BY_HOP - cancel hop by hop */
 int tm_e2e_cancel_hop_by_hop = 1;
 
@@ -288,6 +304,128 @@ void tm_branch_restore_msg_fields(sip_msg_t *i_req, tm_branch_bak_t *bbak)
 	i_req->body_lumps = bbak->body_lumps_backup;
 }
 
+/**
+ * return 1 if the branch can be built from the template branch
+ * - adding the branches of a t_forward_nonack() call, for the same
+ *   transaction and message, with no changes done per branch in the
+ *   lumps (no branch route, no callbacks, no path) and same send socket,
+ *   protocol and via flags as the template
+ */
+static int tm_branch_tmpl_match(struct cell *t, struct sip_msg *i_req,
+		struct dest_info *dst, unsigned int vbflags)
+{
+	if(!_tm_branch_tmpl.on || _tm_branch_tmpl.t != t
+			|| _tm_branch_tmpl.msg_id != i_req->id) {
+		return 0;
+	}
+	if(_tm_branch_tmpl.branch >= t->nr_of_outgoings
+			|| t->uac[_tm_branch_tmpl.branch].request.buffer == NULL
+			|| t->uac[_tm_branch_tmpl.branch].uri.s == NULL) {
+		return 0;
+	}
+	if(_tm_branch_tmpl.send_sock != dst->send_sock
+			|| _tm_branch_tmpl.proto != dst->proto
+			|| _tm_branch_tmpl.vbflags != vbflags) {
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * keep the branch as template for the next branches of the message
+ */
+static void tm_branch_tmpl_set(struct cell *t, struct sip_msg *i_req,
+		int branch, struct dest_info *dst, unsigned int vbflags)
+{
+	if(!_tm_branch_tmpl.on) {
+		return;
+	}
+	_tm_branch_tmpl.t = t;
+	_tm_branch_tmpl.msg_id = i_req->id;
+	_tm_branch_tmpl.branch = branch;
+	_tm_branch_tmpl.send_sock = dst->send_sock;
+	_tm_branch_tmpl.proto = dst->proto;
+	_tm_branch_tmpl.vbflags = vbflags;
+}
+
+/**
+ * drop the template branch and enable (on=1) or disable (on=0) keeping one
+ * for the next branches
+ */
+static void tm_branch_tmpl_reset(int on)
+{
+	memset(&_tm_branch_tmpl, 0, sizeof(tm_branch_tmpl_t));
+	_tm_branch_tmpl.on = on;
+}
+
+/**
+ * build the request of a new branch from the buffer of the template branch,
+ * replacing the request URI and the first (local) Via header
+ * @return shm buffer on success, NULL on error
+ */
+static char *print_uac_request_from_tmpl(struct cell *t,
+		struct sip_msg *i_req, unsigned int *len, struct dest_info *dst,
+		ksr_msgbuild_t *mbd)
+{
+	char *buf;
+	char *buf_end;
+	char *shbuf;
+	char *p;
+	str *ouri;
+	str *nuri;
+	str branch_str;
+	char *via, *old_via_begin, *old_via_end;
+	unsigned int via_len;
+
+	buf = t->uac[_tm_branch_tmpl.branch].request.buffer;
+	buf_end = buf + t->uac[_tm_branch_tmpl.branch].request.buffer_len;
+	ouri = &t->uac[_tm_branch_tmpl.branch].uri;
+	nuri = GET_RURI(i_req);
+	branch_str.s = i_req->add_to_branch_s;
+	branch_str.len = i_req->add_to_branch_len;
+
+	/* the local via header follows the first line */
+	old_via_begin = lw_find_via(ouri->s + ouri->len, buf_end);
+	if(!old_via_begin) {
+		LM_DBG("beginning of via header not found\n");
+		return NULL;
+	}
+	old_via_end = lw_next_line(old_via_begin, buf_end);
+	if(!old_via_end) {
+		LM_DBG("end of via header not found\n");
+		return NULL;
+	}
+
+	via = create_via_hf(&via_len, i_req, dst, &branch_str, mbd);
+	if(!via) {
+		LM_ERR("via building failed\n");
+		return NULL;
+	}
+
+	*len = (buf_end - buf) + nuri->len - ouri->len + via_len
+		   - (old_via_end - old_via_begin);
+	shbuf = (char *)shm_malloc(*len);
+	if(!shbuf) {
+		SHM_MEM_ERROR;
+		pkg_free(via);
+		return NULL;
+	}
+
+	p = shbuf;
+	memcpy(p, buf, ouri->s - buf);
+	p += ouri->s - buf;
+	memcpy(p, nuri->s, nuri->len);
+	p += nuri->len;
+	memcpy(p, ouri->s + ouri->len, old_via_begin - (ouri->s + ouri->len));
+	p += old_via_begin - (ouri->s + ouri->len);
+	memcpy(p, via, via_len);
+	p += via_len;
+	memcpy(p, old_via_end, buf_end - old_via_end);
+
+	pkg_free(via);
+	return shbuf;
+}
+
 /** prepares a new branch "buffer".
  * Creates the buffer used in the branch rb, fills everything needed (
  * the sending information: t->uac[branch].request.dst, branch buffer, uri
@@ -335,8 +473,10 @@ static int prepare_new_uac(struct cell *t, struct sip_msg *i_req, int branch,
 	sip_msg_t *b_req = NULL;
 	char l_buf[BUF_SIZE];
 	int l_copy;
+	int tmpl_ok;
 
 	l_copy = 0;
+	tmpl_ok = 0;
 	shbuf = 0;
 	ret = E_UNSPEC;
 	memset(&bbak, 0, sizeof(tm_branch_bak_t));
@@ -468,8 +608,10 @@ static int prepare_new_uac(struct cell *t, struct sip_msg *i_req, int branch,
 		if(b_req->path_vec.s != 0 && bbak.free_path == 0)
 			bbak.free_path = 1;
 	} else {
-		/* no branch route and no TMCB_REQUEST_FWDED callback => set
-		 * msg uri and path to the new values (if needed) */
+		/* no branch route and no TMCB_REQUEST_FWDED callback => lumps
+		 * are the same for all branches, only uri and path can differ */
+		tmpl_ok = (_tm_branch_template && l_copy == 0);
+		/* set msg uri and path to the new values (if needed) */
 		if(unlikely((uri->s != b_req->new_uri.s
 							|| uri->len != b_req->new_uri.len)
 					&& (b_req->new_uri.s != 0
@@ -554,7 +696,21 @@ static int prepare_new_uac(struct cell *t, struct sip_msg *i_req, int branch,
 	}
 	/* ... and build it now */
 	mbd.tvbflags = t->uac[branch].vbflags;
-	shbuf = build_req_buf_from_sip_req(b_req, &len, dst, BUILD_IN_SHM, &mbd);
+	if(tmpl_ok && b_req->path_vec.len != 0) {
+		/* path is added with lumps when building the request */
+		tmpl_ok = 0;
+	}
+	if(tmpl_ok
+			&& tm_branch_tmpl_match(t, b_req, dst, t->uac[branch].vbflags)) {
+		shbuf = print_uac_request_from_tmpl(t, b_req, &len, dst, &mbd);
+	}
+	if(shbuf == NULL) {
+		shbuf = build_req_buf_from_sip_req(
+				b_req, &len, dst, BUILD_IN_SHM, &mbd);
+		if(tmpl_ok && shbuf && len > 0) {
+			tm_branch_tmpl_set(t, b_req, branch, dst, t->uac[branch].vbflags);
+		}
+	}
 	if(!shbuf || len <= 0) {
 		LM_ERR("could not build request\n");
 		if(shbuf) {
@@ -1621,7 +1777,11 @@ int t_send_branch(struct cell *t, int branch, struct sip_msg *p_msg,
 		}
 	}
 #endif /* USE_DST_BLOCKLIST */
+	/* before sending, a reply can come in before the send returns */
+	if(is_invite(t))
+		uac->req_sent_us = counter_hist_time_us();
 	if(SEND_BUFFER(&uac->request) == -1) {
+		uac->req_sent_us = 0;
 		/* disable the current branch: set a "fake" timeout
 		 *  reply code but don't set uac->reply, to avoid overriding
 		 *  a highly unlikely, perfectly timed fake reply (to a message
@@ -1752,6 +1912,10 @@ int t_forward_nonack(
 		}
 	}
 
+	/* no template for building the branches yet, the branches added next
+	 * can use the first one built */
+	tm_branch_tmpl_reset(1);
+
 	/* if ruri is not already consumed (by another invocation), use current
 	 * uri too. Else add only additional branches (which may be continuously
 	 * refilled).
@@ -1806,6 +1970,8 @@ int t_forward_nonack(
 			lowest_ret = MIN_int(lowest_ret, branch_ret);
 		}
 	}
+	/* the template is not used by other add_uac() callers */
+	tm_branch_tmpl_reset(0);
 	/* consume processed branches */
 	clear_branches();
 
@@ -1870,6 +2036,7 @@ int t_forward_nonack(
 
 canceled:
 	LM_DBG("no forwarding on a canceled transaction\n");
+	tm_branch_tmpl_reset(0);
 	/* reset processed branches */
 	clear_branches();
 	/* restore backup flags from initial env */
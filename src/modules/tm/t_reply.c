@@ -906,8 +906,13 @@ struct sip_msg *fake_req(struct sip_msg *shmem_msg, int extra_flags,
 	struct sip_msg *faked_req;
 	/* make a clone so eventual new parsed headers in pkg are not visible
 	 * to other processes -- other attributes should be already parsed,
-	 * available in the req structure and propagated by cloning */
-	faked_req = sip_msg_shm_clone(shmem_msg, len, 1);
+	 * available in the req structure and propagated by cloning; a compact
+	 * request is cloned compact, its Vias after the first ones have no
+	 * parsed body */
+	faked_req = sip_msg_shm_clone_mode(shmem_msg, len, 1,
+			(shmem_msg->msg_flags & FL_SHM_CLONE_COMPACT)
+					? KSR_MSG_CLONE_COMPACT
+					: KSR_MSG_CLONE_DEFAULT);
 	if(faked_req == NULL) {
 		LM_ERR("failed to clone the request\n");
 		return NULL;
@@ -922,6 +927,12 @@ struct sip_msg *fake_req(struct sip_msg *shmem_msg, int extra_flags,
 
 	faked_req->msg_flags |= extra_flags; /* set the extra tm flags */
 
+	/* compact clone of the request - index again all headers in pkg, so
+	 * they are available to the script */
+	if(sip_msg_shm_clone_expand(faked_req) < 0) {
+		goto error00;
+	}
+
 	/* path_vec was cloned in shm and can change -- make a private copy */
 	if(fake_req_clone_str_helper(
 			   &shmem_msg->path_vec, &faked_req->path_vec, "path_vec")
@@ -968,6 +979,7 @@ error00:
 void free_faked_req(struct sip_msg *faked_req, int len)
 {
 	struct hdr_field *hdr;
+	struct hdr_field *hdr_next;
 	void *mstart = faked_req;
 	void *mend = ((char *)faked_req) + len;
 
@@ -990,6 +1002,16 @@ void free_faked_req(struct sip_msg *faked_req, int len)
 			hdr->parsed = 0;
 		}
 	}
+	/* free header structures that were not cloned (compact clone expanded
+	 * or headers parsed by failure handlers) */
+	for(hdr = faked_req->headers; hdr; hdr = hdr_next) {
+		hdr_next = hdr->next;
+		if((void *)hdr < mstart || (void *)hdr >= mend) {
+			pkg_free(hdr);
+		}
+	}
+	faked_req->headers = 0;
+	faked_req->last_header = 0;
 	/* free parsed body added by failure handlers */
 	if(faked_req->body) {
 		if(faked_req->body->free)
@@ -2073,7 +2095,8 @@ enum rps relay_reply(struct cell *t, struct sip_msg *p_msg, int branch,
 				relayed_msg =
 						FAKED_REPLY; /* mark the relayed_msg as a "FAKE" */
 			} else {
-				buf = build_res_buf_from_sip_res(relayed_msg, &res_len);
+				buf = generate_res_buf_from_sip_res(relayed_msg, &res_len,
+						(ksr_msg_build_pbuf) ? BUILD_IN_PBUF : 0);
 				/* if we build a message from shmem, we need to remove
 				 * via delete lumps which are now stirred in the shmem-ed
 				 * structure
@@ -2224,14 +2247,14 @@ enum rps relay_reply(struct cell *t, struct sip_msg *p_msg, int branch,
 		if(do_put_on_wait && (reply_status == RPS_COMPLETED)) {
 			put_on_wait(t);
 		}
-		pkg_free(buf);
+		msg_build_buf_free(buf);
 	}
 
 	/* success */
 	return reply_status;
 
 error03:
-	pkg_free(buf);
+	msg_build_buf_free(buf);
 error02:
 	if(save_clone) {
 		if(t->uac[branch].reply != FAKED_REPLY)
@@ -2447,6 +2470,11 @@ int reply_received(struct sip_msg *p_msg)
 		goto done;
 	}
 
+	if(last_uac_status == 0 && uac->req_sent_us != 0 && is_invite(t)) {
+		t_stats_inv_first_reply(uac->req_sent_us);
+		uac->req_sent_us = 0;
+	}
+
 	onreply_route = uac->on_reply;
 	if(msg_status >= 200) {
 #ifdef TM_ONREPLY_FINAL_DROP_OK
@@ -31,9 +31,19 @@
 #include "h_table.h"
 
 union t_stats *tm_stats = 0;
+counter_hist_handle_t tm_hist_inv_first_reply = {0};
 
 int init_tm_stats(void)
 {
+	if(counter_hist_register(&tm_hist_inv_first_reply, "tm",
+			   "invite_first_reply_us",
+			   "time from sending an INVITE branch to the first reply"
+			   " (microseconds)",
+			   0)
+			< 0) {
+		LM_ERR("failed to register the invite first reply histogram\n");
+		return -1;
+	}
 	/* Delay initialization of tm_stats  to
 	 * init_tm_stats_child which gets called from child_init,
 	 * in mod_init function other modules can increase the value of
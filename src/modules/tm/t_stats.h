@@ -29,6 +29,7 @@
 
 #include "../../core/rpc.h"
 #include "../../core/pt.h"
+#include "../../core/counters.h"
 
 
 typedef unsigned long stat_counter;
@@ -66,6 +67,9 @@ union t_stats
 };
 extern union t_stats *tm_stats;
 
+/* time between sending an INVITE branch and its first reply (microseconds) */
+extern counter_hist_handle_t tm_hist_inv_first_reply;
+
 #ifdef TM_MORE_STATS
 inline void static t_stats_created(void)
 {
@@ -147,6 +151,15 @@ inline void static t_stats_rpl_sent(void)
 	tm_stats[process_no].s.rpl_sent++;
 }
 
+inline void static t_stats_inv_first_reply(unsigned long long sent_us)
+{
+	unsigned long long now;
+
+	now = counter_hist_time_us();
+	counter_hist_observe(tm_hist_inv_first_reply,
+			(now > sent_us) ? (unsigned long)(now - sent_us) : 0);
+}
+
 
 int init_tm_stats(void);
 int init_tm_stats_child(void);
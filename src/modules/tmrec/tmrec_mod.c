@@ -39,6 +39,7 @@
 #include "../../core/pvar.h"
 #include "../../core/mod_fix.h"
 #include "../../core/kemi.h"
+#include "../../core/hashes.h"
 #include "../../core/utils/tmrec.h"
 #include "period.h"
 
@@ -60,6 +61,19 @@ int tmrec_wday = 0;
 char tmrec_separator = '|';
 char *tmrec_separator_param = NULL;
 
+/* per process cache of the parsed recurrences and of their last result */
+#define TMREC_CACHE_SIZE 64
+
+typedef struct tmrec_cache
+{
+	unsigned int hashid;
+	str rdef; /* copy of the definition, parsed in place */
+	tmrec_t tmr;
+	tr_state_t st;
+} tmrec_cache_t;
+
+static tmrec_cache_t _tmrec_cache[TMREC_CACHE_SIZE];
+
 /* clang-format off */
 static cmd_export_t cmds[] = {
 	{"tmrec_match", (cmd_function)w_tmrec_match, 1,
@@ -119,6 +133,15 @@ static int child_init(int rank)
  */
 static void mod_destroy(void)
 {
+	int i;
+
+	for(i = 0; i < TMREC_CACHE_SIZE; i++) {
+		if(_tmrec_cache[i].rdef.s != NULL) {
+			tmrec_destroy(&_tmrec_cache[i].tmr);
+			pkg_free(_tmrec_cache[i].rdef.s);
+			_tmrec_cache[i].rdef.s = NULL;
+		}
+	}
 	return;
 }
 
@@ -177,11 +200,54 @@ static int fixup_is_leap_year(void **param, int param_no)
 	return 0;
 }
 
+/**
+ * get the parsed time recurrence definition from the cache, parsing it
+ * in place of the entry with the same hash
+ */
+static tmrec_cache_t *tmrec_cache_get(str *rv)
+{
+	tmrec_cache_t *tc;
+	unsigned int hashid;
+	char *p;
+
+	hashid = get_hash1_raw(rv->s, rv->len);
+	tc = &_tmrec_cache[hashid % TMREC_CACHE_SIZE];
+	if(tc->rdef.s != NULL && tc->hashid == hashid && tc->rdef.len == rv->len
+			&& memcmp(tc->rdef.s, rv->s, rv->len) == 0)
+		return tc;
+
+	p = (char *)pkg_malloc(rv->len + 1);
+	if(p == NULL) {
+		PKG_MEM_ERROR;
+		return NULL;
+	}
+	memcpy(p, rv->s, rv->len);
+	p[rv->len] = '\0';
+
+	if(tc->rdef.s != NULL) {
+		tmrec_destroy(&tc->tmr);
+		pkg_free(tc->rdef.s);
+	}
+	memset(tc, 0, sizeof(tmrec_cache_t));
+
+	/* parse time recurrence definition */
+	if(tr_parse_recurrence_string(&tc->tmr, p, tmrec_separator) < 0) {
+		tmrec_destroy(&tc->tmr);
+		memset(&tc->tmr, 0, sizeof(tmrec_t));
+		pkg_free(p);
+		return NULL;
+	}
+	tc->hashid = hashid;
+	tc->rdef.s = p;
+	tc->rdef.len = rv->len;
+
+	return tc;
+}
+
 static int ki_tmrec_match_timestamp(sip_msg_t *msg, str *rv, int ti)
 {
 	time_t tv;
-	ac_tm_t act;
-	tmrec_t tmr;
+	tmrec_cache_t *tc;
 
 	if(msg == NULL)
 		return -1;
@@ -191,34 +257,21 @@ static int ki_tmrec_match_timestamp(sip_msg_t *msg, str *rv, int ti)
 	} else {
 		tv = time(NULL);
 	}
-	memset(&act, 0, sizeof(act));
-	memset(&tmr, 0, sizeof(tmr));
 
-	/* parse time recurrence definition */
-	if(tr_parse_recurrence_string(&tmr, rv->s, tmrec_separator) < 0)
+	tc = tmrec_cache_get(rv);
+	if(tc == NULL)
 		return -1;
 
 	/* if there is no dstart, timerec is valid */
-	if(tmr.dtstart == 0)
-		goto done;
-
-	/* set current time */
-	if(ac_tm_set_time(&act, tv) < 0)
-		goto error;
+	if(tc->tmr.dtstart == 0)
+		return 1;
 
-	/* match the specified recurrence */
-	if(tr_check_recurrence(&tmr, &act, 0) != 0)
-		goto error;
+	/* match the specified recurrence, computed again only after the
+	 * next possible change of the result */
+	if(tr_check_recurrence_state(&tc->tmr, tv, &tc->st) != 0)
+		return -1;
 
-done:
-	tmrec_destroy(&tmr);
-	ac_tm_destroy(&act);
 	return 1;
-
-error:
-	tmrec_destroy(&tmr);
-	ac_tm_destroy(&act);
-	return -1;
 }
 
 static int ki_tmrec_match(sip_msg_t *msg, str *rv)
@@ -115,14 +115,18 @@ int db_build_userbl_tree(const str *username, const str *domain,
 
 
 /**
- * Rebuild d-tree using database entries
+ * Rebuild d-tree using database entries, and the Bloom filter of its
+ * prefixes, which replaces the one in filter
  * \return negative on failure, positive on success, indicating the number of d-tree entries
  */
-int db_reload_source(const str *dbtable, struct dtrie_node_t *root)
+int db_reload_source(
+		const str *dbtable, struct dtrie_node_t *root, ksr_bloom_t **filter)
 {
 	db_key_t columns[2] = {
 			&globalblocklist_prefix_col, &globalblocklist_allowlist_col};
 	db1_res_t *res;
+	ksr_bloom_t *nfilter;
+	str prefix;
 	int i;
 	int n = 0;
 	void *nodeflags;
@@ -140,6 +144,8 @@ int db_reload_source(const str *dbtable, struct dtrie_node_t *root)
 	}
 
 	dtrie_clear(root, NULL, match_mode);
+	/* without a filter the d-tree is always searched */
+	nfilter = ksr_bloom_new(RES_ROW_N(res), UBL_FILTER_BITS, 0);
 
 	if(RES_COL_N(res) > 1) {
 		for(i = 0; i < RES_ROW_N(res); i++) {
@@ -157,14 +163,15 @@ int db_reload_source(const str *dbtable, struct dtrie_node_t *root)
 						nodeflags = (void *)MARK_ALLOWLIST;
 					}
 
-					if(dtrie_insert(root,
-							   RES_ROWS(res)[i].values[0].val.string_val,
-							   strlen(RES_ROWS(res)[i]
-											   .values[0]
-											   .val.string_val),
-							   nodeflags, match_mode)
+					prefix.s =
+							(char *)RES_ROWS(res)[i].values[0].val.string_val;
+					prefix.len = strlen(prefix.s);
+					if(dtrie_insert(root, prefix.s, prefix.len, nodeflags,
+							   match_mode)
 							< 0)
 						LM_ERR("could not insert values into trie.\n");
+					else if(nfilter)
+						ksr_bloom_add(nfilter, &prefix);
 
 					n++;
 				} else {
@@ -175,5 +182,88 @@ int db_reload_source(const str *dbtable, struct dtrie_node_t *root)
 	}
 	userblocklist_dbf.free_result(userblocklist_dbh, res);
 
+	ksr_bloom_free(*filter);
+	*filter = nfilter;
+
 	return n;
 }
+
+
+/**
+ * Builds the key of the Bloom filter of the users: the user, or the
+ * user@domain when the domain is used, truncated to fit in buf, which
+ * has KSR_BLOOM_KEY_MAX chars.
+ */
+void ubl_user_key(const str *user, const str *domain, int use_domain,
+		char *buf, str *key)
+{
+	int len;
+
+	len = (user->len < KSR_BLOOM_KEY_MAX) ? user->len : KSR_BLOOM_KEY_MAX;
+	memcpy(buf, user->s, len);
+	if(use_domain && len < KSR_BLOOM_KEY_MAX) {
+		buf[len++] = '@';
+		if(domain->len < KSR_BLOOM_KEY_MAX - len) {
+			memcpy(buf + len, domain->s, domain->len);
+			len += domain->len;
+		} else {
+			memcpy(buf + len, domain->s, KSR_BLOOM_KEY_MAX - len);
+			len = KSR_BLOOM_KEY_MAX;
+		}
+	}
+	key->s = buf;
+	key->len = len;
+}
+
+
+/**
+ * Builds a Bloom filter of the users having entries in a per user table,
+ * case insensitive like the usual collations of the database.
+ * \return the filter on success, NULL otherwise
+ */
+ksr_bloom_t *db_build_user_filter(const str *dbtable, int use_domain)
+{
+	db_key_t columns[2] = {
+			&userblocklist_username_col, &userblocklist_domain_col};
+	db1_res_t *res;
+	ksr_bloom_t *filter;
+	char buf[KSR_BLOOM_KEY_MAX];
+	str user, domain, key;
+	int i;
+
+	if(userblocklist_dbf.use_table(userblocklist_dbh, dbtable) < 0) {
+		LM_ERR("cannot use db table '%.*s'\n", dbtable->len, dbtable->s);
+		return NULL;
+	}
+	if(userblocklist_dbf.query(
+			   userblocklist_dbh, NULL, NULL, NULL, columns, 0, 2, NULL, &res)
+			< 0) {
+		LM_ERR("error while executing query on db table '%.*s'\n", dbtable->len,
+				dbtable->s);
+		return NULL;
+	}
+
+	filter = ksr_bloom_new(RES_ROW_N(res), UBL_FILTER_BITS, KSR_BLOOM_ICASE);
+	if(filter == NULL)
+		goto done;
+	for(i = 0; i < RES_ROW_N(res); i++) {
+		if(RES_ROWS(res)[i].values[0].nul
+				|| RES_ROWS(res)[i].values[0].type != DB1_STRING)
+			continue;
+		user.s = (char *)RES_ROWS(res)[i].values[0].val.string_val;
+		user.len = strlen(user.s);
+		domain.s = "";
+		if(!RES_ROWS(res)[i].values[1].nul
+				&& RES_ROWS(res)[i].values[1].type == DB1_STRING)
+			domain.s = (char *)RES_ROWS(res)[i].values[1].val.string_val;
+		domain.len = strlen(domain.s);
+		ubl_user_key(&user, &domain, use_domain, buf, &key);
+		ksr_bloom_add(filter, &key);
+	}
+	LM_DBG("filter of %u users of table '%.*s'\n", filter->items,
+			dbtable->len, dbtable->s);
+
+done:
+	userblocklist_dbf.free_result(userblocklist_dbh, res);
+	return filter;
+}
@@ -31,13 +31,21 @@
 #define _DB_H_
 
 #include "../../core/sr_module.h"
+#include "../../core/utils/bloom.h"
 #include "../../lib/trie/dtrie.h"
 
 #define MARK_ALLOWLIST 1
 #define MARK_BLOCKLIST 2
 
+/* bits per entry of the Bloom filters, about 1% false positives */
+#define UBL_FILTER_BITS 10
+
 int db_build_userbl_tree(const str *user, const str *domain, const str *table,
 		struct dtrie_node_t *root, int use_domain);
-int db_reload_source(const str *table, struct dtrie_node_t *root);
+int db_reload_source(
+		const str *table, struct dtrie_node_t *root, ksr_bloom_t **filter);
+ksr_bloom_t *db_build_user_filter(const str *table, int use_domain);
+void ubl_user_key(const str *user, const str *domain, int use_domain,
+		char *buf, str *key);
 
 #endif
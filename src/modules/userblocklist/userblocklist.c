@@ -85,6 +85,7 @@ struct check_blocklist_fs_t
 str userblocklist_db_url = str_init(DEFAULT_RODB_URL);
 int use_domain = 0;
 int match_mode = 10; /* numeric */
+static int user_filter = 0;
 static struct dtrie_node_t *gnode = NULL;
 
 /* ---- fixup functions: */
@@ -146,6 +147,7 @@ static param_export_t params[] = {
 	globalblocklist_DB_COLS
 	{"use_domain", PARAM_INT, &use_domain},
 	{"match_mode", PARAM_INT, &match_mode},
+	{"user_filter", PARAM_INT, &user_filter},
 	{0, 0, 0}
 };
 
@@ -170,6 +172,8 @@ struct source_t
 	char *table;
 	/** d-tree structure: will be built from data in database */
 	struct dtrie_node_t *dtrie_root;
+	/** Bloom filter of the prefixes in the d-tree, NULL if not built */
+	ksr_bloom_t *filter;
 };
 
 
@@ -182,6 +186,8 @@ struct source_list_t
 static gen_lock_t *lock = NULL;
 static struct source_list_t *sources = NULL;
 static struct dtrie_node_t *dtrie_root = NULL;
+/* Bloom filter of the users with entries in the default user table */
+static ksr_bloom_t **user_filter_p = NULL;
 
 
 static int check_user_blocklist_fixup(void **param, int param_no)
@@ -209,6 +215,10 @@ static int ki_check_user_list(sip_msg_t *msg, str *suser, str *sdomain,
 	void **nodeflags;
 	char *ptr;
 	char req_number[MAXNUMBERLEN + 1];
+	char key_buf[KSR_BLOOM_KEY_MAX];
+	str key;
+	int use_filter;
+	int n;
 
 	if(stable == NULL || stable->len <= 0) {
 		/* use default table name */
@@ -245,11 +255,32 @@ static int ki_check_user_list(sip_msg_t *msg, str *suser, str *sdomain,
 	LM_DBG("check entry %s for user %.*s on domain %.*s in table %.*s\n",
 			req_number, suser->len, suser->s, sdomain->len, sdomain->s,
 			table.len, table.s);
-	if(db_build_userbl_tree(suser, sdomain, &table, dtrie_root, use_domain)
-			< 0) {
+
+	/* the filter of the default table tells the users without entries */
+	use_filter = (user_filter_p != NULL
+				  && STR_EQ(table, userblocklist_table));
+	if(use_filter) {
+		ubl_user_key(suser, sdomain, use_domain, key_buf, &key);
+		lock_get(lock);
+		if(*user_filter_p != NULL && !ksr_bloom_check(*user_filter_p, &key)) {
+			lock_release(lock);
+			LM_DBG("no entries for user %.*s\n", key.len, key.s);
+			return (!listtype) ? 1 : -1;
+		}
+		lock_release(lock);
+	}
+
+	n = db_build_userbl_tree(suser, sdomain, &table, dtrie_root, use_domain);
+	if(n < 0) {
 		LM_ERR("cannot build d-tree\n");
 		return -1;
 	}
+	if(use_filter && n == 0) {
+		lock_get(lock);
+		if(*user_filter_p != NULL)
+			ksr_bloom_false_positive(*user_filter_p);
+		lock_release(lock);
+	}
 
 	ptr = req_number;
 	/* Skip over non-digits.  */
@@ -416,7 +447,7 @@ static int load_source(struct source_t *src)
 	tmp.s = src->table;
 	tmp.len = strlen(src->table);
 
-	result = db_reload_source(&tmp, src->dtrie_root);
+	result = db_reload_source(&tmp, src->dtrie_root, &src->filter);
 	if(result < 0) {
 		LM_ERR("cannot load source from '%.*s'\n", tmp.len, tmp.s);
 		return 0;
@@ -486,6 +517,33 @@ static int add_source(const char *table)
 }
 
 
+/**
+ * Searches the longest prefix of a number in the d-tree of a source,
+ * skipping the search if the Bloom filter of the source has none of the
+ * prefixes. The lock has to be held.
+ */
+static void **source_longest_match(struct dtrie_node_t *root, char *number)
+{
+	struct source_t *src;
+	void **nodeflags;
+	str num;
+
+	num.s = number;
+	num.len = strlen(number);
+	for(src = sources->head; src; src = src->next) {
+		if(src->dtrie_root == root)
+			break;
+	}
+	if(src && src->filter && !ksr_bloom_check_prefix(src->filter, &num))
+		return NULL;
+	nodeflags = dtrie_longest_match(root, num.s, num.len, NULL, match_mode);
+	if(!nodeflags && src && src->filter)
+		ksr_bloom_false_positive(src->filter);
+
+	return nodeflags;
+}
+
+
 static int check_globalblocklist_fixup(void **param, int param_no)
 {
 	char *table = globalblocklist_table.s;
@@ -678,8 +736,7 @@ static int check_blocklist(sip_msg_t *msg, struct check_blocklist_fs_t *arg1)
 
 	/* avoids dirty reads when updating d-tree */
 	lock_get(lock);
-	nodeflags = dtrie_longest_match(
-			arg1->dtrie_root, ptr, strlen(ptr), NULL, match_mode);
+	nodeflags = source_longest_match(arg1->dtrie_root, ptr);
 	if(nodeflags) {
 		if(*nodeflags == (void *)MARK_ALLOWLIST) {
 			/* LM_DBG("allowlisted"); */
@@ -764,8 +821,7 @@ static int check_allowlist(sip_msg_t *msg, struct check_blocklist_fs_t *arg1)
 
 	/* avoids dirty reads when updating d-tree */
 	lock_get(lock);
-	nodeflags = dtrie_longest_match(
-			arg1->dtrie_root, ptr, strlen(ptr), NULL, match_mode);
+	nodeflags = source_longest_match(arg1->dtrie_root, ptr);
 	if(nodeflags) {
 		if(*nodeflags == (void *)MARK_ALLOWLIST) {
 			/* LM_DBG("allowlisted"); */
@@ -805,6 +861,11 @@ static int reload_sources(void)
 		src = src->next;
 	}
 
+	if(user_filter_p != NULL) {
+		ksr_bloom_free(*user_filter_p);
+		*user_filter_p = db_build_user_filter(&userblocklist_table, use_domain);
+	}
+
 	/* critical section end */
 	lock_release(lock);
 
@@ -834,6 +895,7 @@ void ubl_destroy_source_list(void)
 			if(src->table)
 				shm_free(src->table);
 			dtrie_destroy(&(src->dtrie_root), NULL, match_mode);
+			ksr_bloom_free(src->filter);
 			shm_free(src);
 		}
 
@@ -1164,6 +1226,43 @@ static void ubl_rpc_reload_blocklist(rpc_t *rpc, void *ctx)
 	return;
 }
 
+static int filter_stats_rpc(
+		rpc_t *rpc, void *ctx, void *th, char *name, ksr_bloom_t *filter)
+{
+	ksr_bloom_stats_t st;
+	void *sh;
+
+	if(filter == NULL)
+		return 0;
+	ksr_bloom_get_stats(filter, &st);
+	if(rpc->struct_add(th, "{", name, &sh) < 0)
+		return -1;
+	return rpc->struct_add(sh, "uuuujjj", "items", st.items, "bits", st.bits,
+			"bits_set", st.bits_set, "hashes", st.nhash, "checks", st.checks,
+			"positives", st.positives, "false_positives", st.false_positives);
+}
+
+static void ubl_rpc_filter_stats(rpc_t *rpc, void *ctx)
+{
+	struct source_t *src;
+	void *th;
+	int ret = 0;
+
+	if(rpc->add(ctx, "{", &th) < 0)
+		return;
+
+	lock_get(lock);
+	for(src = sources->head; src && ret == 0; src = src->next)
+		ret = filter_stats_rpc(rpc, ctx, th, src->table, src->filter);
+	if(ret == 0 && user_filter_p != NULL)
+		ret = filter_stats_rpc(
+				rpc, ctx, th, userblocklist_table.s, *user_filter_p);
+	lock_release(lock);
+
+	if(ret < 0)
+		rpc->fault(ctx, 500, "Internal error creating inner struct");
+}
+
 static void ubl_rpc_dump_blocklist(rpc_t *rpc, void *ctx)
 {
 	return dump_blocklist_rpc(rpc, ctx);
@@ -1210,6 +1309,9 @@ static const char *ubl_rpc_check_userblocklist_doc[2] = {
 static const char *ubl_rpc_check_userallowlist_doc[2] = {
 		"Check user allowlist records.", 0};
 
+static const char *ubl_rpc_filter_stats_doc[2] = {
+		"Statistics of the Bloom filters of the blocklists.", 0};
+
 rpc_export_t ubl_rpc[] = {
 		{"userblocklist.reload_blocklist", ubl_rpc_reload_blocklist,
 				ubl_rpc_reload_blocklist_doc, 0},
@@ -1223,6 +1325,8 @@ rpc_export_t ubl_rpc[] = {
 				ubl_rpc_check_userblocklist_doc, 0},
 		{"userblocklist.check_userallowlist", ubl_rpc_check_userallowlist,
 				ubl_rpc_check_userallowlist_doc, 0},
+		{"userblocklist.filter_stats", ubl_rpc_filter_stats,
+				ubl_rpc_filter_stats_doc, 0},
 		{0, 0, 0, 0}};
 
 static int ubl_rpc_init(void)
@@ -1244,6 +1348,14 @@ static int mod_init(void)
 		return -1;
 	if(init_source_list() != 0)
 		return -1;
+	if(user_filter) {
+		user_filter_p = shm_malloc(sizeof(ksr_bloom_t *));
+		if(!user_filter_p) {
+			SHM_MEM_ERROR;
+			return -1;
+		}
+		*user_filter_p = NULL;
+	}
 	return 0;
 }
 
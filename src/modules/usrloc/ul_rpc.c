@@ -188,6 +188,81 @@ int rpc_dump_contact(rpc_t *rpc, void *ctx, void *ih, ucontact_t *c)
 	return 0;
 }
 
+/*!
+ * \brief Dump the location tables as a sequence of per AoR structures
+ *
+ * Used when the transport can send the reply in parts. The reply is
+ * flushed after each hash slot, with the slot unlocked.
+ */
+static void ul_rpc_dump_stream(rpc_t *rpc, void *ctx, int summary)
+{
+	struct urecord *r;
+	dlist_t *dl;
+	udomain_t *dom;
+	ucontact_t *c;
+	void *bh;
+	void *ih;
+	int max, n, i;
+
+	for(dl = _ksr_ul_root; dl; dl = dl->next) {
+		dom = dl->d;
+		for(i = 0, n = 0, max = 0; i < dom->size; i++) {
+			lock_ulslot(dom, i);
+			n += dom->table[i].n;
+			if(max < dom->table[i].n)
+				max = dom->table[i].n;
+			for(r = dom->table[i].first; r; r = r->next) {
+				if(rpc->add(ctx, "{", &bh) < 0) {
+					unlock_ulslot(dom, i);
+					rpc->fault(ctx, 500, "Internal error creating aor struct");
+					return;
+				}
+				if(summary == 1) {
+					if(rpc->struct_add(
+							   bh, "SS", "Domain", &dl->name, "AoR", &r->aor)
+							< 0) {
+						unlock_ulslot(dom, i);
+						rpc->fault(
+								ctx, 500, "Internal error creating aor struct");
+						return;
+					}
+					continue;
+				}
+				if(rpc->struct_add(bh, "SSu[", "Domain", &dl->name, "AoR",
+						   &r->aor, "HashID", r->aorhash, "Contacts", &ih)
+						< 0) {
+					unlock_ulslot(dom, i);
+					rpc->fault(ctx, 500, "Internal error creating aor struct");
+					return;
+				}
+				for(c = r->contacts; c; c = c->next) {
+					if(rpc_dump_contact(rpc, ctx, ih, c) == -1) {
+						unlock_ulslot(dom, i);
+						return;
+					}
+				}
+			}
+			unlock_ulslot(dom, i);
+			if(rpc->flush(ctx) < 0) {
+				LM_DBG("rpc client gone - stopping the dump\n");
+				return;
+			}
+		}
+
+		/* domain summary at the end of its records */
+		if(rpc->add(ctx, "{", &bh) < 0) {
+			rpc->fault(ctx, 500, "Internal error creating stats struct");
+			return;
+		}
+		if(rpc->struct_add(bh, "Sddd", "Domain", &dl->name, "Size",
+				   (int)dom->size, "Records", n, "Max-Slots", max)
+				< 0) {
+			rpc->fault(ctx, 500, "Internal error adding stats");
+			return;
+		}
+	}
+}
+
 static void ul_rpc_dump(rpc_t *rpc, void *ctx)
 {
 	struct urecord *r;
@@ -210,6 +285,11 @@ static void ul_rpc_dump(rpc_t *rpc, void *ctx)
 	if(brief.len == 5 && (strncmp(brief.s, "brief", 5) == 0))
 		summary = 1;
 
+	if(rpc_stream_enabled(rpc, ctx)) {
+		ul_rpc_dump_stream(rpc, ctx, summary);
+		return;
+	}
+
 	if(rpc->add(ctx, "{", &th) < 0) {
 		rpc->fault(ctx, 500, "Internal error creating top rpc");
 		return;
@@ -53,45 +53,117 @@ void prom_body_delete(prom_ctx_t *ctx)
 }
 
 /**
- * @brief Write some data in prom_body buffer.
+ * @brief Grow the reply buffer to have room for at least need more bytes.
+ *
+ * The buffer starts small and it is doubled on demand, up to the limit
+ * set by xhttp_prom_buf_size.
+ *
+ * @return 0 on success.
+ */
+static int prom_body_grow(struct xhttp_prom_reply *reply, int need)
+{
+	int size;
+	char *buf;
+
+	if(reply->buf.len >= buf_size) {
+		LM_ERR("Error body buffer overflow: %d (max %d)\n",
+				reply->body.len + need, buf_size);
+		return -1;
+	}
+	size = (reply->buf.len > 0) ? reply->buf.len : PROM_BODY_BUF_INIT;
+	while(size - reply->body.len <= need && size < buf_size) {
+		size *= 2;
+	}
+	if(size > buf_size) {
+		size = buf_size;
+	}
+	if(size - reply->body.len <= need) {
+		LM_ERR("Error body buffer overflow: %d (max %d)\n",
+				reply->body.len + need, buf_size);
+		return -1;
+	}
+	buf = (char *)pkg_realloc(reply->buf.s, size);
+	if(buf == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	LM_DBG("Body buffer resized from %d to %d\n", reply->buf.len, size);
+	reply->buf.s = buf;
+	reply->buf.len = size;
+	reply->body.s = buf;
+	return 0;
+}
+
+/**
+ * @brief Print in prom_body buffer, growing it if needed.
  *
  * @return number of bytes written.
  * @return -1 on error.
  */
-int prom_body_printf(prom_ctx_t *ctx, char *fmt, ...)
+static int prom_body_vprintf(prom_ctx_t *ctx, char *fmt, va_list ap)
 {
 	struct xhttp_prom_reply *reply = &ctx->reply;
-
-	va_list ap;
-
-	va_start(ap, fmt);
+	va_list aq;
+	char *p;
+	int remaining_len;
+	int len;
 
 	LM_DBG("Body current length: %d\n", reply->body.len);
 
-	char *p = reply->buf.s + reply->body.len;
-	int remaining_len = reply->buf.len - reply->body.len;
+	p = reply->buf.s + reply->body.len;
+	remaining_len = reply->buf.len - reply->body.len;
 	LM_DBG("Remaining length: %d\n", remaining_len);
 
-	/* int vsnprintf(char *str, size_t size, const char *format, va_list ap); */
-	int len = vsnprintf(p, remaining_len, fmt, ap);
+	va_copy(aq, ap);
+	len = vsnprintf(p, remaining_len, fmt, aq);
+	va_end(aq);
 	if(len < 0) {
 		LM_ERR("Error printing body buffer\n");
-		goto error;
-	} else if(len >= remaining_len) {
-		LM_ERR("Error body buffer overflow: %d (%d)\n", len, remaining_len);
-		goto error;
-	} else {
-		/* Buffer printed OK. */
-		reply->body.len += len;
-		LM_DBG("Body new length: %d\n", reply->body.len);
+		return -1;
+	}
+	if(len >= remaining_len) {
+		if(prom_body_grow(reply, len) < 0) {
+			return -1;
+		}
+		p = reply->buf.s + reply->body.len;
+		remaining_len = reply->buf.len - reply->body.len;
+		va_copy(aq, ap);
+		len = vsnprintf(p, remaining_len, fmt, aq);
+		va_end(aq);
+		if(len < 0 || len >= remaining_len) {
+			LM_ERR("Error printing body buffer: %d (%d)\n", len,
+					remaining_len);
+			return -1;
+		}
 	}
 
-	va_end(ap);
 	return len;
+}
 
-error:
+/**
+ * @brief Write some data in prom_body buffer.
+ *
+ * @return number of bytes written.
+ * @return -1 on error.
+ */
+int prom_body_printf(prom_ctx_t *ctx, char *fmt, ...)
+{
+	struct xhttp_prom_reply *reply = &ctx->reply;
+
+	va_list ap;
+
+	va_start(ap, fmt);
+	int len = prom_body_vprintf(ctx, fmt, ap);
 	va_end(ap);
-	return -1;
+	if(len < 0) {
+		return -1;
+	}
+
+	/* Buffer printed OK. */
+	reply->body.len += len;
+	LM_DBG("Body new length: %d\n", reply->body.len);
+
+	return len;
 }
 
 /**
@@ -109,42 +181,27 @@ int prom_body_name_printf(prom_ctx_t *ctx, char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
+	int len = prom_body_vprintf(ctx, fmt, ap);
+	va_end(ap);
+	if(len < 0) {
+		return -1;
+	}
 
-	LM_DBG("Body current length: %d\n", reply->body.len);
+	/* Buffer printed OK. */
 
+	/* Change - into _ to accomplish with Prometheus guidelines for metric names */
 	char *p = reply->buf.s + reply->body.len;
-	int remaining_len = reply->buf.len - reply->body.len;
-	LM_DBG("Remaining length: %d\n", remaining_len);
-
-	/* int vsnprintf(char *str, size_t size, const char *format, va_list ap); */
-	int len = vsnprintf(p, remaining_len, fmt, ap);
-	if(len < 0) {
-		LM_ERR("Error printing body buffer\n");
-		goto error;
-	} else if(len >= remaining_len) {
-		LM_ERR("Error body buffer overflow: %d (%d)\n", len, remaining_len);
-		goto error;
-	} else {
-		/* Buffer printed OK. */
-
-		/* Change - into _ to accomplish with Prometheus guidelines for metric names */
-		int i;
-		for(i = 0; i < len; i++) {
-			if(p[i] == '-') {
-				p[i] = '_';
-			}
+	int i;
+	for(i = 0; i < len; i++) {
+		if(p[i] == '-') {
+			p[i] = '_';
 		}
-
-		reply->body.len += len;
-		LM_DBG("Body new length: %d\n", reply->body.len);
 	}
 
-	va_end(ap);
-	return len;
+	reply->body.len += len;
+	LM_DBG("Body new length: %d\n", reply->body.len);
 
-error:
-	va_end(ap);
-	return -1;
+	return len;
 }
 
 /**
@@ -421,6 +478,140 @@ static void prom_get_all_grps_cbk(void *p, str *g)
 	counter_iterate_grp_vars(g->s, prom_get_grp_vars_cbk, p);
 }
 
+/**
+ * @brief Generate the Prometheus lines of a core histogram.
+ *
+ * Cumulative _bucket lines for all the buckets up to the highest one with
+ * values, so the series of a bucket does not disappear while it stays
+ * unchanged, then +Inf, _sum and _count.
+ *
+ * @return 0 on success.
+ */
+static int hist_generate(
+		prom_ctx_t *ctx, str *group, str *name, counter_hist_handle_t h)
+{
+	counter_val_t buckets[CNT_HIST_BUCKETS];
+	counter_val_t count, sum, acc;
+	uint64_t ts;
+	int last;
+	int b;
+
+	if(counter_hist_get(h, buckets, &count, &sum) < 0) {
+		return -1;
+	}
+	if(get_timestamp(&ts)) {
+		LM_ERR("Error getting current timestamp\n");
+		return -1;
+	}
+
+	/* the last bucket has no upper bound, it is counted only in +Inf */
+	for(last = CNT_HIST_BUCKETS - 2; last >= 0 && buckets[last] == 0; last--)
+		;
+	acc = 0;
+	for(b = 0; b <= last; b++) {
+		acc += buckets[b];
+		if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_bucket",
+				   xhttp_prom_beginning.len, xhttp_prom_beginning.s,
+				   group->len, group->s, name->len, name->s)
+				== -1) {
+			goto error;
+		}
+		if(prom_body_printf(ctx, "{le=\"%lu\"%s} %lu",
+				   counter_hist_bucket_le(b), xhttp_prom_tags_comma,
+				   (unsigned long)acc)
+				== -1) {
+			goto error;
+		}
+		if(prom_body_timestamp_printf(ctx, ts) == -1) {
+			goto error;
+		}
+		if(prom_body_printf(ctx, "\n") == -1) {
+			goto error;
+		}
+	}
+
+	if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_bucket",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, group->len,
+			   group->s, name->len, name->s)
+			== -1) {
+		goto error;
+	}
+	if(prom_body_printf(ctx, "{le=\"+Inf\"%s} %lu", xhttp_prom_tags_comma,
+			   (unsigned long)count)
+			== -1) {
+		goto error;
+	}
+	if(prom_body_timestamp_printf(ctx, ts) == -1) {
+		goto error;
+	}
+	if(prom_body_printf(ctx, "\n") == -1) {
+		goto error;
+	}
+
+	if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_sum",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, group->len,
+			   group->s, name->len, name->s)
+			== -1) {
+		goto error;
+	}
+	if(prom_body_printf(
+			   ctx, "%s %lu", xhttp_prom_tags_braces, (unsigned long)sum)
+			== -1) {
+		goto error;
+	}
+	if(prom_body_timestamp_printf(ctx, ts) == -1) {
+		goto error;
+	}
+	if(prom_body_printf(ctx, "\n") == -1) {
+		goto error;
+	}
+
+	if(prom_body_name_printf(ctx, "%.*s%.*s_%.*s_count",
+			   xhttp_prom_beginning.len, xhttp_prom_beginning.s, group->len,
+			   group->s, name->len, name->s)
+			== -1) {
+		goto error;
+	}
+	if(prom_body_printf(
+			   ctx, "%s %lu", xhttp_prom_tags_braces, (unsigned long)count)
+			== -1) {
+		goto error;
+	}
+	if(prom_body_timestamp_printf(ctx, ts) == -1) {
+		goto error;
+	}
+	if(prom_body_printf(ctx, "\n") == -1) {
+		goto error;
+	}
+	return 0;
+
+error:
+	LM_ERR("Fail to print\n");
+	return -1;
+}
+
+typedef struct prom_hist_filter
+{
+	prom_ctx_t *ctx;
+	str group; /* only the histograms of this group, if set */
+} prom_hist_filter_t;
+
+/**
+ * @brief Histogram getter callback.
+ */
+static void prom_get_hists_cbk(
+		void *p, str *g, str *n, counter_hist_handle_t h)
+{
+	prom_hist_filter_t *hf = (prom_hist_filter_t *)p;
+
+	if(hf->group.len > 0
+			&& (hf->group.len != g->len
+					|| strncmp(hf->group.s, g->s, g->len) != 0)) {
+		return;
+	}
+	hist_generate(hf->ctx, g, n, h);
+}
+
 #define STATS_MAX_LEN 1024
 
 /**
@@ -462,6 +653,7 @@ int prom_stats_get(prom_ctx_t *ctx, str *stat)
 	int len = stat->len;
 
 	stat_var *s_stat;
+	prom_hist_filter_t hf;
 
 	if(len == 0) {
 		LM_DBG("Do not show Kamailio statistics\n");
@@ -474,7 +666,14 @@ int prom_stats_get(prom_ctx_t *ctx, str *stat)
 			return -1;
 		}
 
+		counter_snapshot_start();
 		counter_iterate_grp_names(prom_get_all_grps_cbk, ctx);
+		counter_snapshot_end();
+
+		hf.ctx = ctx;
+		hf.group.s = NULL;
+		hf.group.len = 0;
+		counter_hist_iterate(prom_get_hists_cbk, &hf);
 	} else if(stat->s[len - 1] == ':') {
 		LM_DBG("Showing statistics for group: %.*s\n", stat->len, stat->s);
 
@@ -497,6 +696,11 @@ int prom_stats_get(prom_ctx_t *ctx, str *stat)
 			stat_tmp[len - 1] = '\0';
 			counter_iterate_grp_vars(stat_tmp, prom_get_grp_vars_cbk, ctx);
 			stat_tmp[len - 1] = ':';
+
+			hf.ctx = ctx;
+			hf.group.s = stat->s;
+			hf.group.len = len - 1;
+			counter_hist_iterate(prom_get_hists_cbk, &hf);
 		}
 	} else {
 		LM_DBG("Showing statistic for: %.*s\n", stat->len, stat->s);
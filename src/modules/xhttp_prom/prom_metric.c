@@ -31,6 +31,8 @@
 #include "../../core/mem/shm_mem.h"
 #include "../../core/locking.h"
 #include "../../core/ut.h"
+#include "../../core/pt.h"
+#include "../../core/hashes.h"
 #include "../../core/parser/parse_param.h"
 
 #include "xhttp_prom.h"
@@ -44,7 +46,13 @@
  * - Module: @ref xhttp_prom
  */
 
-/* Every internal function locks and unlocks the metric system. */
+/* Metrics are created at startup and indexed by a hash table of names. The
+ * lvalues of each metric are kept in a hash table of label values, each slot
+ * being protected by a lock from a shared set. */
+
+#define PROM_METRIC_HTABLE_SIZE 256 /**< Slots for metrics (power of 2). */
+#define PROM_LVALUE_HTABLE_SIZE 64 /**< Slots for lvalues of a metric. */
+#define PROM_LOCK_SET_SIZE 64 /**< Number of locks for lvalues (power of 2). */
 
 /**
  * @brief enumeration of metric types.
@@ -85,24 +93,27 @@ typedef struct prom_hist_value_s
 	uint64_t *buckets_count; /**< Array of counters for buckets. */
 } prom_hist_value_t;
 
-typedef struct prom_metric_s prom_metric_t;
-
 /**
  * @brief Struct to store a value of a label.
  */
-typedef struct prom_lvalue_s
+struct prom_lvalue_s
 {
-	prom_lb_t lval; /**< values for labels in current metric. */
-	uint64_t ts;	/**< timespan. Last time metric was modified. */
+	prom_lb_t lval;	  /**< values for labels in current metric. */
+	unsigned int hid; /**< hash of the values for labels. */
+	int pinned;		  /**< referenced by a handle, it does not expire. */
+	uint64_t ts;	  /**< timespan. Last time metric was modified. */
 	union
 	{
 		uint64_t cval;			 /**< Counter value. */
 		double gval;			 /**< Gauge value. */
 		prom_hist_value_t *hval; /**< Pointer to histogram data. */
 	} m;
+	uint64_t *cslots; /**< Counter value per process, summed when printed. */
+	uint64_t *cbase;  /**< Slot values at last reset, subtracted when read. */
+	int cslots_no;	  /**< Number of counter slots. */
 	struct prom_metric_s *metric; /**< Metric associated to current lvalue. */
 	struct prom_lvalue_s *next;
-} prom_lvalue_t;
+};
 
 /**
  * @brief Struct to store number of buckets and their upper values.
@@ -124,7 +135,9 @@ struct prom_metric_s
 	struct prom_lb_s *lb_name; /**< Names of labels. */
 	struct prom_buckets_upper_s
 			*buckets_upper; /**< Upper bounds for buckets. */
-	struct prom_lvalue_s *lval_list;
+	unsigned int hid;	/**< Hash of the name. */
+	struct prom_lvalue_s **lv_htable; /**< Hash table of lvalues. */
+	struct prom_metric_s *hnext;	  /**< Next in hash table slot. */
 	struct prom_metric_s *next;
 };
 
@@ -132,7 +145,9 @@ struct prom_metric_s
  * @brief Data related to Prometheus metrics.
  */
 static prom_metric_t *prom_metric_list = NULL;
-static gen_lock_t *prom_lock = NULL; /**< Lock to protect Prometheus metrics. */
+static prom_metric_t *prom_metric_htable[PROM_METRIC_HTABLE_SIZE];
+static gen_lock_set_t *prom_lock_set =
+		NULL; /**< Locks to protect lvalues of Prometheus metrics. */
 static uint64_t
 		lvalue_timeout; /**< Timeout in milliseconds for old lvalue struct. */
 
@@ -145,8 +160,15 @@ static void prom_lb_node_free(prom_lb_node_t *lb_node, int shared_mem);
 static int prom_lb_node_add(prom_lb_t *m_lb, char *s, int len, int shared_mem);
 static void prom_lvalue_free(prom_lvalue_t *plv);
 static void prom_lvalue_list_free(prom_lvalue_t *plv);
+static void prom_lvalue_htable_free(prom_lvalue_t **lv_htable);
 static void prom_histogram_value_free(prom_hist_value_t *phv);
 
+/**
+ * @brief Index in the lock set for a slot of the lvalue hash table.
+ */
+#define prom_lvalue_lock_idx(p_m, slot) \
+	(((p_m)->hid + (slot)) & (PROM_LOCK_SET_SIZE - 1))
+
 /**
  * @brief Parse a string and convert to double.
  *
@@ -212,6 +234,7 @@ static void prom_metric_list_free()
 	}
 
 	prom_metric_list = NULL;
+	memset(prom_metric_htable, 0, sizeof(prom_metric_htable));
 }
 
 /**
@@ -227,17 +250,17 @@ int prom_metric_init()
 	lvalue_timeout = ((uint64_t)timeout_minutes) * 60000;
 	LM_DBG("lvalue_timeout set to %" PRIu64 "\n", lvalue_timeout);
 
-	/* Initialize lock. */
-	prom_lock = lock_alloc();
-	if(!prom_lock) {
-		LM_ERR("Cannot allocate lock\n");
+	/* Initialize locks. */
+	prom_lock_set = lock_set_alloc(PROM_LOCK_SET_SIZE);
+	if(!prom_lock_set) {
+		LM_ERR("Cannot allocate lock set\n");
 		return -1;
 	}
 
-	if(lock_init(prom_lock) == NULL) {
-		LM_ERR("Cannot initialize the lock\n");
-		lock_dealloc(prom_lock);
-		prom_lock = NULL;
+	if(lock_set_init(prom_lock_set) == NULL) {
+		LM_ERR("Cannot initialize the lock set\n");
+		lock_set_dealloc(prom_lock_set);
+		prom_lock_set = NULL;
 		return -1;
 	}
 
@@ -250,12 +273,12 @@ int prom_metric_init()
  */
 void prom_metric_close()
 {
-	/* Free lock */
-	if(prom_lock) {
-		LM_DBG("Freeing lock\n");
-		lock_destroy(prom_lock);
-		lock_dealloc(prom_lock);
-		prom_lock = NULL;
+	/* Free locks */
+	if(prom_lock_set) {
+		LM_DBG("Freeing lock set\n");
+		lock_set_destroy(prom_lock_set);
+		lock_set_dealloc(prom_lock_set);
+		prom_lock_set = NULL;
 	}
 
 	/* Free metric list. */
@@ -303,7 +326,7 @@ static void prom_counter_free(prom_metric_t *m_cnt)
 
 	prom_lb_free(m_cnt->lb_name, 1);
 
-	prom_lvalue_list_free(m_cnt->lval_list);
+	prom_lvalue_htable_free(m_cnt->lv_htable);
 
 	shm_free(m_cnt);
 }
@@ -316,20 +339,81 @@ static void prom_counter_free(prom_metric_t *m_cnt)
  */
 static prom_metric_t *prom_metric_get(str *s_name)
 {
-	prom_metric_t *p = prom_metric_list;
+	unsigned int hid = get_hash1_raw(s_name->s, s_name->len);
+	prom_metric_t *p = prom_metric_htable[hid & (PROM_METRIC_HTABLE_SIZE - 1)];
 
 	while(p) {
-		if(s_name->len == p->name.len
+		if(p->hid == hid && s_name->len == p->name.len
 				&& strncmp(s_name->s, p->name.s, s_name->len) == 0) {
 			LM_DBG("Metric found: %.*s\n", p->name.len, p->name.s);
 			break;
 		}
-		p = p->next;
+		p = p->hnext;
 	}
 
 	return p;
 }
 
+/**
+ * @brief Add a metric at the end of the list and index it by name.
+ *
+ * Only done at startup, the list and the hash table are not locked.
+ *
+ * @return 0 on success.
+ */
+static int prom_metric_register(prom_metric_t *p_m)
+{
+	prom_metric_t **l;
+
+	p_m->lv_htable = (prom_lvalue_t **)shm_malloc(
+			sizeof(prom_lvalue_t *) * PROM_LVALUE_HTABLE_SIZE);
+	if(p_m->lv_htable == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(p_m->lv_htable, 0, sizeof(prom_lvalue_t *) * PROM_LVALUE_HTABLE_SIZE);
+	p_m->hid = get_hash1_raw(p_m->name.s, p_m->name.len);
+
+	/* Place metric at the end of list. */
+	l = &prom_metric_list;
+	while(*l != NULL) {
+		l = &((*l)->next);
+	}
+	*l = p_m;
+	p_m->next = NULL;
+
+	/* Place metric at the end of its hash table slot. */
+	l = &prom_metric_htable[p_m->hid & (PROM_METRIC_HTABLE_SIZE - 1)];
+	while(*l != NULL) {
+		l = &((*l)->hnext);
+	}
+	*l = p_m;
+	p_m->hnext = NULL;
+
+	return 0;
+}
+
+/**
+ * @brief Hash of the values for labels.
+ */
+static unsigned int prom_lvalue_hash(str *l1, str *l2, str *l3)
+{
+	unsigned int h;
+
+	if(l1 == NULL) {
+		return 0;
+	}
+	h = get_hash1_raw(l1->s, l1->len);
+	if(l2 == NULL) {
+		return h;
+	}
+	h = h * 31 + get_hash1_raw(l2->s, l2->len);
+	if(l3 == NULL) {
+		return h;
+	}
+	return h * 31 + get_hash1_raw(l3->s, l3->len);
+}
+
 /**
  * @brief Compare prom_lb_t structure using some strings.
  *
@@ -431,6 +515,10 @@ static void prom_lvalue_free(prom_lvalue_t *plv)
 		prom_histogram_value_free(plv->m.hval);
 	}
 
+	if(plv->cslots) {
+		shm_free(plv->cslots);
+	}
+
 	/* Free list of strings. */
 	prom_lb_node_t *lb_node = plv->lval.lb;
 	while(lb_node) {
@@ -456,6 +544,24 @@ static void prom_lvalue_list_free(prom_lvalue_t *plv)
 	}
 }
 
+/**
+ * @brief Free the hash table of lvalue structures of a metric.
+ */
+static void prom_lvalue_htable_free(prom_lvalue_t **lv_htable)
+{
+	int i;
+
+	if(lv_htable == NULL) {
+		return;
+	}
+
+	for(i = 0; i < PROM_LVALUE_HTABLE_SIZE; i++) {
+		prom_lvalue_list_free(lv_htable[i]);
+	}
+
+	shm_free(lv_htable);
+}
+
 /**
  * @brief Fill lvalue data in prom_lvalue_t structure based on three strings.
  *
@@ -520,7 +626,7 @@ static int prom_lvalue_lb_create(prom_lvalue_t *lv, str *l1, str *l2, str *l3)
  * @return NULL on error.
  */
 static prom_lvalue_t *prom_metric_lvalue_create(
-		prom_metric_t *p_m, str *l1, str *l2, str *l3)
+		prom_metric_t *p_m, unsigned int hid, str *l1, str *l2, str *l3)
 {
 	if(p_m == NULL) {
 		LM_ERR("No metric found\n");
@@ -537,14 +643,29 @@ static prom_lvalue_t *prom_metric_lvalue_create(
 
 	/* Set link to metric */
 	plv->metric = p_m;
+	plv->hid = hid;
 
 	if(prom_lvalue_lb_create(plv, l1, l2, l3)) {
 		LM_ERR("Cannot create list of strings\n");
 		goto error;
 	}
 
-	/* Place plv at the end of lvalue list. */
-	prom_lvalue_t **l = &p_m->lval_list;
+	/* Counters have a slot per process to be updated without lock, followed
+	 * by the base values of the slots at last reset. */
+	if(p_m->type == M_COUNTER && get_max_procs() > 0) {
+		plv->cslots_no = get_max_procs();
+		plv->cslots =
+				(uint64_t *)shm_malloc(2 * sizeof(uint64_t) * plv->cslots_no);
+		if(plv->cslots == NULL) {
+			SHM_MEM_ERROR;
+			goto error;
+		}
+		memset(plv->cslots, 0, 2 * sizeof(uint64_t) * plv->cslots_no);
+		plv->cbase = plv->cslots + plv->cslots_no;
+	}
+
+	/* Place plv at the end of its hash table slot. */
+	prom_lvalue_t **l = &p_m->lv_htable[hid & (PROM_LVALUE_HTABLE_SIZE - 1)];
 	while(*l != NULL) {
 		l = &((*l)->next);
 	}
@@ -560,56 +681,62 @@ error:
 }
 
 /**
- * @brief Find a lvalue based on its labels.
+ * @brief Check that the number of labels matches the metric.
  *
- * If it does not exist it creates a new one and inserts it into the metric.
- *
- * @return pointer to lvalue on success.
- * @return NULL on error.
+ * @return 0 on success.
  */
-static prom_lvalue_t *prom_lvalue_get_create(
-		prom_metric_t *p_m, str *l1, str *l2, str *l3)
+static int prom_metric_lb_check(prom_metric_t *p_m, str *l1, str *l2, str *l3)
 {
-	if(!p_m) {
-		LM_ERR("No metric found\n");
-		return NULL;
-	}
-
 	/* Check number of elements in labels. */
 	if(l1 == NULL) {
 		if(p_m->lb_name != NULL) {
 			LM_ERR("Number of labels does not match for metric: %.*s\n",
 					p_m->name.len, p_m->name.s);
-			return NULL;
+			return -1;
 		}
 
 	} else if(l2 == NULL) {
 		if(!p_m || !p_m->lb_name || p_m->lb_name->n_elem != 1) {
 			LM_ERR("Number of labels does not match for metric: %.*s\n",
 					p_m->name.len, p_m->name.s);
-			return NULL;
+			return -1;
 		}
 
 	} else if(l3 == NULL) {
 		if(!p_m || !p_m->lb_name || p_m->lb_name->n_elem != 2) {
 			LM_ERR("Number of labels does not match for metric: %.*s\n",
 					p_m->name.len, p_m->name.s);
-			return NULL;
+			return -1;
 		}
 
 	} else {
 		if(!p_m || !p_m->lb_name || p_m->lb_name->n_elem != 3) {
 			LM_ERR("Number of labels does not match for metric: %.*s\n",
 					p_m->name.len, p_m->name.s);
-			return NULL;
+			return -1;
 		}
 
 	} /* if l1 == NULL */
 
+	return 0;
+}
+
+/**
+ * @brief Find a lvalue based on its labels.
+ *
+ * If it does not exist it creates a new one and inserts it into the metric.
+ * The lock of the hash table slot has to be held.
+ *
+ * @return pointer to lvalue on success.
+ * @return NULL on error.
+ */
+static prom_lvalue_t *prom_lvalue_get_create(
+		prom_metric_t *p_m, unsigned int hid, str *l1, str *l2, str *l3)
+{
 	/* Find existing prom_lvalue_t structure. */
-	prom_lvalue_t *p = p_m->lval_list;
+	prom_lvalue_t *p = p_m->lv_htable[hid & (PROM_LVALUE_HTABLE_SIZE - 1)];
 	while(p) {
-		if(prom_lvalue_compare(p, l1, l2, l3) == 0) {
+		if(p->hid == hid && prom_lvalue_compare(p, l1, l2, l3) == 0) {
 			LM_DBG("LValue structure found\n");
 			return p;
 		}
@@ -618,7 +745,7 @@ static prom_lvalue_t *prom_lvalue_get_create(
 
 	LM_DBG("Creating lvalue %.*s\n", p_m->name.len, p_m->name.s);
 	/* No lvalue structure found. Create and insert a new one. */
-	p = prom_metric_lvalue_create(p_m, l1, l2, l3);
+	p = prom_metric_lvalue_create(p_m, hid, l1, l2, l3);
 	if(p == NULL) {
 		LM_ERR("Cannot create a new lvalue structure\n");
 		return NULL;
@@ -628,29 +755,19 @@ static prom_lvalue_t *prom_lvalue_get_create(
 }
 
 /**
- * @brief Delete old lvalue structures in a metric.
+ * @brief Delete old lvalue structures in a hash table slot of a metric.
  *
- * Only for shared memory.
+ * Only for shared memory. The lock of the slot has to be held.
  */
-static void prom_metric_timeout_delete(prom_metric_t *p_m)
+static void prom_lvalue_slot_timeout_delete(
+		prom_metric_t *p_m, int slot, uint64_t ts)
 {
-	if(p_m == NULL) {
-		return;
-	}
-
-	/* Get timestamp. */
-	uint64_t ts;
-	if(get_timestamp(&ts)) {
-		LM_ERR("Fail to get timestamp\n");
-		return;
-	}
-
 	/* Parse lvalue list deleting outdated items. */
-	prom_lvalue_t **l = &p_m->lval_list;
+	prom_lvalue_t **l = &p_m->lv_htable[slot];
 	while(*l != NULL) {
 		prom_lvalue_t *current = *l;
 
-		if(ts - current->ts > lvalue_timeout) {
+		if(!current->pinned && ts - current->ts > lvalue_timeout) {
 			LM_DBG("Timeout found\n");
 			*l = (*l)->next;
 
@@ -665,39 +782,70 @@ static void prom_metric_timeout_delete(prom_metric_t *p_m)
 }
 
 /**
- * @brief Delete old lvalue structures in list of metrics.
+ * @brief Get a lvalue of a metric based on its labels and lock it.
+ *
+ * If no lvalue matches it creates a new lvalue. On success the lock of
+ * the lvalue is held and its index is stored in lidx, to be released
+ * by the caller with lock_set_release().
+ *
+ * @return NULL if no lvalue was found or created.
+ * @return pointer to lvalue on success.
  */
-static void prom_metric_list_timeout_delete()
+static prom_lvalue_t *prom_lvalue_lock(
+		prom_metric_t *p_m, str *l1, str *l2, str *l3, int *lidx)
 {
-	prom_metric_t *p = prom_metric_list;
+	if(prom_metric_lb_check(p_m, l1, l2, l3)) {
+		return NULL;
+	}
 
-	while(p) {
-		prom_metric_timeout_delete(p);
-		p = p->next;
+	/* Get timestamp. */
+	uint64_t ts;
+	if(get_timestamp(&ts)) {
+		LM_ERR("Fail to get timestamp\n");
+		return NULL;
 	}
+
+	unsigned int hid = prom_lvalue_hash(l1, l2, l3);
+	int slot = hid & (PROM_LVALUE_HTABLE_SIZE - 1);
+	*lidx = prom_lvalue_lock_idx(p_m, slot);
+	lock_set_get(prom_lock_set, *lidx);
+
+	/* Delete old lvalue structures. */
+	if(lvalue_timeout > 0) {
+		prom_lvalue_slot_timeout_delete(p_m, slot, ts);
+	}
+
+	prom_lvalue_t *p_lv = NULL;
+	p_lv = prom_lvalue_get_create(p_m, hid, l1, l2, l3);
+	if(p_lv == NULL) {
+		LM_ERR("Failed to create lvalue\n");
+		lock_set_release(prom_lock_set, *lidx);
+		return NULL;
+	}
+
+	p_lv->ts = ts;
+	LM_DBG("New timestamp: %" PRIu64 "\n", p_lv->ts);
+
+	return p_lv;
 }
 
 /**
- * @brief Get a lvalue based on its metric name and labels.
+ * @brief Get a lvalue based on its metric name and labels and lock it.
  *
  * If metric name exists but no lvalue matches it creates a new lvalue.
+ * On success the lock index is stored in lidx, as for prom_lvalue_lock().
  *
  * @return NULL if no lvalue was found or created.
  * @return pointer to lvalue on success.
  */
-static prom_lvalue_t *prom_metric_lvalue_get(
-		str *s_name, metric_type_t m_type, str *l1, str *l2, str *l3)
+static prom_lvalue_t *prom_metric_lvalue_lock(
+		str *s_name, metric_type_t m_type, str *l1, str *l2, str *l3, int *lidx)
 {
 	if(!s_name || s_name->len == 0 || s_name->s == NULL) {
 		LM_ERR("No name for metric\n");
 		return NULL;
 	}
 
-	/* Delete old lvalue structures. */
-	if(lvalue_timeout > 0) {
-		prom_metric_list_timeout_delete();
-	}
-
 	prom_metric_t *p_m = prom_metric_get(s_name);
 	if(p_m == NULL) {
 		LM_ERR("No metric found for name: %.*s\n", s_name->len, s_name->s);
@@ -710,24 +858,7 @@ static prom_lvalue_t *prom_metric_lvalue_get(
 		return NULL;
 	}
 
-	/* Get timestamp. */
-	uint64_t ts;
-	if(get_timestamp(&ts)) {
-		LM_ERR("Fail to get timestamp\n");
-		return NULL;
-	}
-
-	prom_lvalue_t *p_lv = NULL;
-	p_lv = prom_lvalue_get_create(p_m, l1, l2, l3);
-	if(p_lv == NULL) {
-		LM_ERR("Failed to create lvalue\n");
-		return NULL;
-	}
-
-	p_lv->ts = ts;
-	LM_DBG("New timestamp: %" PRIu64 "\n", p_lv->ts);
-
-	return p_lv;
+	return prom_lvalue_lock(p_m, l1, l2, l3, lidx);
 }
 
 /**
@@ -1044,12 +1175,10 @@ int prom_counter_create(char *spec)
 	}
 
 	/* Place counter at the end of list. */
-	prom_metric_t **l = &prom_metric_list;
-	while(*l != NULL) {
-		l = &((*l)->next);
+	if(prom_metric_register(m_cnt)) {
+		LM_ERR("Cannot register counter: %.*s\n", m_cnt->name.len, m_cnt->name.s);
+		goto error;
 	}
-	*l = m_cnt;
-	m_cnt->next = NULL;
 
 	/* Everything went fine. */
 	return 0;
@@ -1083,7 +1212,7 @@ static void prom_gauge_free(prom_metric_t *m_gg)
 
 	prom_lb_free(m_gg->lb_name, 1);
 
-	prom_lvalue_list_free(m_gg->lval_list);
+	prom_lvalue_htable_free(m_gg->lv_htable);
 
 	shm_free(m_gg);
 }
@@ -1155,12 +1284,10 @@ int prom_gauge_create(char *spec)
 	}
 
 	/* Place gauge at the end of list. */
-	prom_metric_t **l = &prom_metric_list;
-	while(*l != NULL) {
-		l = &((*l)->next);
+	if(prom_metric_register(m_gg)) {
+		LM_ERR("Cannot register gauge: %.*s\n", m_gg->name.len, m_gg->name.s);
+		goto error;
 	}
-	*l = m_gg;
-	m_gg->next = NULL;
 
 	/* Everything went fine. */
 	return 0;
@@ -1175,26 +1302,58 @@ error:
 	return -1;
 }
 
+/**
+ * @brief Add to the counter slot of current process.
+ *
+ * Every process writes only its own slot, so no lock is needed. The value
+ * without slot is used, with the lock held, by processes out of range.
+ *
+ * @return 0 if the slot was updated, -1 if the lock is needed.
+ */
+static inline int prom_lvalue_counter_add_slot(prom_lvalue_t *p, int number)
+{
+	if(p->cslots == NULL || process_no < 0 || process_no >= p->cslots_no) {
+		return -1;
+	}
+	p->cslots[process_no] += number;
+	return 0;
+}
+
+/**
+ * @brief Get the value of a counter, adding up the slots of processes.
+ */
+static uint64_t prom_lvalue_counter_get(prom_lvalue_t *p)
+{
+	uint64_t cval = p->m.cval;
+	int i;
+
+	for(i = 0; i < p->cslots_no; i++) {
+		cval += p->cslots[i] - p->cbase[i];
+	}
+	return cval;
+}
+
 /**
  * @brief Add some positive amount to a counter.
  */
 int prom_counter_inc(str *s_name, int number, str *l1, str *l2, str *l3)
 {
-	lock_get(prom_lock);
+	int lidx;
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_COUNTER, l1, l2, l3);
+	p = prom_metric_lvalue_lock(s_name, M_COUNTER, l1, l2, l3, &lidx);
 	if(!p) {
 		LM_ERR("Cannot find counter: %.*s\n", s_name->len, s_name->s);
-		lock_release(prom_lock);
 		return -1;
 	}
 
 	/* Add to counter value. */
-	p->m.cval += number;
+	if(prom_lvalue_counter_add_slot(p, number) < 0) {
+		p->m.cval += number;
+	}
 
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
 	return 0;
 }
 
@@ -1203,21 +1362,126 @@ int prom_counter_inc(str *s_name, int number, str *l1, str *l2, str *l3)
  */
 int prom_counter_reset(str *s_name, str *l1, str *l2, str *l3)
 {
-	lock_get(prom_lock);
+	int lidx;
+	int i;
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_COUNTER, l1, l2, l3);
+	p = prom_metric_lvalue_lock(s_name, M_COUNTER, l1, l2, l3, &lidx);
 	if(!p) {
 		LM_ERR("Cannot find counter: %.*s\n", s_name->len, s_name->s);
-		lock_release(prom_lock);
 		return -1;
 	}
 
-	/* Reset counter value. */
+	/* Reset counter value. The slots are owned by their processes and
+	 * updated without lock, so only their current values are taken as
+	 * base, to be subtracted when the counter is read. */
 	p->m.cval = 0;
+	for(i = 0; i < p->cslots_no; i++) {
+		p->cbase[i] = p->cslots[i];
+	}
 
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
+	return 0;
+}
+
+/**
+ * @brief Get a counter by name, to be used as handle.
+ *
+ * @return pointer to metric on success.
+ * @return NULL on error.
+ */
+prom_metric_t *prom_counter_get(str *s_name)
+{
+	prom_metric_t *p_m;
+
+	if(!s_name || s_name->len == 0 || s_name->s == NULL) {
+		LM_ERR("No name for metric\n");
+		return NULL;
+	}
+
+	p_m = prom_metric_get(s_name);
+	if(p_m == NULL) {
+		LM_ERR("No metric found for name: %.*s\n", s_name->len, s_name->s);
+		return NULL;
+	}
+
+	if(p_m->type != M_COUNTER) {
+		LM_ERR("Metric type does not match for metric: %.*s\n", s_name->len,
+				s_name->s);
+		return NULL;
+	}
+
+	return p_m;
+}
+
+/**
+ * @brief Add some positive amount to a counter got by handle.
+ */
+int prom_counter_inc_metric(
+		prom_metric_t *p_m, int number, str *l1, str *l2, str *l3)
+{
+	int lidx;
+
+	prom_lvalue_t *p = NULL;
+	p = prom_lvalue_lock(p_m, l1, l2, l3, &lidx);
+	if(!p) {
+		LM_ERR("Cannot find counter: %.*s\n", p_m->name.len, p_m->name.s);
+		return -1;
+	}
+
+	if(prom_lvalue_counter_add_slot(p, number) < 0) {
+		p->m.cval += number;
+	}
+
+	lock_set_release(prom_lock_set, lidx);
+	return 0;
+}
+
+/**
+ * @brief Get the lvalue of a counter for some labels and pin it.
+ *
+ * A pinned lvalue is not deleted by timeout, so it can be kept as handle
+ * and updated with prom_counter_lvalue_inc().
+ *
+ * @return pointer to lvalue on success.
+ * @return NULL on error.
+ */
+prom_lvalue_t *prom_counter_lvalue_pin(
+		prom_metric_t *p_m, str *l1, str *l2, str *l3)
+{
+	int lidx;
+
+	prom_lvalue_t *p = NULL;
+	p = prom_lvalue_lock(p_m, l1, l2, l3, &lidx);
+	if(!p) {
+		LM_ERR("Cannot find counter: %.*s\n", p_m->name.len, p_m->name.s);
+		return NULL;
+	}
+	p->pinned = 1;
+
+	lock_set_release(prom_lock_set, lidx);
+	return p;
+}
+
+/**
+ * @brief Add some positive amount to a pinned counter lvalue.
+ *
+ * No lock is taken if current process has a counter slot.
+ */
+int prom_counter_lvalue_inc(prom_lvalue_t *plv, int number)
+{
+	int lidx;
+
+	if(prom_lvalue_counter_add_slot(plv, number) == 0) {
+		return 0;
+	}
+
+	lidx = prom_lvalue_lock_idx(
+			plv->metric, plv->hid & (PROM_LVALUE_HTABLE_SIZE - 1));
+	lock_set_get(prom_lock_set, lidx);
+	plv->m.cval += number;
+	lock_set_release(prom_lock_set, lidx);
 	return 0;
 }
 
@@ -1226,21 +1490,20 @@ int prom_counter_reset(str *s_name, str *l1, str *l2, str *l3)
  */
 int prom_gauge_inc(str *s_name, double number, str *l1, str *l2, str *l3)
 {
-	lock_get(prom_lock);
+	int lidx;
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3);
+	p = prom_metric_lvalue_lock(s_name, M_GAUGE, l1, l2, l3, &lidx);
 	if(!p) {
 		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
-		lock_release(prom_lock);
 		return -1;
 	}
 
 	/* Increase/decrease gauge value. */
 	p->m.gval += number;
 
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
 	return 0;
 }
 
@@ -1249,21 +1512,20 @@ int prom_gauge_inc(str *s_name, double number, str *l1, str *l2, str *l3)
  */
 int prom_gauge_set(str *s_name, double number, str *l1, str *l2, str *l3)
 {
-	lock_get(prom_lock);
+	int lidx;
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3);
+	p = prom_metric_lvalue_lock(s_name, M_GAUGE, l1, l2, l3, &lidx);
 	if(!p) {
 		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
-		lock_release(prom_lock);
 		return -1;
 	}
 
 	/* Set gauge value. */
 	p->m.gval = number;
 
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
 	return 0;
 }
 
@@ -1272,21 +1534,20 @@ int prom_gauge_set(str *s_name, double number, str *l1, str *l2, str *l3)
  */
 int prom_gauge_reset(str *s_name, str *l1, str *l2, str *l3)
 {
-	lock_get(prom_lock);
+	int lidx;
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_GAUGE, l1, l2, l3);
+	p = prom_metric_lvalue_lock(s_name, M_GAUGE, l1, l2, l3, &lidx);
 	if(!p) {
 		LM_ERR("Cannot find gauge: %.*s\n", s_name->len, s_name->s);
-		lock_release(prom_lock);
 		return -1;
 	}
 
 	/* Reset counter value. */
 	p->m.gval = 0.0;
 
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
 	return 0;
 }
 
@@ -1463,7 +1724,7 @@ static void prom_histogram_free(prom_metric_t *m_hist)
 
 	prom_lb_free(m_hist->lb_name, 1);
 
-	prom_lvalue_list_free(m_hist->lval_list);
+	prom_lvalue_htable_free(m_hist->lv_htable);
 
 	shm_free(m_hist);
 }
@@ -1555,12 +1816,10 @@ int prom_histogram_create(char *spec)
 	}
 
 	/* Place histogram at the end of list. */
-	prom_metric_t **l = &prom_metric_list;
-	while(*l != NULL) {
-		l = &((*l)->next);
+	if(prom_metric_register(m_hist)) {
+		LM_ERR("Cannot register histogram: %.*s\n", m_hist->name.len, m_hist->name.s);
+		goto error;
 	}
-	*l = m_hist;
-	m_hist->next = NULL;
 
 	/* For debugging purpose show upper bounds for buckets. */
 	int i;
@@ -1693,14 +1952,14 @@ error:
 int prom_histogram_observe(
 		str *s_name, double number, str *l1, str *l2, str *l3)
 {
-	lock_get(prom_lock);
+	int lidx;
 
 	/* Find a lvalue based on its metric name and labels. */
 	prom_lvalue_t *p = NULL;
-	p = prom_metric_lvalue_get(s_name, M_HISTOGRAM, l1, l2, l3);
+	p = prom_metric_lvalue_lock(s_name, M_HISTOGRAM, l1, l2, l3, &lidx);
 	if(!p) {
 		LM_ERR("Cannot find histogram: %.*s\n", s_name->len, s_name->s);
-		goto error;
+		return -1;
 	}
 
 	/* Observe value in histogram related structure. */
@@ -1710,11 +1969,11 @@ int prom_histogram_observe(
 		goto error;
 	}
 
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
 	return 0;
 
 error:
-	lock_release(prom_lock);
+	lock_set_release(prom_lock_set, lidx);
 	return -1;
 }
 
@@ -1926,7 +2185,8 @@ static int prom_metric_lvalue_print(
 				goto error;
 		}
 
-		if(prom_body_printf(ctx, " %" PRIu64, pvl->m.cval) == -1) {
+		if(prom_body_printf(ctx, " %" PRIu64, prom_lvalue_counter_get(pvl))
+				== -1) {
 			LM_ERR("Fail to print\n");
 			goto error;
 		}
@@ -2177,7 +2437,14 @@ static int prom_metric_metadata_print(
  */
 int prom_metric_list_print(prom_ctx_t *ctx)
 {
-	lock_get(prom_lock);
+	uint64_t ts = 0;
+	int lidx = -1;
+	int slot;
+
+	if(lvalue_timeout > 0 && get_timestamp(&ts)) {
+		LM_ERR("Fail to get timestamp\n");
+		return -1;
+	}
 
 	prom_metric_t *p = prom_metric_list;
 	if(p) {
@@ -2194,8 +2461,6 @@ int prom_metric_list_print(prom_ctx_t *ctx)
 
 	while(p) {
 
-		prom_lvalue_t *pvl = p->lval_list;
-
 		if(metadata_flags) {
 			if(prom_metric_metadata_print(ctx, p, metadata_flags)) {
 				LM_ERR("Failed to print metric metadata\n");
@@ -2203,24 +2468,43 @@ int prom_metric_list_print(prom_ctx_t *ctx)
 			}
 		}
 
-		while(pvl) {
-			if(prom_metric_lvalue_print(ctx, p, pvl)) {
-				LM_ERR("Failed to print\n");
-				goto error;
+		/* Lock only one slot of lvalues at a time. */
+		for(slot = 0; slot < PROM_LVALUE_HTABLE_SIZE; slot++) {
+			if(p->lv_htable[slot] == NULL) {
+				continue;
 			}
+			lidx = prom_lvalue_lock_idx(p, slot);
+			lock_set_get(prom_lock_set, lidx);
 
-			pvl = pvl->next;
+			if(lvalue_timeout > 0) {
+				prom_lvalue_slot_timeout_delete(p, slot, ts);
+			}
+
+			prom_lvalue_t *pvl = p->lv_htable[slot];
+			while(pvl) {
+				if(prom_metric_lvalue_print(ctx, p, pvl)) {
+					LM_ERR("Failed to print\n");
+					goto error;
+				}
 
-		} /* while pvl */
+				pvl = pvl->next;
+
+			} /* while pvl */
+
+			lock_set_release(prom_lock_set, lidx);
+			lidx = -1;
+
+		} /* for slot */
 
 		p = p->next;
 
 	} /* while p */
 
-	lock_release(prom_lock);
 	return 0;
 
 error:
-	lock_release(prom_lock);
+	if(lidx >= 0) {
+		lock_set_release(prom_lock_set, lidx);
+	}
 	return -1;
 }
@@ -35,6 +35,9 @@
 
 #include "xhttp_prom.h"
 
+typedef struct prom_metric_s prom_metric_t;
+typedef struct prom_lvalue_s prom_lvalue_t;
+
 /**
  * @brief Initialize user defined metrics.
  */
@@ -82,6 +85,28 @@ int prom_gauge_reset(str *s_name, str *l1, str *l2, str *l3);
  */
 int prom_counter_inc(str *s_name, int number, str *l1, str *l2, str *l3);
 
+/**
+ * @brief Get a counter by name, to be used as handle.
+ */
+prom_metric_t *prom_counter_get(str *s_name);
+
+/**
+ * @brief Add some positive amount to a counter got by handle.
+ */
+int prom_counter_inc_metric(
+		prom_metric_t *p_m, int number, str *l1, str *l2, str *l3);
+
+/**
+ * @brief Get the lvalue of a counter for some labels and pin it.
+ */
+prom_lvalue_t *prom_counter_lvalue_pin(
+		prom_metric_t *p_m, str *l1, str *l2, str *l3);
+
+/**
+ * @brief Add some positive amount to a pinned counter lvalue.
+ */
+int prom_counter_lvalue_inc(prom_lvalue_t *plv, int number);
+
 /**
  * @brief Increase (or decrease, if amount is negative) a gauge by the given amount.
  */
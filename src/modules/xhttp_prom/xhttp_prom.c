@@ -512,16 +512,19 @@ static int w_prom_check_uri(sip_msg_t *msg)
 static int init_xhttp_prom_reply(prom_ctx_t *ctx)
 {
 	struct xhttp_prom_reply *reply = &ctx->reply;
+	int size;
 
 	reply->code = 200;
 	reply->reason = XHTTP_PROM_REASON_OK;
-	reply->buf.s = pkg_malloc(buf_size);
+	/* Start with a small buffer, it grows on demand up to buf_size. */
+	size = (buf_size < PROM_BODY_BUF_INIT) ? buf_size : PROM_BODY_BUF_INIT;
+	reply->buf.s = pkg_malloc(size);
 	if(!reply->buf.s) {
 		PKG_MEM_ERROR;
 		prom_fault(ctx, 500, "Internal Server Error (No memory left)");
 		return -1;
 	}
-	reply->buf.len = buf_size;
+	reply->buf.len = size;
 	reply->body.s = reply->buf.s;
 	reply->body.len = 0;
 	return 0;
@@ -1089,9 +1092,43 @@ static int w_prom_gauge_reset_l3(
 	return w_prom_gauge_reset(msg, pname, l1, l2, l3);
 }
 
+/**
+ * @brief Handle for the counter name parameter of prom_counter_inc.
+ *
+ * When the name is static the metric is resolved at startup. When the
+ * labels are static too, the lvalue is pinned at first use in each
+ * process, then updated without lookup and lock.
+ */
+typedef struct prom_counter_hdl
+{
+	gparam_t *gname;	   /**< Name of the counter. */
+	prom_metric_t *metric; /**< Metric if the name is static. */
+	int lstate; /**< Labels: 0 - not checked, 1 - pinned, -1 - dynamic. */
+	prom_lvalue_t *lv; /**< Pinned lvalue if labels are static. */
+} prom_counter_hdl_t;
+
 static int fixup_counter_inc(void **param, int param_no)
 {
-	if(param_no == 1 || param_no == 2) {
+	prom_counter_hdl_t *hdl;
+
+	if(param_no == 1) {
+		if(fixup_spve_igp(param, param_no) < 0) {
+			return -1;
+		}
+		hdl = (prom_counter_hdl_t *)pkg_malloc(sizeof(prom_counter_hdl_t));
+		if(hdl == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		memset(hdl, 0, sizeof(prom_counter_hdl_t));
+		hdl->gname = (gparam_t *)*param;
+		if(hdl->gname->type == GPARAM_TYPE_STR) {
+			/* Unknown counters are reported at runtime, as for dynamic names */
+			hdl->metric = prom_counter_get(&hdl->gname->v.str);
+		}
+		*param = (void *)hdl;
+		return 0;
+	} else if(param_no == 2) {
 		return fixup_spve_igp(param, param_no);
 	} else {
 		return fixup_spve_null(param, 1);
@@ -1100,7 +1137,17 @@ static int fixup_counter_inc(void **param, int param_no)
 
 static int fixup_free_counter_inc(void **param, int param_no)
 {
-	if(param_no == 1 || param_no == 2) {
+	prom_counter_hdl_t *hdl;
+
+	if(param_no == 1) {
+		hdl = (prom_counter_hdl_t *)*param;
+		if(hdl == NULL) {
+			return 0;
+		}
+		*param = (void *)hdl->gname;
+		pkg_free(hdl);
+		return fixup_free_spve_igp(param, param_no);
+	} else if(param_no == 2) {
 		return fixup_free_spve_igp(param, param_no);
 	} else {
 		return fixup_free_spve_null(param, 1);
@@ -1256,13 +1303,15 @@ static int w_prom_counter_inc(struct sip_msg *msg, char *pname, char *pnumber,
 {
 	int number;
 	str s_name;
+	prom_counter_hdl_t *hdl;
 
 	if(pname == NULL || pnumber == 0) {
 		LM_ERR("Invalid parameters\n");
 		return -1;
 	}
+	hdl = (prom_counter_hdl_t *)pname;
 
-	if(get_str_fparam(&s_name, msg, (gparam_t *)pname) != 0) {
+	if(get_str_fparam(&s_name, msg, hdl->gname) != 0) {
 		LM_ERR("No counter name\n");
 		return -1;
 	}
@@ -1321,8 +1370,37 @@ static int w_prom_counter_inc(struct sip_msg *msg, char *pname, char *pnumber,
 		l3 = NULL;
 	} /* if l1 != NULL */
 
-	if(prom_counter_inc(&s_name, number, (l1 != NULL) ? &l1_str : NULL,
-			   (l2 != NULL) ? &l2_str : NULL, (l3 != NULL) ? &l3_str : NULL)) {
+	if(hdl->metric != NULL && hdl->lstate == 0) {
+		/* First use in this process - pin the lvalue if labels are static */
+		hdl->lstate = -1;
+		if((l1 == NULL || ((gparam_t *)l1)->type == GPARAM_TYPE_STR)
+				&& (l2 == NULL || ((gparam_t *)l2)->type == GPARAM_TYPE_STR)
+				&& (l3 == NULL
+						|| ((gparam_t *)l3)->type == GPARAM_TYPE_STR)) {
+			hdl->lv = prom_counter_lvalue_pin(hdl->metric,
+					(l1 != NULL) ? &l1_str : NULL,
+					(l2 != NULL) ? &l2_str : NULL,
+					(l3 != NULL) ? &l3_str : NULL);
+			if(hdl->lv != NULL) {
+				hdl->lstate = 1;
+			}
+		}
+	}
+
+	if(hdl->lv != NULL) {
+		prom_counter_lvalue_inc(hdl->lv, number);
+	} else if(hdl->metric != NULL) {
+		if(prom_counter_inc_metric(hdl->metric, number,
+				   (l1 != NULL) ? &l1_str : NULL,
+				   (l2 != NULL) ? &l2_str : NULL,
+				   (l3 != NULL) ? &l3_str : NULL)) {
+			LM_ERR("Cannot add number: %d to counter: %.*s\n", number,
+					s_name.len, s_name.s);
+			return -1;
+		}
+	} else if(prom_counter_inc(&s_name, number, (l1 != NULL) ? &l1_str : NULL,
+					  (l2 != NULL) ? &l2_str : NULL,
+					  (l3 != NULL) ? &l3_str : NULL)) {
 		LM_ERR("Cannot add number: %d to counter: %.*s\n", number, s_name.len,
 				s_name.s);
 		return -1;
@@ -96,6 +96,16 @@ extern char *xhttp_prom_tags_comma;
  */
 extern char *xhttp_prom_tags_braces;
 
+/**
+ * @brief maximum size of the buffer that contains the reply.
+ */
+extern int buf_size;
+
+/**
+ * @brief initial size of the reply buffer, it grows up to buf_size.
+ */
+#define PROM_BODY_BUF_INIT 16384
+
 /**
  * @brief timeout in minutes to delete old metrics.
  */
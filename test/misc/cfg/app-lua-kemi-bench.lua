@@ -0,0 +1,26 @@
+-- benchmark for the execution of KEMI functions from Lua scripts
+-- - used by app-lua-kemi-bench.cfg
+
+local BENCH_LOOPS = 1000000
+
+function ksr_bench()
+	local i = 0
+	local v
+	local ss = KSR.pv.get("$TV(sn)")
+	local su = KSR.pv.get("$TV(un)")
+	while i < BENCH_LOOPS do
+		v = KSR.pv.get("$si")
+		v = KSR.pv.get("$rU")
+		KSR.pv.sets("$var(x)", "abc")
+		KSR.pv.seti("$var(y)", i)
+		v = KSR.is_method("INVITE")
+		v = KSR.is_myself_ruri()
+		v = KSR.hdr.is_present("Record-Route")
+		v = KSR.siputils.has_totag()
+		v = KSR.textops.search("INVITE")
+		i = i + 1
+	end
+	local d = (KSR.pv.get("$TV(sn)") - ss) * 1000000
+			+ KSR.pv.get("$TV(un)") - su
+	KSR.notice("bench: " .. i .. " loops in " .. d .. " usec\n")
+end
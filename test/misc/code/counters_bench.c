@@ -0,0 +1,218 @@
+/*
+ * benchmark for the layout of the per process counters (core/counters.c)
+ *
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+/*
+ * Example gcc command line:
+ *  gcc -O2 -Wall counters_bench.c -o counters_bench
+ *
+ * Usage:
+ *  ./counters_bench [-p max_procs] [-c counters] [-n loops]
+ *
+ * The counters are kept in shared memory, one row per process, like in
+ * core/counters.c. For 1, 2, 4, ... max_procs processes, each process
+ * increments the counters of its row and the total rate is printed for:
+ *  - misaligned: rows padded to 128 bytes, but starting at an address not
+ *    aligned to 128 bytes (like the shm block of the counters before) - the
+ *    end of a row shares the cache line with the start of the next one
+ *  - aligned: rows padded to 128 bytes and aligned to 128 bytes
+ * Then it prints the time to read all the counters one by one, walking
+ * the rows for each counter, and with a snapshot (one pass over the rows).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define CACHELINE_PAD 128
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* each process bumps a few counters of its row, as done per message */
+static void run_proc(volatile long *row, int cnts, long loops)
+{
+	long i;
+	int c;
+
+	for(i = 0; i < loops; i++) {
+		for(c = 0; c < cnts; c += 4) {
+			row[c]++;
+		}
+		row[cnts - 1]++;
+	}
+}
+
+static double run_layout(char *mem, int procs, int cnts, int row_len,
+		long loops, int aligned)
+{
+	volatile long *vals;
+	unsigned long long t0, t1;
+	int p;
+	pid_t pid;
+
+	if(aligned) {
+		vals = (long *)(((unsigned long)mem + CACHELINE_PAD - 1)
+						& ~((unsigned long)CACHELINE_PAD - 1));
+	} else {
+		/* like an unaligned shm_malloc() result */
+		vals = (long *)(((unsigned long)mem
+								& ~((unsigned long)CACHELINE_PAD - 1))
+						+ CACHELINE_PAD - sizeof(long));
+	}
+	memset((void *)vals, 0, (size_t)procs * row_len * sizeof(long));
+
+	t0 = now_ns();
+	for(p = 0; p < procs; p++) {
+		pid = fork();
+		if(pid < 0) {
+			perror("fork");
+			exit(-1);
+		}
+		if(pid == 0) {
+			run_proc(vals + (long)p * row_len, cnts, loops);
+			_exit(0);
+		}
+	}
+	for(p = 0; p < procs; p++) {
+		wait(NULL);
+	}
+	t1 = now_ns();
+	/* millions of increments per second, for all processes */
+	return (double)procs * loops * (cnts / 4 + 1 + (cnts % 4 ? 1 : 0)) * 1000.0
+		   / (double)(t1 - t0);
+}
+
+static void run_reads(char *mem, int procs, int cnts, int row_len, int loops)
+{
+	long *vals;
+	long *sums;
+	unsigned long long t0, t1;
+	volatile long sink = 0;
+	long v;
+	int i, c, r;
+
+	vals = (long *)(((unsigned long)mem + CACHELINE_PAD - 1)
+					& ~((unsigned long)CACHELINE_PAD - 1));
+	sums = malloc(sizeof(long) * cnts);
+	if(sums == NULL) {
+		exit(-1);
+	}
+
+	t0 = now_ns();
+	for(i = 0; i < loops; i++) {
+		for(c = 0; c < cnts; c++) {
+			v = 0;
+			for(r = 0; r < procs; r++) {
+				v += vals[(long)r * row_len + c];
+			}
+			sink += v;
+		}
+	}
+	t1 = now_ns();
+	printf("  read per counter: %10.1f us/dump\n",
+			(double)(t1 - t0) / loops / 1000.0);
+
+	t0 = now_ns();
+	for(i = 0; i < loops; i++) {
+		memset(sums, 0, sizeof(long) * cnts);
+		for(r = 0; r < procs; r++) {
+			for(c = 0; c < cnts; c++) {
+				sums[c] += vals[(long)r * row_len + c];
+			}
+		}
+		for(c = 0; c < cnts; c++) {
+			sink += sums[c];
+		}
+	}
+	t1 = now_ns();
+	printf("  read snapshot:    %10.1f us/dump\n",
+			(double)(t1 - t0) / loops / 1000.0);
+	free(sums);
+}
+
+int main(int argc, char **argv)
+{
+	int max_procs = 8;
+	int cnts = 40;
+	long loops = 10000000;
+	int row_len;
+	int procs;
+	size_t size;
+	char *mem;
+	int c;
+
+	while((c = getopt(argc, argv, "p:c:n:")) != -1) {
+		switch(c) {
+			case 'p':
+				max_procs = atoi(optarg);
+				break;
+			case 'c':
+				cnts = atoi(optarg);
+				break;
+			case 'n':
+				loops = atol(optarg);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-p max_procs] [-c counters]"
+								" [-n loops]\n",
+						argv[0]);
+				return -1;
+		}
+	}
+	if(max_procs < 1 || cnts < 1 || loops < 1) {
+		fprintf(stderr, "invalid parameters\n");
+		return -1;
+	}
+
+	row_len = ((cnts * sizeof(long) - 1) / CACHELINE_PAD + 1) * CACHELINE_PAD
+			  / sizeof(long);
+	size = (size_t)max_procs * row_len * sizeof(long) + 2 * CACHELINE_PAD;
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			-1, 0);
+	if(mem == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	printf("counters: %d, row: %d, loops: %ld\n", cnts, row_len, loops);
+	printf("%6s %18s %14s\n", "procs", "misaligned Mops/s",
+			"aligned Mops/s");
+	for(procs = 1; procs <= max_procs; procs *= 2) {
+		printf("%6d %18.1f %14.1f\n", procs,
+				run_layout(mem, procs, cnts, row_len, loops, 0),
+				run_layout(mem, procs, cnts, row_len, loops, 1));
+		if(procs < max_procs && procs * 2 > max_procs) {
+			procs = max_procs / 2;
+		}
+	}
+	printf("reading %d counters of %d processes:\n", cnts, max_procs);
+	run_reads(mem, max_procs, cnts, row_len, 10000);
+
+	munmap(mem, size);
+	return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * benchmark for the prefix index (lib/pfxidx) against a per digit trie
+ *
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+/*
+ * Example gcc command line:
+ *  gcc -O2 -msse2 -Wall pfxidx_bench.c -o pfxidx_bench
+ *
+ * Usage:
+ *  ./pfxidx_bench [-n prefixes] [-l lookups] [-s seed]
+ *
+ * Builds n random digit prefixes (default 10M, 2 to 12 digits, most of
+ * them below a few hundred "country codes", like real routing tables)
+ * into:
+ *  - dtrie: one node per digit with a 10 pointers child array, like
+ *    lib/trie, drouting and prefix_route did
+ *  - pfxidx: the compact index of lib/pfxidx
+ * and prints the memory used, the build time and the average latency of
+ * the longest prefix match of random 12 digit numbers. The results of
+ * both structures are compared for every lookup.
+ *
+ * lib/pfxidx/pfxidx.c is included directly, with the shared memory and
+ * log functions replaced by the ones below.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+/* replacements for the core headers used by pfxidx.c */
+#define shm_mem_h
+#define dprint_h
+
+static unsigned long mem_used = 0;
+
+static void *bench_malloc(size_t size)
+{
+	size_t *p;
+
+	p = malloc(size + sizeof(size_t));
+	if(p == NULL)
+		return NULL;
+	*p = size;
+	mem_used += size;
+	return p + 1;
+}
+
+static void bench_free(void *ptr)
+{
+	size_t *p;
+
+	if(ptr == NULL)
+		return;
+	p = (size_t *)ptr - 1;
+	mem_used -= *p;
+	free(p);
+}
+
+static void *bench_realloc(void *ptr, size_t size)
+{
+	size_t *p;
+
+	if(ptr == NULL)
+		return bench_malloc(size);
+	p = (size_t *)ptr - 1;
+	mem_used -= *p;
+	p = realloc(p, size + sizeof(size_t));
+	if(p == NULL)
+		return NULL;
+	*p = size;
+	mem_used += size;
+	return p + 1;
+}
+
+#define shm_malloc(s) bench_malloc(s)
+#define shm_free(p) bench_free(p)
+#define shm_realloc(p, s) bench_realloc((p), (s))
+#define SHM_MEM_ERROR fprintf(stderr, "out of memory\n")
+#define LM_ERR(fmt, args...) fprintf(stderr, fmt, ##args)
+#define LM_WARN(fmt, args...) fprintf(stderr, fmt, ##args)
+#define LM_DBG(fmt, args...)
+
+#include "../../../src/lib/pfxidx/pfxidx.c"
+
+/* per digit trie */
+typedef struct dnode
+{
+	struct dnode **child;
+	void *data;
+} dnode_t;
+
+static dnode_t *dnode_new(void)
+{
+	dnode_t *n;
+
+	n = bench_malloc(sizeof(dnode_t));
+	n->child = bench_malloc(10 * sizeof(dnode_t *));
+	memset(n->child, 0, 10 * sizeof(dnode_t *));
+	n->data = NULL;
+	return n;
+}
+
+static void dtrie_add(dnode_t *root, const char *s, int len, void *data)
+{
+	int i;
+
+	for(i = 0; i < len; i++) {
+		if(root->child[s[i] - '0'] == NULL)
+			root->child[s[i] - '0'] = dnode_new();
+		root = root->child[s[i] - '0'];
+	}
+	root->data = data;
+}
+
+static void *dtrie_longest(dnode_t *root, const char *s, int len)
+{
+	void *ret;
+	int i;
+
+	ret = root->data;
+	for(i = 0; i < len; i++) {
+		root = root->child[s[i] - '0'];
+		if(root == NULL)
+			break;
+		if(root->data)
+			ret = root->data;
+	}
+	return ret;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void rand_digits(char *s, int len, unsigned int *seed)
+{
+	int i;
+
+	for(i = 0; i < len; i++)
+		s[i] = '0' + rand_r(seed) % 10;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int n = 10000000;
+	unsigned int nl = 2000000;
+	unsigned int seed = 1;
+	unsigned int i;
+	unsigned long mem;
+	unsigned long mismatch;
+	char cc[300][4];
+	char *nums;
+	char *keys;
+	char *c;
+	int clen;
+	int len;
+	int opt;
+	double t;
+	dnode_t *root;
+	pfx_builder_t *b;
+	pfx_index_t *idx;
+	pfx_stats_t st;
+	void **slot;
+	void *r1, *r2;
+
+	while((opt = getopt(argc, argv, "n:l:s:")) != -1) {
+		switch(opt) {
+			case 'n':
+				n = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				nl = strtoul(optarg, NULL, 10);
+				break;
+			case 's':
+				seed = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-n prefixes] [-l lookups] "
+								"[-s seed]\n",
+						argv[0]);
+				return 1;
+		}
+	}
+
+	/* country codes of 1 to 3 digits */
+	for(i = 0; i < 300; i++) {
+		len = 1 + rand_r(&seed) % 3;
+		rand_digits(cc[i], len, &seed);
+		cc[i][len] = '\0';
+	}
+
+	/* 16 bytes per prefix: length and digits */
+	keys = malloc((size_t)n * 16);
+	for(i = 0; i < n; i++) {
+		if(rand_r(&seed) % 16 == 0) {
+			len = 2 + rand_r(&seed) % 11;
+			rand_digits(keys + i * 16 + 1, len, &seed);
+		} else {
+			c = cc[rand_r(&seed) % 300];
+			clen = strlen(c);
+			len = clen + 1 + rand_r(&seed) % (12 - clen);
+			memcpy(keys + i * 16 + 1, c, clen);
+			rand_digits(keys + i * 16 + 1 + clen, len - clen, &seed);
+		}
+		keys[i * 16] = (char)len;
+	}
+
+	mem = mem_used;
+	t = now();
+	root = dnode_new();
+	for(i = 0; i < n; i++)
+		dtrie_add(root, keys + i * 16 + 1, keys[i * 16],
+				(void *)(unsigned long)(i + 1));
+	printf("dtrie:  build %.2fs, memory %lu MB\n", now() - t,
+			(mem_used - mem) >> 20);
+
+	mem = mem_used;
+	t = now();
+	b = pfx_builder_new();
+	for(i = 0; i < n; i++) {
+		slot = pfx_builder_slot(b, keys + i * 16 + 1, keys[i * 16]);
+		if(slot == NULL)
+			return 1;
+		*slot = (void *)(unsigned long)(i + 1);
+	}
+	idx = pfx_index_build(b);
+	pfx_builder_free(b, NULL);
+	if(idx == NULL)
+		return 1;
+	pfx_index_stats(idx, &st);
+	printf("pfxidx: build %.2fs, memory %lu MB (%u prefixes, %u nodes)\n",
+			now() - t, (mem_used - mem) >> 20, st.prefixes, st.nodes);
+
+	/* the numbers to look up, 12 digits */
+	nums = malloc((size_t)nl * 12);
+	seed = 7;
+	rand_digits(nums, nl * 12, &seed);
+
+	/* each lookup depends on the result of the previous one, so the time
+	 * is the latency of a lookup, as for one call routing a request */
+	r1 = NULL;
+	t = now();
+	for(i = 0; i < nl; i++)
+		r1 = dtrie_longest(
+				root, nums + (i ^ ((unsigned long)r1 & 1)) % nl * 12, 12);
+	printf("dtrie:  lookup %.0f ns (%p)\n", (now() - t) * 1e9 / nl, r1);
+
+	r2 = NULL;
+	t = now();
+	for(i = 0; i < nl; i++)
+		r2 = pfx_index_longest(
+				idx, nums + (i ^ ((unsigned long)r2 & 1)) % nl * 12, 12, NULL);
+	printf("pfxidx: lookup %.0f ns (%p)\n", (now() - t) * 1e9 / nl, r2);
+
+	/* the same prefix added twice keeps the last value in both */
+	mismatch = 0;
+	for(i = 0; i < nl; i++) {
+		r1 = dtrie_longest(root, nums + i * 12, 12);
+		r2 = pfx_index_longest(idx, nums + i * 12, 12, NULL);
+		if(r1 != r2)
+			mismatch++;
+	}
+	printf("mismatches: %lu\n", mismatch);
+
+	pfx_index_free(idx, NULL);
+	free(nums);
+	free(keys);
+	return mismatch ? 1 : 0;
+}
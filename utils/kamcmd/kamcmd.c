@@ -105,6 +105,8 @@ Options:\n\
                 %v at the places where values read from the reply should be\n\
                 substituted. To print '%v', escape it using '%': %%v.\n\
     -b          use binrpc protocol\n\
+    -S          ask for streamed (partial) replies in binrpc mode, printed\n\
+                as they arrive (e.g., for ul.dump on large data sets)\n\
     -j          use jsonrpc protocol\n\
     -t timeout  timeout in seconds to wait for jsonrpc response\n\
     -z size     size in kilobytes for jsonrpc response buffer\n\
@@ -131,6 +133,7 @@ Examples:\n\
 
 
 int verbose = 0;
+int stream_replies = 0; /* ask for partial replies (-S) */
 char *reply_socket = 0; /* unix datagram reply socket name */
 char *sock_dir = 0;		/* same as above, but only the directory */
 char *unix_socket = 0;
@@ -601,8 +604,10 @@ static void hexdump(unsigned char *buf, int len, int ascii)
 }
 
 
-/* returns: -1 on error, number of bytes written on success */
-static int send_binrpc_cmd(int s, struct binrpc_cmd *cmd, int cookie)
+/* returns: -1 on error, number of bytes written on success
+ * type is BINRPC_REQ or BINRPC_REQ_STREAM */
+static int send_binrpc_req(
+		int s, struct binrpc_cmd *cmd, int cookie, int type)
 {
 	struct iovec v[IOVEC_CNT];
 	int r;
@@ -637,7 +642,7 @@ static int send_binrpc_cmd(int s, struct binrpc_cmd *cmd, int cookie)
 		if(ret < 0)
 			goto binrpc_err;
 	}
-	ret = binrpc_build_hdr(BINRPC_REQ, binrpc_pkt_len(&body), cookie, msg_hdr,
+	ret = binrpc_build_hdr(type, binrpc_pkt_len(&body), cookie, msg_hdr,
 			BINRPC_MAX_HDR_SIZE);
 	if(ret < 0)
 		goto binrpc_err;
@@ -660,6 +665,12 @@ binrpc_err:
 }
 
 
+static int send_binrpc_cmd(int s, struct binrpc_cmd *cmd, int cookie)
+{
+	return send_binrpc_req(s, cmd, cookie, BINRPC_REQ);
+}
+
+
 static int binrpc_errno = 0;
 
 /* reads the whole reply
@@ -668,9 +679,13 @@ static int binrpc_errno = 0;
  * error returns: -1 - read error (check errno)
  *                -2 - binrpc parse error (check binrpc_errno)
  *                -3 - cookie error (the cookied doesn't match)
- *                -4 - message too big */
-static int get_reply(int s, unsigned char *reply_buf, int max_reply_size,
-		int cookie, struct binrpc_parse_ctx *in_pkt, unsigned char **body)
+ *                -4 - message too big
+ * extra - on input the number of bytes already in reply_buf, on output
+ *         the number of bytes read after the end of the reply (start of
+ *         the next one, for streamed replies) */
+static int get_reply_ex(int s, unsigned char *reply_buf, int max_reply_size,
+		int cookie, struct binrpc_parse_ctx *in_pkt, unsigned char **body,
+		int *extra)
 {
 	unsigned char *crt;
 	unsigned char *hdr_end;
@@ -678,26 +693,35 @@ static int get_reply(int s, unsigned char *reply_buf, int max_reply_size,
 	int n;
 	int ret;
 
-	hdr_end = crt = reply_buf;
+	hdr_end = reply_buf;
+	crt = reply_buf + *extra;
 	msg_end = reply_buf + max_reply_size;
 	binrpc_errno = 0;
+	n = *extra;
+	*extra = 0;
 	do {
-		n = read(s, crt, (int)(msg_end - crt));
-		if(n <= 0) {
-			if(errno == EINTR)
-				continue;
-			goto error_read;
-		}
-		if(verbose >= 3) {
-			/* dump it in hex */
-			printf("received %d bytes in reply (@offset %d):\n", n,
-					(int)(crt - reply_buf));
-			hexdump(crt, n, 1);
+		if(n == 0) {
+			n = read(s, crt, (int)(msg_end - crt));
+			if(n <= 0) {
+				if(errno == EINTR) {
+					n = 0;
+					continue;
+				}
+				goto error_read;
+			}
+			if(verbose >= 3) {
+				/* dump it in hex */
+				printf("received %d bytes in reply (@offset %d):\n", n,
+						(int)(crt - reply_buf));
+				hexdump(crt, n, 1);
+			}
+			crt += n;
 		}
-		crt += n;
+		n = 0;
 		/* parse header if not parsed yet */
 		if(hdr_end == reply_buf) {
-			hdr_end = binrpc_parse_init(in_pkt, reply_buf, n, &ret);
+			hdr_end = binrpc_parse_init(
+					in_pkt, reply_buf, (int)(crt - reply_buf), &ret);
 			if(ret < 0) {
 				if(ret == E_BINRPC_MORE_DATA)
 					continue;
@@ -740,6 +764,7 @@ static int get_reply(int s, unsigned char *reply_buf, int max_reply_size,
 	} while(crt < msg_end);
 
 	*body = hdr_end;
+	*extra = (int)(crt - msg_end);
 	return (int)(msg_end - reply_buf);
 error_read:
 	return -1;
@@ -753,6 +778,17 @@ error_toolong:
 }
 
 
+static int get_reply(int s, unsigned char *reply_buf, int max_reply_size,
+		int cookie, struct binrpc_parse_ctx *in_pkt, unsigned char **body)
+{
+	int extra;
+
+	extra = 0;
+	return get_reply_ex(
+			s, reply_buf, max_reply_size, cookie, in_pkt, body, &extra);
+}
+
+
 /* returns a malloced copy of str, with all the escapes ('\') resolved */
 static char *str_escape(char *str)
 {
@@ -938,18 +974,23 @@ static int run_binrpc_cmd(int s, struct binrpc_cmd *cmd, char *fmt)
 	unsigned char *msg_body;
 	struct binrpc_parse_ctx in_pkt;
 	int ret;
+	int extra;
 
 	cookie = gen_cookie();
-	if((ret = send_binrpc_cmd(s, cmd, cookie)) < 0) {
+	if((ret = send_binrpc_req(s, cmd, cookie,
+				stream_replies ? BINRPC_REQ_STREAM : BINRPC_REQ))
+			< 0) {
 		if(ret == -1)
 			goto error_send;
 		else
 			goto binrpc_err;
 	}
+	extra = 0;
+read_reply:
 	/* read reply */
 	memset(&in_pkt, 0, sizeof(in_pkt));
-	if((ret = get_reply(
-				s, reply_buf, MAX_REPLY_SIZE, cookie, &in_pkt, &msg_body))
+	if((ret = get_reply_ex(s, reply_buf, MAX_REPLY_SIZE, cookie, &in_pkt,
+				&msg_body, &extra))
 			< 0) {
 		switch(ret) {
 			case -1:
@@ -974,6 +1015,17 @@ static int run_binrpc_cmd(int s, struct binrpc_cmd *cmd, char *fmt)
 				goto error;
 			}
 			break;
+		case BINRPC_REPL_CHUNK:
+			/* partial reply of a streamed request, print it and wait
+			 * for the next one */
+			if(print_body(&in_pkt, msg_body, in_pkt.tlen, fmt) < 0) {
+				goto error;
+			}
+			fflush(stdout);
+			if(extra > 0) {
+				memmove(reply_buf, reply_buf + ret, extra);
+			}
+			goto read_reply;
 		default:
 			fprintf(stderr, "ERROR: not a reply\n");
 			goto error;
@@ -2309,7 +2361,7 @@ int main(int argc, char **argv)
 	sock_name = 0;
 	sock_type = UNIXS_SOCK;
 	opterr = 0;
-	while((c = getopt(argc, argv, "UVhbjs:D:R:vf:t:z:")) != -1) {
+	while((c = getopt(argc, argv, "UVhbjSs:D:R:vf:t:z:")) != -1) {
 		switch(c) {
 			case 'V':
 				printf("version: %s\n", version);
@@ -2339,6 +2391,9 @@ int main(int argc, char **argv)
 			case 'j':
 				_kamcmd_rpc_type = KAMCMD_JSONRPC;
 				break;
+			case 'S':
+				stream_replies = 1;
+				break;
 			case 't':
 				_kamcmd_read_timeout = (int)atol(optarg);
 				if(_kamcmd_read_timeout < 0) {
@@ -0,0 +1,497 @@
+/*
+ * Copyright (C) 2026 Kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Builds a compact mtree image file from a list of prefix - value records,
+ * to be used with the 'file' attribute of the mtree module parameter.
+ *
+ * The input has one record per line: the prefix, a separator (tab or
+ * space by default) and the value (the rest of the line). Empty lines
+ * and lines starting with '#' are skipped. The image is written to a
+ * temporary file, which is renamed to the output file at the end, so a
+ * running Kamailio can be switched to it with the mtree.reload command.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "../../src/modules/mtree/mtree_cimg.h"
+
+#define MTC_MAX_PREFIX 63
+#define MTC_DUP_ERROR 0
+#define MTC_DUP_IGNORE 1
+#define MTC_DUP_ALLOW 2
+
+typedef struct mtc_item
+{
+	char *prefix;
+	uint32_t plen;
+	uint32_t sid; /* id of the value string */
+	uint32_t seq; /* position in the input */
+} mtc_item_t;
+
+/* growing array */
+typedef struct mtc_buf
+{
+	char *b;
+	size_t len;
+	size_t size;
+} mtc_buf_t;
+
+static mtc_item_t *_items = NULL;
+static size_t _nitems = 0;
+
+/* distinct values, with an open addressing hash table */
+static mtc_buf_t _strings;
+static mtc_buf_t _stroffs;
+static uint32_t _nstrings = 0;
+static uint32_t *_strhash = NULL;
+static size_t _strhash_size = 0;
+
+static void *mtc_buf_add(mtc_buf_t *mb, const void *data, size_t len)
+{
+	size_t nsize;
+	char *nb;
+
+	if(mb->len + len > mb->size) {
+		nsize = (mb->size == 0) ? 4096 : mb->size;
+		while(nsize < mb->len + len)
+			nsize *= 2;
+		nb = realloc(mb->b, nsize);
+		if(nb == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(-1);
+		}
+		mb->b = nb;
+		mb->size = nsize;
+	}
+	if(data != NULL)
+		memcpy(mb->b + mb->len, data, len);
+	else
+		memset(mb->b + mb->len, 0, len);
+	mb->len += len;
+	return mb->b + mb->len - len;
+}
+
+static uint32_t mtc_hash(const char *s, int len)
+{
+	uint32_t h = 2166136261U;
+	int i;
+
+	for(i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void mtc_strhash_grow(void)
+{
+	uint32_t *nh;
+	size_t nsize;
+	uint32_t *offs;
+	uint32_t i;
+	size_t k;
+
+	nsize = (_strhash_size == 0) ? 1024 : 2 * _strhash_size;
+	nh = calloc(nsize, sizeof(uint32_t));
+	if(nh == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(-1);
+	}
+	offs = (uint32_t *)_stroffs.b;
+	for(i = 0; i < _nstrings; i++) {
+		k = mtc_hash(_strings.b + offs[i], offs[i + 1] - offs[i]) & (nsize - 1);
+		while(nh[k] != 0)
+			k = (k + 1) & (nsize - 1);
+		nh[k] = i + 1;
+	}
+	free(_strhash);
+	_strhash = nh;
+	_strhash_size = nsize;
+}
+
+/**
+ * id of the value, added to the strings pool if new
+ */
+static uint32_t mtc_string_id(const char *s, int len)
+{
+	uint32_t *offs;
+	uint32_t off;
+	uint32_t sid;
+	size_t k;
+
+	if(_stroffs.len == 0) {
+		off = 0;
+		mtc_buf_add(&_stroffs, &off, sizeof(uint32_t));
+	}
+	if((_nstrings + 1) * 2 > _strhash_size)
+		mtc_strhash_grow();
+	offs = (uint32_t *)_stroffs.b;
+	k = mtc_hash(s, len) & (_strhash_size - 1);
+	while(_strhash[k] != 0) {
+		sid = _strhash[k] - 1;
+		if(offs[sid + 1] - offs[sid] == (uint32_t)len
+				&& memcmp(_strings.b + offs[sid], s, len) == 0)
+			return sid;
+		k = (k + 1) & (_strhash_size - 1);
+	}
+	if(_strings.len + len > 0xffffffffUL) {
+		fprintf(stderr, "too much value data\n");
+		exit(-1);
+	}
+	mtc_buf_add(&_strings, s, len);
+	off = (uint32_t)_strings.len;
+	mtc_buf_add(&_stroffs, &off, sizeof(uint32_t));
+	_strhash[k] = _nstrings + 1;
+	return _nstrings++;
+}
+
+static int mtc_item_cmp(const void *a, const void *b)
+{
+	const mtc_item_t *x = a;
+	const mtc_item_t *y = b;
+	uint32_t l;
+	int r;
+
+	l = (x->plen < y->plen) ? x->plen : y->plen;
+	r = memcmp(x->prefix, y->prefix, l);
+	if(r != 0)
+		return r;
+	if(x->plen != y->plen)
+		return (x->plen < y->plen) ? -1 : 1;
+	/* same prefix - the last added first */
+	return (x->seq < y->seq) ? 1 : -1;
+}
+
+static int mtc_read(FILE *f, const char *seps)
+{
+	char *line = NULL;
+	size_t lsize = 0;
+	ssize_t n;
+	size_t isize = 0;
+	unsigned long lno = 0;
+	char *p;
+	char *v;
+
+	while((n = getline(&line, &lsize, f)) >= 0) {
+		lno++;
+		while(n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+			line[--n] = '\0';
+		if(n == 0 || line[0] == '#')
+			continue;
+		p = line;
+		v = p + strcspn(p, seps);
+		if(*v == '\0' || v == p) {
+			fprintf(stderr, "invalid record at line %lu\n", lno);
+			return -1;
+		}
+		if(v - p > MTC_MAX_PREFIX) {
+			fprintf(stderr, "prefix too long at line %lu\n", lno);
+			return -1;
+		}
+		*v++ = '\0';
+		if(*v == '\0') {
+			fprintf(stderr, "empty value at line %lu\n", lno);
+			return -1;
+		}
+		if(_nitems == isize) {
+			isize = (isize == 0) ? 65536 : 2 * isize;
+			_items = realloc(_items, isize * sizeof(mtc_item_t));
+			if(_items == NULL) {
+				fprintf(stderr, "out of memory\n");
+				return -1;
+			}
+		}
+		_items[_nitems].plen = (uint32_t)strlen(p);
+		_items[_nitems].prefix = malloc(_items[_nitems].plen);
+		if(_items[_nitems].prefix == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return -1;
+		}
+		memcpy(_items[_nitems].prefix, p, _items[_nitems].plen);
+		_items[_nitems].sid = mtc_string_id(v, strlen(v));
+		_items[_nitems].seq = (uint32_t)_nitems;
+		_nitems++;
+	}
+	free(line);
+	return 0;
+}
+
+static int mtc_same_prefix(mtc_item_t *a, mtc_item_t *b)
+{
+	return a->plen == b->plen && memcmp(a->prefix, b->prefix, a->plen) == 0;
+}
+
+/**
+ * write len bytes of data, padded with zeros to size
+ */
+static int mtc_fwrite(FILE *f, const void *data, size_t len, size_t size)
+{
+	static const char zeros[8] = {0};
+
+	if(len > 0 && fwrite(data, 1, len, f) != len)
+		return -1;
+	if(size > len && fwrite(zeros, 1, size - len, f) != size - len)
+		return -1;
+	return 0;
+}
+
+/**
+ * build the path compressed trie over the sorted items and write it
+ */
+static int mtc_write(const char *fname, int dups)
+{
+	mtc_buf_t nodes = {0};
+	mtc_buf_t labels = {0};
+	mtc_buf_t vlists = {0};
+	mtc_buf_t ranges = {0};
+	mt_cimg_hdr_t hdr;
+	mt_cimg_node_t *nd;
+	uint32_t *single = NULL;
+	uint32_t *rg;
+	uint32_t r[3];
+	uint32_t i, j, k, e, lo, hi, start;
+	uint32_t cnt;
+	uint32_t maxlen = 0;
+	uint32_t nitems = 0;
+	size_t ni;
+	char *tmpname;
+	FILE *f;
+
+	single = calloc(_nstrings + 1, sizeof(uint32_t));
+	tmpname = malloc(strlen(fname) + 8);
+	if(single == NULL || tmpname == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	/* the root - keys are [lo, hi) of the unique prefixes */
+	mtc_buf_add(&nodes, NULL, sizeof(mt_cimg_node_t));
+	r[0] = 0;
+	r[1] = (uint32_t)_nitems;
+	r[2] = 0;
+	mtc_buf_add(&ranges, r, sizeof(r));
+
+	/* nodes are numbered in the order they are processed (breadth first),
+	 * so the children of a node get consecutive indexes */
+	for(ni = 0; ni < nodes.len / sizeof(mt_cimg_node_t); ni++) {
+		rg = (uint32_t *)ranges.b + 3 * ni;
+		lo = rg[0];
+		hi = rg[1];
+		start = rg[2];
+		/* the label ends at the common prefix of the range, or at the end
+		 * of its first (shortest) key */
+		if(ni == 0) {
+			e = 0;
+		} else {
+			e = _items[lo].plen;
+			for(k = start; k < e && k < _items[hi - 1].plen
+						   && _items[lo].prefix[k] == _items[hi - 1].prefix[k];
+					k++)
+				;
+			e = k;
+		}
+		nd = (mt_cimg_node_t *)nodes.b + ni;
+		nd->label = (uint32_t)labels.len;
+		nd->llen = (uint8_t)(e - start);
+		mtc_buf_add(&labels, _items[lo].prefix + start, e - start);
+		if(labels.len > 0xffffffffUL) {
+			fprintf(stderr, "too many nodes\n");
+			return -1;
+		}
+
+		if(ni != 0 && _items[lo].plen == e) {
+			/* the prefix ends here - collect its values */
+			for(i = lo + 1; i < hi && mtc_same_prefix(&_items[lo], &_items[i]);
+					i++)
+				;
+			if(i - lo > 1 && dups == MTC_DUP_ERROR) {
+				fprintf(stderr, "duplicated prefix [%.*s]\n",
+						(int)_items[lo].plen, _items[lo].prefix);
+				return -1;
+			}
+			cnt = (dups == MTC_DUP_ALLOW) ? i - lo : 1;
+			if(dups == MTC_DUP_IGNORE)
+				/* keep the first added */
+				lo = i - 1;
+			if(cnt == 1 && single[_items[lo].sid] != 0) {
+				nd->vlist = single[_items[lo].sid];
+			} else {
+				nd->vlist = (uint32_t)(vlists.len / sizeof(uint32_t)) + 1;
+				mtc_buf_add(&vlists, &cnt, sizeof(uint32_t));
+				for(j = lo; j < lo + cnt; j++)
+					mtc_buf_add(&vlists, &_items[j].sid, sizeof(uint32_t));
+				if(cnt == 1)
+					single[_items[lo].sid] = nd->vlist;
+			}
+			nitems += cnt;
+			if(e > maxlen)
+				maxlen = e;
+			lo = i;
+		}
+
+		/* children - one per next char */
+		nd->child = (uint32_t)(nodes.len / sizeof(mt_cimg_node_t));
+		nd->nchild = 0;
+		for(i = lo; i < hi; i = j) {
+			for(j = i + 1; j < hi && _items[j].prefix[e] == _items[i].prefix[e];
+					j++)
+				;
+			r[0] = i;
+			r[1] = j;
+			r[2] = e;
+			mtc_buf_add(&ranges, r, sizeof(r));
+			mtc_buf_add(&nodes, NULL, sizeof(mt_cimg_node_t));
+			/* the buffer may have been moved */
+			nd = (mt_cimg_node_t *)nodes.b + ni;
+			nd->nchild++;
+		}
+		if(nodes.len / sizeof(mt_cimg_node_t) > 0xffffffffUL) {
+			fprintf(stderr, "too many nodes\n");
+			return -1;
+		}
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = MT_CIMG_MAGIC;
+	hdr.version = MT_CIMG_VERSION;
+	hdr.nnodes = (uint32_t)(nodes.len / sizeof(mt_cimg_node_t));
+	hdr.nlabels = (uint32_t)labels.len;
+	hdr.nvlists = (uint32_t)(vlists.len / sizeof(uint32_t));
+	hdr.nstrings = _nstrings;
+	hdr.nitems = nitems;
+	hdr.maxlen = maxlen;
+	hdr.strsize = _strings.len;
+	hdr.ctime = (uint64_t)time(NULL);
+	hdr.size = MT_CIMG_SIZE(&hdr);
+	if(_nstrings == 0) {
+		k = 0;
+		mtc_buf_add(&_stroffs, &k, sizeof(uint32_t));
+	}
+
+	sprintf(tmpname, "%s.tmp", fname);
+	f = fopen(tmpname, "w");
+	if(f == NULL) {
+		fprintf(stderr, "cannot open %s: %s\n", tmpname, strerror(errno));
+		return -1;
+	}
+	if(mtc_fwrite(f, &hdr, sizeof(hdr), MT_CIMG_NODES_OFF(&hdr)) < 0
+			|| mtc_fwrite(f, nodes.b, nodes.len, nodes.len) < 0
+			|| mtc_fwrite(f, labels.b, labels.len,
+					   MT_CIMG_VLISTS_OFF(&hdr) - MT_CIMG_LABELS_OFF(&hdr))
+					   < 0
+			|| mtc_fwrite(f, vlists.b, vlists.len, vlists.len) < 0
+			|| mtc_fwrite(f, _stroffs.b, _stroffs.len,
+					   MT_CIMG_STRINGS_OFF(&hdr) - MT_CIMG_STROFFS_OFF(&hdr))
+					   < 0
+			|| mtc_fwrite(f, _strings.b, _strings.len, _strings.len) < 0) {
+		fprintf(stderr, "cannot write %s: %s\n", tmpname, strerror(errno));
+		fclose(f);
+		unlink(tmpname);
+		return -1;
+	}
+	if(fflush(f) != 0 || fsync(fileno(f)) != 0 || fclose(f) != 0) {
+		fprintf(stderr, "cannot write %s: %s\n", tmpname, strerror(errno));
+		unlink(tmpname);
+		return -1;
+	}
+	if(rename(tmpname, fname) != 0) {
+		fprintf(stderr, "cannot rename %s: %s\n", tmpname, strerror(errno));
+		unlink(tmpname);
+		return -1;
+	}
+	fprintf(stderr,
+			"%s: %u items, %u nodes, %u distinct values, %llu bytes\n", fname,
+			hdr.nitems, hdr.nnodes, hdr.nstrings,
+			(unsigned long long)hdr.size);
+	free(single);
+	free(tmpname);
+	return 0;
+}
+
+static void mtc_usage(const char *name)
+{
+	fprintf(stderr,
+			"usage: %s [-i | -a] [-s separators] -o <output file> [input file]\n"
+			"  -i - ignore duplicated prefixes, keeping the first value\n"
+			"  -a - allow duplicated prefixes, keeping all the values\n"
+			"  -s - chars separating the prefix from the value (default tab"
+			" and space)\n"
+			"  the input is read from stdin if no file is given\n",
+			name);
+}
+
+int main(int argc, char **argv)
+{
+	const char *seps = "\t ";
+	const char *out = NULL;
+	int dups = MTC_DUP_ERROR;
+	FILE *f;
+	int c;
+
+	while((c = getopt(argc, argv, "ias:o:h")) != -1) {
+		switch(c) {
+			case 'i':
+				dups = MTC_DUP_IGNORE;
+				break;
+			case 'a':
+				dups = MTC_DUP_ALLOW;
+				break;
+			case 's':
+				seps = optarg;
+				break;
+			case 'o':
+				out = optarg;
+				break;
+			default:
+				mtc_usage(argv[0]);
+				return -1;
+		}
+	}
+	if(out == NULL || argc - optind > 1) {
+		mtc_usage(argv[0]);
+		return -1;
+	}
+	if(optind < argc) {
+		f = fopen(argv[optind], "r");
+		if(f == NULL) {
+			fprintf(stderr, "cannot open %s: %s\n", argv[optind],
+					strerror(errno));
+			return -1;
+		}
+	} else {
+		f = stdin;
+	}
+	if(mtc_read(f, seps) < 0)
+		return -1;
+	if(f != stdin)
+		fclose(f);
+
+	qsort(_items, _nitems, sizeof(mtc_item_t), mtc_item_cmp);
+	if(mtc_write(out, dups) < 0)
+		return -1;
+	return 0;
+}